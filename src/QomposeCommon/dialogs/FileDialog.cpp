@@ -47,7 +47,10 @@ FileDescriptor FileDialog::getNullDescriptor()
 
 FileDescriptor FileDialog::getPathDescriptor(const QString &p)
 {
-	FileDescriptor desc = {p, encoding_utils::detectTextCodec(p)};
+	// Only sample the start of the file, so opening very large files
+	// doesn't block on validating them. Buffer confirms the encoding as
+	// it reads the rest of the file.
+	FileDescriptor desc = {p, encoding_utils::detectTextCodec(p, true)};
 
 	if(desc.textCodec.isNull())
 	{
@@ -19,29 +19,54 @@
 #include "Buffer.h"
 
 #include <QByteArray>
+#include <QCoreApplication>
 #include <QDir>
+#include <QEvent>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QMessageBox>
+#include <QMetaObject>
 #include <QPrinter>
+#include <QResizeEvent>
+#include <QScrollBar>
 #include <QString>
 #include <QTextBlock>
 #include <QTextCodec>
 #include <QTextCursor>
-#include <QTextStream>
+#include <QThread>
 #include <QVariant>
 
 #include <bdrck/fs/Util.hpp>
 
 #include "core/Types.hpp"
 #include "core/config/Configuration.hpp"
+#include "core/document/PieceTable.hpp"
+#include "core/document/TextScanner.hpp"
+#include "core/file/FileWatcher.hpp"
+#include "core/file/MMIOFile.hpp"
+#include "core/file/MMIOPrefetcher.hpp"
+#include "core/string/Transcoder.hpp"
 
 #include "QomposeCommon/Defines.h"
+#include "QomposeCommon/dialogs/EncodingDialog.h"
+#include "QomposeCommon/editor/DocumentView.h"
+#include "QomposeCommon/editor/LargeFileLoader.h"
 #include "QomposeCommon/editor/pane/Pane.h"
+#include "QomposeCommon/fs/DocumentSaver.h"
 #include "QomposeCommon/fs/DocumentWriter.h"
 #include "QomposeCommon/gui/BufferWidget.h"
 
+namespace
+{
+/*!
+ * Files at least this large are opened in large file mode, rather than
+ * being decoded into a QTextDocument, if they are UTF-8 or if they are in
+ * one of the encodings core::string::TextDecoder supports.
+ */
+constexpr qint64 LARGE_FILE_THRESHOLD = 32 * QMEGABYTE;
+}
+
 namespace qompose
 {
 namespace editor
@@ -51,7 +76,19 @@ Buffer::Buffer(Pane *pp, QWidget *p)
           configWatcher(new qompose::util::ConfigurationWatcher(this)),
           parentPane(pp),
           path(QString()),
-          codec("UTF-8")
+          codec("UTF-8"),
+          largeFile(false),
+          largeFileView(nullptr),
+          loaderThread(nullptr),
+          loadGeneration(0),
+          loadedPieces(),
+          loadedStatistics(),
+          statistics(),
+          mappedFile(),
+          mappedFileWatcher(),
+          contentsGeneration(0),
+          savingGeneration(0),
+          saverThread(nullptr)
 {
 	// Load our initial settings, and connect our settings object.
 
@@ -86,6 +123,13 @@ Buffer::Buffer(Pane *pp, QWidget *p)
 	                 SLOT(doModificationChanged(bool)));
 }
 
+Buffer::~Buffer()
+{
+	waitForSave();
+	stopLargeFileLoad();
+	watchMappedFile(nullptr);
+}
+
 Pane *Buffer::getParentPane() const
 {
 	return parentPane;
@@ -100,7 +144,7 @@ bool Buffer::open(const FileDescriptor &f)
 
 	bool r = read();
 
-	if(r)
+	if(r && !isLargeFile())
 	{
 		QTextCursor curs = textCursor();
 		curs.movePosition(QTextCursor::Start, QTextCursor::MoveAnchor);
@@ -115,6 +159,9 @@ bool Buffer::revert()
 	if(!hasBeenSaved())
 		return false;
 
+	if(isLargeFile())
+		return read(true);
+
 	QTextCursor curs = textCursor();
 	int cursPos = curs.position();
 
@@ -189,6 +236,7 @@ bool Buffer::prepareToClose()
 	if(b == QMessageBox::Yes)
 	{
 		save();
+		waitForSave();
 		if(!isModified())
 			return true;
 	}
@@ -295,6 +343,30 @@ void Buffer::setEncoding(const QByteArray &e)
 		revert();
 }
 
+bool Buffer::isLargeFile() const
+{
+	return largeFile;
+}
+
+core::document::TextStatistics const *Buffer::getTextStatistics() const
+{
+	return statistics.get();
+}
+
+int Buffer::getCurrentLine() const
+{
+	if(isLargeFile())
+		return static_cast<int>(largeFileView->getCurrentLine());
+	return Editor::getCurrentLine();
+}
+
+int Buffer::getCurrentColumn() const
+{
+	if(isLargeFile())
+		return static_cast<int>(largeFileView->getCurrentColumn());
+	return Editor::getCurrentColumn();
+}
+
 void Buffer::print(QPrinter *p)
 {
 	document()->print(p);
@@ -318,31 +390,265 @@ bool Buffer::read(bool u)
 	if(c == nullptr)
 		return false;
 
+	waitForSave();
+	stopLargeFileLoad();
+
+	QFileInfo info(getPath());
+	auto encoding = core::string::textEncodingFromName(
+	        c->name().toStdString());
+	// If the file can't be opened in large file mode (for instance,
+	// because it doesn't start with valid UTF-8 after all), read it
+	// normally instead, and let confirmEncoding() ask about it.
+	if((c->name() == "UTF-8" || !!encoding) &&
+	   info.size() >= LARGE_FILE_THRESHOLD && readLargeFile(encoding))
+	{
+		return true;
+	}
+	setLargeFileMode(false);
+
 	QFile file(getPath());
 
 	if(!file.open(QIODevice::ReadOnly))
 		return false;
 
-	QTextStream reader(&file);
-	reader.setCodec(c);
+	// Read the file once, and scan the same bytes we decode, so its
+	// statistics are available without reading it again. The
+	// QTextDocument keeps its own line index, so we don't need one.
+	QByteArray bytes = file.readAll();
+	statistics.reset();
+	if(c->name() == "UTF-8")
+	{
+		auto begin =
+		        reinterpret_cast<uint8_t const *>(bytes.constData());
+		statistics = std::make_shared<core::document::TextStatistics>(
+		        core::document::scanText(begin, begin + bytes.size(),
+		                                 false));
+	}
+	QString contents = c->toUnicode(bytes);
 
 	if(u)
 	{
 		selectAll();
-		insertPlainText(reader.readAll());
+		insertPlainText(contents);
 	}
 	else
 	{
-		setPlainText(reader.readAll());
+		setPlainText(contents);
 	}
 
 	setModified(false);
+	confirmEncoding();
 
 	return true;
 }
 
+bool Buffer::readLargeFile(
+        std::experimental::optional<core::string::TextEncoding> encoding)
+{
+	// Show the start of the file right away, and build the full piece
+	// table (which requires reading the entire file) in the background.
+
+	std::shared_ptr<core::file::MMIOFile> file;
+	core::document::PieceTable preview;
+	try
+	{
+		// The file is only ever read through the mapping (saving
+		// replaces it instead), so it doesn't need to be locked
+		// exclusively. It is read from start to end while loading.
+		file = std::make_shared<core::file::MMIOFile>(
+		        getPath().toStdString(),
+		        core::file::MMIOFileMode::Shared,
+		        core::file::MMIOAccessPattern::Sequential);
+
+		// The converted text is in memory, so a file which isn't
+		// UTF-8 can always be previewed, but a UTF-8 preview refers
+		// to the file, and fails if it isn't valid UTF-8.
+		if(!!encoding)
+			preview = makePreviewPieceTable(file, *encoding);
+		else
+			preview = makePreviewPieceTable(file);
+	}
+	catch(...)
+	{
+		return false;
+	}
+
+	setPlainText(QString());
+	setLargeFileMode(true);
+
+	largeFileView->setReadOnly(true);
+	largeFileView->setPieceTable(preview);
+	if(!!encoding)
+	{
+		// There's nothing to prefetch from the file.
+		largeFileView->setPrefetcher(nullptr);
+		watchMappedFile(nullptr);
+	}
+	else
+	{
+		// Huge pages are only a hint, which many kernels ignore for
+		// file mappings.
+		file->adviseHugePages(true);
+		largeFileView->setPrefetcher(
+		        std::make_shared<core::file::MMIOPrefetcher>(file));
+		watchMappedFile(file);
+	}
+
+	statistics.reset();
+	loadedPieces = std::make_shared<core::document::PieceTable>();
+	loadedStatistics = std::make_shared<core::document::TextStatistics>();
+	LargeFileLoader *loader =
+	        new LargeFileLoader(file, loadedPieces, loadedStatistics,
+	                            ++loadGeneration, encoding);
+	loaderThread = new QThread(this);
+	loader->moveToThread(loaderThread);
+
+	QObject::connect(loaderThread, &QThread::started, loader,
+	                 &LargeFileLoader::load);
+	QObject::connect(loader, &LargeFileLoader::loaded, loaderThread,
+	                 &QThread::quit);
+	QObject::connect(loader, &LargeFileLoader::loaded, this,
+	                 &Buffer::doLargeFileLoaded);
+	QObject::connect(loaderThread, &QThread::finished, loader,
+	                 &QObject::deleteLater);
+	loaderThread->start();
+
+	setModified(false);
+	return true;
+}
+
+void Buffer::setLargeFileMode(bool enabled)
+{
+	if(enabled && largeFileView == nullptr)
+	{
+		largeFileView = new DocumentView(this);
+		largeFileView->setGeometry(rect());
+
+		QObject::connect(largeFileView,
+		                 &DocumentView::cursorPositionChanged, this,
+		                 &Buffer::cursorPositionChanged);
+		QObject::connect(largeFileView, &DocumentView::contentsChanged,
+		                 this, &Buffer::doLargeFileContentsChanged);
+	}
+
+	if(largeFileView == nullptr)
+		return;
+
+	if(enabled)
+	{
+		largeFileView->setFont(font());
+		largeFileView->setGutterVisible(isGutterVisible());
+		largeFileView->setIndentationWidth(
+		        static_cast<int>(getIndentationWidth()));
+		largeFileView->setIndentationMode(getIndentationMode());
+		largeFileView->setWrapGuideVisible(isWrapGuideVisible());
+		largeFileView->setWrapGuideColumnWidth(
+		        getWrapGuideColumnWidth());
+		largeFileView->setWrapGuideColor(getWrapGuideColor());
+		largeFileView->setEditorForeground(getEditorForeground());
+		largeFileView->setEditorBackground(getEditorBackground());
+		largeFileView->setCurrentLineColor(getCurrentLineColor());
+		largeFileView->setGutterForeground(getGutterForeground());
+		largeFileView->setGutterBackground(getGutterBackground());
+	}
+	else
+	{
+		// Drop our references to the previous file's mapping.
+		largeFileView->setPieceTable(core::document::PieceTable());
+		largeFileView->setPrefetcher(nullptr);
+		watchMappedFile(nullptr);
+	}
+
+	largeFile = enabled;
+	setReadOnly(enabled);
+	largeFileView->setVisible(enabled);
+	setFocusProxy(enabled ? largeFileView : nullptr);
+}
+
+void Buffer::confirmEncoding()
+{
+	if(codec != "UTF-8" || !statistics || statistics->valid)
+		return;
+
+	QString message =
+	        tr("'%1' doesn't contain valid UTF-8 after all. Which "
+	           "character encoding should be used to open it?")
+	                .arg(QFileInfo(getPath()).fileName());
+	QString chosen =
+	        EncodingDialog::promptEncoding(this, codec, message);
+	if(chosen.isNull() || chosen == codec)
+		return;
+
+	codec = chosen;
+	Q_EMIT encodingChanged(codec.toLatin1());
+	read();
+}
+
+void Buffer::watchMappedFile(
+        std::shared_ptr<core::file::MMIOFile> const &file)
+{
+	mappedFileWatcher.reset();
+	mappedFile = file;
+	if(!mappedFile)
+		return;
+
+	// The watcher calls us back on its own thread, so just queue the
+	// notification for our thread. Destroying the watcher joins its
+	// thread, and Qt drops notifications queued for destroyed objects.
+	auto notify = [this]() {
+		QMetaObject::invokeMethod(this, "doMappedFileChanged",
+		                          Qt::QueuedConnection);
+	};
+	try
+	{
+		mappedFileWatcher.reset(new core::file::FileWatcher(
+		        getPath().toStdString(), notify));
+	}
+	catch(...)
+	{
+		// Without a watcher, we won't notice changes, but the file's
+		// mapping still guards against it being truncated.
+	}
+}
+
+void Buffer::stopLargeFileLoad()
+{
+	if(loaderThread == nullptr)
+		return;
+
+	// The loader can't be interrupted, so just wait for it to finish.
+	// It deletes itself once its thread stops, and bumping the
+	// generation makes us ignore its (possibly already queued) result.
+	++loadGeneration;
+	loaderThread->quit();
+	loaderThread->wait();
+	delete loaderThread;
+	loaderThread = nullptr;
+	loadedPieces.reset();
+	loadedStatistics.reset();
+}
+
+void Buffer::finishLargeFileLoad()
+{
+	// The loader's result is queued for our thread, and so is the signal
+	// which would stop its thread, so stop the thread here, and then
+	// deliver the result right away.
+	while(loaderThread != nullptr)
+	{
+		QThread *thread = loaderThread;
+		thread->quit();
+		thread->wait();
+		QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+		if(loaderThread == thread)
+			stopLargeFileLoad();
+	}
+}
+
 bool Buffer::write()
 {
+	if(isLargeFile())
+		return writeLargeFile();
+
 	// Get the right text codec for our encoding.
 
 	QTextCodec *c = QTextCodec::codecForName(codec.toStdString().c_str());
@@ -350,25 +656,29 @@ bool Buffer::write()
 	if(c == nullptr)
 		return false;
 
-	// Try opening the file we're going to write.
-
-	QFile file(getPath());
-
-	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
-		return false;
+	// Write the file, using our document writer.
 
-	// Setup our document writer.
+	bool trimmed = qompose::core::config::instance()
+	                       .get()
+	                       .save_strip_trailing_spaces();
+	auto writeDocument = [&](QIODevice &device) {
+		DocumentWriter writer(&device);
 
-	DocumentWriter writer(&file);
+		writer.setCodec(c);
+		writer.setWhitespaceTrimmed(trimmed);
 
-	writer.setCodec(c);
-	writer.setWhitespaceTrimmed(qompose::core::config::instance()
-	                                    .get()
-	                                    .save_strip_trailing_spaces());
+		// Our QTextDocument only uses '\n', so convert line endings
+		// back to the file's original style.
+		if(!!statistics)
+			writer.setLineEnding(statistics->lineEnding());
 
-	bool r = writer.write(document());
+		return writer.write(document());
+	};
 
-	file.close();
+	// The whole document is in memory, so if the file can't be replaced
+	// atomically (e.g. because its directory is read-only), it's safe
+	// to overwrite it in place instead.
+	bool r = saveAtomically(getPath(), writeDocument, true);
 
 	if(r)
 		setModified(false);
@@ -376,6 +686,78 @@ bool Buffer::write()
 	return r;
 }
 
+bool Buffer::writeLargeFile()
+{
+	// Until the file has been loaded, the view only holds its preview,
+	// so saving now would truncate it. Finishing the load may reopen the
+	// file in another encoding, which can start another load, or even
+	// leave large file mode.
+	finishLargeFileLoad();
+	if(!isLargeFile())
+		return write();
+
+	// If the file turned out not to be UTF-8, and wasn't reopened in
+	// another encoding, the preview is all that will ever be loaded.
+	if(largeFileView->isReadOnly())
+	{
+		QMessageBox::critical(
+		        this, tr("Save Failed"),
+		        tr("'%1' could not be saved, because only part of it "
+		           "was loaded.")
+		                .arg(QFileInfo(getPath()).fileName()));
+		return false;
+	}
+
+	if(QTextCodec::codecForName(codec.toLatin1()) == nullptr)
+		return false;
+
+	// Saves are never abandoned, so just wait for the previous one.
+	waitForSave();
+
+	// The snapshot shares its pieces with the document, so taking it is
+	// cheap, and editing the document doesn't affect it.
+	DocumentSaver *saver = new DocumentSaver(
+	        getPath(), largeFileView->getDocument().pieces,
+	        codec.toLatin1(), qompose::core::config::instance()
+	                                  .get()
+	                                  .save_strip_trailing_spaces(),
+	        mappedFile);
+	savingGeneration = contentsGeneration;
+	saverThread = new QThread(this);
+	saver->moveToThread(saverThread);
+
+	// The thread is stopped directly, so waitForSave() can wait for it
+	// without our event loop running.
+	QObject::connect(saverThread, &QThread::started, saver,
+	                 &DocumentSaver::save);
+	QObject::connect(saver, &DocumentSaver::saved, saverThread,
+	                 &QThread::quit, Qt::DirectConnection);
+	QObject::connect(saver, &DocumentSaver::saved, this,
+	                 &Buffer::doLargeFileSaved);
+	QObject::connect(saverThread, &QThread::finished, saver,
+	                 &QObject::deleteLater);
+	saverThread->start();
+
+	return true;
+}
+
+void Buffer::waitForSave()
+{
+	if(saverThread == nullptr)
+		return;
+
+	// Deliver the saver's (queued) result right away.
+	saverThread->wait();
+	QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
+
+void Buffer::resizeEvent(QResizeEvent *e)
+{
+	Editor::resizeEvent(e);
+	if(largeFileView != nullptr)
+		largeFileView->setGeometry(rect());
+}
+
 void Buffer::doModificationChanged(bool QUNUSED(c))
 {
 	Q_EMIT titleChanged(getTitle());
@@ -439,6 +821,133 @@ void Buffer::doSettingChanged(std::string const &name)
 		setGutterBackground(qompose::core::config::toQColor(
 		        config.gutter_background()));
 	}
+
+	if(isLargeFile())
+		setLargeFileMode(true);
+}
+
+void Buffer::doLargeFileLoaded(int generation)
+{
+	if(generation != loadGeneration || !isLargeFile())
+		return;
+
+	loaderThread->wait();
+	delete loaderThread;
+	loaderThread = nullptr;
+	std::shared_ptr<core::document::PieceTable> pieces;
+	pieces.swap(loadedPieces);
+	statistics = loadedStatistics;
+	loadedStatistics.reset();
+
+	// If the file turned out not to be UTF-8, leave the (read-only)
+	// preview as-is, and ask which encoding to use instead.
+	if(!statistics->valid)
+	{
+		confirmEncoding();
+		return;
+	}
+
+	// The preview is a prefix of the full file, so the cursor and scroll
+	// position can be carried over as-is.
+	std::size_t offset =
+	        largeFileView->getDocument().cursor.getCharacterOffset();
+	int scroll = largeFileView->verticalScrollBar()->value();
+
+	largeFileView->setPieceTable(*pieces, offset);
+	largeFileView->verticalScrollBar()->setValue(scroll);
+	largeFileView->setReadOnly(false);
+
+	// Handle any changes to the file which happened while it was being
+	// loaded.
+	doMappedFileChanged();
+}
+
+void Buffer::doLargeFileContentsChanged()
+{
+	++contentsGeneration;
+	if(!largeFileView->isReadOnly() && !isModified())
+		setModified(true);
+}
+
+void Buffer::doLargeFileSaved(bool success, QString const &error)
+{
+	if(saverThread == nullptr)
+		return;
+
+	saverThread->wait();
+	delete saverThread;
+	saverThread = nullptr;
+
+	if(!success)
+	{
+		QMessageBox::critical(
+		        this, tr("Save Failed"),
+		        tr("'%1' could not be saved: %2")
+		                .arg(QFileInfo(getPath()).fileName())
+		                .arg(error));
+		return;
+	}
+
+	if(contentsGeneration == savingGeneration)
+		setModified(false);
+}
+
+void Buffer::doMappedFileChanged()
+{
+	// While the file is being loaded, the loader may read any part of
+	// it, so changes are handled once it has finished.
+	if(!mappedFile || loaderThread != nullptr || mappedFile->isDetached())
+		return;
+
+	// If the file was only appended to (e.g. a log file being written),
+	// or was renamed (e.g. a log file being rotated), the parts of it
+	// we refer to are unaffected, so we can keep reading it.
+	core::file::MMIOFileChange change = mappedFile->getChange();
+	if(change == core::file::MMIOFileChange::None ||
+	   change == core::file::MMIOFileChange::Extended)
+	{
+		return;
+	}
+
+	// A save in progress reads the pieces we're about to change.
+	waitForSave();
+
+	// Only copy the parts of the file which are still in use, which is
+	// usually much less than all of it.
+	auto ranges = largeFileView->getReferencedRanges(*mappedFile);
+	try
+	{
+		if(!!ranges)
+			mappedFile->detach(*ranges);
+		else
+			mappedFile->detach();
+	}
+	catch(...)
+	{
+		QMessageBox::critical(
+		        this, tr("File Changed"),
+		        tr("'%1' was changed by another program, and could "
+		           "not be copied into memory.")
+		                .arg(QFileInfo(getPath()).fileName()));
+		return;
+	}
+	mappedFileWatcher.reset();
+
+	// Whatever was changed before the file was copied is already part
+	// of the text, so the pieces which refer to it must be measured
+	// again.
+	largeFileView->remeasureFile(*mappedFile);
+
+	QMessageBox::warning(
+	        this, tr("File Changed"),
+	        tr("'%1' was changed by another program. Since it was being "
+	           "read directly from the disk, some of those changes may "
+	           "now be shown, and any part of it which was removed, or "
+	           "which is no longer valid UTF-8, now contains blank (NUL) "
+	           "characters. Save the file to keep the text shown, or "
+	           "revert it to load the new version.")
+	                .arg(QFileInfo(getPath()).fileName()));
+	setModified(true);
 }
 }
 }
@@ -19,6 +19,8 @@
 #ifndef INCLUDE_QOMPOSECOMMON_EDITOR_BUFFER_H
 #define INCLUDE_QOMPOSECOMMON_EDITOR_BUFFER_H
 
+#include <experimental/optional>
+#include <memory>
 #include <string>
 
 #include "QomposeCommon/Types.h"
@@ -26,13 +28,37 @@
 #include "QomposeCommon/util/ConfigurationWatcher.hpp"
 
 class QPrinter;
+class QResizeEvent;
+class QThread;
 
 namespace qompose
 {
 class Pane;
 
+namespace core
+{
+namespace document
+{
+class PieceTable;
+struct TextStatistics;
+}
+
+namespace file
+{
+class FileWatcher;
+class MMIOFile;
+}
+
+namespace string
+{
+enum class TextEncoding;
+}
+}
+
 namespace editor
 {
+class DocumentView;
+
 /*!
  * \brief This class provides high-level buffer functionality for editors.
  */
@@ -51,7 +77,7 @@ public:
 	Buffer(Pane *pp, QWidget *p = nullptr);
 
 	Buffer(const Buffer &) = delete;
-	virtual ~Buffer() = default;
+	virtual ~Buffer();
 
 	Buffer &operator=(const Buffer &) = delete;
 
@@ -189,6 +215,36 @@ public:
 	 */
 	void setEncoding(const QByteArray &e);
 
+	/*!
+	 * Large UTF-8 files are opened in "large file mode": instead of
+	 * decoding the whole file into our QTextDocument, the file is
+	 * mapped into memory and displayed by a DocumentView, which only
+	 * lays out the lines which are actually visible.
+	 *
+	 * \return Whether or not this buffer is in large file mode.
+	 */
+	bool isLargeFile() const;
+
+	/*!
+	 * This function returns the statistics (line endings, longest line,
+	 * and so on) computed while our file was being loaded. They are
+	 * only known for files which were read as UTF-8, or in large file
+	 * mode, and they describe the file as it was loaded.
+	 *
+	 * \return Our file's statistics, or nullptr if they aren't known.
+	 */
+	core::document::TextStatistics const *getTextStatistics() const;
+
+	/*!
+	 * \return The current cursor's 1-indexed line number.
+	 */
+	int getCurrentLine() const;
+
+	/*!
+	 * \return The current cursor's 1-indexed column number.
+	 */
+	int getCurrentColumn() const;
+
 public Q_SLOTS:
 	/*!
 	 * This slot prints our buffer's contents to the given printer object.
@@ -205,6 +261,22 @@ private:
 	QString path;
 	QString codec;
 
+	bool largeFile;
+	DocumentView *largeFileView;
+	QThread *loaderThread;
+	int loadGeneration;
+	std::shared_ptr<core::document::PieceTable> loadedPieces;
+	std::shared_ptr<core::document::TextStatistics> loadedStatistics;
+	std::shared_ptr<core::document::TextStatistics const> statistics;
+	// The file our large file mode document refers to, if it is mapped.
+	std::shared_ptr<core::file::MMIOFile> mappedFile;
+	std::unique_ptr<core::file::FileWatcher> mappedFileWatcher;
+	// Counts edits to our large file mode document, so we know whether
+	// it has changed since the save in progress (if any) started.
+	int contentsGeneration;
+	int savingGeneration;
+	QThread *saverThread;
+
 	/*!
 	 * This function sets our buffer's internal path to the given file
 	 * path, in such a way that we can guarantee that our internal path is
@@ -226,14 +298,92 @@ private:
 	 */
 	bool read(bool u = false);
 
+	/*!
+	 * This function maps our current file into memory and displays it
+	 * in large file mode. The first screen of the file is shown right
+	 * away, and the file's full line index is built in a background
+	 * thread. The view is read-only until that finishes.
+	 *
+	 * Files which aren't UTF-8 are converted to UTF-8 as they are
+	 * loaded, one chunk at a time.
+	 *
+	 * \param encoding The file's encoding, or nothing if it is UTF-8.
+	 * \return True on success, or false if the file couldn't be mapped
+	 *         or previewed, in which case the buffer is left unchanged.
+	 */
+	bool readLargeFile(
+	        std::experimental::optional<core::string::TextEncoding>
+	                encoding);
+
+	/*!
+	 * This function enables or disables large file mode, creating our
+	 * DocumentView the first time it is needed.
+	 *
+	 * \param enabled Whether large file mode should be enabled.
+	 */
+	void setLargeFileMode(bool enabled);
+
+	/*!
+	 * A file's encoding may be guessed from just the start of the file,
+	 * so once it has been read, this function checks whether a file
+	 * thought to be UTF-8 actually is. If not, the user is asked which
+	 * encoding to use instead, and the file is read again.
+	 */
+	void confirmEncoding();
+
+	/*!
+	 * This function starts watching the given mapped file for changes
+	 * made by other programs, which our large file mode document
+	 * (which refers to the file directly) would otherwise see.
+	 *
+	 * \param file The mapped file to watch, or nullptr to stop.
+	 */
+	void watchMappedFile(std::shared_ptr<core::file::MMIOFile> const &file);
+
+	/*!
+	 * This function waits for any in-progress background load to
+	 * finish, discarding its result.
+	 */
+	void stopLargeFileLoad();
+
+	/*!
+	 * This function waits for any in-progress background load to
+	 * finish, and handles its result, including any further load that
+	 * handling it starts.
+	 */
+	void finishLargeFileLoad();
+
 	/*!
 	 * This is a utility function which writes the contents of our buffer
-	 * to our buffer's current file path.
+	 * to our buffer's current file path. The file is replaced atomically
+	 * (see saveAtomically()), so it is never left truncated.
 	 *
 	 * \return True on success, or false otherwise.
 	 */
 	bool write();
 
+	/*!
+	 * This function starts writing a snapshot of our large file mode
+	 * document to our current file path in the background, so editing
+	 * can continue while a large file is being saved. Like write(), the
+	 * new contents replace the original atomically, which is required
+	 * anyway since the original is still mapped into memory. The parts
+	 * of the mapped file which haven't been edited are copied from it
+	 * by the kernel, rather than written from memory.
+	 *
+	 * \return True if the save was started, or false otherwise.
+	 */
+	bool writeLargeFile();
+
+	/*!
+	 * This function waits for any in-progress background save to
+	 * finish, and handles its result.
+	 */
+	void waitForSave();
+
+protected:
+	virtual void resizeEvent(QResizeEvent *e) override;
+
 private Q_SLOTS:
 	/*!
 	 * This function handles our modification state being changed by
@@ -253,6 +403,40 @@ private Q_SLOTS:
 	 */
 	void doSettingChanged(std::string const &name);
 
+	/*!
+	 * This function is called once the background thread has built the
+	 * full piece table for a file opened in large file mode, and swaps
+	 * it in for the preview we were displaying.
+	 *
+	 * \param generation The generation of the load which finished.
+	 */
+	void doLargeFileLoaded(int generation);
+
+	/*!
+	 * This function handles the contents of our large file mode view
+	 * being edited, by marking this buffer as modified.
+	 */
+	void doLargeFileContentsChanged();
+
+	/*!
+	 * This function is called once a background save has finished. If
+	 * our document hasn't been edited since the save started, it is no
+	 * longer modified.
+	 *
+	 * \param success Whether or not the save succeeded.
+	 * \param error If the save failed, a description of why.
+	 */
+	void doLargeFileSaved(bool success, QString const &error);
+
+	/*!
+	 * This function handles our mapped file being changed by another
+	 * program. If the change could affect the parts of the file we
+	 * refer to (i.e., it wasn't just appended to), we stop reading the
+	 * file, copying the parts we still refer to into memory, and let
+	 * the user know.
+	 */
+	void doMappedFileChanged();
+
 Q_SIGNALS:
 	void titleChanged(const QString &);
 	void pathChanged(const QString &);
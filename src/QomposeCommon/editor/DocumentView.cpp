@@ -0,0 +1,1042 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DocumentView.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+#include <QByteArray>
+#include <QFontMetrics>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QScrollBar>
+#include <QWheelEvent>
+
+#include "core/string/CharacterWidth.hpp"
+#include "core/string/Utf8StringRef.hpp"
+#include "core/string/Utf8Validation.hpp"
+
+#include "QomposeCommon/util/FontMetrics.h"
+
+namespace
+{
+// The space between the gutter (or left edge) and the text, in pixels.
+constexpr int CONTENT_MARGIN = 4;
+
+// The horizontal padding on either side of the line numbers, in pixels.
+constexpr int GUTTER_PADDING = 3;
+
+// How many screens ahead of the viewport are prefetched while scrolling.
+constexpr std::size_t PREFETCH_SCREENS = 4;
+
+/*!
+ * Expand the tabs in the given line of text into spaces, measuring every
+ * character the same way DisplayColumns does (so e.g. wide characters
+ * occupy two columns, and combining marks none), so tab stops and the
+ * line's width agree with the caret's column.
+ *
+ * \param text The line of text to expand.
+ * \param tabWidth The width of a tab stop, in columns.
+ * \param columns Set to the number of columns the line occupies.
+ * \return The line, with its tabs replaced by spaces.
+ */
+QString expandTabs(QString const &text, std::size_t tabWidth,
+                   std::size_t &columns)
+{
+	QString expanded;
+	expanded.reserve(text.size());
+	columns = 0;
+	int length = 1;
+	for(int i = 0; i < text.size(); i += length)
+	{
+		QChar c = text[i];
+		uint32_t character = c.unicode();
+		length = 1;
+		if(c.isHighSurrogate() && i + 1 < text.size() &&
+		   text[i + 1].isLowSurrogate())
+		{
+			character = QChar::surrogateToUcs4(c, text[i + 1]);
+			length = 2;
+		}
+
+		std::size_t next = qompose::core::string::advanceDisplayColumn(
+		        columns, character, tabWidth);
+		if(character == '\t')
+		{
+			int spaces = static_cast<int>(next - columns);
+			expanded.append(QString(spaces, QLatin1Char(' ')));
+		}
+		else
+		{
+			expanded.append(text.midRef(i, length));
+		}
+		columns = next;
+	}
+	return expanded;
+}
+
+/*!
+ * Return a copy of the UTF-8 bytes in the range [begin, end).
+ */
+QByteArray
+copyBytes(qompose::core::document::PieceTable const &pieces,
+          qompose::core::document::Cursor const &begin,
+          qompose::core::document::Cursor const &end)
+{
+	QByteArray bytes;
+	pieces.forEachSpan(begin, end, [&bytes](uint8_t const *b,
+	                                        uint8_t const *e) {
+		bytes.append(reinterpret_cast<char const *>(b),
+		             static_cast<int>(e - b));
+		return true;
+	});
+	return bytes;
+}
+
+int clampToInt(std::size_t value)
+{
+	return static_cast<int>(
+	        std::min(value, static_cast<std::size_t>(INT_MAX)));
+}
+}
+
+namespace qompose
+{
+namespace editor
+{
+DocumentView::DocumentView(QWidget *p)
+        : hotkey::HotkeyedWidget<QAbstractScrollArea>(p),
+          document(core::document::PieceTable()),
+          history(),
+          readOnly(false),
+          gutterVisible(false),
+          currentFont(QFont("Courier")),
+          originalFontSize(11.0),
+          currentFontZoom(0),
+          indentationWidth(8),
+          indentationMode(qompose::core::IndentationMode::Tabs),
+          wrapGuideVisible(false),
+          wrapGuideWidth(0),
+          wrapGuideColor(QColor(255, 255, 255)),
+          editorForeground(QColor(0, 0, 0)),
+          editorBackground(QColor(255, 255, 255)),
+          currentLineHighlight(QColor(128, 128, 128)),
+          gutterForeground(QColor(255, 255, 255)),
+          gutterBackground(QColor(0, 0, 0)),
+          widestLine(0),
+          columns(8),
+          prefetcher(),
+          prefetchLine(0),
+          prefetchForward(true)
+{
+	initializeHotkeys();
+
+	setFocusPolicy(Qt::StrongFocus);
+	viewport()->setCursor(Qt::IBeamCursor);
+
+	setFont(QFont("Courier", 11));
+	setPieceTable(core::document::PieceTable());
+}
+
+void DocumentView::setPieceTable(core::document::PieceTable const &pieces,
+                                 std::size_t offset)
+{
+	document = core::document::Document(pieces,
+	                                    pieces.characterToCursor(offset));
+	history = core::document::DocumentHistory();
+	core::document::push(history, document);
+	widestLine = 0;
+
+	showDocument();
+}
+
+void DocumentView::setPrefetcher(
+        std::shared_ptr<core::file::MMIOPrefetcher> const &p)
+{
+	prefetcher = p;
+	prefetchLine = firstVisibleLine();
+	prefetchForward = true;
+	prefetchAhead(true);
+}
+
+std::experimental::optional<std::vector<core::file::MMIOFile::Range>>
+DocumentView::getReferencedRanges(core::file::MMIOFile const &file) const
+{
+	if(core::document::undoDepth(history) != history.past.size())
+		return std::experimental::nullopt;
+
+	uint8_t const *fileBegin = file.data();
+	uint8_t const *fileEnd = fileBegin + file.size();
+	// Snapshots share most of their pieces, so visit each distinct
+	// piece only once, rather than every piece of every snapshot.
+	std::vector<core::document::PieceTree const *> trees{
+	        &document.pieces.pieces};
+	for(auto const &entries : {&history.past, &history.future})
+	{
+		for(auto const &entry : *entries)
+			trees.push_back(&entry.document.pieces.pieces);
+	}
+
+	std::vector<core::file::MMIOFile::Range> ranges;
+	auto collect = [&](core::document::Piece const &piece) {
+		uint8_t const *begin = piece.data();
+		uint8_t const *end = piece.dataEnd();
+		if(begin >= fileBegin && end <= fileEnd)
+		{
+			ranges.emplace_back(
+			        static_cast<std::size_t>(begin - fileBegin),
+			        static_cast<std::size_t>(end - begin));
+		}
+	};
+	core::document::forEachDistinctPiece(trees, collect);
+
+	std::sort(ranges.begin(), ranges.end());
+	std::vector<core::file::MMIOFile::Range> merged;
+	for(auto const &range : ranges)
+	{
+		if(!merged.empty() &&
+		   range.first <= merged.back().first + merged.back().second)
+		{
+			std::size_t end = std::max(
+			        merged.back().first + merged.back().second,
+			        range.first + range.second);
+			merged.back().second = end - merged.back().first;
+		}
+		else
+		{
+			merged.push_back(range);
+		}
+	}
+	return merged;
+}
+
+void DocumentView::remeasureFile(core::file::MMIOFile &file)
+{
+	core::document::discardSpilled(history);
+
+	std::vector<core::document::Document *> documents{&document};
+	for(auto entries : {&history.past, &history.future})
+	{
+		for(auto &entry : *entries)
+			documents.push_back(&entry.document);
+	}
+	std::vector<core::document::PieceTree *> trees;
+	for(core::document::Document *d : documents)
+		trees.push_back(&d->pieces.pieces);
+	std::vector<core::document::PieceTree const *> constTrees(
+	        trees.begin(), trees.end());
+
+	uint8_t const *fileBegin = file.data();
+	uint8_t const *fileEnd = fileBegin + file.size();
+	auto isInFile = [&](core::document::Piece const &piece) {
+		return piece.data() >= fileBegin && piece.dataEnd() <= fileEnd;
+	};
+
+	// Zeroing a piece's bytes may split a character at the edge of
+	// another piece which overlaps it, so repeat until every piece is
+	// valid. Each pass zeroes more of the file, so this terminates.
+	bool zeroed = true;
+	while(zeroed)
+	{
+		zeroed = false;
+		auto validate = [&](core::document::Piece const &piece) {
+			if(!isInFile(piece) ||
+			   core::string::isValidUtf8(piece.data(),
+			                             piece.dataEnd()))
+			{
+				return;
+			}
+			file.zero(core::file::MMIOFile::Range(
+			        static_cast<std::size_t>(piece.data() -
+			                                 fileBegin),
+			        piece.metrics.bytes));
+			zeroed = true;
+		};
+		core::document::forEachDistinctPiece(constTrees, validate);
+	}
+
+	auto measure = [&](core::document::Piece const &piece) {
+		if(!isInFile(piece))
+			return piece.metrics;
+		return core::document::Piece(piece.getResource(), piece.data(),
+		                             piece.dataEnd())
+		        .metrics;
+	};
+	core::document::remeasurePieces(trees, measure);
+
+	// Cursors refer to a particular version of a tree, and character
+	// offsets may have changed, but byte offsets haven't.
+	for(core::document::Document *d : documents)
+		d->cursor = d->pieces.byteToCursor(d->cursor.getByteOffset());
+
+	widestLine = 0;
+	updateScrollBars();
+	setCursor(document.cursor);
+	Q_EMIT contentsChanged();
+}
+
+core::document::Document const &DocumentView::getDocument() const
+{
+	return document;
+}
+
+void DocumentView::setReadOnly(bool r)
+{
+	readOnly = r;
+}
+
+bool DocumentView::isReadOnly() const
+{
+	return readOnly;
+}
+
+void DocumentView::setGutterVisible(bool v)
+{
+	gutterVisible = v;
+	updateScrollBars();
+	viewport()->update();
+}
+
+bool DocumentView::isGutterVisible() const
+{
+	return gutterVisible;
+}
+
+void DocumentView::setFont(QFont const &f)
+{
+	currentFont = f;
+	originalFontSize = qMax(currentFont.pointSizeF(), 1.0);
+	setFontZoom(currentFontZoom);
+}
+
+QFont DocumentView::getFont() const
+{
+	return currentFont;
+}
+
+int DocumentView::fontZoom() const
+{
+	return currentFontZoom;
+}
+
+void DocumentView::setFontZoom(int z)
+{
+	currentFontZoom = qMax(-100, z);
+
+	qreal sizef = fontZoomSize();
+	if(sizef > 0.0)
+		currentFont.setPointSizeF(sizef);
+
+	QAbstractScrollArea::setFont(currentFont);
+	viewport()->setFont(currentFont);
+
+	updateScrollBars();
+	viewport()->update();
+}
+
+void DocumentView::resetFontZoom()
+{
+	setFontZoom(0);
+}
+
+std::size_t DocumentView::getIndentationWidth() const
+{
+	return static_cast<std::size_t>(indentationWidth);
+}
+
+void DocumentView::setIndentationWidth(int w)
+{
+	indentationWidth = qAbs(w);
+	columns.setTabWidth(static_cast<std::size_t>(indentationWidth));
+	widestLine = 0;
+	updateScrollBars();
+	viewport()->update();
+}
+
+core::IndentationMode DocumentView::getIndentationMode() const
+{
+	return indentationMode;
+}
+
+void DocumentView::setIndentationMode(core::IndentationMode mode)
+{
+	indentationMode = mode;
+}
+
+bool DocumentView::isWrapGuideVisible() const
+{
+	return wrapGuideVisible;
+}
+
+void DocumentView::setWrapGuideVisible(bool v)
+{
+	wrapGuideVisible = v;
+	viewport()->update();
+}
+
+int DocumentView::getWrapGuideColumnWidth() const
+{
+	return wrapGuideWidth;
+}
+
+void DocumentView::setWrapGuideColumnWidth(int w)
+{
+	wrapGuideWidth = qAbs(w);
+	viewport()->update();
+}
+
+QColor DocumentView::getWrapGuideColor() const
+{
+	return wrapGuideColor;
+}
+
+void DocumentView::setWrapGuideColor(QColor const &c)
+{
+	wrapGuideColor = c;
+	viewport()->update();
+}
+
+QColor DocumentView::getEditorForeground() const
+{
+	return editorForeground;
+}
+
+void DocumentView::setEditorForeground(QColor const &c)
+{
+	editorForeground = c;
+	viewport()->update();
+}
+
+QColor DocumentView::getEditorBackground() const
+{
+	return editorBackground;
+}
+
+void DocumentView::setEditorBackground(QColor const &c)
+{
+	editorBackground = c;
+	viewport()->update();
+}
+
+QColor DocumentView::getCurrentLineColor() const
+{
+	return currentLineHighlight;
+}
+
+void DocumentView::setCurrentLineColor(QColor const &c)
+{
+	currentLineHighlight = c;
+	viewport()->update();
+}
+
+QColor DocumentView::getGutterForeground() const
+{
+	return gutterForeground;
+}
+
+void DocumentView::setGutterForeground(QColor const &c)
+{
+	gutterForeground = c;
+	viewport()->update();
+}
+
+QColor DocumentView::getGutterBackground() const
+{
+	return gutterBackground;
+}
+
+void DocumentView::setGutterBackground(QColor const &c)
+{
+	gutterBackground = c;
+	viewport()->update();
+}
+
+std::size_t DocumentView::getCurrentLine() const
+{
+	return document.pieces.cursorToLine(document.cursor) + 1;
+}
+
+std::size_t DocumentView::getCurrentColumn() const
+{
+	return cursorColumn(document.cursor) + 1;
+}
+
+void DocumentView::undo()
+{
+	// The oldest snapshot is the document as it was loaded, which
+	// must always remain in the history.
+	if(readOnly || core::document::undoDepth(history) <= 1)
+		return;
+
+	core::document::undo(history);
+	showDocument();
+}
+
+void DocumentView::redo()
+{
+	if(readOnly)
+		return;
+
+	core::document::redo(history);
+	showDocument();
+}
+
+void DocumentView::keyPressEvent(QKeyEvent *e)
+{
+	QString text = e->text();
+	Qt::KeyboardModifiers commands =
+	        Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier;
+	bool printable = !text.isEmpty() && !(e->modifiers() & commands);
+	for(QChar c : text)
+		printable = printable && c.isPrint();
+
+	if(printable)
+	{
+		insertText(text, core::document::EditKind::Insertion);
+		e->accept();
+	}
+	else
+	{
+		hotkey::HotkeyedWidget<QAbstractScrollArea>::keyPressEvent(e);
+	}
+}
+
+void DocumentView::mousePressEvent(QMouseEvent *e)
+{
+	if(e->button() != Qt::LeftButton)
+	{
+		QAbstractScrollArea::mousePressEvent(e);
+		return;
+	}
+
+	int row = qMax(0, e->pos().y()) / lineHeight();
+	qreal x = qMax(0.0, static_cast<qreal>(e->pos().x()) - textLeft());
+	std::size_t column = static_cast<std::size_t>(
+	        qRound(x / singleColumnWidth()));
+
+	setCursor(cursorAtColumn(firstVisibleLine() +
+	                                 static_cast<std::size_t>(row),
+	                         column));
+}
+
+void DocumentView::paintEvent(QPaintEvent *e)
+{
+	QPainter painter(viewport());
+	painter.setFont(currentFont);
+	painter.fillRect(e->rect(), editorBackground);
+
+	int height = lineHeight();
+	int ascent = QFontMetrics(currentFont).ascent();
+	int width = viewport()->width();
+	int gutter = gutterWidth();
+	qreal left = textLeft();
+	qreal columnWidth = singleColumnWidth();
+
+	std::size_t lines = document.pieces.lineCount();
+	std::size_t first = firstVisibleLine();
+	std::size_t last = std::min(lines, first + visibleLineCount() + 1);
+	std::size_t cursorLine =
+	        document.pieces.cursorToLine(document.cursor);
+	std::size_t limit = static_cast<std::size_t>(
+	                            horizontalScrollBar()->value()) +
+	                    visibleColumnCount() + 1;
+
+	// Draw the visible lines, and nothing else. Each line is fetched
+	// from the piece table on demand, and truncated at the right edge
+	// of the viewport.
+
+	std::size_t widest = widestLine;
+	for(std::size_t line = first; line < last; ++line)
+	{
+		int top = static_cast<int>(line - first) * height;
+
+		if(line == cursorLine)
+		{
+			QRect highlight(gutter, top, width - gutter, height);
+			painter.fillRect(highlight, currentLineHighlight);
+		}
+
+		std::size_t lineColumns;
+		QString text = expandTabs(lineText(line, limit),
+		                          columns.getTabWidth(), lineColumns);
+		widest = std::max(widest, lineColumns);
+
+		painter.setPen(editorForeground);
+		painter.drawText(QPointF(left, top + ascent), text);
+	}
+
+	// Draw the wrap guide, if it is enabled. This is only meaningful
+	// for monospaced fonts, where columns have a fixed width.
+
+	if(wrapGuideVisible && FontMetrics(currentFont).isMonospaced())
+	{
+		qreal x = left +
+		          columnWidth * static_cast<qreal>(wrapGuideWidth);
+		if(x >= gutter)
+		{
+			painter.setPen(wrapGuideColor);
+			painter.drawLine(QPointF(x, 0),
+			                 QPointF(x, viewport()->height()));
+		}
+	}
+
+	// Draw the caret, if it is on a visible line.
+
+	if(hasFocus() && cursorLine >= first && cursorLine < last)
+	{
+		std::size_t column = cursorColumn(document.cursor);
+		qreal x = left + columnWidth * static_cast<qreal>(column);
+		int top = static_cast<int>(cursorLine - first) * height;
+		painter.fillRect(QRectF(x, top, 2.0, height), editorForeground);
+	}
+
+	// Draw the gutter last, so it covers any horizontally scrolled text.
+
+	if(gutterVisible)
+	{
+		painter.fillRect(QRect(0, 0, gutter, viewport()->height()),
+		                 gutterBackground);
+		painter.setPen(gutterForeground);
+		for(std::size_t line = first; line < last; ++line)
+		{
+			int top = static_cast<int>(line - first) * height;
+			painter.drawText(QRect(0, top, gutter - GUTTER_PADDING,
+			                       height),
+			                 Qt::AlignRight | Qt::AlignVCenter,
+			                 QString::number(line + 1));
+		}
+	}
+
+	painter.end();
+
+	// We only learn how wide lines are as they are laid out, so the
+	// horizontal scroll range grows as wider lines come into view.
+	if(widest != widestLine)
+	{
+		widestLine = widest;
+		updateScrollBars();
+	}
+}
+
+void DocumentView::resizeEvent(QResizeEvent *e)
+{
+	QAbstractScrollArea::resizeEvent(e);
+	updateScrollBars();
+}
+
+void DocumentView::scrollContentsBy(int, int dy)
+{
+	// Content moves up (dy is negative) when scrolling towards the end.
+	if(dy != 0)
+		prefetchAhead(dy < 0);
+	viewport()->update();
+}
+
+void DocumentView::wheelEvent(QWheelEvent *e)
+{
+	if(e->modifiers() == Qt::ControlModifier)
+	{
+		/*
+		 * If the user does Ctrl+Wheel, zoom in/out on our text. Delta
+		 * is degrees turned * 8. We scale by 100% for each 120 degrees
+		 * turned.
+		 */
+
+		qreal scale = static_cast<qreal>(e->delta()) / 8.0;
+		scale *= 0.8333;
+
+		setFontZoom(currentFontZoom + qRound(scale));
+	}
+	else
+	{
+		QAbstractScrollArea::wheelEvent(e);
+	}
+}
+
+void DocumentView::initializeHotkeys()
+{
+	using core::document::EditKind;
+
+	// Editing
+
+	addHotkey(Hotkey(Qt::Key_Backspace, 0, ~Qt::KeyboardModifiers(0)),
+	          [this]() { eraseBackward(); });
+
+	addHotkey(Hotkey(Qt::Key_Delete, 0, ~Qt::KeyboardModifiers(0)),
+	          [this]() { eraseForward(); });
+
+	addHotkey(Hotkey(Qt::Key_Return, 0, ~Qt::KeyboardModifiers(0)),
+	          [this]() { insertText("\n", EditKind::Insertion); });
+
+	addHotkey(Hotkey(Qt::Key_Enter, 0, ~Qt::KeyboardModifiers(0)),
+	          [this]() { insertText("\n", EditKind::Insertion); });
+
+	addHotkey(Hotkey(Qt::Key_Tab), [this]() {
+		insertText(getIndentString(), EditKind::Insertion);
+	});
+
+	// Undo / redo
+
+	addHotkey(Hotkey(Qt::Key_Z, Qt::ControlModifier),
+	          [this]() { undo(); });
+
+	addHotkey(Hotkey(Qt::Key_Y, Qt::ControlModifier),
+	          [this]() { redo(); });
+
+	addHotkey(Hotkey(Qt::Key_Z, Qt::ControlModifier | Qt::ShiftModifier),
+	          [this]() { redo(); });
+
+	// Movement
+
+	addHotkey(Hotkey(Qt::Key_Left), [this]() {
+		if(document.cursor != document.pieces.begin())
+			setCursor(document.cursor - 1);
+	});
+
+	addHotkey(Hotkey(Qt::Key_Right), [this]() {
+		if(document.cursor != document.pieces.end())
+			setCursor(document.cursor + 1);
+	});
+
+	addHotkey(Hotkey(Qt::Key_Up), [this]() {
+		std::size_t line =
+		        document.pieces.cursorToLine(document.cursor);
+		if(line > 0)
+			moveToLine(line - 1);
+	});
+
+	addHotkey(Hotkey(Qt::Key_Down), [this]() {
+		moveToLine(document.pieces.cursorToLine(document.cursor) + 1);
+	});
+
+	addHotkey(Hotkey(Qt::Key_PageUp), [this]() {
+		std::size_t line =
+		        document.pieces.cursorToLine(document.cursor);
+		moveToLine(line - std::min(line, visibleLineCount()));
+	});
+
+	addHotkey(Hotkey(Qt::Key_PageDown), [this]() {
+		moveToLine(document.pieces.cursorToLine(document.cursor) +
+		           visibleLineCount());
+	});
+
+	addHotkey(Hotkey(Qt::Key_Home), [this]() {
+		setCursor(document.pieces.lineToCursor(
+		        document.pieces.cursorToLine(document.cursor)));
+	});
+
+	addHotkey(Hotkey(Qt::Key_End), [this]() {
+		setCursor(cursorAtColumn(
+		        document.pieces.cursorToLine(document.cursor),
+		        static_cast<std::size_t>(-1)));
+	});
+
+	addHotkey(Hotkey(Qt::Key_Home, Qt::ControlModifier),
+	          [this]() { setCursor(document.pieces.begin()); });
+
+	addHotkey(Hotkey(Qt::Key_End, Qt::ControlModifier),
+	          [this]() { setCursor(document.pieces.end()); });
+
+	// Ctrl+(Zero)
+
+	addHotkey(Hotkey(Qt::Key_0, Qt::ControlModifier),
+	          [this]() { resetFontZoom(); });
+}
+
+qreal DocumentView::fontZoomSize() const
+{
+	qreal scale = static_cast<qreal>(fontZoom()) / 100.0;
+	qreal fsize = originalFontSize + (scale * originalFontSize);
+
+	return qMax(fsize, 0.0);
+}
+
+qreal DocumentView::singleColumnWidth() const
+{
+	return qMax(FontMetrics(currentFont).getColumnWidthF(), 1.0);
+}
+
+int DocumentView::lineHeight() const
+{
+	return qMax(QFontMetrics(currentFont).height(), 1);
+}
+
+int DocumentView::gutterWidth() const
+{
+	if(!gutterVisible)
+		return 0;
+
+	int digits = QString::number(document.pieces.lineCount()).size();
+	return QFontMetrics(currentFont).width(QLatin1Char('9')) * digits +
+	       GUTTER_PADDING * 2;
+}
+
+qreal DocumentView::textLeft() const
+{
+	return static_cast<qreal>(gutterWidth() + CONTENT_MARGIN) -
+	       singleColumnWidth() *
+	               static_cast<qreal>(horizontalScrollBar()->value());
+}
+
+std::size_t DocumentView::firstVisibleLine() const
+{
+	return static_cast<std::size_t>(verticalScrollBar()->value());
+}
+
+std::size_t DocumentView::visibleLineCount() const
+{
+	return static_cast<std::size_t>(
+	        qMax(1, viewport()->height() / lineHeight()));
+}
+
+std::size_t DocumentView::visibleColumnCount() const
+{
+	qreal width = static_cast<qreal>(viewport()->width() - gutterWidth() -
+	                                 CONTENT_MARGIN);
+	return static_cast<std::size_t>(
+	        qMax(1, static_cast<int>(width / singleColumnWidth())));
+}
+
+QString DocumentView::lineText(std::size_t line, std::size_t limit) const
+{
+	core::document::PieceTable const &pieces = document.pieces;
+	core::document::Cursor begin = pieces.lineToCursor(line);
+	core::document::Cursor end = pieces.lineToCursor(line + 1);
+	if(static_cast<std::size_t>(end - begin) > limit)
+		end = begin + static_cast<std::ptrdiff_t>(limit);
+
+	QByteArray bytes = copyBytes(pieces, begin, end);
+	while(bytes.endsWith('\n') || bytes.endsWith('\r'))
+		bytes.chop(1);
+	return QString::fromUtf8(bytes);
+}
+
+std::size_t
+DocumentView::cursorColumn(core::document::Cursor const &cursor) const
+{
+	return columns.columnOf(document.pieces, cursor);
+}
+
+core::document::Cursor DocumentView::cursorAtColumn(std::size_t line,
+                                                    std::size_t column) const
+{
+	if(line >= document.pieces.lineCount())
+		return document.pieces.end();
+	return columns.cursorAt(document.pieces, line, column);
+}
+
+QString DocumentView::getIndentString() const
+{
+	switch(getIndentationMode())
+	{
+	case qompose::core::IndentationMode::Spaces:
+		return QString(" ").repeated(
+		        static_cast<int>(getIndentationWidth()));
+
+	case qompose::core::IndentationMode::Tabs:
+		return QString("\t");
+	}
+}
+
+void DocumentView::setCursor(core::document::Cursor const &cursor)
+{
+	document.cursor = cursor;
+	ensureCursorVisible();
+	viewport()->update();
+	Q_EMIT cursorPositionChanged();
+}
+
+void DocumentView::moveToLine(std::size_t line)
+{
+	line = std::min(line, document.pieces.lineCount() - 1);
+	setCursor(cursorAtColumn(line, cursorColumn(document.cursor)));
+}
+
+void DocumentView::insertText(QString const &text,
+                              core::document::EditKind kind)
+{
+	if(readOnly)
+		return;
+
+	QByteArray utf8 = text.toUtf8();
+	uint8_t const *begin = reinterpret_cast<uint8_t const *>(utf8.data());
+
+	core::document::PieceTable pieces = document.pieces;
+	core::document::Cursor cursor = pieces.insert(
+	        document.cursor,
+	        core::string::Utf8StringRef(begin, begin + utf8.size()));
+	auto length = static_cast<std::ptrdiff_t>(text.toUcs4().size());
+	commit(pieces, cursor + length, kind);
+}
+
+void DocumentView::eraseBackward()
+{
+	if(readOnly || document.cursor == document.pieces.begin())
+		return;
+
+	core::document::PieceTable pieces = document.pieces;
+	core::document::Cursor cursor =
+	        pieces.erase(document.cursor - 1, document.cursor);
+	commit(pieces, cursor, core::document::EditKind::Deletion);
+}
+
+void DocumentView::eraseForward()
+{
+	if(readOnly || document.cursor == document.pieces.end())
+		return;
+
+	core::document::PieceTable pieces = document.pieces;
+	core::document::Cursor cursor =
+	        pieces.erase(document.cursor, document.cursor + 1);
+	commit(pieces, cursor, core::document::EditKind::Deletion);
+}
+
+void DocumentView::commit(core::document::PieceTable const &pieces,
+                          core::document::Cursor const &cursor,
+                          core::document::EditKind kind)
+{
+	document = core::document::Document(pieces, cursor);
+	core::document::push(history, document, kind);
+
+	updateScrollBars();
+	setCursor(document.cursor);
+	Q_EMIT contentsChanged();
+}
+
+void DocumentView::showDocument()
+{
+	boost::optional<core::document::Document> current =
+	        core::document::present(history);
+	if(!!current)
+		document = *current;
+
+	updateScrollBars();
+	setCursor(document.cursor);
+	Q_EMIT contentsChanged();
+}
+
+void DocumentView::updateScrollBars()
+{
+	std::size_t lines = document.pieces.lineCount();
+	std::size_t visibleLines = visibleLineCount();
+	verticalScrollBar()->setRange(
+	        0, clampToInt(lines - std::min(lines, visibleLines)));
+	verticalScrollBar()->setPageStep(clampToInt(visibleLines));
+	verticalScrollBar()->setSingleStep(1);
+
+	std::size_t visibleColumns = visibleColumnCount();
+	std::size_t hidden = widestLine - std::min(widestLine, visibleColumns);
+	horizontalScrollBar()->setRange(0, clampToInt(hidden));
+	horizontalScrollBar()->setPageStep(clampToInt(visibleColumns));
+	horizontalScrollBar()->setSingleStep(1);
+}
+
+void DocumentView::prefetchAhead(bool forward)
+{
+	if(!prefetcher)
+		return;
+
+	// Each request covers several screens, so only make a new one once
+	// we've scrolled a screen past the last one, or changed direction.
+	std::size_t first = firstVisibleLine();
+	std::size_t screen = visibleLineCount();
+	std::size_t distance = first > prefetchLine ? first - prefetchLine
+	                                            : prefetchLine - first;
+	if(forward == prefetchForward && distance > 0 && distance < screen)
+		return;
+	prefetchLine = first;
+	prefetchForward = forward;
+
+	std::size_t lines = document.pieces.lineCount();
+	std::size_t begin;
+	std::size_t end;
+	if(forward)
+	{
+		begin = std::min(lines, first + screen);
+		end = std::min(lines, begin + PREFETCH_SCREENS * screen);
+	}
+	else
+	{
+		end = first;
+		begin = end - std::min(end, PREFETCH_SCREENS * screen);
+	}
+	if(begin >= end)
+		return;
+
+	// Visit whole pieces, so finding the lines doesn't read (and fault
+	// in) the very pages we want to prefetch. Consecutive pieces of an
+	// unedited file are adjacent in the mapping, so merge their spans
+	// into as few requests as we can.
+	uint8_t const *rangeBegin = nullptr;
+	uint8_t const *rangeEnd = nullptr;
+	auto merge = [&](uint8_t const *b, uint8_t const *e) {
+		if(b != rangeEnd)
+		{
+			if(rangeBegin != nullptr)
+				prefetcher->prefetch(rangeBegin, rangeEnd);
+			rangeBegin = b;
+		}
+		rangeEnd = e;
+		return true;
+	};
+	document.pieces.forEachLineSpan(begin, end, merge);
+	if(rangeBegin != nullptr)
+		prefetcher->prefetch(rangeBegin, rangeEnd);
+}
+
+void DocumentView::ensureCursorVisible()
+{
+	std::size_t line = document.pieces.cursorToLine(document.cursor);
+	std::size_t first = firstVisibleLine();
+	std::size_t visibleLines = visibleLineCount();
+	if(line < first)
+	{
+		verticalScrollBar()->setValue(clampToInt(line));
+	}
+	else if(line >= first + visibleLines)
+	{
+		verticalScrollBar()->setValue(
+		        clampToInt(line - visibleLines + 1));
+	}
+
+	std::size_t column = cursorColumn(document.cursor);
+	std::size_t firstColumn =
+	        static_cast<std::size_t>(horizontalScrollBar()->value());
+	std::size_t visibleColumns = visibleColumnCount();
+	if(column >= widestLine)
+	{
+		widestLine = column + 1;
+		updateScrollBars();
+	}
+	if(column < firstColumn)
+	{
+		horizontalScrollBar()->setValue(clampToInt(column));
+	}
+	else if(column >= firstColumn + visibleColumns)
+	{
+		horizontalScrollBar()->setValue(
+		        clampToInt(column - visibleColumns + 1));
+	}
+}
+}
+}
@@ -0,0 +1,313 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_QOMPOSECOMMON_EDITOR_DOCUMENT_VIEW_H
+#define INCLUDE_QOMPOSECOMMON_EDITOR_DOCUMENT_VIEW_H
+
+#include <cstddef>
+#include <experimental/optional>
+#include <memory>
+#include <vector>
+
+#include <QAbstractScrollArea>
+#include <QColor>
+#include <QFont>
+#include <QString>
+
+#include "core/Types.hpp"
+#include "core/document/DisplayColumns.hpp"
+#include "core/document/Document.hpp"
+#include "core/document/DocumentHistory.hpp"
+#include "core/document/PieceTable.hpp"
+#include "core/file/MMIOPrefetcher.hpp"
+
+#include "QomposeCommon/hotkey/HotkeyedWidget.h"
+
+class QKeyEvent;
+class QMouseEvent;
+class QPaintEvent;
+class QResizeEvent;
+class QWheelEvent;
+
+namespace qompose
+{
+namespace editor
+{
+/*!
+ * \brief A text view which renders directly from a core PieceTable.
+ *
+ * Unlike Editor, this widget doesn't copy its contents into a
+ * QTextDocument. Instead, each time it is painted it fetches only the
+ * lines which are actually visible from the document's PieceTable, so
+ * opening or scrolling through a very large file costs roughly the same
+ * as a small one. Every edit produces a new Document snapshot, which is
+ * recorded in a DocumentHistory for undo and redo.
+ *
+ * This view doesn't support selections yet; the cursor is always a
+ * single caret position.
+ */
+class DocumentView : public hotkey::HotkeyedWidget<QAbstractScrollArea>
+{
+	Q_OBJECT
+
+public:
+	/*!
+	 * Create a new, empty document view.
+	 *
+	 * \param p Our parent widget.
+	 */
+	DocumentView(QWidget *p = nullptr);
+
+	DocumentView(DocumentView const &) = delete;
+	virtual ~DocumentView() = default;
+
+	DocumentView &operator=(DocumentView const &) = delete;
+
+	/*!
+	 * Replace this view's contents with the given text. This resets
+	 * the undo history, and moves the cursor to the given character
+	 * offset (or the end of the text, if it is shorter than that).
+	 *
+	 * \param pieces The new contents for this view.
+	 * \param offset The character offset to place the cursor at.
+	 */
+	void setPieceTable(core::document::PieceTable const &pieces,
+	                   std::size_t offset = 0);
+
+	/*!
+	 * Set the prefetcher used to read the parts of a mapped file which
+	 * are about to be scrolled into view in the background, so painting
+	 * them doesn't stall on page faults. Any part of the document which
+	 * isn't in the prefetcher's file is just ignored.
+	 *
+	 * \param p The prefetcher to use, or nullptr to disable prefetching.
+	 */
+	void setPrefetcher(
+	        std::shared_ptr<core::file::MMIOPrefetcher> const &p);
+
+	/*!
+	 * Find the parts of the given mapped file which this view still
+	 * refers to, either in the current document or in any snapshot in
+	 * its undo history. Overlapping and adjacent ranges are merged.
+	 *
+	 * \param file A mapped file which this view's pieces may refer to.
+	 * \return The referenced ranges, sorted by offset, or nothing if
+	 * some snapshots have been spilled to disk, since those may refer
+	 * to any part of the file.
+	 */
+	std::experimental::optional<std::vector<core::file::MMIOFile::Range>>
+	getReferencedRanges(core::file::MMIOFile const &file) const;
+
+	/*!
+	 * Measure every piece which refers to the given (detached) file
+	 * again, in the current document and in its undo history, after
+	 * the bytes it contains were changed by another program before it
+	 * was detached. Any piece whose bytes are no longer valid UTF-8 is
+	 * overwritten with NUL characters first. Snapshots which have been
+	 * spilled to disk can't be updated, so they are discarded.
+	 *
+	 * \param file The detached file whose contents changed.
+	 */
+	void remeasureFile(core::file::MMIOFile &file);
+
+	/*!
+	 * \return The document snapshot currently being displayed.
+	 */
+	core::document::Document const &getDocument() const;
+
+	/*!
+	 * While a view is read-only, the cursor can still be moved but all
+	 * edits (including undo and redo) are ignored.
+	 *
+	 * \param r Whether or not this view should be read-only.
+	 */
+	void setReadOnly(bool r);
+	bool isReadOnly() const;
+
+	void setGutterVisible(bool v);
+	bool isGutterVisible() const;
+
+	void setFont(QFont const &f);
+	QFont getFont() const;
+
+	int fontZoom() const;
+	void setFontZoom(int z);
+	void resetFontZoom();
+
+	std::size_t getIndentationWidth() const;
+	void setIndentationWidth(int w);
+
+	core::IndentationMode getIndentationMode() const;
+	void setIndentationMode(core::IndentationMode mode);
+
+	bool isWrapGuideVisible() const;
+	void setWrapGuideVisible(bool v);
+
+	int getWrapGuideColumnWidth() const;
+	void setWrapGuideColumnWidth(int w);
+
+	QColor getWrapGuideColor() const;
+	void setWrapGuideColor(QColor const &c);
+
+	QColor getEditorForeground() const;
+	void setEditorForeground(QColor const &c);
+
+	QColor getEditorBackground() const;
+	void setEditorBackground(QColor const &c);
+
+	QColor getCurrentLineColor() const;
+	void setCurrentLineColor(QColor const &c);
+
+	QColor getGutterForeground() const;
+	void setGutterForeground(QColor const &c);
+
+	QColor getGutterBackground() const;
+	void setGutterBackground(QColor const &c);
+
+	/*!
+	 * \return The (one-based) line number the cursor is on.
+	 */
+	std::size_t getCurrentLine() const;
+
+	/*!
+	 * \return The (one-based) display column the cursor is on.
+	 */
+	std::size_t getCurrentColumn() const;
+
+public Q_SLOTS:
+	void undo();
+	void redo();
+
+protected:
+	virtual void keyPressEvent(QKeyEvent *e) override;
+	virtual void mousePressEvent(QMouseEvent *e) override;
+	virtual void paintEvent(QPaintEvent *e) override;
+	virtual void resizeEvent(QResizeEvent *e) override;
+	virtual void scrollContentsBy(int dx, int dy) override;
+	virtual void wheelEvent(QWheelEvent *e) override;
+
+private:
+	core::document::Document document;
+	core::document::DocumentHistory history;
+
+	bool readOnly;
+	bool gutterVisible;
+	QFont currentFont;
+	qreal originalFontSize;
+	int currentFontZoom;
+	int indentationWidth;
+	core::IndentationMode indentationMode;
+	bool wrapGuideVisible;
+	int wrapGuideWidth;
+	QColor wrapGuideColor;
+	QColor editorForeground;
+	QColor editorBackground;
+	QColor currentLineHighlight;
+	QColor gutterForeground;
+	QColor gutterBackground;
+
+	// The widest line we've laid out so far, in columns.
+	std::size_t widestLine;
+
+	// Converts between cursors and columns, caching as it goes.
+	mutable core::document::DisplayColumns columns;
+
+	std::shared_ptr<core::file::MMIOPrefetcher> prefetcher;
+	// Where, and in which direction, we last prefetched from.
+	std::size_t prefetchLine;
+	bool prefetchForward;
+
+	void initializeHotkeys();
+
+	qreal fontZoomSize() const;
+	qreal singleColumnWidth() const;
+	int lineHeight() const;
+	int gutterWidth() const;
+	qreal textLeft() const;
+
+	std::size_t firstVisibleLine() const;
+	std::size_t visibleLineCount() const;
+	std::size_t visibleColumnCount() const;
+
+	/*!
+	 * Return the text of the given line, without its line ending.
+	 * At most limit characters are decoded, so a very long line
+	 * doesn't have to be read in full just to paint its beginning.
+	 *
+	 * \param line The zero-based line number to fetch.
+	 * \param limit The maximum number of characters to return.
+	 * \return The (possibly truncated) line's text.
+	 */
+	QString lineText(std::size_t line, std::size_t limit) const;
+
+	/*!
+	 * \param cursor A position in the current document.
+	 * \return The zero-based display column of the given position.
+	 */
+	std::size_t cursorColumn(core::document::Cursor const &cursor) const;
+
+	/*!
+	 * Return the position on the given line which is closest to the
+	 * given display column, without going past the end of the line.
+	 *
+	 * \param line The zero-based line number.
+	 * \param column The zero-based display column.
+	 * \return The closest position on that line.
+	 */
+	core::document::Cursor cursorAtColumn(std::size_t line,
+	                                      std::size_t column) const;
+
+	QString getIndentString() const;
+
+	void setCursor(core::document::Cursor const &cursor);
+	void moveToLine(std::size_t line);
+	void insertText(QString const &text, core::document::EditKind kind);
+	void eraseBackward();
+	void eraseForward();
+
+	/*!
+	 * Display the given snapshot, and record it in our history.
+	 *
+	 * \param pieces The edited contents.
+	 * \param cursor The cursor position after the edit.
+	 * \param kind The kind of edit which produced this snapshot.
+	 */
+	void commit(core::document::PieceTable const &pieces,
+	            core::document::Cursor const &cursor,
+	            core::document::EditKind kind);
+
+	void showDocument();
+	void updateScrollBars();
+	void ensureCursorVisible();
+
+	/*!
+	 * Prefetch the next few screens of the document in the direction
+	 * we're scrolling in, if we haven't done so recently.
+	 *
+	 * \param forward Whether we're scrolling towards the end.
+	 */
+	void prefetchAhead(bool forward);
+
+Q_SIGNALS:
+	void cursorPositionChanged();
+	void contentsChanged();
+};
+}
+}
+
+#endif
@@ -20,6 +20,9 @@
 
 #include <QPainter>
 #include <QTextBlock>
+#include <QVector>
+
+#include "core/string/CharacterWidth.hpp"
 
 #include "QomposeCommon/editor/Gutter.h"
 #include "QomposeCommon/editor/algorithm/General.h"
@@ -328,17 +331,20 @@ int Editor::getCurrentLine() const
 
 int Editor::getCurrentColumn() const
 {
-	FontMetrics metrics(currentFont);
-
-	qreal xoff = static_cast<qreal>(cursorRect().x());
+	// Compute the column from the text itself, rather than from the
+	// cursor's position in the layout, which is both slower and wrong
+	// for characters which aren't exactly one column wide.
+	QTextCursor cursor = textCursor();
+	QString text = cursor.block().text().left(cursor.positionInBlock());
 
-	xoff -= x();
-	xoff -= contentOffset().x();
-	xoff -= document()->documentMargin();
-
-	xoff /= metrics.getColumnWidthF(1);
+	std::size_t column = 0;
+	for(uint character : text.toUcs4())
+	{
+		column = core::string::advanceDisplayColumn(
+		        column, character, getIndentationWidth());
+	}
 
-	return qRound(xoff) + 1;
+	return static_cast<int>(column) + 1;
 }
 
 void Editor::paintEvent(QPaintEvent *e)
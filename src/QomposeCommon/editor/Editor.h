@@ -325,8 +325,8 @@ public:
 
 	/*!
 	 * This function returns the current cursor's 1-indexed column number.
-	 * This is based upon the pixel offset of the cursor, so we properly
-	 * account for tab stops.
+	 * This is the cursor's display column, so we properly account for
+	 * tab stops and for wide (e.g. East Asian) characters.
 	 *
 	 * \return The current cursor's column number.
 	 */
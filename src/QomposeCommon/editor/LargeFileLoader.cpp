@@ -0,0 +1,169 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LargeFileLoader.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+// The number of bytes at the start of a file shown as a preview.
+constexpr std::size_t PREVIEW_SIZE = 1024 * 1024;
+
+// The number of bytes converted at a time when loading files which
+// aren't UTF-8. This is also roughly the size of each resource.
+constexpr std::size_t TRANSCODE_CHUNK_SIZE = 1024 * 1024;
+}
+
+namespace qompose
+{
+namespace editor
+{
+uint8_t const *MappedFileRegion::data() const
+{
+	return file->data();
+}
+
+std::size_t MappedFileRegion::size() const
+{
+	return length;
+}
+
+core::document::PieceTable
+makePreviewPieceTable(std::shared_ptr<core::file::MMIOFile> const &file)
+{
+	uint8_t const *begin = file->data();
+	uint8_t const *end = begin + std::min(file->size(), PREVIEW_SIZE);
+
+	// Stop at the last complete line in the preview if there is one, or
+	// otherwise at least at a character boundary.
+	if(end != begin + file->size())
+	{
+		uint8_t const *lineEnd = end;
+		while(lineEnd > begin && *(lineEnd - 1) != '\n')
+			--lineEnd;
+
+		if(lineEnd != begin)
+		{
+			end = lineEnd;
+		}
+		else
+		{
+			while(end > begin && (*end & 0xC0U) == 0x80U)
+				--end;
+		}
+	}
+
+	return core::document::PieceTable(MappedFileRegion{
+	        file, static_cast<std::size_t>(end - begin)});
+}
+
+core::document::PieceTable
+makePreviewPieceTable(std::shared_ptr<core::file::MMIOFile> const &file,
+                      core::string::TextEncoding encoding)
+{
+	std::size_t length = std::min(file->size(), PREVIEW_SIZE);
+	core::string::TextDecoder decoder(encoding);
+	std::vector<uint8_t> preview;
+	decoder.decode(file->data(), file->data() + length, preview);
+
+	// The decoder's output always ends on a character boundary, but
+	// stop at the last complete line in the preview if there is one.
+	if(length == file->size())
+	{
+		decoder.finish(preview);
+	}
+	else
+	{
+		auto lineEnd =
+		        std::find(preview.rbegin(), preview.rend(), '\n');
+		if(lineEnd != preview.rend())
+			preview.erase(lineEnd.base(), preview.end());
+	}
+
+	return core::document::PieceTable(std::move(preview));
+}
+
+LargeFileLoader::LargeFileLoader(
+        std::shared_ptr<core::file::MMIOFile> const &f,
+        std::shared_ptr<core::document::PieceTable> const &r,
+        std::shared_ptr<core::document::TextStatistics> const &s, int g,
+        std::experimental::optional<core::string::TextEncoding> e)
+        : QObject(nullptr),
+          file(f),
+          result(r),
+          statistics(s),
+          generation(g),
+          encoding(e)
+{
+}
+
+void LargeFileLoader::load()
+{
+	core::document::TextScanner scanner(false);
+	if(!encoding)
+	{
+		// The file's encoding may have been guessed from just its
+		// first few bytes, so it might not be valid UTF-8 after all.
+		// If not, the result is left empty, and the statistics report
+		// that the file is invalid.
+		try
+		{
+			*result = core::document::PieceTable(
+			        MappedFileRegion{file, file->size()}, scanner);
+		}
+		catch(std::runtime_error const &)
+		{
+		}
+		*statistics = scanner.finish();
+
+		// From now on, the file is read wherever it is being edited.
+		file->advise(core::file::MMIOAccessPattern::Random);
+		Q_EMIT loaded(generation);
+		return;
+	}
+
+	core::string::TextDecoder decoder(*encoding);
+	core::document::PieceTable pieces;
+	std::vector<uint8_t> output;
+	for(std::size_t offset = 0; offset < file->size();
+	    offset += TRANSCODE_CHUNK_SIZE)
+	{
+		uint8_t const *chunk = file->data() + offset;
+		std::size_t length =
+		        std::min(file->size() - offset, TRANSCODE_CHUNK_SIZE);
+		decoder.decode(chunk, chunk + length, output);
+		if(offset + length == file->size())
+			decoder.finish(output);
+
+		// Copy the output, so each resource is no larger than it
+		// needs to be, and reuse the buffer for the next chunk.
+		pieces.append(
+		        std::vector<uint8_t>(output.begin(), output.end()),
+		        scanner);
+		output.clear();
+	}
+
+	*result = pieces;
+	*statistics = scanner.finish();
+	Q_EMIT loaded(generation);
+}
+}
+}
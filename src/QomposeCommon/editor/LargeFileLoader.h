@@ -0,0 +1,142 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_QOMPOSECOMMON_EDITOR_LARGE_FILE_LOADER_H
+#define INCLUDE_QOMPOSECOMMON_EDITOR_LARGE_FILE_LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <experimental/optional>
+#include <memory>
+
+#include <QObject>
+
+#include "core/document/PieceTable.hpp"
+#include "core/document/TextScanner.hpp"
+#include "core/file/MMIOFile.hpp"
+#include "core/string/Transcoder.hpp"
+
+namespace qompose
+{
+namespace editor
+{
+/*!
+ * \brief A PieceTable resource which refers to a prefix of a mapped file.
+ *
+ * Several piece tables can share the same mapping this way, e.g. a quick
+ * preview of the start of a file and the full table built later on.
+ */
+struct MappedFileRegion
+{
+	std::shared_ptr<core::file::MMIOFile> file;
+	std::size_t length;
+
+	uint8_t const *data() const;
+	std::size_t size() const;
+};
+
+/*!
+ * Build a piece table containing only the first few lines of the given
+ * file. This is cheap regardless of the file's size, so it can be shown
+ * right away while the full table is built in the background.
+ *
+ * Since the table refers to the file's bytes directly, they must be valid
+ * UTF-8; if they aren't, an exception is thrown.
+ *
+ * \param file The mapped file to preview.
+ * \return A piece table containing a prefix of the file.
+ */
+core::document::PieceTable
+makePreviewPieceTable(std::shared_ptr<core::file::MMIOFile> const &file);
+
+/*!
+ * Build a piece table containing only the first few lines of the given
+ * file, which is in some encoding other than UTF-8. Only the start of the
+ * file is converted to UTF-8, so this is also cheap regardless of the
+ * file's size.
+ *
+ * \param file The mapped file to preview.
+ * \param encoding The file's encoding.
+ * \return A piece table containing a prefix of the file.
+ */
+core::document::PieceTable
+makePreviewPieceTable(std::shared_ptr<core::file::MMIOFile> const &file,
+                      core::string::TextEncoding encoding);
+
+/*!
+ * \brief This class builds a PieceTable for an entire mapped file.
+ *
+ * Building the table scans every byte of the file to compute its line
+ * and character index, which can take a while for very large files.
+ * This object is meant to be moved to a worker thread; the load() slot
+ * does the work, and loaded() is emitted once the result is available.
+ * Since a load can't be interrupted, loaded() carries a generation
+ * number so the receiver can ignore loads it has since abandoned.
+ *
+ * Files in other encodings are converted to UTF-8 one chunk at a time,
+ * with each converted chunk becoming one of the table's resources, so
+ * the file is never held in memory in both encodings at once.
+ *
+ * The same pass which builds the table also computes the file's
+ * TextStatistics (e.g. its line ending style). Line starts aren't
+ * recorded, since the table indexes lines itself. If a UTF-8 file turns
+ * out to contain invalid bytes, no table is built, and the statistics
+ * are marked invalid instead.
+ */
+class LargeFileLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	/*!
+	 * \param f The file to load.
+	 * \param r The piece table to store the result in.
+	 * \param s The statistics to store the result's statistics in.
+	 * \param g A number identifying this load, passed to loaded().
+	 * \param e The file's encoding, or nothing if it is UTF-8.
+	 */
+	LargeFileLoader(
+	        std::shared_ptr<core::file::MMIOFile> const &f,
+	        std::shared_ptr<core::document::PieceTable> const &r,
+	        std::shared_ptr<core::document::TextStatistics> const &s,
+	        int g,
+	                std::experimental::optional<core::string::TextEncoding>
+	                        e = std::experimental::nullopt);
+
+	LargeFileLoader(LargeFileLoader const &) = delete;
+	virtual ~LargeFileLoader() = default;
+
+	LargeFileLoader &operator=(LargeFileLoader const &) = delete;
+
+public Q_SLOTS:
+	void load();
+
+private:
+	std::shared_ptr<core::file::MMIOFile> file;
+	std::shared_ptr<core::document::PieceTable> result;
+	std::shared_ptr<core::document::TextStatistics> statistics;
+	int generation;
+	std::experimental::optional<core::string::TextEncoding> encoding;
+
+Q_SIGNALS:
+	void loaded(int generation);
+};
+}
+}
+
+#endif
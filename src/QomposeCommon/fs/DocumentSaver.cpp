@@ -0,0 +1,166 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DocumentSaver.h"
+
+#include <exception>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextCodec>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "QomposeCommon/fs/DocumentWriter.h"
+
+namespace
+{
+/*!
+ * Flush the given directory's entries to disk, so e.g. a file which was
+ * just renamed into it keeps its new name after a crash.
+ *
+ * \param path The path to the directory.
+ * \return True on success, or false otherwise.
+ */
+bool syncDirectory(QString const &path)
+{
+	int fd = open(QFile::encodeName(path).constData(),
+	              O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(fd == -1)
+		return false;
+	bool r = fsync(fd) == 0;
+	close(fd);
+	return r;
+}
+}
+
+namespace qompose
+{
+bool saveAtomically(QString const &path,
+                    std::function<bool(QIODevice &)> const &write,
+                    bool directWriteFallback, QString *error)
+{
+	QSaveFile file(path);
+	file.setDirectWriteFallback(directWriteFallback);
+	if(!file.open(QIODevice::WriteOnly))
+	{
+		if(error != nullptr)
+			*error = file.errorString();
+		return false;
+	}
+
+	// QSaveFile writes to a temporary file in the same directory, and
+	// renames it over the original when committed. Make sure the new
+	// contents are on disk before the rename, so a crash can't leave
+	// an empty file behind.
+	if(!write(file) || !file.flush() || fsync(file.handle()) != 0)
+	{
+		if(error != nullptr)
+			*error = file.errorString();
+		file.cancelWriting();
+		file.commit();
+		return false;
+	}
+	if(!file.commit())
+	{
+		if(error != nullptr)
+			*error = file.errorString();
+		return false;
+	}
+
+	// The file has been saved either way, but the rename itself might
+	// not survive a crash if this fails, so it isn't an error.
+	syncDirectory(QFileInfo(path).absolutePath());
+	return true;
+}
+
+DocumentSaver::DocumentSaver(QString const &p,
+                             core::document::PieceTable const &d,
+                             QByteArray const &c, bool t,
+                             std::shared_ptr<core::file::MMIOFile> const &s)
+        : QObject(nullptr),
+          path(p),
+          document(d),
+          codec(c),
+          whitespaceTrimmed(t),
+          source(s),
+          sourceFd(-1)
+{
+	if(!source)
+		return;
+
+	// The file may be detached while we're saving, so get our own
+	// descriptor for it now. If the bytes we mapped have already been
+	// changed on disk, they can't be copied from it.
+	try
+	{
+		core::file::MMIOFileChange change = source->getChange();
+		if(change == core::file::MMIOFileChange::None ||
+		   change == core::file::MMIOFileChange::Extended)
+		{
+			sourceFd = source->duplicateDescriptor();
+		}
+	}
+	catch(std::exception const &)
+	{
+	}
+}
+
+DocumentSaver::~DocumentSaver()
+{
+	if(sourceFd != -1)
+		close(sourceFd);
+}
+
+void DocumentSaver::save()
+{
+	bool r = false;
+	QString error;
+	QTextCodec *c = QTextCodec::codecForName(codec);
+	if(c != nullptr)
+	{
+		auto writeDocument = [this, c](QIODevice &device) {
+			DocumentWriter writer(&device);
+			writer.setCodec(c);
+			writer.setWhitespaceTrimmed(whitespaceTrimmed);
+			// Even without a descriptor, the source tells which
+			// lines weren't edited, and so shouldn't be trimmed.
+			if(source)
+			{
+				writer.setSourceFile(source->data(),
+				                     source->size(), sourceFd);
+			}
+			return writer.write(document);
+		};
+
+		// Writing over the file the snapshot refers to would corrupt
+		// the snapshot as it is written, so only fall back to writing
+		// in place if it doesn't refer to a mapped file at all.
+		r = saveAtomically(path, writeDocument, !source, &error);
+	}
+	else
+	{
+		error = tr("The '%1' encoding isn't supported.")
+		                .arg(QString::fromLatin1(codec));
+	}
+
+	Q_EMIT saved(r, error);
+}
+}
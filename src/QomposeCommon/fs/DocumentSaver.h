@@ -0,0 +1,116 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCLUDE_QOMPOSECOMMON_FS_DOCUMENT_SAVER_H
+#define INCLUDE_QOMPOSECOMMON_FS_DOCUMENT_SAVER_H
+
+#include <functional>
+#include <memory>
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include "core/document/PieceTable.hpp"
+#include "core/file/MMIOFile.hpp"
+
+class QIODevice;
+
+namespace qompose
+{
+/*!
+ * This function replaces the file at the given path atomically. The new
+ * contents are written to a temporary file in the same directory, which
+ * is flushed to disk and then renamed over the original. So, if writing
+ * fails (or the system crashes) partway through, the original file is
+ * left as it was, rather than truncated.
+ *
+ * If the directory isn't writable, no temporary file can be created in
+ * it. In that case, the file can optionally be overwritten in place
+ * instead, giving up atomicity. This must not be allowed if the new
+ * contents are read from the original file as they are written.
+ *
+ * \param path The path to the file to replace.
+ * \param write A function which writes the new contents to a device.
+ * \param directWriteFallback Whether to overwrite the file in place if
+ *        it can't be replaced atomically.
+ * \param error If not null, set to the reason saving failed, if it did.
+ * \return True on success, or false otherwise.
+ */
+bool saveAtomically(QString const &path,
+                    std::function<bool(QIODevice &)> const &write,
+                    bool directWriteFallback = false,
+                    QString *error = nullptr);
+
+/*!
+ * \brief This class saves a PieceTable snapshot in the background.
+ *
+ * Since PieceTables are persistent, taking a snapshot to save is cheap,
+ * and the document can keep being edited while the snapshot is written.
+ * This object is meant to be moved to a worker thread; the save() slot
+ * writes the snapshot with a DocumentWriter (see saveAtomically()), and
+ * saved() is emitted once it is done.
+ *
+ * If the snapshot was loaded from a mapped file, the parts of it which
+ * haven't been edited are copied from that file directly (see
+ * DocumentWriter::setSourceFile()).
+ */
+class DocumentSaver : public QObject
+{
+	Q_OBJECT
+
+public:
+	/*!
+	 * \param p The path to save the snapshot to.
+	 * \param d The snapshot to save.
+	 * \param c The name of the codec to encode the snapshot with.
+	 * \param t Whether or not to trim trailing whitespace.
+	 * \param s The mapped file the snapshot was loaded from, if any.
+	 */
+	DocumentSaver(QString const &p, core::document::PieceTable const &d,
+	              QByteArray const &c, bool t,
+	              std::shared_ptr<core::file::MMIOFile> const &s =
+	                      nullptr);
+
+	DocumentSaver(DocumentSaver const &) = delete;
+	virtual ~DocumentSaver();
+
+	DocumentSaver &operator=(DocumentSaver const &) = delete;
+
+public Q_SLOTS:
+	void save();
+
+private:
+	QString path;
+	core::document::PieceTable document;
+	QByteArray codec;
+	bool whitespaceTrimmed;
+	std::shared_ptr<core::file::MMIOFile> source;
+	// Our own descriptor for the source file, or -1 if there is none.
+	int sourceFd;
+
+Q_SIGNALS:
+	/*!
+	 * \param success Whether or not the snapshot was saved.
+	 * \param error If saving failed, a description of why.
+	 */
+	void saved(bool success, QString const &error);
+};
+}
+
+#endif
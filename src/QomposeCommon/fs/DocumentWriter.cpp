@@ -18,20 +18,42 @@
 
 #include "DocumentWriter.h"
 
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+#include <QByteArray>
+#include <QFileDevice>
 #include <QIODevice>
-#include <QRegExp>
-#include <QStringList>
+#include <QTextBlock>
 #include <QTextCodec>
 #include <QTextDocument>
 
+#include "core/document/PieceTable.hpp"
+#include "core/document/TextScanner.hpp"
+#include "core/file/FileCopy.hpp"
+#include "core/string/Transcoder.hpp"
+#include "core/string/WhitespaceTrimmer.hpp"
+
 namespace qompose
 {
-DocumentWriter::DocumentWriter() : whitespaceTrimmed(false), stream()
+DocumentWriter::DocumentWriter()
+        : whitespaceTrimmed(false),
+          lineEnding(core::document::LineEnding::Lf),
+          stream(),
+          sourceData(nullptr),
+          sourceSize(0),
+          sourceFd(-1)
 {
 }
 
 DocumentWriter::DocumentWriter(QIODevice *d)
-        : whitespaceTrimmed(false), stream()
+        : whitespaceTrimmed(false),
+          lineEnding(core::document::LineEnding::Lf),
+          stream(),
+          sourceData(nullptr),
+          sourceSize(0),
+          sourceFd(-1)
 {
 	setDevice(d);
 }
@@ -70,6 +92,24 @@ void DocumentWriter::setWhitespaceTrimmed(bool w)
 	whitespaceTrimmed = w;
 }
 
+core::document::LineEnding DocumentWriter::getLineEnding() const
+{
+	return lineEnding;
+}
+
+void DocumentWriter::setLineEnding(core::document::LineEnding e)
+{
+	lineEnding = e;
+}
+
+void DocumentWriter::setSourceFile(uint8_t const *data, std::size_t size,
+                                   int fd)
+{
+	sourceData = data;
+	sourceSize = size;
+	sourceFd = fd;
+}
+
 bool DocumentWriter::write(const QTextDocument *d)
 {
 	// Make sure our device is good for writing.
@@ -80,39 +120,222 @@ bool DocumentWriter::write(const QTextDocument *d)
 		return false;
 	}
 
-	// Get the contents of the document.
+	// Write the document one block (i.e., line) at a time, rather than
+	// copying all of it with toPlainText() first. Our text stream
+	// encodes and writes its buffer whenever it fills up.
 
-	QString contents = d->toPlainText();
+	bool format = isWhitespaceTrimmed() ||
+	              getLineEnding() != core::document::LineEnding::Lf;
+	QString ending = lineEndingString();
+	for(QTextBlock block = d->begin(); block.isValid();
+	    block = block.next())
+	{
+		if(block != d->begin())
+			stream << ending;
+
+		// Like toPlainText(), replace non-breaking spaces.
+		QString line = block.text();
+		line.replace(QChar::Nbsp, QLatin1Char(' '));
+		stream << (format ? formatLines(line) : line);
 
-	if(isWhitespaceTrimmed())
-		contents = trimWhitespace(contents);
+		if(stream.status() != QTextStream::Ok)
+			return false;
+	}
 
-	// Write the contents to our text stream.
+	stream.flush();
+	return stream.status() == QTextStream::Ok;
+}
 
-	stream << contents;
+bool DocumentWriter::write(core::document::PieceTable const &pieces)
+{
+	QIODevice *device = getDevice();
+	if(!device->isWritable() && !device->open(QIODevice::WriteOnly))
+		return false;
 
-	getDevice()->close();
+	auto writeBytes = [device](uint8_t const *begin, uint8_t const *end) {
+		qint64 length = static_cast<qint64>(end - begin);
+		return device->write(reinterpret_cast<char const *>(begin),
+		                     length) == length;
+	};
 
+	// Trimming whitespace holds back at most a run of whitespace, so
+	// each span can still be written as soon as it has been trimmed.
+	// Lines of our source file which weren't edited are left as-is.
+	using core::document::PieceTable;
+	auto forEachSpan = [&](PieceTable::SpanVisitor const &visitor) {
+		if(!isWhitespaceTrimmed())
+			return pieces.forEachSpan(visitor);
+
+		if(sourceData != nullptr)
+		{
+			core::string::EditedLineTrimmer trimmer(
+			        sourceData, sourceData + sourceSize, visitor);
+			bool r = pieces.forEachSpan(
+			        [&](uint8_t const *begin, uint8_t const *end) {
+				        return trimmer.trim(begin, end);
+				});
+			return r && trimmer.finish();
+		}
+
+		core::string::WhitespaceTrimmer trimmer;
+		std::vector<uint8_t> trimmed;
+		bool r = pieces.forEachSpan(
+		        [&](uint8_t const *begin, uint8_t const *end) {
+			        trimmed.clear();
+			        trimmer.trim(begin, end, trimmed);
+			        return trimmed.empty() ||
+			               visitor(trimmed.data(),
+			                       trimmed.data() + trimmed.size());
+			});
+		trimmer.finish();
+		return r;
+	};
+
+	QByteArray codecName = getCodec()->name();
+	if(codecName == "UTF-8")
+	{
+		// Anything already buffered by the device has to be written
+		// before we write to its descriptor.
+		auto file = qobject_cast<QFileDevice *>(device);
+		if(sourceFd != -1 && file != nullptr && file->handle() != -1 &&
+		   file->flush())
+		{
+			return writeIncrementally(forEachSpan, file->handle());
+		}
+		return forEachSpan(writeBytes);
+	}
+
+	auto encoding = core::string::textEncodingFromName(
+	        codecName.toStdString());
+	if(!encoding)
+	{
+		// Spans always end on character boundaries, so they can be
+		// decoded independently.
+		bool r = forEachSpan(
+		        [this](uint8_t const *begin, uint8_t const *end) {
+			        stream << QString::fromUtf8(
+			                reinterpret_cast<char const *>(begin),
+			                static_cast<int>(end - begin));
+			        return stream.status() == QTextStream::Ok;
+			});
+		stream.flush();
+		return r && stream.status() == QTextStream::Ok;
+	}
+
+	core::string::TextEncoder encoder(*encoding,
+	                                  stream.generateByteOrderMark());
+	std::vector<uint8_t> buffer;
+	auto writeBuffer = [&]() {
+		bool r = writeBytes(buffer.data(),
+		                    buffer.data() + buffer.size());
+		buffer.clear();
+		return r;
+	};
+
+	bool r = forEachSpan(
+	        [&](uint8_t const *begin, uint8_t const *end) {
+		        encoder.encode(begin, end, buffer);
+		        return writeBuffer();
+		});
+	encoder.finish(buffer);
+	return writeBuffer() && r;
+}
+
+bool DocumentWriter::writeIncrementally(SpanIterator const &forEachSpan,
+                                        int fd)
+{
+	uint8_t const *sourceEnd = sourceData + sourceSize;
+	auto isInSource = [&](uint8_t const *begin, uint8_t const *end) {
+		return begin >= sourceData && end <= sourceEnd;
+	};
+
+	// The pieces of an unedited region of the file are adjacent in its
+	// mapping, so merge spans into as few ranges as we can.
+	uint8_t const *rangeBegin = nullptr;
+	uint8_t const *rangeEnd = nullptr;
+	auto writeRange = [&]() {
+		if(rangeBegin == rangeEnd)
+			return;
+
+		// If the file has been truncated since it was mapped, write
+		// whatever is left of the range from the mapping.
+		std::size_t length =
+		        static_cast<std::size_t>(rangeEnd - rangeBegin);
+		std::size_t copied = core::file::copyFileRange(
+		        sourceFd,
+		        static_cast<std::size_t>(rangeBegin - sourceData), fd,
+		        length);
+		core::file::writeFully(fd, rangeBegin + copied, rangeEnd);
+		rangeBegin = rangeEnd = nullptr;
+	};
+
+	try
+	{
+		forEachSpan([&](uint8_t const *begin, uint8_t const *end) {
+			// Trimmed text is only valid until we return, so
+			// anything not from the source is written right away.
+			if(!isInSource(begin, end))
+			{
+				writeRange();
+				core::file::writeFully(fd, begin, end);
+				return true;
+			}
+
+			if(begin != rangeEnd)
+			{
+				writeRange();
+				rangeBegin = begin;
+			}
+			rangeEnd = end;
+			return true;
+		});
+		writeRange();
+	}
+	catch(std::exception const &)
+	{
+		return false;
+	}
 	return true;
 }
 
-QString DocumentWriter::trimWhitespace(const QString &s) const
+QString DocumentWriter::lineEndingString() const
 {
-	QString result("");
+	if(getLineEnding() == core::document::LineEnding::CrLf)
+		return "\r\n";
+	else if(getLineEnding() == core::document::LineEnding::Cr)
+		return "\r";
+	return "\n";
+}
 
-	QStringList lines =
-	        s.split(QRegExp("\n|(\r\n)|\r"), QString::KeepEmptyParts);
+QString DocumentWriter::formatLines(const QString &s) const
+{
+	QString ending = lineEndingString();
 
-	for(int i = 0; i < lines.size(); ++i)
+	QString result;
+	result.reserve(s.size());
+
+	int begin = 0;
+	while(true)
 	{
-		int n = lines.at(i).size() - 1;
-		while((n >= 0) && lines.at(i).at(n).isSpace())
-			--n;
+		int end = begin;
+		while(end < s.size() && s.at(end) != '\n' && s.at(end) != '\r')
+			++end;
+
+		int last = end;
+		if(isWhitespaceTrimmed())
+		{
+			while(last > begin && s.at(last - 1).isSpace())
+				--last;
+		}
+		result.append(s.midRef(begin, last - begin));
 
-		result.append(lines.at(i).left(n + 1));
+		if(end == s.size())
+			break;
+		result.append(ending);
 
-		if(i < lines.size() - 1)
-			result.append('\n');
+		begin = end + 1;
+		if(s.at(end) == '\r' && begin < s.size() && s.at(begin) == '\n')
+			++begin;
 	}
 
 	return result;
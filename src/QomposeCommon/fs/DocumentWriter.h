@@ -19,6 +19,10 @@
 #ifndef INCLUDE_QOMPOSECOMMON_UTIL_DOCUMENT_WRITER_H
 #define INCLUDE_QOMPOSECOMMON_UTIL_DOCUMENT_WRITER_H
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
 #include <QString>
 #include <QTextStream>
 
@@ -28,6 +32,15 @@ class QTextDocument;
 
 namespace qompose
 {
+namespace core
+{
+namespace document
+{
+enum class LineEnding;
+class PieceTable;
+}
+}
+
 /*!
  * \brief This class encapsulates code to write QDocuments to QIODevices.
  */
@@ -103,38 +116,129 @@ public:
 	 */
 	void setWhitespaceTrimmed(bool w);
 
+	/*!
+	 * This function returns the line ending this writer uses when
+	 * writing QTextDocuments.
+	 *
+	 * \return The line ending this object is currently using.
+	 */
+	core::document::LineEnding getLineEnding() const;
+
+	/*!
+	 * This function sets the line ending to use when writing
+	 * QTextDocuments, whose plain text always uses '\n'. This is
+	 * normally the line ending the file used when it was loaded, so
+	 * saving it doesn't change its style.
+	 *
+	 * \param e The line ending to use.
+	 */
+	void setLineEnding(core::document::LineEnding e);
+
+	/*!
+	 * This function sets the file which the piece tables we write are
+	 * (mostly) mapped from. When a piece table is written as UTF-8 to a
+	 * file, the ranges of it which lie in this file's mapping are copied
+	 * from the file by the kernel (see core::file::copyFileRange())
+	 * instead of being read through the mapping. So, saving a huge file
+	 * after a small edit only writes the edit.
+	 *
+	 * If trailing whitespace is being trimmed, only lines which were
+	 * edited are trimmed (see core::string::EditedLineTrimmer), so the
+	 * rest can still be copied as-is.
+	 *
+	 * The descriptor must refer to the same file as the mapping, and
+	 * is not closed by this object.
+	 *
+	 * \param data The beginning of the file's mapping.
+	 * \param size The size of the file's mapping, in bytes.
+	 * \param fd A descriptor for the file, or -1 to read the mapping.
+	 */
+	void setSourceFile(uint8_t const *data, std::size_t size, int fd);
+
 	/*!
 	 * This function writes the given document to our writer's current
 	 * QIODevice, using our current QTextCodec for text encoding.
 	 *
-	 * This is done by getting the document's plain text (via
-	 * toPlainText()), optionally processing it first, and then writing it
-	 * to whatever QIODevice we're configured to use.
+	 * The document is written one block at a time, optionally trimming
+	 * whitespace and converting line endings as it goes, so its text is
+	 * never copied in full. The device is left open, so e.g. a QSaveFile
+	 * can be committed afterwards.
 	 *
 	 * \param d The text document to write.
 	 * \return True on success, or false otherwise.
 	 */
 	bool write(const QTextDocument *d);
 
+	/*!
+	 * This function writes the given piece table to our writer's current
+	 * QIODevice, using our current QTextCodec for text encoding.
+	 *
+	 * The table is written one piece at a time, so this never needs
+	 * more than a piece's worth of memory, regardless of how large the
+	 * table is. UTF-8 text is written as-is, and the encodings
+	 * core::string::TextEncoder supports are converted directly; any
+	 * other codec is used through a QTextStream. Trailing whitespace is
+	 * trimmed (see core::string::WhitespaceTrimmer) if enabled, except
+	 * on unedited lines of our source file, if we have one, but line
+	 * endings are always written as they are.
+	 *
+	 * This only reads the given table, which is an immutable snapshot,
+	 * so it can be written from any thread while editing continues.
+	 *
+	 * \param pieces The piece table to write.
+	 * \return True on success, or false otherwise.
+	 */
+	bool write(core::document::PieceTable const &pieces);
+
 private:
 	bool whitespaceTrimmed;
+	core::document::LineEnding lineEnding;
 
 	QTextStream stream;
 
+	uint8_t const *sourceData;
+	std::size_t sourceSize;
+	int sourceFd;
+
+	// Calls the given visitor with each span of the text to write,
+	// like core::document::PieceTable::forEachSpan().
+	typedef std::function<bool(
+	        std::function<bool(uint8_t const *, uint8_t const *)> const &)>
+	        SpanIterator;
+
+	/*!
+	 * This function writes the given spans' bytes as-is to the given
+	 * descriptor, copying the ranges which lie in our source file from
+	 * the source's descriptor.
+	 *
+	 * \param forEachSpan A function which calls a visitor with each
+	 *        span to write, e.g. a piece table's (possibly trimmed)
+	 *        spans.
+	 * \param fd The descriptor to write to.
+	 * \return True on success, or false otherwise.
+	 */
+	bool writeIncrementally(SpanIterator const &forEachSpan, int fd);
+
+	/*!
+	 * \return Our current line ending, as a string.
+	 */
+	QString lineEndingString() const;
+
 	/*!
-	 * This is a utility function which trims the trailing whitespace from
-	 * each line in the given string. The given string is split into lines
-	 * ending with one of the various platform-dependent newlines, and
-	 * then each line is stripped of trailing whitespace (i.e., any
-	 * QChars where isSpace() returns true).
+	 * This is a utility function which splits the given string into
+	 * lines ending with one of the various platform-dependent newlines,
+	 * and joins them back together using our line ending. If whitespace
+	 * trimming is enabled, each line is also stripped of trailing
+	 * whitespace (i.e., any QChars where isSpace() returns true). This
+	 * is all done in a single pass over the string.
 	 *
 	 * Note that the given string isn't modified; a new string is returned
 	 * instead.
 	 *
-	 * \param s The string to trim trailing whitespace from.
+	 * \param s The string to process.
 	 * \return A copy of the given string, after processing.
 	 */
-	QString trimWhitespace(const QString &s) const;
+	QString formatLines(const QString &s) const;
 };
 }
 
@@ -19,14 +19,22 @@
 #include "Encoding.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <utility>
 #include <vector>
 
 #include "core/file/MMIOFile.hpp"
+#include "core/string/Utf8Validation.hpp"
 
 namespace
 {
+/*!
+ * When only a provisional encoding is requested, this is how many bytes
+ * at the start of the file are checked for valid UTF-8.
+ */
+constexpr std::size_t PROVISIONAL_SAMPLE_SIZE = 1024 * 1024;
+
 /**
  * \brief A list of valid unicode BOM's, and their associated encodings.
  *
@@ -58,106 +66,31 @@ bool bomPresent(const std::vector<uint8_t> &bytes,
 	                  file.data());
 }
 
-/**
- * Tests whether or not the contents of a suspected UTF-8 codepoint are
- * valid. It is assumed that the caller has already verified the first byte
- * of the codepoint, which indicates the number of other bytes.
- *
- * If the codepoint is valid, then the given codepoint pointer will be moved
- * to the first byte after the codepoint being examined.
- *
- * \param codepoint A pointer to the first 0x10xxxxxx byte in the codepoint.
- * \param length The length of the codepoint, excluding the first byte.
- * \param end The last byte in the overall data stream being examined.
- * \return Whether or not the given codepoint is a valid codepoint.
- */
-bool isValidUTF8CodePoint(const uint8_t *&codepoint, std::size_t length,
-                          const uint8_t *end)
-{
-	if(length == 0)
-		return false;
-	const uint8_t *codepointEnd = codepoint + length;
-	if(codepointEnd > end)
-		return false;
-
-	// Skip the first byte in the codepoint; the caller should have
-	// already verified the first byte.
-	++codepoint;
-
-	for(const uint8_t *byte = codepoint; byte < codepointEnd; ++byte)
-	{
-		if((*byte & 0xC0) != 0x80)
-			return false;
-	}
-
-	codepoint = codepointEnd;
-	return true;
-}
-
 /**
  * Determine whether or not the contents of the given file are valid UTF-8
- * codepoints (which indicates that it is most likely a text file encoded
- * with UTF-8).
+ * (which indicates that it is most likely a text file encoded with UTF-8).
+ * This uses the same rules as our UTF-8 decoder, so any file accepted here
+ * can be displayed without decoding errors.
+ *
+ * If the file is to be sampled, only its first PROVISIONAL_SAMPLE_SIZE
+ * bytes (stopping before any character split by that boundary) are
+ * checked. Otherwise the whole file is checked, in parallel.
  *
  * \param file The file whose contents will be examined.
- * \return Whether or not the given file contains only valid UTF-8 codepoints.
+ * \param sample Whether to examine only the start of the file.
+ * \return Whether or not the given file contains only valid UTF-8.
  */
-bool isValidUTF8(const qompose::core::file::MMIOFile &file)
+bool isValidUTF8(const qompose::core::file::MMIOFile &file, bool sample)
 {
-	// UTF-8 code points can be up to six bytes long. They follow one of
-	// the following formats:
-	//
-	// 0x0xxxxxxx
-	// 0x110xxxxx 0x10xxxxxx
-	// 0x1110xxxx 0x10xxxxxx 0x10xxxxxx
-	// 0x11110xxx 0x10xxxxxx 0x10xxxxxx 0x10xxxxxx
-	// 0x111110xx 0x10xxxxxx 0x10xxxxxx 0x10xxxxxx 0x10xxxxxx
-	// 0x1111110x 0x10xxxxxx 0x10xxxxxx 0x10xxxxxx 0x10xxxxxx 0x10xxxxxx
-	//
-	// If we encounter any sequence of bytes which do not follow this
-	// pattern, then we know that the given file contains non-UTF8 data.
-
-	const uint8_t *byte = file.data();
-	const uint8_t *end = file.data() + file.size();
-	while(byte < end)
-	{
-		if((*byte & 0x80) == 0x00) // 0x0xxxxxxx (1 byte)
-		{
-			++byte;
-		}
-		else if((*byte & 0xE0) == 0xC0) // 0x110xxxxx (2 bytes)
-		{
-			if(!isValidUTF8CodePoint(byte, 2, end))
-				return false;
-		}
-		else if((*byte & 0xF0) == 0xE0) // 0x1110xxxx (3 bytes)
-		{
-			if(!isValidUTF8CodePoint(byte, 3, end))
-				return false;
-		}
-		else if((*byte & 0xF8) == 0xF0) // 0x11110xxx (4 bytes)
-		{
-			if(!isValidUTF8CodePoint(byte, 4, end))
-				return false;
-		}
-		else if((*byte & 0xFC) == 0xF8) // 0x111110xx (5 bytes)
-		{
-			if(!isValidUTF8CodePoint(byte, 5, end))
-				return false;
-		}
-		else if((*byte & 0xFE) == 0xFC) // 0x1111110x (6 bytes)
-		{
-			if(!isValidUTF8CodePoint(byte, 6, end))
-				return false;
-		}
-		else
-		{
-			// Invalid first byte of sequence point.
-			return false;
-		}
-	}
-
-	return true;
+	uint8_t const *begin = file.data();
+	uint8_t const *end = begin + file.size();
+	if(!sample || file.size() <= PROVISIONAL_SAMPLE_SIZE)
+		return qompose::core::string::isValidUtf8Parallel(begin, end);
+
+	end = begin + PROVISIONAL_SAMPLE_SIZE;
+	while(end > begin && (*end & 0xC0U) == 0x80U)
+		--end;
+	return qompose::core::string::isValidUtf8(begin, end);
 }
 }
 
@@ -165,11 +98,13 @@ namespace qompose
 {
 namespace encoding_utils
 {
-QString detectTextCodec(const QString &f)
+QString detectTextCodec(const QString &f, bool provisional)
 {
 	try
 	{
-		core::file::MMIOFile file(f.toStdString());
+		core::file::MMIOFile file(
+		        f.toStdString(), core::file::MMIOFileMode::Shared,
+		        core::file::MMIOAccessPattern::Sequential);
 
 		// If the file is empty, just default to UTF-8.
 		if(file.size() == 0)
@@ -184,7 +119,7 @@ QString detectTextCodec(const QString &f)
 
 		// I guess there's no BOM; see if the bytes in this file are
 		// valid UTF-8. Otherwise, we will just return no encoding.
-		if(isValidUTF8(file))
+		if(isValidUTF8(file, provisional))
 			return QString("UTF-8");
 		else
 			return QString();
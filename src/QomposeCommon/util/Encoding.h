@@ -33,10 +33,18 @@ namespace encoding_utils
  * If the character encoding cannot be determined, or if some other error
  * occurs, then we will return a null QString instead.
  *
+ * Detecting UTF-8 requires validating the entire file. For very large files
+ * this can take a while, even though it is done in parallel, so a
+ * provisional answer can be requested instead, which is based only on the
+ * start of the file. In that case, UTF-8 may be returned for a file which
+ * turns out to be invalid later on, so it is up to the caller to confirm
+ * it as the rest of the file is read.
+ *
  * \param f The path to the file whose encoding will be detected.
+ * \param provisional Whether to sample only the start of large files.
  * \return The encoding the given file seems to be using.
  */
-QString detectTextCodec(const QString &f);
+QString detectTextCodec(const QString &f, bool provisional = false);
 }
 }
 
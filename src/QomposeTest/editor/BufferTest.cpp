@@ -0,0 +1,81 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <QString>
+
+#include <bdrck/fs/TemporaryStorage.hpp>
+
+#include "core/config/Configuration.hpp"
+
+#include "QomposeCommon/Types.h"
+#include "QomposeCommon/editor/Buffer.h"
+
+namespace
+{
+void writeFile(std::string const &path, std::string const &contents)
+{
+	std::ofstream out(path, std::ios_base::out | std::ios_base::binary |
+	                                std::ios_base::trunc);
+	REQUIRE(out.is_open());
+	out << contents;
+}
+
+std::string readFile(std::string const &path)
+{
+	std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+	REQUIRE(in.is_open());
+	return std::string(std::istreambuf_iterator<char>(in),
+	                   std::istreambuf_iterator<char>());
+}
+}
+
+TEST_CASE("Test saving a large file while it is being loaded", "[Buffer]")
+{
+	bdrck::fs::TemporaryStorage directory(
+	        bdrck::fs::TemporaryStorageType::DIRECTORY);
+	qompose::core::config::ConfigurationInstance config(
+	        directory.getPath() + "/qompose.conf");
+
+	// Make the file large enough to be opened in large file mode, and
+	// much larger than the preview shown while it is being loaded.
+	std::string contents;
+	for(std::size_t i = 0; contents.size() < 40 * 1024 * 1024; ++i)
+		contents.append("Line number " + std::to_string(i) + ".\n");
+
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+	writeFile(file.getPath(), contents);
+
+	{
+		qompose::editor::Buffer buffer(nullptr);
+		REQUIRE(buffer.open(qompose::FileDescriptor(
+		        QString::fromStdString(file.getPath()), "UTF-8")));
+		REQUIRE(buffer.isLargeFile());
+
+		// Destroying the buffer waits for the save to finish.
+		buffer.save();
+		CHECK(!buffer.isModified());
+	}
+	CHECK(contents == readFile(file.getPath()));
+}
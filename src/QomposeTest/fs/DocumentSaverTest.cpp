@@ -0,0 +1,204 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QIODevice>
+#include <QString>
+
+#include <bdrck/fs/TemporaryStorage.hpp>
+
+#include "core/document/PieceTable.hpp"
+#include "core/file/MMIOFile.hpp"
+#include "core/string/Utf8StringRef.hpp"
+
+#include "QomposeCommon/editor/LargeFileLoader.h"
+#include "QomposeCommon/fs/DocumentSaver.h"
+
+namespace
+{
+struct VectorResource
+{
+	std::vector<uint8_t> bytes;
+
+	uint8_t const *data() const
+	{
+		return bytes.data();
+	}
+
+	std::size_t size() const
+	{
+		return bytes.size();
+	}
+};
+
+void writeFile(std::string const &path, std::string const &contents)
+{
+	std::ofstream out(path, std::ios_base::out | std::ios_base::binary |
+	                                std::ios_base::trunc);
+	REQUIRE(out.is_open());
+	out << contents;
+}
+
+std::string readFile(std::string const &path)
+{
+	std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+	REQUIRE(in.is_open());
+	return std::string(std::istreambuf_iterator<char>(in),
+	                   std::istreambuf_iterator<char>());
+}
+}
+
+TEST_CASE("Test atomic saves replace the original file", "[DocumentSaver]")
+{
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+	writeFile(file.getPath(), "original");
+	QString path = QString::fromStdString(file.getPath());
+
+	CHECK(qompose::saveAtomically(path, [](QIODevice &device) {
+		return device.write("replaced", 8) == 8;
+	}));
+	CHECK("replaced" == readFile(file.getPath()));
+}
+
+TEST_CASE("Test failed atomic saves leave the original file intact",
+          "[DocumentSaver]")
+{
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+	writeFile(file.getPath(), "original");
+	QString path = QString::fromStdString(file.getPath());
+
+	CHECK(!qompose::saveAtomically(path, [](QIODevice &device) {
+		device.write("partial", 7);
+		return false;
+	}));
+	CHECK("original" == readFile(file.getPath()));
+}
+
+TEST_CASE("Test saving a piece table snapshot", "[DocumentSaver]")
+{
+	std::string const CONTENTS("foo  \nbar\t\r\nbaz ");
+
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+	QString path = QString::fromStdString(file.getPath());
+	qompose::core::document::PieceTable pieces(
+	        VectorResource{{CONTENTS.begin(), CONTENTS.end()}});
+
+	qompose::DocumentSaver untrimmed(path, pieces, "UTF-8", false);
+	untrimmed.save();
+	CHECK(CONTENTS == readFile(file.getPath()));
+
+	qompose::DocumentSaver trimmed(path, pieces, "UTF-8", true);
+	trimmed.save();
+	CHECK("foo\nbar\r\nbaz" == readFile(file.getPath()));
+}
+
+TEST_CASE("Test saving a mapped snapshot incrementally", "[DocumentSaver]")
+{
+	std::string contents;
+	for(std::size_t i = 0; i < 1024 * 1024; ++i)
+		contents.push_back(
+		        i % 64 == 63 ? '\n' : static_cast<char>('a' + i % 26));
+
+	bdrck::fs::TemporaryStorage source(
+	        bdrck::fs::TemporaryStorageType::FILE);
+	bdrck::fs::TemporaryStorage destination(
+	        bdrck::fs::TemporaryStorageType::FILE);
+	writeFile(source.getPath(), contents);
+
+	auto mapped = std::make_shared<qompose::core::file::MMIOFile>(
+	        source.getPath(), qompose::core::file::MMIOFileMode::Shared);
+	qompose::core::document::PieceTable pieces(
+	        qompose::editor::MappedFileRegion{mapped, mapped->size()});
+	pieces.insert(pieces.lineToCursor(1),
+	              qompose::core::string::Utf8StringRef("header\n"));
+	pieces.insert(pieces.lineToCursor(pieces.lineCount() - 1),
+	              qompose::core::string::Utf8StringRef("footer\n"));
+
+	std::string expected;
+	pieces.forEachSpan([&](uint8_t const *begin, uint8_t const *end) {
+		expected.append(begin, end);
+		return true;
+	});
+
+	// Only the inserted text is written from memory; the rest of the
+	// file is copied from the original.
+	qompose::DocumentSaver saver(
+	        QString::fromStdString(destination.getPath()), pieces,
+	        "UTF-8", false, mapped);
+	saver.save();
+	CHECK(expected == readFile(destination.getPath()));
+
+	// Saving over the original works too, since the snapshot refers to
+	// the file which was mapped, not whatever is at its path now.
+	qompose::DocumentSaver inPlace(
+	        QString::fromStdString(source.getPath()), pieces, "UTF-8",
+	        false, mapped);
+	inPlace.save();
+	CHECK(expected == readFile(source.getPath()));
+}
+
+TEST_CASE("Test trimming a mapped snapshot incrementally", "[DocumentSaver]")
+{
+	std::vector<std::string> lines;
+	for(std::size_t i = 0; i < 64 * 1024; ++i)
+		lines.push_back("line " + std::to_string(i) + " \t\n");
+	std::string contents;
+	for(auto const &line : lines)
+		contents += line;
+
+	bdrck::fs::TemporaryStorage source(
+	        bdrck::fs::TemporaryStorageType::FILE);
+	bdrck::fs::TemporaryStorage destination(
+	        bdrck::fs::TemporaryStorageType::FILE);
+	writeFile(source.getPath(), contents);
+
+	auto mapped = std::make_shared<qompose::core::file::MMIOFile>(
+	        source.getPath(), qompose::core::file::MMIOFileMode::Shared);
+	qompose::core::document::PieceTable pieces(
+	        qompose::editor::MappedFileRegion{mapped, mapped->size()});
+	pieces.insert(pieces.lineToCursor(1),
+	              qompose::core::string::Utf8StringRef("header  \n"));
+	pieces.insert(pieces.lineToCursor(1001),
+	              qompose::core::string::Utf8StringRef("edited "));
+
+	// Only the added and edited lines are trimmed; the rest of the file
+	// is copied as it was.
+	std::string expected = lines[0] + "header\n";
+	for(std::size_t i = 1; i < lines.size(); ++i)
+	{
+		if(i == 1000)
+			expected += "edited line 1000\n";
+		else
+			expected += lines[i];
+	}
+
+	qompose::DocumentSaver saver(
+	        QString::fromStdString(destination.getPath()), pieces,
+	        "UTF-8", true, mapped);
+	saver.save();
+	CHECK(expected == readFile(destination.getPath()));
+}
@@ -18,6 +18,9 @@
 
 #include <catch/catch.hpp>
 
+#include <fstream>
+#include <string>
+
 #include <bdrck/fs/TemporaryStorage.hpp>
 
 #include "QomposeCommon/util/Encoding.h"
@@ -29,3 +32,24 @@ TEST_CASE("Test empty files default to UTF-8 encoding", "[Encoding]")
 	        QString::fromStdString(file.getPath()));
 	CHECK("UTF-8" == encoding);
 }
+
+TEST_CASE("Test provisional encoding detection only samples large files",
+          "[Encoding]")
+{
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+
+	{
+		// Valid UTF-8, except for a single stray byte well past the
+		// start of the file.
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		out << std::string(4 * 1024 * 1024, 'a') << '\x80';
+	}
+
+	QString path = QString::fromStdString(file.getPath());
+	CHECK("UTF-8" ==
+	      qompose::encoding_utils::detectTextCodec(path, true));
+	CHECK(qompose::encoding_utils::detectTextCodec(path).isNull());
+}
@@ -0,0 +1,186 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <numeric>
+
+namespace
+{
+volatile uint64_t sink = 0;
+
+std::string identifierOf(std::string const &name, std::string const &corpus)
+{
+	return name + "/" + corpus;
+}
+
+/*!
+ * Escape the given string for use inside a JSON string literal.
+ */
+std::string escapeJson(std::string const &s)
+{
+	std::string escaped;
+	for(char c : s)
+	{
+		if(c == '"' || c == '\\')
+		{
+			escaped.push_back('\\');
+			escaped.push_back(c);
+		}
+		else if(static_cast<unsigned char>(c) < 0x20U)
+		{
+			char buffer[8];
+			std::snprintf(buffer, sizeof(buffer), "\\u%04x",
+			              static_cast<unsigned int>(c));
+			escaped.append(buffer);
+		}
+		else
+		{
+			escaped.push_back(c);
+		}
+	}
+	return escaped;
+}
+
+/*!
+ * \return The throughput implied by the given time, in MiB per second.
+ */
+double throughputOf(std::size_t bytes, double nanoseconds)
+{
+	if(nanoseconds <= 0.0)
+		return 0.0;
+	return static_cast<double>(bytes) / (1024.0 * 1024.0) /
+	       (nanoseconds / 1e9);
+}
+}
+
+namespace qompose
+{
+namespace bench
+{
+void consume(uint64_t value)
+{
+	sink = sink ^ value;
+}
+
+BenchmarkSuite::BenchmarkSuite() : benchmarks()
+{
+}
+
+void BenchmarkSuite::add(std::string const &name, std::string const &corpus,
+                         std::size_t bytes, Body const &body)
+{
+	benchmarks.push_back({name, corpus, bytes, body});
+}
+
+std::vector<std::string> BenchmarkSuite::list() const
+{
+	std::vector<std::string> identifiers;
+	for(auto const &benchmark : benchmarks)
+	{
+		identifiers.push_back(
+		        identifierOf(benchmark.name, benchmark.corpus));
+	}
+	return identifiers;
+}
+
+std::vector<BenchmarkResult>
+BenchmarkSuite::run(std::string const &filter, std::size_t iterations) const
+{
+	typedef std::chrono::steady_clock Clock;
+
+	iterations = std::max<std::size_t>(1, iterations);
+	std::vector<BenchmarkResult> results;
+	for(auto const &benchmark : benchmarks)
+	{
+		if(identifierOf(benchmark.name, benchmark.corpus)
+		           .find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		benchmark.body();
+
+		std::vector<double> samples;
+		for(std::size_t i = 0; i < iterations; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			benchmark.body();
+			Clock::time_point end = Clock::now();
+			samples.push_back(
+			        std::chrono::duration<double, std::nano>(
+			                end - start)
+			                .count());
+		}
+
+		std::sort(samples.begin(), samples.end());
+		double mean =
+		        std::accumulate(samples.begin(), samples.end(), 0.0) /
+		        static_cast<double>(samples.size());
+		results.push_back({benchmark.name, benchmark.corpus,
+		                   benchmark.bytes, iterations, samples.front(),
+		                   samples[samples.size() / 2], mean});
+	}
+	return results;
+}
+
+void writeJson(std::ostream &out, std::vector<BenchmarkResult> const &results)
+{
+	std::ios_base::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1);
+	out << "{\n\t\"benchmarks\": [";
+	for(std::size_t i = 0; i < results.size(); ++i)
+	{
+		BenchmarkResult const &r = results[i];
+		out << (i == 0 ? "\n" : ",\n") << "\t\t{"
+		    << "\"name\": \"" << escapeJson(r.name) << "\", "
+		    << "\"corpus\": \"" << escapeJson(r.corpus) << "\", "
+		    << "\"bytes\": " << r.bytes << ", "
+		    << "\"iterations\": " << r.iterations << ", "
+		    << "\"min_ns\": " << r.minimumNanoseconds << ", "
+		    << "\"median_ns\": " << r.medianNanoseconds << ", "
+		    << "\"mean_ns\": " << r.meanNanoseconds << ", "
+		    << "\"median_mib_per_s\": "
+		    << throughputOf(r.bytes, r.medianNanoseconds) << "}";
+	}
+	out << "\n\t]\n}\n";
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void writeTable(std::ostream &out,
+                std::vector<BenchmarkResult> const &results)
+{
+	for(auto const &r : results)
+	{
+		char line[256];
+		std::snprintf(line, sizeof(line),
+		              "%-40s %-8s %12.0f ns %10.1f MiB/s\n",
+		              r.name.c_str(), r.corpus.c_str(),
+		              r.medianNanoseconds,
+		              throughputOf(r.bytes, r.medianNanoseconds));
+		out << line;
+	}
+}
+}
+}
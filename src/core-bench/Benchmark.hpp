@@ -0,0 +1,133 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_bench_Benchmark_HPP
+#define qompose_core_bench_Benchmark_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace qompose
+{
+namespace bench
+{
+/*!
+ * Make sure the compiler can't optimize away the computation of the given
+ * value, by folding it into a volatile sink.
+ *
+ * \param value A result computed by a benchmark.
+ */
+void consume(uint64_t value);
+
+struct BenchmarkResult
+{
+	std::string name;
+	std::string corpus;
+	// The number of bytes each iteration processes.
+	std::size_t bytes;
+	std::size_t iterations;
+	double minimumNanoseconds;
+	double medianNanoseconds;
+	double meanNanoseconds;
+};
+
+/*!
+ * \brief A BenchmarkSuite is a list of named benchmarks.
+ *
+ * Each benchmark is a function which does one iteration of some work,
+ * together with the corpus it works on and its size in bytes. Any setup
+ * (e.g. generating the corpus) should be done when the benchmark is
+ * added, so it isn't included in the timings.
+ */
+class BenchmarkSuite
+{
+public:
+	typedef std::function<void()> Body;
+
+	BenchmarkSuite();
+
+	BenchmarkSuite(BenchmarkSuite const &) = delete;
+	BenchmarkSuite(BenchmarkSuite &&) = default;
+	BenchmarkSuite &operator=(BenchmarkSuite const &) = delete;
+	BenchmarkSuite &operator=(BenchmarkSuite &&) = default;
+
+	~BenchmarkSuite() = default;
+
+	/*!
+	 * \param name The name of the benchmark.
+	 * \param corpus The name of the corpus the benchmark works on.
+	 * \param bytes The number of bytes each iteration processes.
+	 * \param body The function which does one iteration.
+	 */
+	void add(std::string const &name, std::string const &corpus,
+	         std::size_t bytes, Body const &body);
+
+	/*!
+	 * \return The "name/corpus" identifiers of every benchmark.
+	 */
+	std::vector<std::string> list() const;
+
+	/*!
+	 * Run every benchmark whose "name/corpus" identifier contains the
+	 * given filter. Each one is run once to warm up, and then the
+	 * given number of times.
+	 *
+	 * \param filter A substring to select benchmarks by.
+	 * \param iterations The number of timed iterations for each one.
+	 * \return The results of each benchmark which was run.
+	 */
+	std::vector<BenchmarkResult> run(std::string const &filter,
+	                                 std::size_t iterations) const;
+
+private:
+	struct Benchmark
+	{
+		std::string name;
+		std::string corpus;
+		std::size_t bytes;
+		Body body;
+	};
+
+	std::vector<Benchmark> benchmarks;
+};
+
+/*!
+ * Write the given results as a JSON document, so they can be compared
+ * by other tools (e.g. to track regressions between versions).
+ *
+ * \param out The stream to write to.
+ * \param results The results to write.
+ */
+void writeJson(std::ostream &out, std::vector<BenchmarkResult> const &results);
+
+/*!
+ * Write the given results as a human readable table.
+ *
+ * \param out The stream to write to.
+ * \param results The results to write.
+ */
+void writeTable(std::ostream &out,
+                std::vector<BenchmarkResult> const &results);
+}
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Corpus.hpp"
+
+#include <random>
+
+namespace
+{
+constexpr std::size_t LINE_LENGTH = 80;
+
+void appendUtf8(std::vector<uint8_t> &out, uint32_t c)
+{
+	if(c < 0x80U)
+	{
+		out.push_back(static_cast<uint8_t>(c));
+	}
+	else if(c < 0x800U)
+	{
+		out.push_back(static_cast<uint8_t>(0xC0U | (c >> 6)));
+		out.push_back(static_cast<uint8_t>(0x80U | (c & 0x3FU)));
+	}
+	else if(c < 0x10000U)
+	{
+		out.push_back(static_cast<uint8_t>(0xE0U | (c >> 12)));
+		out.push_back(static_cast<uint8_t>(0x80U | ((c >> 6) & 0x3FU)));
+		out.push_back(static_cast<uint8_t>(0x80U | (c & 0x3FU)));
+	}
+	else
+	{
+		out.push_back(static_cast<uint8_t>(0xF0U | (c >> 18)));
+		out.push_back(
+		        static_cast<uint8_t>(0x80U | ((c >> 12) & 0x3FU)));
+		out.push_back(static_cast<uint8_t>(0x80U | ((c >> 6) & 0x3FU)));
+		out.push_back(static_cast<uint8_t>(0x80U | (c & 0x3FU)));
+	}
+}
+
+uint32_t randomIn(std::mt19937 &generator, uint32_t first, uint32_t last)
+{
+	return std::uniform_int_distribution<uint32_t>(first, last)(generator);
+}
+
+uint32_t randomCharacter(std::mt19937 &generator,
+                         qompose::bench::CorpusKind kind)
+{
+	using qompose::bench::CorpusKind;
+
+	if(kind == CorpusKind::Ascii)
+		return randomIn(generator, 0x20U, 0x7EU);
+	if(kind == CorpusKind::Cjk)
+		return randomIn(generator, 0x4E00U, 0x9FFFU);
+
+	// Mixed text is mostly ASCII, like e.g. commented source code.
+	uint32_t roll = randomIn(generator, 0, 99);
+	if(roll < 70)
+		return randomIn(generator, 0x20U, 0x7EU);
+	if(roll < 80)
+		return randomIn(generator, 0xA0U, 0x7FFU);
+	if(roll < 95)
+		return randomIn(generator, 0x4E00U, 0x9FFFU);
+	return randomIn(generator, 0x1F300U, 0x1F5FFU);
+}
+}
+
+namespace qompose
+{
+namespace bench
+{
+std::vector<CorpusKind> allCorpusKinds()
+{
+	return {CorpusKind::Ascii, CorpusKind::Cjk, CorpusKind::Mixed,
+	        CorpusKind::Invalid};
+}
+
+std::string corpusName(CorpusKind kind)
+{
+	switch(kind)
+	{
+	case CorpusKind::Ascii:
+		return "ascii";
+	case CorpusKind::Cjk:
+		return "cjk";
+	case CorpusKind::Mixed:
+		return "mixed";
+	case CorpusKind::Invalid:
+		return "invalid";
+	}
+	return "unknown";
+}
+
+std::vector<uint8_t> generateCorpus(CorpusKind kind, std::size_t bytes,
+                                    uint32_t seed)
+{
+	std::mt19937 generator(seed);
+	std::vector<uint8_t> corpus;
+	corpus.reserve(bytes + 4);
+
+	std::size_t column = 0;
+	while(corpus.size() < bytes)
+	{
+		if(column == LINE_LENGTH)
+		{
+			corpus.push_back('\n');
+			column = 0;
+			continue;
+		}
+		appendUtf8(corpus, randomCharacter(generator, kind));
+		++column;
+	}
+
+	if(kind == CorpusKind::Invalid && !corpus.empty())
+	{
+		// Overwrite a character near the end with a lone
+		// continuation byte, which is never valid.
+		std::size_t position = corpus.size() - corpus.size() / 64 - 1;
+		while(position > 0 && (corpus[position] & 0xC0U) == 0x80U)
+			--position;
+		corpus[position] = 0x80U;
+	}
+
+	return corpus;
+}
+}
+}
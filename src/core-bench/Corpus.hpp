@@ -0,0 +1,70 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_bench_Corpus_HPP
+#define qompose_core_bench_Corpus_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace qompose
+{
+namespace bench
+{
+enum class CorpusKind
+{
+	// Printable ASCII text, like most source code.
+	Ascii,
+	// CJK ideographs, which are three bytes each in UTF-8.
+	Cjk,
+	// A mix of one, two, three and four byte characters.
+	Mixed,
+	// Mixed text with a single invalid sequence near its end, so
+	// validation has to scan (almost) everything before failing.
+	Invalid
+};
+
+/*!
+ * \return Every kind of corpus, in a stable order.
+ */
+std::vector<CorpusKind> allCorpusKinds();
+
+/*!
+ * \return A short name for the given kind of corpus, for reports.
+ */
+std::string corpusName(CorpusKind kind);
+
+/*!
+ * Generate a synthetic UTF-8 corpus. The output only depends on the
+ * arguments, so results are comparable between runs and machines. A
+ * newline is inserted roughly every 80 characters, so the corpus has
+ * realistically sized lines.
+ *
+ * \param kind The kind of text to generate.
+ * \param bytes The approximate size of the corpus, in bytes.
+ * \param seed The seed for the pseudo-random generator.
+ * \return The generated bytes.
+ */
+std::vector<uint8_t> generateCorpus(CorpusKind kind, std::size_t bytes,
+                                    uint32_t seed = 0);
+}
+}
+
+#endif
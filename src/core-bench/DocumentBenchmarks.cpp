@@ -0,0 +1,186 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DocumentBenchmarks.hpp"
+
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <bdrck/fs/TemporaryStorage.hpp>
+
+#include "core/document/Cursor.hpp"
+#include "core/document/Document.hpp"
+#include "core/document/DocumentHistory.hpp"
+#include "core/document/PieceTable.hpp"
+#include "core/file/InMemoryFile.hpp"
+#include "core/file/MMIOFile.hpp"
+#include "core/string/Utf8StringRef.hpp"
+#include "core-bench/Corpus.hpp"
+
+namespace
+{
+// The number of edits each DocumentHistory benchmark iteration makes.
+constexpr std::size_t HISTORY_EDITS = 1000;
+// The text each of those edits inserts.
+constexpr uint8_t HISTORY_TEXT[] = {'e', 'd', 'i', 't'};
+
+typedef std::shared_ptr<bdrck::fs::TemporaryStorage const> SharedFile;
+
+SharedFile writeCorpus(std::vector<uint8_t> const &corpus)
+{
+	auto file = std::make_shared<bdrck::fs::TemporaryStorage const>(
+	        bdrck::fs::TemporaryStorageType::FILE);
+	std::ofstream out(file->getPath(), std::ios_base::out |
+	                                           std::ios_base::binary |
+	                                           std::ios_base::trunc);
+	out.write(reinterpret_cast<char const *>(corpus.data()),
+	          static_cast<std::streamsize>(corpus.size()));
+	return file;
+}
+
+/*!
+ * Open the given file as a TextResource. Files are mapped read-only, the
+ * way large files are when they are opened.
+ */
+template <typename File> File openFile(std::string const &path)
+{
+	return File(path);
+}
+
+template <>
+qompose::core::file::MMIOFile
+openFile<qompose::core::file::MMIOFile>(std::string const &path)
+{
+	return qompose::core::file::MMIOFile(
+	        path, qompose::core::file::MMIOFileMode::Shared,
+	        qompose::core::file::MMIOAccessPattern::Sequential);
+}
+
+/*!
+ * Add benchmarks for loading a PieceTable from the given corpus using
+ * the given kind of TextResource, and for iterating over its contents.
+ */
+template <typename File>
+void addPieceTableBenchmarks(qompose::bench::BenchmarkSuite &suite,
+                             std::string const &source,
+                             std::string const &name,
+                             std::vector<uint8_t> const &corpus)
+{
+	using qompose::core::document::Cursor;
+	using qompose::core::document::PieceTable;
+
+	SharedFile file = writeCorpus(corpus);
+	auto load = [file]() {
+		PieceTable table(openFile<File>(file->getPath()));
+		qompose::bench::consume(table.dataSize());
+	};
+
+	auto table = std::make_shared<PieceTable const>(
+	        openFile<File>(file->getPath()));
+	auto iterate = [table]() {
+		uint64_t sum = 0;
+		for(Cursor it = table->begin(); it != table->end(); ++it)
+			sum += *it;
+		qompose::bench::consume(sum);
+	};
+
+	auto spans = [table]() {
+		uint64_t sum = 0;
+		table->forEachSpan([&sum](uint8_t const *b, uint8_t const *e) {
+			for(; b != e; ++b)
+				sum += *b;
+			return true;
+		});
+		qompose::bench::consume(sum);
+	};
+
+	std::size_t bytes = corpus.size();
+	suite.add("PieceTable/load-" + source, name, bytes, load);
+	suite.add("Cursor/forward-" + source, name, bytes, iterate);
+	suite.add("PieceTable/forEachSpan-" + source, name, bytes, spans);
+}
+
+/*!
+ * Add a benchmark which pushes a series of small insertions at random
+ * positions onto a DocumentHistory, and then undoes all of them.
+ */
+void addHistoryBenchmark(qompose::bench::BenchmarkSuite &suite,
+                         std::string const &name,
+                         std::vector<uint8_t> const &corpus)
+{
+	using qompose::core::document::Document;
+	using qompose::core::document::DocumentHistory;
+	using qompose::core::document::EditKind;
+	using qompose::core::document::PieceTable;
+
+	SharedFile file = writeCorpus(corpus);
+	auto base = std::make_shared<PieceTable const>(
+	        qompose::core::file::InMemoryFile(file->getPath()));
+	auto history = [base]() {
+		qompose::core::string::Utf8StringRef text(
+		        HISTORY_TEXT, HISTORY_TEXT + sizeof(HISTORY_TEXT));
+
+		std::mt19937 generator(0);
+		std::uniform_int_distribution<std::size_t> offsets(
+		        0, base->length());
+		DocumentHistory history;
+		PieceTable table(*base);
+		push(history, Document(table));
+		for(std::size_t i = 0; i < HISTORY_EDITS; ++i)
+		{
+			auto cursor = table.insert(
+			        table.characterToCursor(offsets(generator)),
+			        text);
+			push(history, Document(table, cursor), EditKind::Other);
+		}
+		while(undoDepth(history) > 1)
+			undo(history);
+		qompose::bench::consume(present(history)->pieces.dataSize());
+	};
+
+	suite.add("DocumentHistory/push-undo", name,
+	          HISTORY_EDITS * sizeof(HISTORY_TEXT), history);
+}
+}
+
+namespace qompose
+{
+namespace bench
+{
+void addDocumentBenchmarks(BenchmarkSuite &suite, std::size_t bytes)
+{
+	for(CorpusKind kind : allCorpusKinds())
+	{
+		// PieceTables require valid UTF-8.
+		if(kind == CorpusKind::Invalid)
+			continue;
+
+		std::string name = corpusName(kind);
+		std::vector<uint8_t> corpus = generateCorpus(kind, bytes);
+		addPieceTableBenchmarks<qompose::core::file::MMIOFile>(
+		        suite, "mmio", name, corpus);
+		addPieceTableBenchmarks<qompose::core::file::InMemoryFile>(
+		        suite, "memory", name, corpus);
+		addHistoryBenchmark(suite, name, corpus);
+	}
+}
+}
+}
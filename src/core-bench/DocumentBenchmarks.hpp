@@ -0,0 +1,41 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_bench_DocumentBenchmarks_HPP
+#define qompose_core_bench_DocumentBenchmarks_HPP
+
+#include <cstddef>
+
+#include "core-bench/Benchmark.hpp"
+
+namespace qompose
+{
+namespace bench
+{
+/*!
+ * Add benchmarks for loading and iterating over PieceTables, and for
+ * DocumentHistory, to the given suite.
+ *
+ * \param suite The suite to add the benchmarks to.
+ * \param bytes The size of each generated corpus, in bytes.
+ */
+void addDocumentBenchmarks(BenchmarkSuite &suite, std::size_t bytes);
+}
+}
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StringBenchmarks.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "core/string/Utf8Iterator.hpp"
+#include "core/string/Utf8String.hpp"
+#include "core/string/Utf8StringRef.hpp"
+#include "core/string/Utf8Validation.hpp"
+#include "core-bench/Corpus.hpp"
+
+namespace
+{
+typedef std::shared_ptr<std::vector<uint8_t> const> SharedCorpus;
+
+/*!
+ * Split the given corpus into words, separated by spaces or newlines.
+ * The spaces in the CJK corpus are rare, so only mixed text gives a
+ * realistic distribution of word lengths.
+ */
+std::vector<qompose::core::string::Utf8StringRef>
+splitWords(std::vector<uint8_t> const &corpus)
+{
+	std::vector<qompose::core::string::Utf8StringRef> words;
+	uint8_t const *begin = corpus.data();
+	uint8_t const *end = corpus.data() + corpus.size();
+	uint8_t const *word = begin;
+	for(uint8_t const *it = begin; it != end; ++it)
+	{
+		if(*it != ' ' && *it != '\n')
+			continue;
+		if(word != it)
+			words.emplace_back(word, it);
+		word = it + 1;
+	}
+	if(word != end)
+		words.emplace_back(word, end);
+	return words;
+}
+
+void addIteratorBenchmarks(qompose::bench::BenchmarkSuite &suite,
+                           std::string const &name, SharedCorpus corpus)
+{
+	using qompose::core::string::Utf8Iterator;
+	using qompose::core::string::Utf8ReverseIterator;
+
+	suite.add("Utf8Iterator/forward", name, corpus->size(), [corpus]() {
+		uint8_t const *begin = corpus->data();
+		Utf8Iterator it(begin, begin + corpus->size());
+		uint64_t sum = 0;
+		for(; it != Utf8Iterator(); ++it)
+			sum += *it;
+		qompose::bench::consume(sum);
+	});
+
+	suite.add("Utf8Iterator/reverse", name, corpus->size(), [corpus]() {
+		uint8_t const *begin = corpus->data();
+		uint8_t const *end = corpus->data() + corpus->size();
+		Utf8ReverseIterator it(Utf8Iterator(begin, end, end));
+		Utf8ReverseIterator last(Utf8Iterator(begin, end));
+		uint64_t sum = 0;
+		for(; it != last; ++it)
+			sum += *it;
+		qompose::bench::consume(sum);
+	});
+
+	suite.add("Utf8String/length", name, corpus->size(), [corpus]() {
+		// Construct a new string each time, since the length is
+		// cached after it is first computed.
+		qompose::core::string::Utf8String string(
+		        corpus->data(), corpus->data() + corpus->size());
+		qompose::bench::consume(string.length());
+	});
+}
+
+void addWordBenchmarks(qompose::bench::BenchmarkSuite &suite,
+                       std::string const &name, SharedCorpus corpus)
+{
+	using qompose::core::string::Utf8String;
+	using qompose::core::string::Utf8StringRef;
+
+	auto words = std::make_shared<std::vector<Utf8StringRef> const>(
+	        splitWords(*corpus));
+	auto strings = std::make_shared<std::vector<Utf8String>>();
+	for(auto const &word : *words)
+		strings->emplace_back(word);
+
+	auto construct = [corpus, words]() {
+		std::vector<Utf8String> result;
+		result.reserve(words->size());
+		for(auto const &word : *words)
+			result.emplace_back(word);
+		qompose::bench::consume(result.size());
+	};
+
+	auto copy = [strings]() {
+		std::vector<Utf8String> result(*strings);
+		qompose::bench::consume(result.size());
+	};
+
+	auto intern = [corpus, words]() {
+		std::vector<Utf8String> result;
+		result.reserve(words->size());
+		for(auto const &word : *words)
+			result.push_back(Utf8String::intern(word));
+		qompose::bench::consume(result.size());
+	};
+
+	suite.add("Utf8String/construct-words", name, corpus->size(),
+	          construct);
+	suite.add("Utf8String/copy-words", name, corpus->size(), copy);
+	suite.add("Utf8String/intern-words", name, corpus->size(), intern);
+}
+}
+
+namespace qompose
+{
+namespace bench
+{
+void addStringBenchmarks(BenchmarkSuite &suite, std::size_t bytes)
+{
+	for(CorpusKind kind : allCorpusKinds())
+	{
+		std::string name = corpusName(kind);
+		auto corpus = std::make_shared<std::vector<uint8_t> const>(
+		        generateCorpus(kind, bytes));
+
+		std::size_t size = corpus->size();
+		suite.add("isValidUtf8", name, size, [corpus]() {
+			uint8_t const *begin = corpus->data();
+			consume(core::string::isValidUtf8(
+			        begin, begin + corpus->size()));
+		});
+		suite.add("isValidUtf8Parallel", name, size, [corpus]() {
+			uint8_t const *begin = corpus->data();
+			consume(core::string::isValidUtf8Parallel(
+			        begin, begin + corpus->size()));
+		});
+
+		// The remaining benchmarks throw on invalid UTF-8.
+		if(kind == CorpusKind::Invalid)
+			continue;
+
+		addIteratorBenchmarks(suite, name, corpus);
+		if(kind == CorpusKind::Mixed)
+			addWordBenchmarks(suite, name, corpus);
+	}
+}
+}
+}
@@ -0,0 +1,159 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core-bench/Benchmark.hpp"
+#include "core-bench/DocumentBenchmarks.hpp"
+#include "core-bench/StringBenchmarks.hpp"
+
+namespace
+{
+constexpr std::size_t DEFAULT_CORPUS_SIZE = 1024 * 1024;
+constexpr std::size_t DEFAULT_ITERATIONS = 10;
+
+struct Options
+{
+	std::string filter;
+	std::size_t iterations;
+	std::size_t bytes;
+	std::string output;
+	bool list;
+};
+
+void printUsage(char const *program)
+{
+	std::cerr << "Usage: " << program << " [options]\n"
+	          << "  --filter STRING    Only run benchmarks whose "
+	             "name/corpus contains STRING.\n"
+	          << "  --iterations N     The number of timed iterations "
+	             "per benchmark (default "
+	          << DEFAULT_ITERATIONS << ").\n"
+	          << "  --size BYTES       The size of each generated corpus "
+	             "(default "
+	          << DEFAULT_CORPUS_SIZE << ").\n"
+	          << "  --json FILE        Also write the results as JSON to "
+	             "FILE (\"-\" for stdout).\n"
+	          << "  --list             List the benchmarks, and exit.\n";
+}
+
+std::size_t parseSize(std::string const &value)
+{
+	std::size_t parsed = 0;
+	std::size_t size = std::stoull(value, &parsed);
+	if(parsed != value.size() || size == 0)
+		throw std::invalid_argument("Invalid number: " + value);
+	return size;
+}
+
+Options parseOptions(int argc, char **argv)
+{
+	Options options{"", DEFAULT_ITERATIONS, DEFAULT_CORPUS_SIZE, "",
+	                false};
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string argument(argv[i]);
+		if(argument == "--list")
+		{
+			options.list = true;
+			continue;
+		}
+
+		std::string error = "Invalid option: " + argument;
+		if(i + 1 >= argc)
+			throw std::invalid_argument(error);
+		std::string value(argv[++i]);
+		if(argument == "--filter")
+			options.filter = value;
+		else if(argument == "--iterations")
+			options.iterations = parseSize(value);
+		else if(argument == "--size")
+			options.bytes = parseSize(value);
+		else if(argument == "--json")
+			options.output = value;
+		else
+			throw std::invalid_argument(error);
+	}
+	return options;
+}
+}
+
+/*!
+ * This is the main function for our benchmarks. The corpora they work
+ * on are generated deterministically, so results from different runs
+ * (and different versions of the code) can be compared directly.
+ *
+ * \param argc The number of command-line arguments.
+ * \param argv The command-line arguments.
+ */
+int main(int argc, char **argv)
+{
+	Options options;
+	try
+	{
+		options = parseOptions(argc, argv);
+	}
+	catch(std::exception const &e)
+	{
+		std::cerr << e.what() << "\n";
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	qompose::bench::BenchmarkSuite suite;
+	qompose::bench::addStringBenchmarks(suite, options.bytes);
+	qompose::bench::addDocumentBenchmarks(suite, options.bytes);
+
+	if(options.list)
+	{
+		for(auto const &identifier : suite.list())
+			std::cout << identifier << "\n";
+		return EXIT_SUCCESS;
+	}
+
+	std::vector<qompose::bench::BenchmarkResult> results =
+	        suite.run(options.filter, options.iterations);
+
+	if(options.output == "-")
+	{
+		qompose::bench::writeJson(std::cout, results);
+		return EXIT_SUCCESS;
+	}
+
+	qompose::bench::writeTable(std::cout, results);
+	if(!options.output.empty())
+	{
+		std::ofstream out(options.output, std::ios_base::out |
+		                                          std::ios_base::trunc);
+		qompose::bench::writeJson(out, results);
+		if(!out)
+		{
+			std::cerr << "Failed to write: " << options.output
+			          << "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
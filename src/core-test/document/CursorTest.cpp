@@ -19,9 +19,12 @@
 #include <catch/catch.hpp>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iterator>
+#include <random>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -30,6 +33,7 @@
 #include "core/document/Cursor.hpp"
 #include "core/document/PieceTable.hpp"
 #include "core/file/InMemoryFile.hpp"
+#include "core/string/Utf8StringRef.hpp"
 
 TEST_CASE("Test PieceTable iteration with cursors", "[Cursor]")
 {
@@ -94,3 +98,66 @@ TEST_CASE("Test PieceTable iterator with reverse cursors", "[Cursor]")
 
 	CHECK(characters == expectedCharacters);
 }
+
+TEST_CASE("Test Cursor random access", "[Cursor]")
+{
+	constexpr char const *TEST_CONTENTS = "this is a test file.";
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+
+	{
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		out.write(TEST_CONTENTS, std::strlen(TEST_CONTENTS));
+	}
+
+	qompose::core::file::InMemoryFile inMemoryFile(file.getPath());
+	qompose::core::document::PieceTable pieceTable(std::move(inMemoryFile));
+
+	// Mix some multi-byte pieces in with the ASCII ones.
+	std::string const INSERTION = "\xCE\xBA\xE1\xBD\xB9";
+	auto insertionBegin =
+	        reinterpret_cast<uint8_t const *>(INSERTION.data());
+	qompose::core::string::Utf8StringRef insertion(
+	        insertionBegin, insertionBegin + INSERTION.size());
+	pieceTable.insert(pieceTable.characterToCursor(4), insertion);
+	pieceTable.insert(pieceTable.characterToCursor(12), insertion);
+	pieceTable.insert(pieceTable.end(), insertion);
+
+	using Character =
+	        qompose::core::document::PieceTable::iterator::value_type;
+	std::vector<Character> characters;
+	std::copy(pieceTable.begin(), pieceTable.end(),
+	          std::back_inserter(characters));
+	REQUIRE(characters.size() == pieceTable.length());
+
+	auto const begin = pieceTable.begin();
+	auto const end = pieceTable.end();
+	CHECK(end - begin ==
+	      static_cast<std::ptrdiff_t>(characters.size()));
+	CHECK(begin + static_cast<std::ptrdiff_t>(characters.size()) == end);
+	CHECK(std::distance(begin, end) ==
+	      static_cast<std::ptrdiff_t>(characters.size()));
+
+	std::mt19937 generator(5489U);
+	auto cursor = begin;
+	for(int i = 0; i < 1000; ++i)
+	{
+		auto offset = static_cast<std::ptrdiff_t>(generator() %
+		                                          characters.size());
+		cursor += offset - (cursor - begin);
+		REQUIRE(cursor - begin == offset);
+		CHECK(cursor == pieceTable.characterToCursor(
+		                        static_cast<std::size_t>(offset)));
+		CHECK(*cursor ==
+		      characters[static_cast<std::size_t>(offset)]);
+		CHECK(begin[offset] ==
+		      characters[static_cast<std::size_t>(offset)]);
+		CHECK(*(end - (static_cast<std::ptrdiff_t>(characters.size()) -
+		               offset)) ==
+		      characters[static_cast<std::size_t>(offset)]);
+		CHECK(begin <= cursor);
+		CHECK(cursor < end);
+	}
+}
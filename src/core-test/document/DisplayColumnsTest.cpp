@@ -0,0 +1,254 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/document/DisplayColumns.hpp"
+#include "core/document/PieceTable.hpp"
+#include "core/string/CharacterWidth.hpp"
+#include "core/string/Utf8StringRef.hpp"
+
+namespace
+{
+using qompose::core::document::Cursor;
+using qompose::core::document::DisplayColumns;
+using qompose::core::document::PieceTable;
+
+struct StringResource
+{
+	std::string contents;
+
+	uint8_t const *data() const
+	{
+		return reinterpret_cast<uint8_t const *>(contents.data());
+	}
+
+	std::size_t size() const
+	{
+		return contents.size();
+	}
+};
+
+/*!
+ * Compute the display column of every character in the table (and of
+ * the end of the table) the slow way, by iterating from the start of
+ * each line.
+ */
+std::vector<std::size_t> referenceColumns(PieceTable const &pieces,
+                                          std::size_t tabWidth)
+{
+	std::vector<std::size_t> columns;
+	std::size_t column = 0;
+	for(uint32_t character : pieces)
+	{
+		columns.push_back(column);
+		if(character == '\n')
+			column = 0;
+		else
+			column = qompose::core::string::advanceDisplayColumn(
+			        column, character, tabWidth);
+	}
+	columns.push_back(column);
+	return columns;
+}
+
+/*!
+ * Generate lines of random text containing tabs, wide characters and
+ * combining marks. Some lines are much longer than the checkpoint
+ * interval.
+ */
+std::string randomText(std::mt19937 &generator)
+{
+	static std::vector<std::string> const CHARACTERS{
+	        "a", "b", " ", "\t", "\xC3\xA9", "\xCC\x81", "\xE4\xB8\xAD",
+	        "\xF0\x9F\x98\x80", "\r"};
+	std::uniform_int_distribution<std::size_t> character(
+	        0, CHARACTERS.size() - 1);
+	std::uniform_int_distribution<std::size_t> length(0, 1500);
+
+	std::string text;
+	for(int line = 0; line < 12; ++line)
+	{
+		for(std::size_t n = length(generator); n > 0; --n)
+			text += CHARACTERS[character(generator)];
+		text += "\n";
+	}
+	return text;
+}
+}
+
+TEST_CASE("Test character display widths", "[DisplayColumns]")
+{
+	using qompose::core::string::characterWidth;
+	CHECK(characterWidth('a') == 1);
+	CHECK(characterWidth(0xE9U) == 1);
+	CHECK(characterWidth(0x0301U) == 0);
+	CHECK(characterWidth(0x200BU) == 0);
+	CHECK(characterWidth(0x4E2DU) == 2);
+	CHECK(characterWidth(0xAC00U) == 2);
+	CHECK(characterWidth(0xFF21U) == 2);
+	CHECK(characterWidth(0x1F600U) == 2);
+	CHECK(characterWidth(0x10FFFDU) == 1);
+
+	using qompose::core::string::advanceDisplayColumn;
+	CHECK(advanceDisplayColumn(0, '\t', 4) == 4);
+	CHECK(advanceDisplayColumn(3, '\t', 4) == 4);
+	CHECK(advanceDisplayColumn(4, '\t', 4) == 8);
+	CHECK(advanceDisplayColumn(5, '\t', 0) == 6);
+}
+
+TEST_CASE("Test display columns match a full scan", "[DisplayColumns]")
+{
+	std::mt19937 generator(1234);
+	for(std::size_t tabWidth : {1, 4, 8})
+	{
+		PieceTable pieces(StringResource{randomText(generator)});
+		std::vector<std::size_t> expected =
+		        referenceColumns(pieces, tabWidth);
+		DisplayColumns columns(tabWidth);
+
+		// Query randomly first, and then backwards, so most
+		// queries start from checkpoints recorded by earlier ones.
+		std::uniform_int_distribution<std::size_t> offset(
+		        0, pieces.length());
+		for(int i = 0; i < 500; ++i)
+		{
+			std::size_t o = offset(generator);
+			CHECK(columns.columnOf(pieces,
+			                       pieces.characterToCursor(o)) ==
+			      expected[o]);
+		}
+		for(std::size_t o = pieces.length() + 1; o > 0; --o)
+		{
+			Cursor cursor = pieces.characterToCursor(o - 1);
+			CHECK(columns.columnOf(pieces, cursor) ==
+			      expected[o - 1]);
+		}
+	}
+}
+
+TEST_CASE("Test display columns survive random edits", "[DisplayColumns]")
+{
+	static std::vector<std::string> const INSERTIONS{
+	        "x", "\t", "\xE4\xB8\xAD", "\xCC\x81", "\n", "ab\ncd"};
+	std::mt19937 generator(4321);
+	PieceTable pieces(StringResource{randomText(generator)});
+	DisplayColumns columns(4);
+
+	for(int edit = 0; edit < 100; ++edit)
+	{
+		// Scan every line, so there are checkpoints both before and
+		// after the next edit.
+		for(std::size_t line = 0; line < pieces.lineCount(); ++line)
+			columns.lineWidth(pieces, line);
+
+		PieceTable edited(pieces);
+		std::size_t offset = generator() % (edited.length() + 1);
+		if(generator() % 2 == 0 && offset < edited.length())
+		{
+			std::size_t length = 1 + generator() % 300;
+			length = std::min(length, edited.length() - offset);
+			edited.erase(edited.characterToCursor(offset),
+			             edited.characterToCursor(offset + length));
+		}
+		else
+		{
+			std::string const &text =
+			        INSERTIONS[generator() % INSERTIONS.size()];
+			edited.insert(edited.characterToCursor(offset),
+			              qompose::core::string::Utf8StringRef(
+			                      text.c_str()));
+		}
+		pieces = edited;
+
+		std::vector<std::size_t> expected = referenceColumns(pieces, 4);
+		for(int i = 0; i < 200; ++i)
+		{
+			std::size_t o = generator() % (pieces.length() + 1);
+			CHECK(columns.columnOf(pieces,
+			                       pieces.characterToCursor(o)) ==
+			      expected[o]);
+		}
+	}
+}
+
+TEST_CASE("Test finding cursors by display column", "[DisplayColumns]")
+{
+	std::mt19937 generator(5678);
+	PieceTable pieces(StringResource{randomText(generator)});
+	DisplayColumns columns(4);
+
+	for(std::size_t line = 0; line < pieces.lineCount(); ++line)
+	{
+		std::size_t width = columns.lineWidth(pieces, line);
+		for(std::size_t column = 0; column <= width + 2; column += 7)
+		{
+			Cursor cursor = columns.cursorAt(pieces, line, column);
+			bool onLine = pieces.cursorToLine(cursor) == line ||
+			              cursor == pieces.end();
+			CHECK(onLine);
+			std::size_t found = columns.columnOf(pieces, cursor);
+			CHECK(found <= column);
+
+			// The next character must extend past the column,
+			// unless the line ends here.
+			if(cursor != pieces.end() && *cursor != '\n' &&
+			   *cursor != '\r')
+			{
+				using qompose::core::string::
+				        advanceDisplayColumn;
+				CHECK(advanceDisplayColumn(found, *cursor, 4) >
+				      column);
+			}
+		}
+	}
+}
+
+TEST_CASE("Test display columns follow edits", "[DisplayColumns]")
+{
+	PieceTable pieces(StringResource{"\tabc\n\xE4\xB8\xAD"
+	                                 "def\n"});
+	DisplayColumns columns(8);
+	CHECK(columns.columnOf(pieces, pieces.characterToCursor(2)) == 9);
+	CHECK(columns.columnOf(pieces, pieces.characterToCursor(6)) == 2);
+	CHECK(columns.lineWidth(pieces, 0) == 11);
+
+	PieceTable edited(pieces);
+	edited.insert(edited.begin(), qompose::core::string::Utf8StringRef(
+	                                      "xy"));
+	CHECK(columns.columnOf(edited, edited.characterToCursor(4)) == 9);
+	CHECK(columns.lineWidth(edited, 0) == 11);
+	CHECK(columns.columnOf(pieces, pieces.characterToCursor(2)) == 9);
+
+	columns.setTabWidth(2);
+	CHECK(columns.columnOf(pieces, pieces.characterToCursor(2)) == 3);
+	CHECK(columns.cursorAt(pieces, 1, 1) ==
+	      pieces.characterToCursor(5));
+	CHECK(columns.cursorAt(pieces, 1, 2) ==
+	      pieces.characterToCursor(6));
+	CHECK(columns.cursorAt(pieces, 1, 100) ==
+	      pieces.characterToCursor(9));
+	CHECK(columns.cursorAt(pieces, 5, 0) == pieces.end());
+}
@@ -0,0 +1,207 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/document/Cursor.hpp"
+#include "core/document/Document.hpp"
+#include "core/document/DocumentHistory.hpp"
+#include "core/document/PieceTable.hpp"
+#include "core/string/Utf8StringRef.hpp"
+
+namespace
+{
+struct StringResource
+{
+	std::string bytes;
+
+	uint8_t const *data() const
+	{
+		return reinterpret_cast<uint8_t const *>(bytes.data());
+	}
+
+	std::size_t size() const
+	{
+		return bytes.size();
+	}
+};
+
+std::string
+contentsOf(qompose::core::document::PieceTable const &table)
+{
+	std::string contents;
+	for(auto it = table.begin(); it != table.end(); ++it)
+		contents.push_back(static_cast<char>(*it));
+	return contents;
+}
+
+qompose::core::string::Utf8StringRef toRef(std::string const &text)
+{
+	auto begin = reinterpret_cast<uint8_t const *>(text.data());
+	return qompose::core::string::Utf8StringRef(begin,
+	                                            begin + text.size());
+}
+
+qompose::core::document::Document
+type(qompose::core::document::Document const &document,
+     std::string const &text)
+{
+	qompose::core::document::PieceTable table(document.pieces);
+	auto cursor = table.insert(
+	        table.characterToCursor(
+	                document.cursor.getCharacterOffset()),
+	        toRef(text));
+	std::size_t offset = cursor.getCharacterOffset() + text.size();
+	return qompose::core::document::Document(
+	        table, table.characterToCursor(offset));
+}
+}
+
+TEST_CASE("Test consecutive typing is coalesced", "[DocumentHistory]")
+{
+	using namespace qompose::core::document;
+
+	PieceTable initial(StringResource{"Hello!"});
+	DocumentHistory history;
+	push(history, Document(initial, initial.characterToCursor(5)));
+
+	for(char c : std::string(", world"))
+	{
+		push(history, type(*present(history), std::string(1, c)),
+		     EditKind::Insertion);
+	}
+	CHECK(undoDepth(history) == 2);
+	CHECK(contentsOf(present(history)->pieces) == "Hello, world!");
+
+	// Typing somewhere else starts a new entry.
+	Document moved = *present(history);
+	moved.cursor = moved.pieces.begin();
+	push(history, type(moved, ">"), EditKind::Insertion);
+	push(history, type(*present(history), " "), EditKind::Insertion);
+	CHECK(undoDepth(history) == 3);
+	CHECK(contentsOf(present(history)->pieces) == "> Hello, world!");
+
+	undo(history);
+	CHECK(contentsOf(present(history)->pieces) == "Hello, world!");
+	undo(history);
+	CHECK(contentsOf(present(history)->pieces) == "Hello!");
+
+	// Undo ends the current run, so typing after it must not be merged
+	// into the entry it returned to.
+	push(history, type(*present(history), "?"), EditKind::Insertion);
+	CHECK(undoDepth(history) == 2);
+	undo(history);
+	CHECK(contentsOf(present(history)->pieces) == "Hello!");
+}
+
+TEST_CASE("Test history spills to disk and reloads", "[DocumentHistory]")
+{
+	using namespace qompose::core::document;
+
+	std::mt19937 generator(5489U);
+	PieceTable initial(StringResource{std::string(1000, 'x')});
+
+	// With a tiny budget, every entry except the present one is spilled.
+	DocumentHistory history(1);
+	push(history, Document(initial));
+
+	std::vector<std::string> expected{contentsOf(initial)};
+	std::vector<std::size_t> cursors{0};
+	for(int i = 0; i < 200; ++i)
+	{
+		Document document = *present(history);
+		PieceTable table(document.pieces);
+		std::size_t offset = generator() % (table.length() + 1);
+		if(generator() % 3 == 0 && offset < table.length())
+		{
+			std::size_t length = std::min<std::size_t>(
+			        generator() % 20, table.length() - offset);
+			table.erase(table.characterToCursor(offset),
+			            table.characterToCursor(offset + length));
+		}
+		else
+		{
+			table.insert(table.characterToCursor(offset),
+			             toRef(std::to_string(i)));
+		}
+
+		push(history, Document(table, table.characterToCursor(offset)));
+		expected.push_back(contentsOf(table));
+		cursors.push_back(offset);
+		CHECK(history.past.size() == 1);
+	}
+	CHECK(undoDepth(history) == expected.size());
+
+	for(std::size_t i = expected.size(); i > 0; --i)
+	{
+		REQUIRE(!!present(history));
+		CHECK(contentsOf(present(history)->pieces) == expected[i - 1]);
+		CHECK(present(history)->cursor.getCharacterOffset() ==
+		      cursors[i - 1]);
+		undo(history);
+	}
+	CHECK(!present(history));
+
+	for(std::size_t i = 0; i < expected.size(); ++i)
+	{
+		redo(history);
+		REQUIRE(!!present(history));
+		CHECK(contentsOf(present(history)->pieces) == expected[i]);
+	}
+}
+
+TEST_CASE("Test coalescing into an entry a spilled entry depends on",
+          "[DocumentHistory]")
+{
+	using namespace qompose::core::document;
+
+	PieceTable initial(StringResource{"abcdef"});
+	DocumentHistory history(1);
+	push(history, Document(initial, initial.characterToCursor(3)));
+	push(history, type(*present(history), "x"), EditKind::Insertion);
+	CHECK(contentsOf(present(history)->pieces) == "abcxdef");
+
+	// Backspace over the "x" and then the "c", as a single run.
+	for(std::size_t i = 0; i < 2; ++i)
+	{
+		PieceTable table(present(history)->pieces);
+		std::size_t offset =
+		        present(history)->cursor.getCharacterOffset() - 1;
+		table.erase(table.characterToCursor(offset),
+		            table.characterToCursor(offset + 1));
+		push(history, Document(table, table.characterToCursor(offset)),
+		     EditKind::Deletion);
+	}
+	CHECK(contentsOf(present(history)->pieces) == "abdef");
+	CHECK(undoDepth(history) == 3);
+
+	undo(history);
+	REQUIRE(!!present(history));
+	CHECK(contentsOf(present(history)->pieces) == "abcxdef");
+	undo(history);
+	REQUIRE(!!present(history));
+	CHECK(contentsOf(present(history)->pieces) == "abcdef");
+}
@@ -0,0 +1,678 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "core/document/Cursor.hpp"
+#include "core/document/Piece.hpp"
+#include "core/document/PieceTable.hpp"
+#include "core/document/PieceTree.hpp"
+#include "core/string/Utf8StringRef.hpp"
+
+namespace
+{
+/*!
+ * A TextResource which owns an in-memory copy of some bytes.
+ */
+struct VectorResource
+{
+	std::vector<uint8_t> bytes;
+
+	uint8_t const *data() const
+	{
+		return bytes.data();
+	}
+
+	std::size_t size() const
+	{
+		return bytes.size();
+	}
+};
+
+/*!
+ * Build a resource big enough to be split into several pieces, made up
+ * of a repeating pattern of one, two, and three byte characters.
+ */
+VectorResource makeLargeResource(std::vector<uint32_t> &characters,
+                                 std::vector<std::size_t> &byteOffsets)
+{
+	static const std::vector<uint8_t> PATTERN{
+	        'a', 0xCEU, 0xBAU, 'b', 0xE1U, 0xBDU, 0xB9U, '\n'};
+	static const std::vector<uint32_t> PATTERN_CHARACTERS{
+	        'a', 0x3BAU, 'b', 0x1F79U, '\n'};
+	static const std::vector<std::size_t> PATTERN_OFFSETS{0, 1, 3, 4, 7};
+
+	VectorResource resource;
+	while(resource.bytes.size() <
+	      qompose::core::document::MAXIMUM_PIECE_SIZE * 3)
+	{
+		for(std::size_t offset : PATTERN_OFFSETS)
+			byteOffsets.push_back(resource.bytes.size() + offset);
+		resource.bytes.insert(resource.bytes.end(), PATTERN.begin(),
+		                      PATTERN.end());
+		characters.insert(characters.end(), PATTERN_CHARACTERS.begin(),
+		                  PATTERN_CHARACTERS.end());
+	}
+	return resource;
+}
+}
+
+TEST_CASE("Test large resources are split into several pieces",
+          "[PieceTable]")
+{
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource resource = makeLargeResource(characters, byteOffsets);
+	std::size_t dataSize = resource.size();
+
+	qompose::core::document::PieceTable table(std::move(resource));
+	CHECK(table.pieces.size() >= 3);
+	CHECK(table.dataSize() == dataSize);
+	CHECK(table.length() == characters.size());
+
+	std::vector<uint32_t> iterated(table.begin(), table.end());
+	CHECK(iterated == characters);
+
+	std::vector<uint32_t> reverseIterated(table.rbegin(), table.rend());
+	CHECK(std::equal(reverseIterated.begin(), reverseIterated.end(),
+	                 characters.rbegin(), characters.rend()));
+}
+
+TEST_CASE("Test PieceTable offset and Cursor conversion", "[PieceTable]")
+{
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource resource = makeLargeResource(characters, byteOffsets);
+	qompose::core::document::PieceTable table(std::move(resource));
+
+	for(std::size_t offset = 0; offset < characters.size(); offset += 997)
+	{
+		auto cursor = table.characterToCursor(offset);
+		CHECK(*cursor == characters[offset]);
+		CHECK(table.cursorToCharacter(cursor) == offset);
+		CHECK(table.cursorToByte(cursor) == byteOffsets[offset]);
+
+		// A byte offset in the middle of a character should find
+		// the beginning of that character.
+		auto byteCursor = table.byteToCursor(byteOffsets[offset] +
+		                                     (characters[offset] > 0x7FU
+		                                              ? 1
+		                                              : 0));
+		CHECK(byteCursor == cursor);
+		CHECK(table.cursorToByte(byteCursor) == byteOffsets[offset]);
+	}
+
+	CHECK(table.characterToCursor(characters.size()) == table.end());
+	CHECK(table.byteToCursor(table.dataSize()) == table.end());
+	CHECK(table.cursorToCharacter(table.end()) == characters.size());
+	CHECK(table.cursorToByte(table.end()) == table.dataSize());
+
+	// Offsets should stay correct while iterating across pieces.
+	auto cursor = table.end();
+	for(std::size_t i = 0; i < qompose::core::document::MAXIMUM_PIECE_SIZE;
+	    ++i)
+	{
+		--cursor;
+	}
+	std::size_t offset = table.cursorToCharacter(cursor);
+	CHECK(table.characterToCursor(offset) == cursor);
+	CHECK(table.cursorToByte(cursor) == byteOffsets[offset]);
+}
+
+TEST_CASE("Test PieceTable line lookup", "[PieceTable]")
+{
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource resource = makeLargeResource(characters, byteOffsets);
+	qompose::core::document::PieceTable table(std::move(resource));
+
+	// Every fifth character in the test resource is a newline, and the
+	// resource ends with a newline, so the last line is empty.
+	constexpr std::size_t LINE_LENGTH = 5;
+	std::size_t lines = characters.size() / LINE_LENGTH;
+	REQUIRE(table.lineCount() == lines + 1);
+
+	for(std::size_t line = 0; line < lines; line += 131)
+	{
+		auto cursor = table.lineToCursor(line);
+		CHECK(table.cursorToCharacter(cursor) == line * LINE_LENGTH);
+		CHECK(table.cursorToLine(cursor) == line);
+
+		std::advance(cursor, LINE_LENGTH - 1);
+		CHECK(*cursor == '\n');
+		CHECK(table.cursorToLine(cursor) == line);
+		++cursor;
+		CHECK(table.cursorToLine(cursor) == line + 1);
+	}
+
+	CHECK(table.lineToCursor(lines) == table.end());
+	CHECK(table.lineToCursor(lines + 1) == table.end());
+	CHECK(table.cursorToLine(table.end()) == lines);
+}
+
+TEST_CASE("Test PieceTable span iteration", "[PieceTable]")
+{
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource resource = makeLargeResource(characters, byteOffsets);
+	std::vector<uint8_t> bytes = resource.bytes;
+	byteOffsets.push_back(bytes.size());
+
+	qompose::core::document::PieceTable table(std::move(resource));
+
+	std::vector<uint8_t> all;
+	CHECK(table.forEachSpan([&all](uint8_t const *begin,
+	                               uint8_t const *end) {
+		all.insert(all.end(), begin, end);
+		return true;
+	}));
+	CHECK(all == bytes);
+
+	std::mt19937 generator(5489U);
+	for(int i = 0; i < 100; ++i)
+	{
+		std::size_t first = generator() % (characters.size() + 1);
+		std::size_t last = generator() % (characters.size() + 1);
+		if(first > last)
+			std::swap(first, last);
+
+		std::vector<uint8_t> spanned;
+		auto collect = [&spanned](uint8_t const *begin,
+		                          uint8_t const *end) {
+			CHECK(begin < end);
+			CHECK((*begin & 0xC0U) != 0x80U);
+			spanned.insert(spanned.end(), begin, end);
+			return true;
+		};
+		table.forEachSpan(table.characterToCursor(first),
+		                  table.characterToCursor(last), collect);
+
+		auto firstByte =
+		        static_cast<std::ptrdiff_t>(byteOffsets[first]);
+		auto lastByte = static_cast<std::ptrdiff_t>(byteOffsets[last]);
+		CHECK(std::equal(spanned.begin(), spanned.end(),
+		                 bytes.begin() + firstByte,
+		                 bytes.begin() + lastByte));
+	}
+
+	// Returning false from the visitor stops the iteration.
+	std::size_t visited = 0;
+	CHECK(!table.forEachSpan([&visited](uint8_t const *, uint8_t const *) {
+		++visited;
+		return false;
+	}));
+	CHECK(visited == 1);
+}
+
+TEST_CASE("Test PieceTable line span iteration", "[PieceTable]")
+{
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource resource = makeLargeResource(characters, byteOffsets);
+	std::vector<uint8_t> bytes = resource.bytes;
+	qompose::core::document::PieceTable table(std::move(resource));
+
+	// Add some extra pieces, so not every piece contains a newline.
+	table.insert(table.lineToCursor(10),
+	             qompose::core::string::Utf8StringRef("x"));
+	table.insert(table.lineToCursor(10000),
+	             qompose::core::string::Utf8StringRef("y"));
+	bytes.clear();
+	table.forEachSpan([&bytes](uint8_t const *begin, uint8_t const *end) {
+		bytes.insert(bytes.end(), begin, end);
+		return true;
+	});
+
+	std::mt19937 generator(5489U);
+	for(int i = 0; i < 100; ++i)
+	{
+		std::size_t first = generator() % (table.lineCount() + 1);
+		std::size_t last = generator() % (table.lineCount() + 1);
+		if(first > last)
+			std::swap(first, last);
+
+		// Whole pieces are visited, which must include every byte of
+		// the lines in the range.
+		std::vector<uint8_t> spanned;
+		auto collect = [&spanned](uint8_t const *begin,
+		                          uint8_t const *end) {
+			spanned.insert(spanned.end(), begin, end);
+			return true;
+		};
+		CHECK(table.forEachLineSpan(first, last, collect));
+
+		auto firstByte = static_cast<std::ptrdiff_t>(
+		        table.lineToCursor(first).getByteOffset());
+		auto lastByte = static_cast<std::ptrdiff_t>(
+		        table.lineToCursor(last).getByteOffset());
+		if(first == last)
+		{
+			CHECK(spanned.empty());
+			continue;
+		}
+		CHECK(std::search(spanned.begin(), spanned.end(),
+		                  bytes.begin() + firstByte,
+		                  bytes.begin() + lastByte) != spanned.end());
+		CHECK(spanned.size() <=
+		      static_cast<std::size_t>(lastByte - firstByte) +
+		              2 * qompose::core::document::MAXIMUM_PIECE_SIZE);
+	}
+}
+
+TEST_CASE("Test PieceTable insertion and erasure", "[PieceTable]")
+{
+	static const std::vector<std::vector<uint8_t>> INSERTIONS{
+	        {'x'},
+	        {'h', 'e', 'l', 'l', 'o', '\n'},
+	        {0xCEU, 0xBAU},
+	        {'\n', 0xE1U, 0xBDU, 0xB9U, '\n'}};
+
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource resource = makeLargeResource(characters, byteOffsets);
+	qompose::core::document::PieceTable table(std::move(resource));
+
+	std::mt19937 generator(1234);
+	for(std::size_t i = 0; i < 500; ++i)
+	{
+		std::size_t offset = generator() % (characters.size() + 1);
+		if(generator() % 2 == 0)
+		{
+			auto const &text = INSERTIONS[generator() %
+			                              INSERTIONS.size()];
+			qompose::core::string::Utf8StringRef ref(
+			        text.data(), text.data() + text.size());
+			auto cursor = table.insert(
+			        table.characterToCursor(offset), ref);
+			CHECK(table.cursorToCharacter(cursor) == offset);
+
+			std::vector<uint32_t> decoded(ref.begin(), ref.end());
+			characters.insert(
+			        characters.begin() +
+			                static_cast<std::ptrdiff_t>(offset),
+			        decoded.begin(), decoded.end());
+		}
+		else
+		{
+			std::size_t length = std::min<std::size_t>(
+			        generator() % 100000, characters.size() - offset);
+			auto cursor = table.erase(
+			        table.characterToCursor(offset),
+			        table.characterToCursor(offset + length));
+			CHECK(table.cursorToCharacter(cursor) == offset);
+
+			characters.erase(
+			        characters.begin() +
+			                static_cast<std::ptrdiff_t>(offset),
+			        characters.begin() +
+			                static_cast<std::ptrdiff_t>(offset +
+			                                            length));
+		}
+
+		REQUIRE(table.length() == characters.size());
+	}
+
+	std::vector<uint32_t> iterated(table.begin(), table.end());
+	CHECK(iterated == characters);
+	CHECK(table.lineCount() ==
+	      1 + static_cast<std::size_t>(std::count(
+	                  characters.begin(), characters.end(), '\n')));
+}
+
+TEST_CASE("Test consecutive insertions share a piece", "[PieceTable]")
+{
+	constexpr char const *TEST_CONTENTS = "this is some typed text.";
+
+	qompose::core::document::PieceTable table;
+	auto cursor = table.end();
+	for(char const *it = TEST_CONTENTS; *it != '\0'; ++it)
+	{
+		auto byte = reinterpret_cast<uint8_t const *>(it);
+		cursor = table.insert(
+		        cursor,
+		        qompose::core::string::Utf8StringRef(byte, byte + 1));
+		++cursor;
+	}
+
+	CHECK(table.pieces.size() == 1);
+	CHECK(table.length() == std::strlen(TEST_CONTENTS));
+	std::string contents(table.begin(), table.end());
+	CHECK(contents == TEST_CONTENTS);
+}
+
+TEST_CASE("Test invalid insertions leave the add buffer unchanged",
+          "[PieceTable]")
+{
+	std::vector<uint8_t> const VALID{'a', 'b'};
+	std::vector<uint8_t> const INVALID{'c', 0xFFU, 'd'};
+
+	using qompose::core::string::Utf8StringRef;
+	auto ref = [](std::vector<uint8_t> const &bytes) {
+		return Utf8StringRef(bytes.data(), bytes.data() + bytes.size());
+	};
+
+	// Failed insertions (into a new chunk, or extending the previous
+	// insertion) leave nothing behind in the add buffer, so the valid
+	// insertions still share one piece at the start of its chunk.
+	qompose::core::document::PieceTable table;
+	CHECK_THROWS(table.insert(table.end(), ref(INVALID)));
+	table.insert(table.end(), ref(VALID));
+	CHECK_THROWS(table.insert(table.end(), ref(INVALID)));
+	table.insert(table.end(), ref(VALID));
+
+	CHECK(table.pieces.size() == 1);
+	std::string contents(table.begin(), table.end());
+	CHECK(contents == "abab");
+	CHECK(table.pieces[0].data() ==
+	      table.getResources().data(table.pieces[0].getResource()));
+}
+
+TEST_CASE("Test pieces refer to the table's resources", "[PieceTable]")
+{
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource resource = makeLargeResource(characters, byteOffsets);
+	std::vector<uint8_t> bytes = resource.bytes;
+
+	qompose::core::document::PieceTable table(std::move(resource));
+	CHECK(table.getResources().size() == 1);
+
+	// Inserted text is stored in a new resource, which copies share.
+	static const std::vector<uint8_t> INSERTION{'n', 'e', 'w'};
+	table.insert(table.characterToCursor(12345),
+	             qompose::core::string::Utf8StringRef(
+	                     INSERTION.data(),
+	                     INSERTION.data() + INSERTION.size()));
+	qompose::core::document::PieceTable copy(table);
+	CHECK(&copy.getResources() == &table.getResources());
+	CHECK(table.getResources().size() == 2);
+
+	std::size_t offset = 0;
+	for(std::size_t i = 0; i < table.pieces.size(); ++i)
+	{
+		auto const &piece = table.pieces[i];
+		uint8_t const *resourceData =
+		        table.getResources().data(piece.getResource());
+		if(piece.getResource() == 0)
+		{
+			auto expected =
+			        bytes.begin() + (piece.data() - resourceData);
+			CHECK(std::equal(piece.data(), piece.dataEnd(),
+			                 expected));
+		}
+		else
+		{
+			CHECK(piece.data() == resourceData);
+			CHECK(std::equal(piece.data(), piece.dataEnd(),
+			                 INSERTION.begin(), INSERTION.end()));
+		}
+		offset += piece.metrics.bytes;
+	}
+	CHECK(offset == bytes.size() + INSERTION.size());
+}
+
+TEST_CASE("Test PieceTable copies are independent snapshots",
+          "[PieceTable]")
+{
+	static const std::vector<uint8_t> INSERTION{'n', 'e', 'w', '\n'};
+	qompose::core::string::Utf8StringRef insertion(
+	        INSERTION.data(), INSERTION.data() + INSERTION.size());
+
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource resource = makeLargeResource(characters, byteOffsets);
+	qompose::core::document::PieceTable table(std::move(resource));
+
+	std::vector<qompose::core::document::PieceTable> snapshots;
+	std::vector<std::vector<uint32_t>> expected;
+	std::mt19937 generator(1234);
+	for(std::size_t i = 0; i < 50; ++i)
+	{
+		snapshots.push_back(table);
+		expected.push_back(characters);
+
+		std::size_t offset = generator() % (characters.size() + 1);
+		if(generator() % 2 == 0)
+		{
+			table.insert(table.characterToCursor(offset), insertion);
+			characters.insert(
+			        characters.begin() +
+			                static_cast<std::ptrdiff_t>(offset),
+			        insertion.begin(), insertion.end());
+		}
+		else
+		{
+			std::size_t length = std::min<std::size_t>(
+			        100, characters.size() - offset);
+			table.erase(table.characterToCursor(offset),
+			            table.characterToCursor(offset + length));
+			characters.erase(
+			        characters.begin() +
+			                static_cast<std::ptrdiff_t>(offset),
+			        characters.begin() +
+			                static_cast<std::ptrdiff_t>(offset +
+			                                            length));
+		}
+	}
+
+	for(std::size_t i = 0; i < snapshots.size(); ++i)
+	{
+		std::vector<uint32_t> iterated(snapshots[i].begin(),
+		                               snapshots[i].end());
+		CHECK(iterated == expected[i]);
+	}
+
+	// Cursors remain valid in copies of the table they came from.
+	auto cursor = table.characterToCursor(characters.size() / 2);
+	qompose::core::document::PieceTable copy(table);
+	table = qompose::core::document::PieceTable();
+	CHECK(copy.cursorToCharacter(cursor) == characters.size() / 2);
+	CHECK(std::vector<uint32_t>(cursor, copy.end()) ==
+	      std::vector<uint32_t>(characters.begin() +
+	                                    static_cast<std::ptrdiff_t>(
+	                                            characters.size() / 2),
+	                            characters.end()));
+}
+
+TEST_CASE("Test PieceTree insertion and removal", "[PieceTable]")
+{
+	static const std::vector<uint8_t> BYTES{'0', '1', '2', '3', '4',
+	                                        '5', '6', '7', '8', '9'};
+	std::mt19937 generator(1234);
+	qompose::core::document::PieceTree tree;
+	std::vector<std::size_t> expected;
+	for(std::size_t i = 0; i < 2000; ++i)
+	{
+		if(expected.empty() || generator() % 3 != 0)
+		{
+			std::size_t length = 1 + generator() % BYTES.size();
+			std::size_t index = generator() % (expected.size() + 1);
+			tree.insert(index, qompose::core::document::Piece(
+			                           0, BYTES.data(),
+			                           BYTES.data() + length));
+			expected.insert(expected.begin() +
+			                        static_cast<std::ptrdiff_t>(index),
+			                length);
+		}
+		else
+		{
+			std::size_t index = generator() % expected.size();
+			tree.erase(index);
+			expected.erase(expected.begin() +
+			               static_cast<std::ptrdiff_t>(index));
+		}
+	}
+
+	REQUIRE(tree.size() == expected.size());
+	std::size_t offset = 0;
+	for(std::size_t i = 0; i < expected.size(); ++i)
+	{
+		CHECK(tree[i].metrics.bytes == expected[i]);
+		CHECK(tree.offsetOf(i).bytes == offset);
+		auto location = tree.find(
+		        &qompose::core::document::PieceMetrics::bytes, offset);
+		CHECK(location.index == i);
+		CHECK(location.offset.bytes == offset);
+		offset += expected[i];
+	}
+	CHECK(tree.getMetrics().bytes == offset);
+	CHECK(tree.find(&qompose::core::document::PieceMetrics::bytes, offset)
+	              .index == tree.size());
+}
+
+TEST_CASE("Test counting the pieces two PieceTrees share", "[PieceTable]")
+{
+	static const std::vector<uint8_t> BYTES(64, 'x');
+	std::mt19937 generator(4321);
+	auto randomPiece = [&generator]() {
+		std::size_t offset = generator() % (BYTES.size() - 1);
+		std::size_t length =
+		        1 + generator() % (BYTES.size() - offset - 1);
+		return qompose::core::document::Piece(
+		        0, BYTES.data() + offset,
+		        BYTES.data() + offset + length);
+	};
+
+	qompose::core::document::PieceTree tree;
+	for(std::size_t i = 0; i < 1000; ++i)
+		tree.insert(generator() % (tree.size() + 1), randomPiece());
+
+	for(std::size_t i = 0; i < 200; ++i)
+	{
+		qompose::core::document::PieceTree edited(tree);
+		for(std::size_t edits = generator() % 3; edits > 0; --edits)
+		{
+			if(generator() % 2 == 0)
+			{
+				edited.insert(generator() % (edited.size() + 1),
+				              randomPiece());
+			}
+			else
+			{
+				edited.erase(generator() % edited.size());
+			}
+		}
+
+		std::size_t limit = std::min(tree.size(), edited.size());
+		auto same = [&](std::size_t a, std::size_t b) {
+			return tree[a].data() == edited[b].data() &&
+			       tree[a].metrics.bytes == edited[b].metrics.bytes;
+		};
+		std::size_t prefix = 0;
+		while(prefix < limit && same(prefix, prefix))
+			++prefix;
+		std::size_t suffix = 0;
+		while(suffix < limit - prefix &&
+		      same(tree.size() - suffix - 1,
+		           edited.size() - suffix - 1))
+		{
+			++suffix;
+		}
+
+		CHECK(qompose::core::document::commonPieceCount(
+		              tree, edited, false, limit) == prefix);
+		CHECK(qompose::core::document::commonPieceCount(
+		              tree, edited, true, limit - prefix) == suffix);
+		tree = edited;
+	}
+}
+
+TEST_CASE("Test visiting the distinct pieces of several PieceTrees",
+          "[PieceTable]")
+{
+	static const std::vector<uint8_t> BYTES(1000, 'x');
+	std::mt19937 generator(2468);
+	std::vector<qompose::core::document::PieceTree> trees(1);
+	for(std::size_t i = 0; i < 100; ++i)
+	{
+		qompose::core::document::PieceTree tree(trees.back());
+		std::size_t offset = generator() % BYTES.size();
+		tree.insert(generator() % (tree.size() + 1),
+		            qompose::core::document::Piece(
+		                    0, BYTES.data() + offset,
+		                    BYTES.data() + offset + 1));
+		trees.push_back(tree);
+	}
+
+	std::size_t total = 0;
+	std::set<uint8_t const *> expected;
+	std::vector<qompose::core::document::PieceTree const *> pointers;
+	for(auto const &tree : trees)
+	{
+		for(std::size_t i = 0; i < tree.size(); ++i)
+			expected.insert(tree[i].data());
+		total += tree.size();
+		pointers.push_back(&tree);
+	}
+
+	std::size_t visits = 0;
+	std::set<uint8_t const *> visited;
+	qompose::core::document::forEachDistinctPiece(
+	        pointers,
+	        [&](qompose::core::document::Piece const &piece) {
+		        ++visits;
+		        visited.insert(piece.data());
+		});
+	CHECK(visited == expected);
+	// Each edit only copies O(log n) nodes, so most pieces are shared.
+	CHECK(visits < total / 4);
+}
+
+TEST_CASE("Test appending resources to a PieceTable", "[PieceTable]")
+{
+	std::vector<uint32_t> characters;
+	std::vector<std::size_t> byteOffsets;
+	VectorResource first = makeLargeResource(characters, byteOffsets);
+	VectorResource second{{'x', 0xCEU, 0xBAU, '\n'}};
+	std::vector<uint8_t> expected = first.bytes;
+	expected.insert(expected.end(), second.bytes.begin(),
+	                second.bytes.end());
+
+	qompose::core::document::PieceTable table;
+	table.append(std::move(first));
+	table.append(VectorResource());
+	qompose::core::document::PieceTable snapshot(table);
+	table.append(std::move(second));
+	CHECK(table.getResources().size() == 2);
+	CHECK(table.dataSize() == expected.size());
+	CHECK(table.length() == characters.size() + 3);
+	CHECK(table.lineCount() == snapshot.lineCount() + 1);
+	CHECK(snapshot.dataSize() == expected.size() - 4);
+
+	std::vector<uint8_t> contents;
+	table.forEachSpan([&contents](uint8_t const *b, uint8_t const *e) {
+		contents.insert(contents.end(), b, e);
+		return true;
+	});
+	CHECK(contents == expected);
+
+	// Invalid resources are rejected without modifying the table.
+	CHECK_THROWS(table.append(VectorResource{{0xFFU}}));
+	CHECK(table.dataSize() == expected.size());
+	CHECK(table.getResources().size() == 2);
+}
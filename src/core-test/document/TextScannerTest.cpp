@@ -0,0 +1,278 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/document/Cursor.hpp"
+#include "core/document/PieceTable.hpp"
+#include "core/document/TextScanner.hpp"
+
+namespace
+{
+std::vector<uint8_t> toBytes(std::string const &s)
+{
+	return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+qompose::core::document::TextStatistics
+scanBytes(std::vector<uint8_t> const &bytes)
+{
+	return qompose::core::document::scanText(bytes.data(),
+	                                         bytes.data() + bytes.size());
+}
+
+/*!
+ * Compute the statistics for some valid UTF-8 text the obvious way, one
+ * byte at a time.
+ */
+qompose::core::document::TextStatistics
+referenceStatistics(std::vector<uint8_t> const &bytes)
+{
+	qompose::core::document::TextStatistics statistics;
+	statistics.bytes = bytes.size();
+	statistics.lineStarts.push_back(0);
+	std::size_t line = 0;
+	for(std::size_t i = 0; i < bytes.size(); ++i)
+	{
+		if(bytes[i] >= 0x80U)
+			statistics.ascii = false;
+		if((bytes[i] & 0xC0U) == 0x80U)
+			continue;
+
+		++statistics.characters;
+		if(bytes[i] == '\r')
+		{
+			if(i + 1 < bytes.size() && bytes[i + 1] == '\n')
+				++statistics.crlfs;
+			else
+				++statistics.carriageReturns;
+		}
+
+		if(bytes[i] != '\n')
+		{
+			++line;
+			continue;
+		}
+
+		if(i == 0 || bytes[i - 1] != '\r')
+			++statistics.lineFeeds;
+		else
+			--line;
+		statistics.longestLine = std::max(statistics.longestLine, line);
+		statistics.lineStarts.push_back(i + 1);
+		line = 0;
+	}
+	statistics.longestLine = std::max(statistics.longestLine, line);
+	return statistics;
+}
+
+void checkEqual(qompose::core::document::TextStatistics const &a,
+                qompose::core::document::TextStatistics const &b)
+{
+	CHECK(a.valid == b.valid);
+	CHECK(a.ascii == b.ascii);
+	CHECK(a.bytes == b.bytes);
+	CHECK(a.characters == b.characters);
+	CHECK(a.lineFeeds == b.lineFeeds);
+	CHECK(a.crlfs == b.crlfs);
+	CHECK(a.carriageReturns == b.carriageReturns);
+	CHECK(a.longestLine == b.longestLine);
+	CHECK(a.lineStarts == b.lineStarts);
+}
+
+/*!
+ * Generate some random text, with short lines ending in every kind of
+ * line ending, and characters of every encoded length.
+ */
+std::vector<uint8_t> makeRandomText(std::mt19937 &generator,
+                                    std::size_t characters)
+{
+	static std::vector<std::vector<uint8_t>> const CHARACTERS{
+	        {'a'},
+	        {' '},
+	        {'\n'},
+	        {'\r'},
+	        {'\r', '\n'},
+	        {0xCEU, 0xBAU},
+	        {0xE1U, 0xBDU, 0xB9U},
+	        {0xF0U, 0x9FU, 0x98U, 0x80U},
+	        {0xF8U, 0x88U, 0x80U, 0x80U, 0x80U},
+	        {0xFCU, 0x84U, 0x80U, 0x80U, 0x80U, 0x80U}};
+
+	std::uniform_int_distribution<std::size_t> pick(0, 99);
+	std::vector<uint8_t> bytes;
+	for(std::size_t i = 0; i < characters; ++i)
+	{
+		// Mostly plain text, so there are long runs of ASCII.
+		std::size_t roll = pick(generator);
+		std::size_t index = roll < 80 ? 0 : roll % CHARACTERS.size();
+		bytes.insert(bytes.end(), CHARACTERS[index].begin(),
+		             CHARACTERS[index].end());
+	}
+	return bytes;
+}
+}
+
+TEST_CASE("Test scanning line endings", "[TextScanner]")
+{
+	auto statistics = scanBytes(toBytes("a\nb\r\nc\rd"));
+	CHECK(statistics.valid);
+	CHECK(statistics.ascii);
+	CHECK(statistics.bytes == 8);
+	CHECK(statistics.characters == 8);
+	CHECK(statistics.lineFeeds == 1);
+	CHECK(statistics.crlfs == 1);
+	CHECK(statistics.carriageReturns == 1);
+	CHECK(statistics.lineCount() == 3);
+	CHECK(statistics.longestLine == 3);
+	CHECK(statistics.lineStarts == std::vector<std::size_t>({0, 2, 5}));
+	CHECK(statistics.hasMixedLineEndings());
+	CHECK(statistics.lineEnding() ==
+	      qompose::core::document::LineEnding::Lf);
+
+	CHECK(scanBytes(toBytes("a\r\nb\r\nc\n")).lineEnding() ==
+	      qompose::core::document::LineEnding::CrLf);
+	CHECK(scanBytes(toBytes("a\rb\r")).lineEnding() ==
+	      qompose::core::document::LineEnding::Cr);
+	CHECK(!scanBytes(toBytes("a\r\nb\r\n")).hasMixedLineEndings());
+
+	auto empty = scanBytes(std::vector<uint8_t>());
+	CHECK(empty.valid);
+	CHECK(empty.lineCount() == 1);
+	CHECK(empty.lineStarts == std::vector<std::size_t>({0}));
+	CHECK(empty.lineEnding() == qompose::core::document::LineEnding::Lf);
+}
+
+TEST_CASE("Test scanning random text", "[TextScanner]")
+{
+	std::mt19937 generator(1234);
+	for(std::size_t characters :
+	    {std::size_t(0), std::size_t(1), std::size_t(63), std::size_t(64),
+	     std::size_t(65), std::size_t(1000), std::size_t(50000)})
+	{
+		std::vector<uint8_t> bytes =
+		        makeRandomText(generator, characters);
+		auto expected = referenceStatistics(bytes);
+		checkEqual(scanBytes(bytes), expected);
+
+		// Scanning in chunks of random sizes should get the same
+		// result, even though chunks split characters and CRLFs.
+		std::uniform_int_distribution<std::size_t> chunkSize(1, 100);
+		qompose::core::document::TextScanner scanner;
+		uint8_t const *begin = bytes.data();
+		uint8_t const *end = bytes.data() + bytes.size();
+		while(begin < end)
+		{
+			std::size_t length = std::min(
+			        chunkSize(generator),
+			        static_cast<std::size_t>(end - begin));
+			scanner.scan(begin, begin + length);
+			begin += length;
+		}
+		checkEqual(scanner.finish(), expected);
+	}
+}
+
+TEST_CASE("Test scanning invalid text", "[TextScanner]")
+{
+	std::vector<uint8_t> bytes(200, 'a');
+	CHECK(scanBytes(bytes).valid);
+
+	// A lone continuation byte.
+	bytes[150] = 0x80U;
+	CHECK(!scanBytes(bytes).valid);
+	CHECK(!scanBytes(bytes).ascii);
+
+	// A character which is cut off at the end of the text.
+	bytes[150] = 'a';
+	bytes.push_back(0xE1U);
+	bytes.push_back(0xBDU);
+	CHECK(!scanBytes(bytes).valid);
+
+	// But not one which is only split between chunks.
+	qompose::core::document::TextScanner scanner;
+	scanner.scan(bytes.data(), bytes.data() + bytes.size());
+	uint8_t const last = 0xB9U;
+	scanner.scan(&last, &last + 1);
+	auto const &statistics = scanner.finish();
+	CHECK(statistics.valid);
+	CHECK(statistics.characters == 201);
+	CHECK(statistics.longestLine == 201);
+}
+
+TEST_CASE("Test scanned line starts agree with PieceTable", "[TextScanner]")
+{
+	std::mt19937 generator(5678);
+	std::vector<uint8_t> bytes = makeRandomText(generator, 200000);
+	auto statistics = scanBytes(bytes);
+	qompose::core::document::PieceTable table(bytes);
+
+	REQUIRE(statistics.lineCount() == table.lineCount());
+	REQUIRE(statistics.lineStarts.size() == table.lineCount());
+	for(std::size_t line = 0; line < table.lineCount(); ++line)
+	{
+		std::size_t offset =
+		        table.cursorToByte(table.lineToCursor(line));
+		CHECK(offset == statistics.lineStarts[line]);
+	}
+}
+
+TEST_CASE("Test scanning text while building a PieceTable", "[TextScanner]")
+{
+	std::mt19937 generator(91011);
+	std::vector<uint8_t> bytes = makeRandomText(generator, 100000);
+	auto expected = referenceStatistics(bytes);
+
+	qompose::core::document::TextScanner scanner;
+	qompose::core::document::PieceTable table(bytes, scanner);
+	checkEqual(scanner.finish(), expected);
+	CHECK(table.dataSize() == bytes.size());
+	CHECK(table.length() == expected.characters);
+	CHECK(table.lineCount() == expected.lineCount());
+
+	// Appending chunks split on character boundaries should measure
+	// the same text the same way.
+	qompose::core::document::TextScanner appendScanner;
+	qompose::core::document::PieceTable appended;
+	std::size_t offset = 0;
+	while(offset < bytes.size())
+	{
+		std::size_t end = std::min(bytes.size(), offset + 7777);
+		while(end < bytes.size() && (bytes[end] & 0xC0U) == 0x80U)
+			++end;
+		appended.append(std::vector<uint8_t>(bytes.begin() + offset,
+		                                     bytes.begin() + end),
+		                appendScanner);
+		offset = end;
+	}
+	checkEqual(appendScanner.finish(), expected);
+	CHECK(appended.pieces.getMetrics() == table.pieces.getMetrics());
+
+	// Invalid text is rejected, leaving the table unchanged.
+	qompose::core::document::TextScanner invalidScanner;
+	std::vector<uint8_t> invalid{'a', 0xE1U, 0xBDU};
+	CHECK_THROWS(appended.append(invalid, invalidScanner));
+	CHECK(appended.pieces.getMetrics() == table.pieces.getMetrics());
+}
@@ -0,0 +1,92 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <bdrck/fs/TemporaryStorage.hpp>
+
+#include "core/file/FileCopy.hpp"
+
+namespace
+{
+std::string readFile(std::string const &path)
+{
+	std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+	REQUIRE(in.is_open());
+	return std::string(std::istreambuf_iterator<char>(in),
+	                   std::istreambuf_iterator<char>());
+}
+}
+
+TEST_CASE("Test copying ranges between files", "[FileCopy]")
+{
+	std::string contents;
+	for(std::size_t i = 0; i < 3 * 1024 * 1024 + 7; ++i)
+		contents.push_back(static_cast<char>('a' + i % 26));
+
+	bdrck::fs::TemporaryStorage source(
+	        bdrck::fs::TemporaryStorageType::FILE);
+	bdrck::fs::TemporaryStorage destination(
+	        bdrck::fs::TemporaryStorageType::FILE);
+
+	{
+		std::ofstream out(source.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		out << contents;
+	}
+
+	int from = open(source.getPath().c_str(), O_RDONLY);
+	REQUIRE(from != -1);
+	int to = open(destination.getPath().c_str(), O_WRONLY | O_TRUNC);
+	REQUIRE(to != -1);
+
+	using qompose::core::file::copyFileRange;
+	using qompose::core::file::writeFully;
+
+	// Copies are appended at the destination's offset, interleaved with
+	// ordinary writes, and never change the source's offset.
+	std::string const INSERTED("inserted");
+	CHECK(10 == copyFileRange(from, 5, to, 10));
+	writeFully(to, reinterpret_cast<uint8_t const *>(INSERTED.data()),
+	           reinterpret_cast<uint8_t const *>(INSERTED.data()) +
+	                   INSERTED.size());
+	CHECK(contents.size() == copyFileRange(from, 0, to, contents.size()));
+	CHECK(0 == copyFileRange(from, 100, to, 0));
+
+	// Ranges which go past the end of the source are copied partially.
+	CHECK(7 == copyFileRange(from, contents.size() - 7, to, 100));
+	CHECK(0 == copyFileRange(from, contents.size() + 1, to, 100));
+
+	close(to);
+	close(from);
+
+	std::string expected = contents.substr(5, 10) + INSERTED + contents +
+	                       contents.substr(contents.size() - 7);
+	CHECK(expected == readFile(destination.getPath()));
+}
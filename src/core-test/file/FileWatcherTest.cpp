@@ -0,0 +1,107 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include <bdrck/fs/TemporaryStorage.hpp>
+
+#include "core/file/FileWatcher.hpp"
+
+namespace
+{
+constexpr std::chrono::seconds NOTIFICATION_TIMEOUT(5);
+
+struct NotificationCounter
+{
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::size_t count = 0;
+
+	void notify()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++count;
+		}
+		changed.notify_all();
+	}
+
+	bool waitFor(std::size_t expected)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return changed.wait_for(lock, NOTIFICATION_TIMEOUT,
+		                        [&]() { return count >= expected; });
+	}
+};
+
+void appendToFile(std::string const &path, std::string const &contents)
+{
+	std::ofstream out(path, std::ios_base::out | std::ios_base::binary |
+	                                std::ios_base::app);
+	REQUIRE(out.is_open());
+	out << contents;
+}
+}
+
+TEST_CASE("Test watching a file for changes", "[FileWatcher]")
+{
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+	appendToFile(file.getPath(), "foo");
+
+	NotificationCounter counter;
+	{
+		qompose::core::file::FileWatcher watcher(
+		        file.getPath(), [&counter]() { counter.notify(); });
+
+		appendToFile(file.getPath(), "bar");
+		REQUIRE(counter.waitFor(1));
+
+		std::size_t count;
+		{
+			std::lock_guard<std::mutex> lock(counter.mutex);
+			count = counter.count;
+		}
+		appendToFile(file.getPath(), "baz");
+		CHECK(counter.waitFor(count + 1));
+	}
+
+	// Once the watcher is destroyed, changes aren't reported anymore.
+	std::size_t count;
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		count = counter.count;
+	}
+	appendToFile(file.getPath(), "qux");
+	std::lock_guard<std::mutex> lock(counter.mutex);
+	CHECK(count == counter.count);
+}
+
+TEST_CASE("Test watching a nonexistent file", "[FileWatcher]")
+{
+	bdrck::fs::TemporaryStorage dir(
+	        bdrck::fs::TemporaryStorageType::DIRECTORY);
+	CHECK_THROWS(qompose::core::file::FileWatcher(
+	        dir.getPath() + "/missing", []() {}));
+}
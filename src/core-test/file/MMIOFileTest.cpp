@@ -19,19 +19,49 @@
 #include <catch/catch.hpp>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iterator>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <boost/optional/optional.hpp>
 
 #include <bdrck/fs/TemporaryStorage.hpp>
 #include <bdrck/fs/Util.hpp>
 
+#include "core/document/Piece.hpp"
 #include "core/document/PieceTable.hpp"
+#include "core/document/PieceTree.hpp"
 #include "core/file/MMIOFile.hpp"
 #include "core/string/Utf8Iterator.hpp"
+#include "core/string/Utf8StringRef.hpp"
+
+namespace
+{
+/*!
+ * A TextResource which refers to a mapped file owned by the test.
+ */
+struct MappedResource
+{
+	std::shared_ptr<qompose::core::file::MMIOFile> file;
+
+	uint8_t const *data() const
+	{
+		return file->data();
+	}
+
+	std::size_t size() const
+	{
+		return file->size();
+	}
+};
+}
 
 TEST_CASE("Memory mapping empty files should work as expected", "[MMIOFile]")
 {
@@ -77,3 +107,264 @@ TEST_CASE("Test MMIO file loading", "[MMIOFile]")
 
 	CHECK(characters == expectedCharacters);
 }
+
+TEST_CASE("Test read-only MMIO file modes", "[MMIOFile]")
+{
+	// Make the file a few pages long, so advice can be given for ranges
+	// which don't start or end on a page boundary.
+	std::string const CONTENTS(3 * 4096 + 123, 'x');
+
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+
+	{
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		out << CONTENTS;
+	}
+	REQUIRE(chmod(file.getPath().c_str(), S_IRUSR | S_IRGRP | S_IROTH) ==
+	        0);
+
+	using qompose::core::file::MMIOAccessPattern;
+	using qompose::core::file::MMIOFile;
+	using qompose::core::file::MMIOFileMode;
+
+	// Any number of readers can share a file at once.
+	MMIOFile shared(file.getPath(), MMIOFileMode::Shared,
+	                MMIOAccessPattern::Sequential);
+	MMIOFile other(file.getPath(), MMIOFileMode::Shared);
+	MMIOFile unlocked(file.getPath(), MMIOFileMode::Unlocked);
+
+	for(MMIOFile const *mapped : {&shared, &other, &unlocked})
+	{
+		REQUIRE(CONTENTS.size() == mapped->size());
+		CHECK(std::equal(CONTENTS.begin(), CONTENTS.end(),
+		                 mapped->data()));
+	}
+	CHECK(MMIOFileMode::Shared == shared.getMode());
+	CHECK(MMIOFileMode::Unlocked == unlocked.getMode());
+
+	CHECK_NOTHROW(shared.advise(MMIOAccessPattern::Random));
+	CHECK_NOTHROW(shared.advise(MMIOAccessPattern::WillNeed, 5000, 10));
+	CHECK_NOTHROW(
+	        shared.advise(MMIOAccessPattern::Normal, 4000, SIZE_MAX));
+	CHECK_NOTHROW(shared.advise(MMIOAccessPattern::Sequential,
+	                            CONTENTS.size() + 1));
+}
+
+TEST_CASE("Test populating MMIO files", "[MMIOFile]")
+{
+	std::string const CONTENTS(5 * 4096 + 17, 'p');
+
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+
+	{
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		out << CONTENTS;
+	}
+
+	using qompose::core::file::MMIOAccessPattern;
+	using qompose::core::file::MMIOFile;
+	using qompose::core::file::MMIOFileMode;
+
+	// Small sequentially-read files are populated as they are mapped.
+	MMIOFile mapped(file.getPath(), MMIOFileMode::Shared,
+	                MMIOAccessPattern::Sequential);
+	CHECK(std::equal(CONTENTS.begin(), CONTENTS.end(), mapped.data()));
+
+	CHECK_NOTHROW(mapped.populate());
+	CHECK_NOTHROW(mapped.populate(0, 0));
+	CHECK_NOTHROW(mapped.populate(4095, 2));
+	CHECK_NOTHROW(mapped.populate(CONTENTS.size() - 1, SIZE_MAX));
+	CHECK_NOTHROW(mapped.populate(CONTENTS.size()));
+
+	// Whether huge pages are supported depends on the kernel, but they
+	// can always be turned off again.
+	mapped.adviseHugePages(true);
+	mapped.adviseHugePages(false);
+	CHECK(std::equal(CONTENTS.begin(), CONTENTS.end(), mapped.data()));
+}
+
+TEST_CASE("Test MMIO files which are changed externally", "[MMIOFile]")
+{
+	std::string const CONTENTS(4 * 4096 + 99, 'c');
+
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+
+	{
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		out << CONTENTS;
+	}
+
+	using qompose::core::file::MMIOFile;
+	using qompose::core::file::MMIOFileChange;
+	using qompose::core::file::MMIOFileMode;
+
+	MMIOFile mapped(file.getPath(), MMIOFileMode::Shared);
+	uint8_t const *data = mapped.data();
+	CHECK(MMIOFileChange::None == mapped.getChange());
+	CHECK(!mapped.isDetached());
+
+	{
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::app);
+		REQUIRE(out.is_open());
+		out << "appended";
+	}
+	CHECK(MMIOFileChange::Extended == mapped.getChange());
+
+	// Reading past the end of a truncated file yields zeros instead of
+	// crashing.
+	REQUIRE(truncate(file.getPath().c_str(), 4096) == 0);
+	CHECK(MMIOFileChange::Truncated == mapped.getChange());
+	CHECK(std::all_of(data, data + 4096,
+	                  [](uint8_t byte) { return byte == 'c'; }));
+	CHECK(std::all_of(data + 4096, data + CONTENTS.size(),
+	                  [](uint8_t byte) { return byte == 0; }));
+
+	// Detaching keeps only the given ranges, at the same address.
+	mapped.detach({MMIOFile::Range(10, 20), MMIOFile::Range(4000, 1000),
+	               MMIOFile::Range(CONTENTS.size() - 1, 100)});
+	CHECK(mapped.isDetached());
+	CHECK(MMIOFileChange::None == mapped.getChange());
+	REQUIRE(data == mapped.data());
+	REQUIRE(CONTENTS.size() == mapped.size());
+	for(std::size_t i = 0; i < CONTENTS.size(); ++i)
+	{
+		bool kept = (i >= 10 && i < 30) || (i >= 4000 && i < 4096);
+		if(data[i] != (kept ? 'c' : 0))
+			FAIL("Unexpected byte at offset " << i);
+	}
+
+	// Once detached, the file can be changed without affecting us.
+	REQUIRE(truncate(file.getPath().c_str(), 0) == 0);
+	CHECK(MMIOFileChange::None == mapped.getChange());
+	CHECK(std::equal(data + 10, data + 30, CONTENTS.begin()));
+}
+
+TEST_CASE("Test detaching MMIO files", "[MMIOFile]")
+{
+	std::string const CONTENTS(2 * 4096 + 1, 'd');
+
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+
+	{
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		out << CONTENTS;
+	}
+
+	using qompose::core::file::MMIOFile;
+	using qompose::core::file::MMIOFileChange;
+	using qompose::core::file::MMIOFileMode;
+
+	MMIOFile mapped(file.getPath(), MMIOFileMode::Exclusive);
+	uint8_t const *data = mapped.data();
+
+	// Duplicated descriptors outlive the file being detached.
+	int fd = mapped.duplicateDescriptor();
+	REQUIRE(fd != -1);
+	mapped.detach();
+	CHECK(mapped.isDetached());
+	CHECK(-1 == mapped.duplicateDescriptor());
+	std::string read(CONTENTS.size(), '\0');
+	CHECK(static_cast<ssize_t>(CONTENTS.size()) ==
+	      pread(fd, &read[0], read.size(), 0));
+	CHECK(CONTENTS == read);
+	close(fd);
+
+	CHECK(data == mapped.data());
+	CHECK(std::equal(CONTENTS.begin(), CONTENTS.end(), mapped.data()));
+
+	// Detaching releases the file's lock, and detaching twice is fine.
+	MMIOFile other(file.getPath(), MMIOFileMode::Exclusive);
+	CHECK_NOTHROW(mapped.detach());
+	CHECK(std::equal(CONTENTS.begin(), CONTENTS.end(), mapped.data()));
+
+	// Only a detached file's contents can be zeroed.
+	CHECK_THROWS(other.zero(MMIOFile::Range(0, 1)));
+	mapped.zero(MMIOFile::Range(4000, 200));
+	mapped.zero(MMIOFile::Range(CONTENTS.size() - 1, 100));
+	for(std::size_t i = 0; i < CONTENTS.size(); ++i)
+	{
+		bool zeroed = (i >= 4000 && i < 4200) ||
+		              i + 1 == CONTENTS.size();
+		if(data[i] != (zeroed ? 0 : 'd'))
+			FAIL("Unexpected byte at offset " << i);
+	}
+	CHECK(std::all_of(other.data(), other.data() + other.size(),
+	                  [](uint8_t byte) { return byte == 'd'; }));
+}
+
+TEST_CASE("Test re-measuring pieces of a truncated MMIO file", "[MMIOFile]")
+{
+	constexpr std::size_t LINES = 200000;
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+
+	{
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		for(std::size_t i = 0; i < LINES; ++i)
+			out << "line\n";
+	}
+
+	using qompose::core::document::Piece;
+	using qompose::core::document::PieceTable;
+	using qompose::core::file::MMIOFile;
+	using qompose::core::file::MMIOFileMode;
+
+	auto mapped = std::make_shared<MMIOFile>(file.getPath(),
+	                                         MMIOFileMode::Shared);
+	std::size_t const size = mapped->size();
+	PieceTable original(MappedResource{mapped});
+	PieceTable edited = original;
+	edited.insert(edited.lineToCursor(LINES / 2),
+	              qompose::core::string::Utf8StringRef("new\n"));
+	REQUIRE(LINES + 1 == original.lineCount());
+	REQUIRE(LINES + 2 == edited.lineCount());
+
+	// Once the file is truncated and detached, its bytes are all NUL, so
+	// the pieces' metrics (e.g. their newline counts) no longer match.
+	REQUIRE(truncate(file.getPath().c_str(), 0) == 0);
+	mapped->detach();
+	REQUIRE(size == mapped->size());
+
+	auto measure = [&mapped](Piece const &piece) {
+		if(piece.data() < mapped->data() ||
+		   piece.dataEnd() > mapped->data() + mapped->size())
+		{
+			return piece.metrics;
+		}
+		return Piece(piece.getResource(), piece.data(), piece.dataEnd())
+		        .metrics;
+	};
+	qompose::core::document::remeasurePieces(
+	        {&original.pieces, &edited.pieces}, measure);
+
+	CHECK(1 == original.lineCount());
+	CHECK(size == original.dataSize());
+	CHECK(size == original.length());
+	CHECK(2 == edited.lineCount());
+	CHECK(size + 4 == edited.dataSize());
+	CHECK(std::size_t(0) == original.lineToCursor(0).getByteOffset());
+	CHECK(size / 2 + 4 == edited.lineToCursor(1).getByteOffset());
+
+	// The trees still share every piece which wasn't edited.
+	CHECK(original.pieces.size() - 1 <=
+	      commonPieceCount(original.pieces, edited.pieces, false,
+	                       original.pieces.size()) +
+	              commonPieceCount(original.pieces, edited.pieces, true,
+	                               original.pieces.size()));
+}
@@ -0,0 +1,106 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <bdrck/fs/TemporaryStorage.hpp>
+
+#include "core/file/MMIOFile.hpp"
+#include "core/file/MMIOPrefetcher.hpp"
+
+namespace
+{
+std::shared_ptr<qompose::core::file::MMIOFile>
+mapFile(bdrck::fs::TemporaryStorage const &file, std::string const &contents)
+{
+	{
+		std::ofstream out(file.getPath(),
+		                  std::ios_base::out | std::ios_base::binary |
+		                          std::ios_base::trunc);
+		REQUIRE(out.is_open());
+		out << contents;
+	}
+
+	return std::make_shared<qompose::core::file::MMIOFile>(
+	        file.getPath(), qompose::core::file::MMIOFileMode::Shared,
+	        qompose::core::file::MMIOAccessPattern::Random);
+}
+}
+
+TEST_CASE("Test prefetching parts of a mapped file", "[MMIOPrefetcher]")
+{
+	std::string const CONTENTS(64 * 4096 + 5, 'f');
+
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+	auto mapped = mapFile(file, CONTENTS);
+	uint8_t const *begin = mapped->data();
+	uint8_t const *end = begin + mapped->size();
+
+	qompose::core::file::MMIOPrefetcher prefetcher(mapped);
+	CHECK(mapped == prefetcher.getFile());
+
+	prefetcher.prefetch(begin, begin + 4096);
+	prefetcher.prefetch(begin + 100, begin + 20000);
+	prefetcher.prefetch(end - 1, end);
+	prefetcher.wait();
+
+	// Ranges are clamped to the file, and empty ranges are ignored.
+	prefetcher.prefetch(begin - 10, begin + 10);
+	prefetcher.prefetch(end - 10, end + 4096);
+	prefetcher.prefetch(end, end + 4096);
+	prefetcher.prefetch(begin + 10, begin + 10);
+	prefetcher.wait();
+
+	// More requests can be made than are kept; the oldest are dropped.
+	using qompose::core::file::MMIOPrefetcher;
+	constexpr std::size_t REQUESTS =
+	        4 * MMIOPrefetcher::MAXIMUM_PENDING_REQUESTS;
+	for(std::size_t i = 0; i < REQUESTS; ++i)
+	{
+		prefetcher.prefetch(begin + i * 4096, begin + (i + 1) * 4096);
+	}
+	prefetcher.wait();
+
+	CHECK(std::string(begin, end) == CONTENTS);
+}
+
+TEST_CASE("Test destroying a prefetcher with pending requests",
+          "[MMIOPrefetcher]")
+{
+	bdrck::fs::TemporaryStorage file(bdrck::fs::TemporaryStorageType::FILE);
+	auto mapped = mapFile(file, std::string(16 * 4096, 'd'));
+
+	{
+		qompose::core::file::MMIOPrefetcher prefetcher(mapped);
+		for(std::size_t i = 0; i < 16; ++i)
+		{
+			prefetcher.prefetch(mapped->data(),
+			                    mapped->data() + mapped->size());
+		}
+	}
+
+	// The file is still mapped, even though the prefetcher is gone.
+	CHECK(mapped.use_count() == 1);
+	CHECK(mapped->data()[0] == 'd');
+}
@@ -0,0 +1,275 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/string/Transcoder.hpp"
+
+namespace
+{
+using qompose::core::string::TextDecoder;
+using qompose::core::string::TextEncoder;
+using qompose::core::string::TextEncoding;
+
+std::vector<TextEncoding> const ENCODINGS{
+        TextEncoding::Latin1, TextEncoding::Utf16LE, TextEncoding::Utf16BE,
+        TextEncoding::Utf32LE, TextEncoding::Utf32BE};
+
+void appendUtf8(uint32_t c, std::vector<uint8_t> &out)
+{
+	if(c < 0x80U)
+	{
+		out.push_back(static_cast<uint8_t>(c));
+	}
+	else if(c < 0x800U)
+	{
+		out.push_back(static_cast<uint8_t>(0xC0U | (c >> 6)));
+		out.push_back(static_cast<uint8_t>(0x80U | (c & 0x3FU)));
+	}
+	else if(c < 0x10000U)
+	{
+		out.push_back(static_cast<uint8_t>(0xE0U | (c >> 12)));
+		out.push_back(static_cast<uint8_t>(0x80U | ((c >> 6) & 0x3FU)));
+		out.push_back(static_cast<uint8_t>(0x80U | (c & 0x3FU)));
+	}
+	else
+	{
+		out.push_back(static_cast<uint8_t>(0xF0U | (c >> 18)));
+		out.push_back(
+		        static_cast<uint8_t>(0x80U | ((c >> 12) & 0x3FU)));
+		out.push_back(static_cast<uint8_t>(0x80U | ((c >> 6) & 0x3FU)));
+		out.push_back(static_cast<uint8_t>(0x80U | (c & 0x3FU)));
+	}
+}
+
+void appendUnit(uint32_t unit, std::size_t size, bool bigEndian,
+                std::vector<uint8_t> &out)
+{
+	for(std::size_t i = 0; i < size; ++i)
+	{
+		std::size_t shift = 8 * (bigEndian ? size - 1 - i : i);
+		out.push_back(static_cast<uint8_t>(unit >> shift));
+	}
+}
+
+void appendEncoded(uint32_t c, TextEncoding encoding,
+                   std::vector<uint8_t> &out)
+{
+	bool bigEndian = encoding == TextEncoding::Utf16BE ||
+	                 encoding == TextEncoding::Utf32BE;
+	switch(encoding)
+	{
+	case TextEncoding::Latin1:
+		out.push_back(static_cast<uint8_t>(c));
+		break;
+	case TextEncoding::Utf16LE:
+	case TextEncoding::Utf16BE:
+		if(c >= 0x10000U)
+		{
+			appendUnit(0xD800U | ((c - 0x10000U) >> 10), 2,
+			           bigEndian, out);
+			appendUnit(0xDC00U | ((c - 0x10000U) & 0x3FFU), 2,
+			           bigEndian, out);
+		}
+		else
+		{
+			appendUnit(c, 2, bigEndian, out);
+		}
+		break;
+	case TextEncoding::Utf32LE:
+	case TextEncoding::Utf32BE:
+		appendUnit(c, 4, bigEndian, out);
+		break;
+	}
+}
+
+/*!
+ * Generate random text which every encoding can represent, with long
+ * runs of ASCII (so the vectorized paths are used) broken up by other
+ * characters.
+ */
+std::vector<uint32_t> randomText(TextEncoding encoding,
+                                 std::mt19937 &generator)
+{
+	uint32_t maximum = encoding == TextEncoding::Latin1 ? 0xFFU : 0x10FFFDU;
+	std::uniform_int_distribution<uint32_t> ascii(0, 0x7F);
+	std::uniform_int_distribution<uint32_t> other(0x80, maximum);
+	std::uniform_int_distribution<std::size_t> runLength(0, 40);
+
+	std::vector<uint32_t> text;
+	for(std::size_t run = 0; run < 50; ++run)
+	{
+		for(std::size_t n = runLength(generator); n > 0; --n)
+			text.push_back(ascii(generator));
+
+		uint32_t c = other(generator);
+		bool invalid = (c >= 0xD800U && c <= 0xDFFFU) ||
+		               (c >= 0xFDD0U && c <= 0xFDEFU) ||
+		               (c & 0xFFFEU) == 0xFFFEU;
+		if(!invalid)
+			text.push_back(c);
+	}
+	return text;
+}
+
+/*!
+ * Feed the given bytes to the given function in randomly sized chunks,
+ * so characters are frequently split between chunks.
+ */
+template <typename Function>
+void forEachChunk(std::vector<uint8_t> const &bytes, std::mt19937 &generator,
+                  Function const &function)
+{
+	std::uniform_int_distribution<std::size_t> chunkSize(0, 9);
+	std::size_t offset = 0;
+	while(offset < bytes.size())
+	{
+		std::size_t size =
+		        std::min(chunkSize(generator), bytes.size() - offset);
+		function(bytes.data() + offset, bytes.data() + offset + size);
+		offset += size;
+	}
+}
+
+std::vector<uint8_t> decodeAll(TextEncoding encoding,
+                               std::vector<uint8_t> const &bytes)
+{
+	TextDecoder decoder(encoding);
+	std::vector<uint8_t> output;
+	decoder.decode(bytes.data(), bytes.data() + bytes.size(), output);
+	decoder.finish(output);
+	return output;
+}
+
+std::vector<uint8_t> encodeAll(TextEncoding encoding,
+                               std::vector<uint8_t> const &bytes)
+{
+	TextEncoder encoder(encoding);
+	std::vector<uint8_t> output;
+	encoder.encode(bytes.data(), bytes.data() + bytes.size(), output);
+	encoder.finish(output);
+	return output;
+}
+
+std::vector<uint8_t> toBytes(std::string const &s)
+{
+	return std::vector<uint8_t>(s.begin(), s.end());
+}
+}
+
+TEST_CASE("Test transcoding round trips", "[Transcoder]")
+{
+	std::mt19937 generator(1234);
+	for(auto encoding : ENCODINGS)
+	{
+		for(int iteration = 0; iteration < 20; ++iteration)
+		{
+			std::vector<uint32_t> text =
+			        randomText(encoding, generator);
+			std::vector<uint8_t> utf8;
+			std::vector<uint8_t> encoded;
+			for(uint32_t c : text)
+			{
+				appendUtf8(c, utf8);
+				appendEncoded(c, encoding, encoded);
+			}
+
+			CHECK(decodeAll(encoding, encoded) == utf8);
+			CHECK(encodeAll(encoding, utf8) == encoded);
+
+			TextDecoder decoder(encoding);
+			std::vector<uint8_t> decoded;
+			forEachChunk(encoded, generator,
+			             [&](uint8_t const *b, uint8_t const *e) {
+				             decoder.decode(b, e, decoded);
+				     });
+			decoder.finish(decoded);
+			CHECK(decoded == utf8);
+
+			TextEncoder encoder(encoding);
+			std::vector<uint8_t> reencoded;
+			forEachChunk(utf8, generator,
+			             [&](uint8_t const *b, uint8_t const *e) {
+				             encoder.encode(b, e, reencoded);
+				     });
+			encoder.finish(reencoded);
+			CHECK(reencoded == encoded);
+		}
+	}
+}
+
+TEST_CASE("Test transcoding byte order marks", "[Transcoder]")
+{
+	// Only a byte order mark at the very beginning is removed.
+	CHECK(decodeAll(TextEncoding::Utf16LE,
+	                {0xFFU, 0xFEU, 'a', 0, 0xFFU, 0xFEU}) ==
+	      toBytes("a\xEF\xBB\xBF"));
+	CHECK(decodeAll(TextEncoding::Utf32BE, {0, 0, 0xFEU, 0xFFU}).empty());
+	CHECK(decodeAll(TextEncoding::Latin1, {0xFFU, 0xFEU}) ==
+	      toBytes("\xC3\xBF\xC3\xBE"));
+
+	TextEncoder encoder(TextEncoding::Utf16BE, true);
+	std::vector<uint8_t> output;
+	encoder.encode(nullptr, nullptr, output);
+	encoder.finish(output);
+	CHECK(output == std::vector<uint8_t>({0xFEU, 0xFFU}));
+
+	TextEncoder latin1(TextEncoding::Latin1, true);
+	output.clear();
+	latin1.finish(output);
+	CHECK(output.empty());
+}
+
+TEST_CASE("Test transcoding invalid input", "[Transcoder]")
+{
+	// Unpaired surrogates, and a truncated code unit.
+	CHECK(decodeAll(TextEncoding::Utf16LE,
+	                {0x00U, 0xD8U, 'a', 0, 0x00U, 0xDCU, 'b'}) ==
+	      toBytes("\xEF\xBF\xBD"
+	              "a\xEF\xBF\xBD\xEF\xBF\xBD"));
+	// Code points past the end of Unicode, and noncharacters.
+	CHECK(decodeAll(TextEncoding::Utf32LE,
+	                {0x00U, 0x00U, 0x11U, 0x00U, 0xFFU, 0xFFU, 0, 0}) ==
+	      toBytes("\xEF\xBF\xBD\xEF\xBF\xBD"));
+
+	// Characters Latin-1 can't represent.
+	CHECK(encodeAll(TextEncoding::Latin1, toBytes("a\xE2\x82\xAC"
+	                                              "b")) == toBytes("a?b"));
+	// Invalid and truncated UTF-8.
+	CHECK(encodeAll(TextEncoding::Utf16BE, {0xFFU, 'a', 0xE2U, 0x82U}) ==
+	      std::vector<uint8_t>({0xFFU, 0xFDU, 0, 'a', 0xFFU, 0xFDU}));
+}
+
+TEST_CASE("Test text encoding names", "[Transcoder]")
+{
+	using qompose::core::string::textEncodingFromName;
+	CHECK(*textEncodingFromName("ISO-8859-1") == TextEncoding::Latin1);
+	CHECK(*textEncodingFromName("utf-16le") == TextEncoding::Utf16LE);
+	CHECK(*textEncodingFromName("UTF-16BE") == TextEncoding::Utf16BE);
+	CHECK(*textEncodingFromName("UTF-32LE") == TextEncoding::Utf32LE);
+	CHECK(*textEncodingFromName("UTF-32BE") == TextEncoding::Utf32BE);
+	CHECK(!textEncodingFromName("UTF-16"));
+	CHECK(!textEncodingFromName("UTF-8"));
+}
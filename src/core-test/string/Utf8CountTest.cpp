@@ -0,0 +1,68 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "core/string/Utf8Count.hpp"
+#include "core/string/Utf8Iterator.hpp"
+
+TEST_CASE("Test UTF-8 character counting", "[Utf8Count]")
+{
+	// Characters of every encoded length, including the 5- and 6-byte
+	// sequences our decoder accepts.
+	static std::vector<std::vector<uint8_t>> const CHARACTERS{
+	        {'a'},
+	        {0xCEU, 0xBAU},
+	        {0xE1U, 0xBDU, 0xB9U},
+	        {0xF0U, 0x9FU, 0x98U, 0x80U},
+	        {0xF8U, 0x88U, 0x80U, 0x80U, 0x80U},
+	        {0xFCU, 0x84U, 0x80U, 0x80U, 0x80U, 0x80U}};
+
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<std::size_t> characterDistribution(
+	        0, CHARACTERS.size() - 1);
+
+	// Try every length up to a few vectors' worth, so the scalar tails
+	// of the vectorized kernels are exercised too.
+	for(std::size_t length = 0; length < 200; ++length)
+	{
+		std::vector<uint8_t> bytes;
+		for(std::size_t i = 0; i < length; ++i)
+		{
+			auto const &character =
+			        CHARACTERS[characterDistribution(generator)];
+			bytes.insert(bytes.end(), character.begin(),
+			             character.end());
+		}
+
+		uint8_t const *begin = bytes.data();
+		uint8_t const *end = bytes.data() + bytes.size();
+		CHECK(qompose::core::string::countUtf8Characters(begin, end) ==
+		      length);
+		CHECK(static_cast<std::size_t>(std::distance(
+		              qompose::core::string::Utf8Iterator(begin, end),
+		              qompose::core::string::Utf8Iterator(
+		                      begin, end, end))) == length);
+	}
+}
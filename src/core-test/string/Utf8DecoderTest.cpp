@@ -0,0 +1,181 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "core/string/Utf8Decoder.hpp"
+
+namespace
+{
+using qompose::core::string::Utf8DecodeResult;
+using qompose::core::string::Utf8DecodeStatus;
+
+/*!
+ * A straightforward (slow) decoder for the rules the real decoder is
+ * supposed to implement, to compare it against. Returns true and sets
+ * value and length if the bytes start with a valid character.
+ */
+bool referenceDecode(std::vector<uint8_t> const &bytes, uint32_t &value,
+                     std::size_t &length)
+{
+	uint8_t first = bytes[0];
+	if(first < 0x80U)
+		length = 1;
+	else if(first < 0xC0U)
+		return false;
+	else if(first < 0xE0U)
+		length = 2;
+	else if(first < 0xF0U)
+		length = 3;
+	else if(first < 0xF8U)
+		length = 4;
+	else if(first < 0xFCU)
+		length = 5;
+	else if(first < 0xFEU)
+		length = 6;
+	else
+		return false;
+
+	if(bytes.size() < length)
+		return false;
+
+	value = first & (length == 1 ? 0x7FU : (0x7FU >> length));
+	for(std::size_t i = 1; i < length; ++i)
+	{
+		if((bytes[i] & 0xC0U) != 0x80U)
+			return false;
+		value = (value << 6) | (bytes[i] & 0x3FU);
+	}
+
+	static uint32_t const MINIMUM[] = {0,        0,         0x80U,
+	                                   0x800U,   0x10000U,  0x200000U,
+	                                   0x4000000U};
+	if(value < MINIMUM[length])
+		return false;
+	if(value >= 0xD800U && value <= 0xDFFFU)
+		return false;
+	if(value >= 0xFDD0U && value <= 0xFDEFU)
+		return false;
+	for(uint32_t plane = 0; plane <= 0x10U; ++plane)
+	{
+		if(value == ((plane << 16) | 0xFFFEU) ||
+		   value == ((plane << 16) | 0xFFFFU))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void checkAgainstReference(std::vector<uint8_t> const &bytes)
+{
+	uint32_t expectedValue = 0;
+	std::size_t expectedLength = 0;
+	bool expected = referenceDecode(bytes, expectedValue, expectedLength);
+
+	Utf8DecodeResult result;
+	Utf8DecodeStatus status = qompose::core::string::decodeUtf8Character(
+	        bytes.data(), bytes.data() + bytes.size(), result);
+
+	REQUIRE((status == Utf8DecodeStatus::Ok) == expected);
+	if(expected)
+	{
+		CHECK(result.value == expectedValue);
+		CHECK(result.current == bytes.data());
+		CHECK(result.currentEnd == bytes.data() + expectedLength);
+	}
+}
+}
+
+TEST_CASE("Test UTF-8 decoder error reporting", "[Utf8Decoder]")
+{
+	typedef std::pair<std::vector<uint8_t>, Utf8DecodeStatus> TestCase;
+	static std::vector<TestCase> const TEST_CASES{
+	        {{0x80U}, Utf8DecodeStatus::InvalidStartByte},
+	        {{0xFFU}, Utf8DecodeStatus::InvalidStartByte},
+	        {{0xCEU, 'a'}, Utf8DecodeStatus::InvalidContinuationByte},
+	        {{0xE1U, 0xBDU}, Utf8DecodeStatus::Truncated},
+	        {{0xC0U, 0x80U}, Utf8DecodeStatus::Overlong},
+	        {{0xF0U, 0x8FU, 0xBFU, 0xBFU}, Utf8DecodeStatus::Overlong},
+	        {{0xEDU, 0xA0U, 0x80U}, Utf8DecodeStatus::Surrogate},
+	        {{0xEFU, 0xBFU, 0xBFU}, Utf8DecodeStatus::Noncharacter}};
+
+	for(auto const &test : TEST_CASES)
+	{
+		Utf8DecodeResult result;
+		CHECK(qompose::core::string::decodeUtf8Character(
+		              test.first.data(),
+		              test.first.data() + test.first.size(),
+		              result) == test.second);
+	}
+}
+
+TEST_CASE("Test UTF-8 decoder matches the reference decoder",
+          "[Utf8Decoder]")
+{
+	// Every one, two and three byte sequence.
+	std::vector<uint8_t> bytes(1);
+	for(unsigned int a = 0; a < 256; ++a)
+	{
+		bytes = {static_cast<uint8_t>(a)};
+		checkAgainstReference(bytes);
+		for(unsigned int b = 0; b < 256; ++b)
+		{
+			bytes = {static_cast<uint8_t>(a),
+			         static_cast<uint8_t>(b)};
+			checkAgainstReference(bytes);
+		}
+	}
+
+	bytes.resize(3);
+	for(unsigned int a = 0xE0U; a < 0xF0U; ++a)
+	{
+		for(unsigned int b = 0; b < 256; ++b)
+		{
+			for(unsigned int c = 0x7FU; c < 0xC1U; ++c)
+			{
+				bytes[0] = static_cast<uint8_t>(a);
+				bytes[1] = static_cast<uint8_t>(b);
+				bytes[2] = static_cast<uint8_t>(c);
+				checkAgainstReference(bytes);
+			}
+		}
+	}
+
+	// Longer sequences, with random continuation bytes.
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<int> distribution(0x7F, 0xC0);
+	for(unsigned int lead = 0xF0U; lead < 0x100U; ++lead)
+	{
+		for(int i = 0; i < 5000; ++i)
+		{
+			bytes = {static_cast<uint8_t>(lead)};
+			for(int j = 0; j < 5; ++j)
+			{
+				bytes.push_back(static_cast<uint8_t>(
+				        distribution(generator)));
+			}
+			checkAgainstReference(bytes);
+		}
+	}
+}
@@ -21,6 +21,8 @@
 #include <algorithm>
 #include <cstddef>
 #include <experimental/optional>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "core/string/Utf8String.hpp"
@@ -452,3 +454,92 @@ TEST_CASE("Test malformed UTF8 sequences", "[Utf8String]")
 		CHECK_THROWS(str.length());
 	}
 }
+
+TEST_CASE("Test short and long string copies", "[Utf8String]")
+{
+	using qompose::core::string::Utf8String;
+	static const std::vector<std::string> TEST_CASES{
+	        "", "abc", std::string(Utf8String::INLINE_CAPACITY, 'x'),
+	        std::string(Utf8String::INLINE_CAPACITY + 1, 'y'),
+	        "\xEF\xBB\xBF" + std::string(Utf8String::INLINE_CAPACITY, 'z'),
+	        std::string(1000, 'w')};
+
+	for(auto const &testCase : TEST_CASES)
+	{
+		Utf8String str(testCase);
+		Utf8String copy(str);
+		CHECK(copy == str);
+		CHECK(copy.dataSize() == str.dataSize());
+		CHECK(std::equal(copy.data(), copy.data() + copy.dataSize(),
+		                 str.data()));
+
+		Utf8String moved(std::move(copy));
+		CHECK(moved == str);
+
+		Utf8String assigned;
+		assigned = moved;
+		CHECK(assigned == str);
+		CHECK(assigned.length() == str.length());
+	}
+}
+
+TEST_CASE("Test BOM skipping for inline strings", "[Utf8String]")
+{
+	qompose::core::string::Utf8String str("\xEF\xBB\xBF"
+	                                      "abc");
+	CHECK(str.dataSize() == 3);
+	CHECK(str.length() == 3);
+	CHECK(str.front() == 'a');
+}
+
+TEST_CASE("Test string interning", "[Utf8String]")
+{
+	using qompose::core::string::Utf8String;
+	using qompose::core::string::Utf8StringRef;
+	std::string contents(100, 'a');
+
+	Utf8String a = Utf8String::intern(Utf8StringRef(contents));
+	Utf8String b = Utf8String::intern(Utf8StringRef(contents));
+	Utf8String c(contents);
+	CHECK(a.data() == b.data());
+	CHECK(a.data() != c.data());
+	CHECK(a == b);
+	CHECK(a == c);
+	CHECK(a.length() == 100);
+
+	Utf8String d = Utf8String::intern(Utf8StringRef("b"));
+	CHECK(d != a);
+	CHECK(d.length() == 1);
+}
+
+TEST_CASE("Test random character access", "[Utf8String]")
+{
+	using qompose::core::string::Utf8String;
+	static const std::vector<std::string> TEST_CASES{
+	        "a", std::string(1000, 'a'), "\xC3\xA9",
+	        "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"};
+
+	for(auto const &base : TEST_CASES)
+	{
+		std::string contents;
+		for(std::size_t i = 0; i < 100; ++i)
+			contents += base;
+		Utf8String str(contents);
+		std::vector<uint32_t> expected(str.begin(), str.end());
+		REQUIRE(expected.size() == str.length());
+
+		// Access out of order, so the index isn't built by sequential
+		// access alone.
+		for(std::size_t i = expected.size(); i > 0; --i)
+			CHECK(str.at(i - 1) == expected[i - 1]);
+		for(std::size_t i = 0; i < expected.size(); ++i)
+			CHECK(str[i] == expected[i]);
+
+		Utf8String copy(str);
+		CHECK(copy.at(expected.size() / 2) ==
+		      expected[expected.size() / 2]);
+		CHECK(str.front() == expected.front());
+		CHECK(str.back() == expected.back());
+		CHECK_THROWS_AS(str.at(expected.size()), std::out_of_range);
+	}
+}
@@ -0,0 +1,205 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "core/string/Utf8Iterator.hpp"
+#include "core/string/Utf8Validation.hpp"
+
+namespace
+{
+bool isValidUtf8(std::vector<uint8_t> const &bytes)
+{
+	return qompose::core::string::isValidUtf8(
+	        bytes.data(), bytes.data() + bytes.size());
+}
+
+/*!
+ * Check the given bytes the slow way, by decoding every character with
+ * Utf8Iterator, which throws on any invalid sequence.
+ */
+bool decodes(std::vector<uint8_t> const &bytes)
+{
+	try
+	{
+		qompose::core::string::Utf8Iterator it(
+		        bytes.data(), bytes.data() + bytes.size());
+		qompose::core::string::Utf8Iterator end;
+		while(it != end)
+			++it;
+		return true;
+	}
+	catch(std::runtime_error const &)
+	{
+		return false;
+	}
+}
+
+/*!
+ * Surround the given bytes with ASCII, so they are checked in the middle
+ * of (and across the boundaries of) the vectorized ASCII blocks.
+ */
+std::vector<uint8_t> embed(std::vector<uint8_t> const &bytes,
+                           std::size_t before, std::size_t after)
+{
+	std::vector<uint8_t> embedded(before, 'a');
+	embedded.insert(embedded.end(), bytes.begin(), bytes.end());
+	embedded.insert(embedded.end(), after, 'z');
+	return embedded;
+}
+}
+
+TEST_CASE("Test UTF-8 validation of known sequences", "[Utf8Validation]")
+{
+	static std::vector<std::pair<std::vector<uint8_t>, bool>> const
+	        TEST_CASES{
+	                {{}, true},
+	                {{'a', 'b', 'c'}, true},
+	                {{0xCEU, 0xBAU}, true},
+	                {{0xE1U, 0xBDU, 0xB9U}, true},
+	                {{0xF0U, 0x9FU, 0x98U, 0x80U}, true},
+	                {{0xF8U, 0x88U, 0x80U, 0x80U, 0x80U}, true},
+	                {{0xFCU, 0x84U, 0x80U, 0x80U, 0x80U, 0x80U}, true},
+	                // Overlong encodings.
+	                {{0xC0U, 0x80U}, false},
+	                {{0xE0U, 0x80U, 0xAFU}, false},
+	                {{0xF0U, 0x8FU, 0xBFU, 0xBFU}, false},
+	                // A UTF-16 surrogate.
+	                {{0xEDU, 0xA0U, 0x80U}, false},
+	                // Noncharacters.
+	                {{0xEFU, 0xBFU, 0xBEU}, false},
+	                {{0xEFU, 0xB7U, 0x90U}, false},
+	                {{0xF4U, 0x8FU, 0xBFU, 0xBFU}, false},
+	                // Invalid or truncated sequences.
+	                {{0x80U}, false},
+	                {{0xFEU}, false},
+	                {{0xFFU}, false},
+	                {{0xCEU}, false},
+	                {{0xE1U, 0xBDU}, false},
+	                {{0xCEU, 'a'}, false}};
+
+	for(auto const &test : TEST_CASES)
+	{
+		for(std::size_t before : {0, 1, 15, 31, 63, 64, 100})
+		{
+			for(std::size_t after : {0, 1, 16, 70})
+			{
+				auto bytes = embed(test.first, before, after);
+				CHECK(isValidUtf8(bytes) == test.second);
+				CHECK(decodes(bytes) == test.second);
+			}
+		}
+	}
+}
+
+TEST_CASE("Test UTF-8 validation matches the decoder", "[Utf8Validation]")
+{
+	std::mt19937 generator(1234);
+	std::uniform_int_distribution<int> byteDistribution(0, 255);
+	std::uniform_int_distribution<std::size_t> lengthDistribution(0, 200);
+
+	for(int i = 0; i < 2000; ++i)
+	{
+		// Mostly ASCII, with a few arbitrary bytes, which are much
+		// more likely to produce interesting (in)valid sequences than
+		// entirely random data.
+		std::vector<uint8_t> bytes(lengthDistribution(generator), 'x');
+		std::size_t count = lengthDistribution(generator) % 4;
+		for(std::size_t j = 0; j < count && !bytes.empty(); ++j)
+		{
+			std::size_t position =
+			        lengthDistribution(generator) % bytes.size();
+			std::size_t length = 1 + position % 6;
+			for(std::size_t k = position;
+			    k < position + length && k < bytes.size(); ++k)
+			{
+				bytes[k] = static_cast<uint8_t>(
+				        byteDistribution(generator));
+			}
+		}
+
+		CHECK(isValidUtf8(bytes) == decodes(bytes));
+	}
+}
+
+TEST_CASE("Test parallel UTF-8 validation matches serial validation",
+          "[Utf8Validation]")
+{
+	// Repeat a mix of 1- to 4-byte characters, whose length (10 bytes)
+	// doesn't divide the chunk size, so chunk boundaries fall in the
+	// middle of characters.
+	std::vector<uint8_t> const CHARACTERS{'a',   0xC3U, 0xA9U, 0xE2U,
+	                                      0x82U, 0xACU, 0xF0U, 0x9FU,
+	                                      0x98U, 0x80U};
+	constexpr std::size_t SIZE = 9 * 1024 * 1024 + 3;
+	constexpr std::size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+	std::vector<uint8_t> bytes;
+	bytes.reserve(SIZE);
+	while(bytes.size() < SIZE)
+		bytes.push_back(CHARACTERS[bytes.size() % CHARACTERS.size()]);
+	// Don't end with an incomplete character.
+	bytes.resize(SIZE - SIZE % CHARACTERS.size());
+
+	auto validate = [&bytes](std::size_t threads) {
+		return qompose::core::string::isValidUtf8Parallel(
+		        bytes.data(), bytes.data() + bytes.size(), threads);
+	};
+
+	for(std::size_t threads : {0, 1, 2, 3, 8})
+		CHECK(validate(threads));
+
+	// Corrupt the text just before, at, and just after each chunk
+	// boundary, both with stray bytes and by truncating characters.
+	for(std::size_t boundary = CHUNK_SIZE; boundary < bytes.size();
+	    boundary += CHUNK_SIZE)
+	{
+		for(std::size_t position = boundary - 5;
+		    position <= boundary + 5; ++position)
+		{
+			for(uint8_t byte : {0x80U, 0xFFU})
+			{
+				uint8_t original = bytes[position];
+				bytes[position] = byte;
+
+				// Only the characters around the corrupted
+				// byte can have become invalid.
+				std::size_t length = CHARACTERS.size();
+				uint8_t const *start =
+				        bytes.data() + position -
+				        position % length - length;
+				bool expected =
+				        qompose::core::string::isValidUtf8(
+				                start, start + 3 * length);
+
+				CHECK(validate(3) == expected);
+				CHECK(validate(8) == expected);
+				bytes[position] = original;
+			}
+		}
+	}
+
+	bytes.back() = 0xF0U;
+	CHECK(!validate(4));
+}
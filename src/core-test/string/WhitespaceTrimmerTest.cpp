@@ -0,0 +1,296 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/string/WhitespaceTrimmer.hpp"
+
+namespace
+{
+std::string trimInChunks(std::string const &text, std::size_t chunkSize)
+{
+	auto begin = reinterpret_cast<uint8_t const *>(text.data());
+	auto end = begin + text.size();
+
+	qompose::core::string::WhitespaceTrimmer trimmer;
+	std::vector<uint8_t> output;
+	for(uint8_t const *it = begin; it < end; it += chunkSize)
+	{
+		std::size_t length = std::min(
+		        chunkSize, static_cast<std::size_t>(end - it));
+		trimmer.trim(it, it + length, output);
+	}
+	trimmer.finish();
+	return std::string(output.begin(), output.end());
+}
+}
+
+TEST_CASE("Test trimming trailing whitespace", "[WhitespaceTrimmer]")
+{
+	struct TestCase
+	{
+		std::string input;
+		std::string expected;
+	};
+
+	std::vector<TestCase> const TEST_CASES{
+	        {"", ""},
+	        {"   ", ""},
+	        {"foo", "foo"},
+	        {"foo  \t", "foo"},
+	        {"  foo bar  \nbaz\t\n", "  foo bar\nbaz\n"},
+	        {"foo \r\nbar\t\r\n \r\n", "foo\r\nbar\r\n\r\n"},
+	        {"foo \rbar \r", "foo\rbar\r"},
+	        {"a \v\f\n\n \t \nb", "a\n\n\nb"},
+	        {"\xc3\xa9 \xe2\x82\xac  \n", "\xc3\xa9 \xe2\x82\xac\n"},
+	        {"tabs\tinside\tlines\t\n", "tabs\tinside\tlines\n"}};
+
+	for(auto const &test : TEST_CASES)
+	{
+		// However the text is split into chunks, the result should be
+		// the same.
+		for(std::size_t chunkSize = 1;
+		    chunkSize <= test.input.size() + 1; ++chunkSize)
+		{
+			CHECK(test.expected ==
+			      trimInChunks(test.input, chunkSize));
+		}
+	}
+}
+
+TEST_CASE("Test reusing a whitespace trimmer", "[WhitespaceTrimmer]")
+{
+	std::string const FIRST("foo   ");
+	std::string const SECOND("bar");
+
+	qompose::core::string::WhitespaceTrimmer trimmer;
+	std::vector<uint8_t> output;
+	trimmer.trim(reinterpret_cast<uint8_t const *>(FIRST.data()),
+	             reinterpret_cast<uint8_t const *>(FIRST.data()) +
+	                     FIRST.size(),
+	             output);
+	trimmer.finish();
+	trimmer.trim(reinterpret_cast<uint8_t const *>(SECOND.data()),
+	             reinterpret_cast<uint8_t const *>(SECOND.data()) +
+	                     SECOND.size(),
+	             output);
+	trimmer.finish();
+	CHECK("foobar" == std::string(output.begin(), output.end()));
+}
+
+TEST_CASE("Test trimming only edited lines", "[WhitespaceTrimmer]")
+{
+	std::string const SOURCE("keep  \nedit  \nkeep\t\r\nend  ");
+	std::string const ADDED("new \n");
+	auto source = reinterpret_cast<uint8_t const *>(SOURCE.data());
+	auto added = reinterpret_cast<uint8_t const *>(ADDED.data());
+
+	std::string output;
+	std::size_t copied = 0;
+	qompose::core::string::EditedLineTrimmer trimmer(
+	        source, source + SOURCE.size(),
+	        [&](uint8_t const *begin, uint8_t const *end) {
+		        output.append(begin, end);
+		        if(begin >= source && end <= source + SOURCE.size())
+			        copied += static_cast<std::size_t>(end - begin);
+		        return true;
+		});
+
+	// Insert a line after the first one, and remove "it" from the
+	// second line. The last line is split into several spans, but is
+	// still unedited.
+	CHECK(trimmer.trim(source, source + 7));
+	CHECK(trimmer.trim(added, added + ADDED.size()));
+	CHECK(trimmer.trim(source + 7, source + 9));
+	CHECK(trimmer.trim(source + 11, source + 23));
+	CHECK(trimmer.trim(source + 23, source + SOURCE.size()));
+	CHECK(trimmer.finish());
+
+	CHECK("keep  \nnew\ned\nkeep\t\r\nend  " == output);
+	CHECK(std::string("keep  \nkeep\t\r\nend  ").size() == copied);
+}
+
+TEST_CASE("Test trimming lines edited by deleting up to a line boundary",
+          "[WhitespaceTrimmer]")
+{
+	std::string const SOURCE("aaa  \nbbb  \nccc  \n");
+	auto source = reinterpret_cast<uint8_t const *>(SOURCE.data());
+
+	auto trim = [&](std::vector<std::pair<std::size_t, std::size_t>> const
+	                        &ranges) {
+		std::string output;
+		qompose::core::string::EditedLineTrimmer trimmer(
+		        source, source + SOURCE.size(),
+		        [&](uint8_t const *begin, uint8_t const *end) {
+			        output.append(begin, end);
+			        return true;
+			});
+		for(auto const &range : ranges)
+		{
+			REQUIRE(trimmer.trim(source + range.first,
+			                     source + range.second));
+		}
+		REQUIRE(trimmer.finish());
+		return output;
+	};
+
+	// Deleting "bbb  \nc" leaves a line which starts partway through
+	// a line of the source.
+	CHECK("aaa  \ncc\n" == trim({{0, 6}, {13, SOURCE.size()}}));
+	CHECK("cc\n" == trim({{13, SOURCE.size()}}));
+
+	// Deleting the end of the file leaves a last line which ends partway
+	// through a line of the source.
+	CHECK("aaa  \nbbb" == trim({{0, 11}}));
+	CHECK("aaa  \nbbb  \nccc  \n" == trim({{0, SOURCE.size()}}));
+}
+
+TEST_CASE("Test trimming edited lines of random edits", "[WhitespaceTrimmer]")
+{
+	static std::string const ALPHABET("ab  \t\n\r");
+	std::mt19937 generator(1234);
+	auto randomText = [&](std::size_t length) {
+		std::uniform_int_distribution<std::size_t> character(
+		        0, ALPHABET.size() - 1);
+		std::string text;
+		for(std::size_t i = 0; i < length; ++i)
+			text.push_back(ALPHABET[character(generator)]);
+		return text;
+	};
+
+	std::string const SOURCE = randomText(4096);
+	std::string const ADDED = randomText(4096);
+	auto source = reinterpret_cast<uint8_t const *>(SOURCE.data());
+	auto added = reinterpret_cast<uint8_t const *>(ADDED.data());
+	auto isInSource = [&](uint8_t const *begin, uint8_t const *end) {
+		return begin >= source && end <= source + SOURCE.size();
+	};
+
+	for(int iteration = 0; iteration < 200; ++iteration)
+	{
+		// Build a text out of (possibly adjacent) ranges of the source
+		// and of added text, remembering where each byte came from.
+		std::vector<std::pair<uint8_t const *, uint8_t const *>> spans;
+		std::vector<uint8_t const *> origins;
+		std::uniform_int_distribution<std::size_t> offset(
+		        0, SOURCE.size() - 64);
+		std::uniform_int_distribution<std::size_t> length(0, 63);
+		std::uniform_int_distribution<int> kind(0, 3);
+		uint8_t const *next = source + offset(generator);
+		for(int i = 0; i < 20; ++i)
+		{
+			int k = kind(generator);
+			uint8_t const *begin =
+			        k == 0 ? added + offset(generator)
+			               : k == 1 ? source + offset(generator)
+			                        : next;
+			if(begin + 64 > source + SOURCE.size() &&
+			   isInSource(begin, begin))
+			{
+				begin = source;
+			}
+			uint8_t const *end = begin + length(generator);
+			spans.emplace_back(begin, end);
+			for(uint8_t const *it = begin; it < end; ++it)
+				origins.push_back(it);
+			if(isInSource(begin, end))
+				next = end;
+		}
+
+		// Lines which are one whole line of the source, unbroken, are
+		// kept as-is, and all others are trimmed.
+		std::string expected;
+		std::size_t expectedCopied = 0;
+		std::size_t lineStart = 0;
+		for(std::size_t i = 0; i <= origins.size(); ++i)
+		{
+			bool atEnd = i == origins.size();
+			if(!atEnd && *origins[i] != '\n' && *origins[i] != '\r')
+				continue;
+
+			bool unedited = true;
+			std::size_t lineEnd = atEnd ? i : i + 1;
+			for(std::size_t j = lineStart; j < lineEnd; ++j)
+			{
+				unedited = unedited &&
+				           isInSource(origins[j], origins[j]) &&
+				           (j == lineStart ||
+				            origins[j] == origins[j - 1] + 1);
+			}
+			if(unedited && lineStart < lineEnd)
+			{
+				uint8_t const *first = origins[lineStart];
+				uint8_t const *last = origins[lineEnd - 1];
+				unedited = (first == source ||
+				            *(first - 1) == '\n' ||
+				            *(first - 1) == '\r') &&
+				           (!atEnd ||
+				            last + 1 == source + SOURCE.size());
+			}
+
+			std::string line;
+			for(std::size_t j = lineStart; j < lineEnd; ++j)
+				line.push_back(static_cast<char>(*origins[j]));
+			if(unedited)
+			{
+				expectedCopied += line.size();
+			}
+			else
+			{
+				std::size_t content = atEnd ? line.size()
+				                            : line.size() - 1;
+				std::size_t trimmed = content;
+				while(trimmed > 0 &&
+				      (line[trimmed - 1] == ' ' ||
+				       line[trimmed - 1] == '\t'))
+				{
+					--trimmed;
+				}
+				line.erase(trimmed, content - trimmed);
+			}
+			expected += line;
+			lineStart = lineEnd;
+		}
+
+		std::string output;
+		std::size_t copied = 0;
+		qompose::core::string::EditedLineTrimmer trimmer(
+		        source, source + SOURCE.size(),
+		        [&](uint8_t const *begin, uint8_t const *end) {
+			        output.append(begin, end);
+			        if(isInSource(begin, end))
+				        copied += static_cast<std::size_t>(
+				                end - begin);
+			        return true;
+			});
+		for(auto const &span : spans)
+			REQUIRE(trimmer.trim(span.first, span.second));
+		REQUIRE(trimmer.finish());
+
+		CHECK(expected == output);
+		CHECK(expectedCopied == copied);
+	}
+}
@@ -0,0 +1,125 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AddBuffer.hpp"
+
+#include <stdexcept>
+
+#include "core/string/Utf8Validation.hpp"
+
+namespace
+{
+/*!
+ * Bytes are copied into the shared chunk before any Piece is built from
+ * them, and they can't be removed from it afterwards, so they must be
+ * validated up front.
+ */
+void requireValidUtf8(uint8_t const *begin, uint8_t const *end)
+{
+	if(!qompose::core::string::isValidUtf8(begin, end))
+		throw std::runtime_error("Invalid UTF-8 piece.");
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+constexpr std::size_t AddBuffer::CHUNK_SIZE;
+
+AddBuffer::AddBuffer() : chunk(), chunkId(0)
+{
+}
+
+std::vector<Piece> AddBuffer::append(ResourceTable &resources,
+                                     uint8_t const *begin,
+                                     uint8_t const *end)
+{
+	requireValidUtf8(begin, end);
+
+	std::vector<Piece> pieces;
+	while(begin < end)
+	{
+		uint8_t const *copied = begin;
+		uint8_t const *pieceBegin = nullptr;
+		if(!!chunk)
+		{
+			pieceBegin = chunk->data() + chunk->size();
+			copied = copyToChunk(begin, end);
+		}
+
+		if(copied == begin)
+		{
+			// The current chunk is full (or there isn't one yet);
+			// start a new one.
+			chunk = std::make_shared<std::vector<uint8_t>>();
+			chunk->reserve(CHUNK_SIZE);
+			chunkId = resources.add(chunk, chunk->data());
+			continue;
+		}
+
+		pieces.emplace_back(chunkId, pieceBegin,
+		                    chunk->data() + chunk->size());
+		begin = copied;
+	}
+	return pieces;
+}
+
+boost::optional<Piece> AddBuffer::extend(Piece const &piece,
+                                         uint8_t const *begin,
+                                         uint8_t const *end)
+{
+	std::size_t length = static_cast<std::size_t>(end - begin);
+	if(!chunk || piece.getResource() != chunkId ||
+	   piece.dataEnd() != chunk->data() + chunk->size() ||
+	   chunk->size() + length > CHUNK_SIZE ||
+	   piece.metrics.bytes + length > MAXIMUM_PIECE_SIZE)
+	{
+		return boost::none;
+	}
+	requireValidUtf8(begin, end);
+
+	uint8_t const *appended = chunk->data() + chunk->size();
+	chunk->insert(chunk->end(), begin, end);
+	Piece suffix(chunkId, appended, appended + length);
+	return Piece(chunkId, piece.data(), suffix.dataEnd(),
+	             piece.metrics + suffix.metrics);
+}
+
+uint8_t const *AddBuffer::copyToChunk(uint8_t const *begin,
+                                      uint8_t const *end)
+{
+	std::size_t available = CHUNK_SIZE - chunk->size();
+	uint8_t const *copyEnd = end;
+	if(static_cast<std::size_t>(end - begin) > available)
+	{
+		copyEnd = begin + available;
+		while(copyEnd > begin && (*copyEnd & 0xC0U) == 0x80U)
+			--copyEnd;
+	}
+
+	// The chunk's capacity was reserved up front, so this never
+	// reallocates (which would invalidate existing pieces).
+	chunk->insert(chunk->end(), begin, copyEnd);
+	return copyEnd;
+}
+}
+}
+}
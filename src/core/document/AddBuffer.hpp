@@ -0,0 +1,109 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_document_AddBuffer_HPP
+#define qompose_core_document_AddBuffer_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/optional/optional.hpp>
+
+#include "core/document/Piece.hpp"
+#include "core/document/ResourceTable.hpp"
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+/*!
+ * \brief An AddBuffer stores all of the text inserted into a PieceTable.
+ *
+ * The buffer is append-only, and it is divided into fixed-capacity
+ * chunks which are never reallocated, so pieces can safely point into
+ * them. Each chunk is added to the document's ResourceTable when it is
+ * created, and the table keeps it alive from then on; the AddBuffer itself
+ * only keeps track of the chunk currently being appended to.
+ */
+class AddBuffer
+{
+public:
+	/*!
+	 * The capacity of each chunk, in bytes.
+	 */
+	static constexpr std::size_t CHUNK_SIZE = MAXIMUM_PIECE_SIZE;
+
+	AddBuffer();
+
+	AddBuffer(AddBuffer const &) = delete;
+	AddBuffer(AddBuffer &&) = default;
+	AddBuffer &operator=(AddBuffer const &) = delete;
+	AddBuffer &operator=(AddBuffer &&) = default;
+
+	~AddBuffer() = default;
+
+	/*!
+	 * Append the given bytes to the buffer, and return pieces which
+	 * refer to them. Several pieces are returned if the bytes don't
+	 * fit in the current chunk. This will throw if the bytes are not
+	 * valid UTF-8, before any of them are appended.
+	 *
+	 * \param resources The table to add any new chunks to.
+	 * \param begin The begin pointer for the bytes to append.
+	 * \param end The end pointer for the bytes to append.
+	 * \return The pieces which, in order, refer to the appended bytes.
+	 */
+	std::vector<Piece> append(ResourceTable &resources,
+	                          uint8_t const *begin, uint8_t const *end);
+
+	/*!
+	 * If the given piece ends exactly where the next append() would
+	 * begin, and the given bytes fit in the current chunk, then append
+	 * them and return the given piece extended to cover them as well.
+	 * This lets a run of consecutive insertions share a single piece.
+	 * Like append(), this throws (leaving the buffer unchanged) if the
+	 * bytes are not valid UTF-8.
+	 *
+	 * \param piece The piece to try to extend.
+	 * \param begin The begin pointer for the bytes to append.
+	 * \param end The end pointer for the bytes to append.
+	 * \return The extended piece, if the piece could be extended.
+	 */
+	boost::optional<Piece> extend(Piece const &piece, uint8_t const *begin,
+	                              uint8_t const *end);
+
+private:
+	std::shared_ptr<std::vector<uint8_t>> chunk;
+	ResourceId chunkId;
+
+	/*!
+	 * Copy as many of the given bytes as will fit into the current
+	 * chunk, without splitting any UTF-8 characters.
+	 *
+	 * \return A pointer just past the last byte which was copied.
+	 */
+	uint8_t const *copyToChunk(uint8_t const *begin, uint8_t const *end);
+};
+}
+}
+}
+
+#endif
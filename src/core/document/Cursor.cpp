@@ -19,7 +19,6 @@
 #include "Cursor.hpp"
 
 #include <cassert>
-#include <type_traits>
 
 namespace qompose
 {
@@ -27,26 +26,32 @@ namespace core
 {
 namespace document
 {
-static_assert(
-        std::is_same<
-                PieceContainer::const_iterator::difference_type,
-                qompose::core::string::Utf8Iterator::difference_type>::value,
-        "Iterators must have the same difference_type.");
-
-Cursor::Cursor() : pieceBegin(), piece(), pieceEnd(), position()
+Cursor::Cursor()
+        : root(nullptr),
+          index(0),
+          piece(nullptr),
+          pieceOffset(),
+          characterOffset(0),
+          position()
 {
 }
 
-Cursor::Cursor(PieceIterator piBegin, PieceIterator pi, PieceIterator piEnd,
+Cursor::Cursor(detail::PieceTreeNode const *r, PieceTree::size_type i,
+               Piece const *p, PieceMetrics const &pOff, std::size_t cOff,
                PositionIterator po)
-        : pieceBegin(piBegin), piece(pi), pieceEnd(piEnd), position(po)
+        : root(r),
+          index(i),
+          piece(p),
+          pieceOffset(pOff),
+          characterOffset(cOff),
+          position(po)
 {
 }
 
 bool Cursor::operator==(Cursor const &o) const
 {
-	return (piece == pieceEnd && o.piece == o.pieceEnd) ||
-	       (piece == o.piece && position == o.position);
+	return (piece == nullptr && o.piece == nullptr) ||
+	       (root == o.root && characterOffset == o.characterOffset);
 }
 
 bool Cursor::operator!=(Cursor const &o) const
@@ -57,23 +62,32 @@ bool Cursor::operator!=(Cursor const &o) const
 Cursor &Cursor::operator++()
 {
 	// Either this is the end cursor, or the current position is valid.
-	assert(piece == pieceEnd || position != piece->end);
+	assert(piece == nullptr || position.getCurrent() != piece->dataEnd());
 
 	// If we are already the end cursor, don't move.
-	if(piece == pieceEnd)
+	if(piece == nullptr)
 		return *this;
 
 	// Increment the position. If we've reached the end of the piece,
 	// move to the next piece and reset the position instead. If there
 	// are no more piece, just reset to being the end cursor instead.
 	++position;
-	if(position == piece->end)
+	++characterOffset;
+	if(position.getCurrent() == piece->dataEnd())
 	{
-		++piece;
-		if(piece == pieceEnd)
+		pieceOffset += piece->metrics;
+		++index;
+		if(index == detail::pieceCount(root))
+		{
+			piece = nullptr;
 			position = PositionIterator();
+		}
 		else
-			position = piece->begin;
+		{
+			piece = &detail::pieceAt(root, index);
+			position = PositionIterator(piece->data(),
+			                            piece->dataEnd());
+		}
 	}
 
 	return *this;
@@ -82,17 +96,20 @@ Cursor &Cursor::operator++()
 Cursor &Cursor::operator--()
 {
 	// If we are already at the first position, don't move.
-	if(piece == pieceBegin && position == piece->begin)
+	if(characterOffset == 0)
 		return *this;
 
-	if((piece == pieceEnd) || (position == piece->begin))
+	if((piece == nullptr) || (position.getCurrent() == piece->data()))
 	{
 		// If this is the end cursor, or the position is already
 		// the first position in the piece, move to the last valid
 		// position in the previous piece instead.
 
-		--piece;
-		position = piece->end;
+		--index;
+		piece = &detail::pieceAt(root, index);
+		pieceOffset -= piece->metrics;
+		position = PositionIterator(piece->data(), piece->dataEnd(),
+		                            piece->dataEnd());
 		--position;
 	}
 	else
@@ -101,6 +118,7 @@ Cursor &Cursor::operator--()
 		// position.
 		--position;
 	}
+	--characterOffset;
 
 	return *this;
 }
@@ -119,6 +137,59 @@ Cursor Cursor::operator--(int)
 	return temp;
 }
 
+Cursor &Cursor::operator+=(difference_type n)
+{
+	assert(n >= 0 || static_cast<std::size_t>(-n) <= characterOffset);
+	moveTo(static_cast<std::size_t>(
+	        static_cast<difference_type>(characterOffset) + n));
+	return *this;
+}
+
+Cursor &Cursor::operator-=(difference_type n)
+{
+	return *this += -n;
+}
+
+Cursor Cursor::operator+(difference_type n) const
+{
+	Cursor temp = *this;
+	temp += n;
+	return temp;
+}
+
+Cursor Cursor::operator-(difference_type n) const
+{
+	Cursor temp = *this;
+	temp -= n;
+	return temp;
+}
+
+Cursor::difference_type Cursor::operator-(Cursor const &o) const
+{
+	return static_cast<difference_type>(characterOffset) -
+	       static_cast<difference_type>(o.characterOffset);
+}
+
+bool Cursor::operator<(Cursor const &o) const
+{
+	return characterOffset < o.characterOffset;
+}
+
+bool Cursor::operator>(Cursor const &o) const
+{
+	return o < *this;
+}
+
+bool Cursor::operator<=(Cursor const &o) const
+{
+	return !(o < *this);
+}
+
+bool Cursor::operator>=(Cursor const &o) const
+{
+	return !(*this < o);
+}
+
 Cursor::reference Cursor::operator*() const
 {
 	return *position;
@@ -129,6 +200,67 @@ Cursor::pointer Cursor::operator->() const
 	return position.operator->();
 }
 
+Cursor::value_type Cursor::operator[](difference_type n) const
+{
+	return *(*this + n);
+}
+
+std::size_t Cursor::getByteOffset() const
+{
+	if(piece == nullptr)
+		return pieceOffset.bytes;
+	return pieceOffset.bytes +
+	       static_cast<std::size_t>(position.getCurrent() - piece->data());
+}
+
+std::size_t Cursor::getCharacterOffset() const
+{
+	return characterOffset;
+}
+
+void Cursor::moveTo(std::size_t offset)
+{
+	uint8_t const *from = nullptr;
+	std::size_t fromOffset = 0;
+
+	if(piece != nullptr && offset >= pieceOffset.characters &&
+	   offset < pieceOffset.characters + piece->metrics.characters)
+	{
+		// Moves within the current piece don't need to search the
+		// tree, and can start scanning from the current position.
+		from = position.getCurrent();
+		fromOffset = characterOffset - pieceOffset.characters;
+	}
+	else
+	{
+		PieceTree::Location location = detail::findPiece(
+		        root, &PieceMetrics::characters, offset);
+		index = location.index;
+		pieceOffset = location.offset;
+		if(index == detail::pieceCount(root))
+		{
+			piece = nullptr;
+			characterOffset = pieceOffset.characters;
+			position = PositionIterator();
+			return;
+		}
+
+		piece = &detail::pieceAt(root, index);
+		from = piece->data();
+	}
+
+	characterOffset = offset;
+	position = PositionIterator(
+	        piece->data(), piece->dataEnd(),
+	        seekCharacter(*piece, from, fromOffset,
+	                      offset - pieceOffset.characters));
+}
+
+Cursor operator+(Cursor::difference_type n, Cursor const &cursor)
+{
+	return cursor + n;
+}
+
 ReverseCursor::ReverseCursor() : preBegin(true), cursor()
 {
 }
@@ -19,9 +19,11 @@
 #ifndef qompose_core_document_Cursor_HPP
 #define qompose_core_document_Cursor_HPP
 
+#include <cstddef>
 #include <iterator>
 
 #include "core/document/Piece.hpp"
+#include "core/document/PieceTree.hpp"
 #include "core/string/Utf8Iterator.hpp"
 
 namespace qompose
@@ -38,17 +40,39 @@ typedef std::iterator<std::bidirectional_iterator_tag,
                       qompose::core::string::Utf8Iterator::pointer,
                       qompose::core::string::Utf8Iterator::reference>
         CursorTraits;
+
+typedef std::iterator<std::random_access_iterator_tag,
+                      qompose::core::string::Utf8Iterator::value_type,
+                      qompose::core::string::Utf8Iterator::difference_type,
+                      qompose::core::string::Utf8Iterator::pointer,
+                      qompose::core::string::Utf8Iterator::reference>
+        RandomAccessCursorTraits;
 }
 
-class Cursor : public detail::CursorTraits
+/*!
+ * \brief A Cursor is an iterator over the characters in a PieceTable.
+ *
+ * Besides its position, a Cursor keeps track of its offset from the
+ * beginning of the document, so converting it to a byte or character
+ * offset, or computing the distance between two Cursors, is O(1).
+ * Cursors are random access iterators: moving a Cursor by N characters is
+ * O(log n) in the number of pieces, plus a bounded scan inside of the
+ * destination piece (which is skipped entirely for ASCII-only pieces).
+ *
+ * A Cursor refers to a particular version of a PieceTable's tree, rather
+ * than to the PieceTable object itself. So, it remains valid in copies of
+ * the table (e.g. in a DocumentHistory), for as long as any of them are
+ * unmodified.
+ */
+class Cursor : public detail::RandomAccessCursorTraits
 {
 public:
-	typedef PieceContainer::const_iterator PieceIterator;
 	typedef qompose::core::string::Utf8Iterator PositionIterator;
 
+	/*!
+	 * Construct an "end" Cursor which does not refer to any PieceTable.
+	 */
 	Cursor();
-	Cursor(PieceIterator piBegin, PieceIterator pi, PieceIterator piEnd,
-	       PositionIterator po);
 
 	Cursor(Cursor const &) = default;
 	Cursor(Cursor &&) = default;
@@ -65,16 +89,77 @@ public:
 	Cursor operator++(int);
 	Cursor operator--(int);
 
+	/*!
+	 * Move this Cursor by the given number of characters. Moving past
+	 * the end of the document produces the end Cursor.
+	 *
+	 * \param n The number of characters to move forward (or backward,
+	 * if it is negative).
+	 * \return This Cursor.
+	 */
+	Cursor &operator+=(difference_type n);
+	Cursor &operator-=(difference_type n);
+
+	Cursor operator+(difference_type n) const;
+	Cursor operator-(difference_type n) const;
+
+	/*!
+	 * Both Cursors must refer to the same version of a PieceTable.
+	 *
+	 * \param o The Cursor to measure from.
+	 * \return The number of characters from o to this Cursor.
+	 */
+	difference_type operator-(Cursor const &o) const;
+
+	bool operator<(Cursor const &o) const;
+	bool operator>(Cursor const &o) const;
+	bool operator<=(Cursor const &o) const;
+	bool operator>=(Cursor const &o) const;
+
 	reference operator*() const;
 	pointer operator->() const;
 
+	/*!
+	 * Return the character n characters after this Cursor. Note that,
+	 * unlike operator*(), this returns the character by value.
+	 *
+	 * \param n The offset of the character to return.
+	 * \return The character at the given offset.
+	 */
+	value_type operator[](difference_type n) const;
+
+	/*!
+	 * \return The offset of this Cursor from the beginning of the
+	 * document, in bytes.
+	 */
+	std::size_t getByteOffset() const;
+
+	/*!
+	 * \return The offset of this Cursor from the beginning of the
+	 * document, in decoded characters.
+	 */
+	std::size_t getCharacterOffset() const;
+
 private:
-	PieceIterator pieceBegin;
-	PieceIterator piece;
-	PieceIterator pieceEnd;
+	friend struct PieceTable;
+
+	detail::PieceTreeNode const *root;
+	PieceTree::size_type index;
+	Piece const *piece;
+	PieceMetrics pieceOffset;
+	std::size_t characterOffset;
 	PositionIterator position;
+
+	Cursor(detail::PieceTreeNode const *r, PieceTree::size_type i,
+	       Piece const *p,
+	       PieceMetrics const &pOff, std::size_t cOff,
+	       PositionIterator po);
+
+	void moveTo(std::size_t offset);
 };
 
+Cursor operator+(Cursor::difference_type n, Cursor const &cursor);
+
 class ReverseCursor : public detail::CursorTraits
 {
 public:
@@ -0,0 +1,235 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DisplayColumns.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "core/string/CharacterWidth.hpp"
+#include "core/string/Utf8Decoder.hpp"
+
+namespace
+{
+/*!
+ * Call the given visitor with each character from the given position up
+ * to (but not including) the end of its line, stopping early if the
+ * visitor returns false.
+ */
+template <typename Visitor>
+void forEachCharacterInLine(qompose::core::document::PieceTable const &pieces,
+                            qompose::core::document::Cursor const &first,
+                            Visitor const &visitor)
+{
+	pieces.forEachSpan(first, pieces.end(), [&visitor](uint8_t const *begin,
+	                                                   uint8_t const *end) {
+		while(begin < end)
+		{
+			uint32_t character = *begin;
+			if(character < 0x80U)
+			{
+				++begin;
+			}
+			else
+			{
+				// Pieces always contain valid UTF-8.
+				qompose::core::string::Utf8DecodeResult result;
+				auto status = qompose::core::string::
+				        decodeUtf8Character(begin, end, result);
+				assert(status == qompose::core::string::
+				                         Utf8DecodeStatus::Ok);
+				(void)status;
+				character = result.value;
+				begin = result.currentEnd;
+			}
+
+			if(character == '\n' || !visitor(character))
+				return false;
+		}
+		return true;
+	});
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+constexpr std::size_t DisplayColumns::CHECKPOINT_INTERVAL;
+constexpr std::size_t DisplayColumns::MAXIMUM_CACHED_LINES;
+
+DisplayColumns::DisplayColumns(std::size_t t)
+        : tabWidth(std::max<std::size_t>(1, t)), table(), lines()
+{
+}
+
+std::size_t DisplayColumns::getTabWidth() const
+{
+	return tabWidth;
+}
+
+void DisplayColumns::setTabWidth(std::size_t t)
+{
+	t = std::max<std::size_t>(1, t);
+	if(t == tabWidth)
+		return;
+	tabWidth = t;
+	lines.clear();
+}
+
+std::size_t DisplayColumns::columnOf(PieceTable const &pieces,
+                                     Cursor const &cursor)
+{
+	Line &line = getLine(pieces, pieces.cursorToLine(cursor));
+	std::size_t target = pieces.cursorToCharacter(cursor) - line.begin;
+	scan(line, [target](std::size_t characters, std::size_t) {
+		return characters >= target;
+	});
+	if(target >= line.scannedCharacters)
+		return line.scannedColumn;
+
+	// The position was scanned before, so start from the nearest
+	// checkpoint before it.
+	std::size_t index = target / CHECKPOINT_INTERVAL;
+	std::size_t column = line.checkpoints[index];
+	std::size_t remaining = target - index * CHECKPOINT_INTERVAL;
+	if(remaining == 0)
+		return column;
+
+	forEachCharacterInLine(
+	        pieces, pieces.characterToCursor(
+	                        line.begin + index * CHECKPOINT_INTERVAL),
+	        [&](uint32_t character) {
+		        column = string::advanceDisplayColumn(column, character,
+		                                              tabWidth);
+		        return --remaining > 0;
+		});
+	return column;
+}
+
+Cursor DisplayColumns::cursorAt(PieceTable const &pieces, std::size_t line,
+                                std::size_t column)
+{
+	Line &l = getLine(pieces, line);
+	scan(l, [column](std::size_t, std::size_t scannedColumn) {
+		return scannedColumn > column;
+	});
+
+	// Every character before the last checkpoint at or before the
+	// column ends at or before the column, so start from there.
+	auto checkpoint = std::upper_bound(l.checkpoints.begin(),
+	                                   l.checkpoints.end(), column) -
+	                  1;
+	std::size_t offset = static_cast<std::size_t>(
+	                             checkpoint - l.checkpoints.begin()) *
+	                     CHECKPOINT_INTERVAL;
+	std::size_t current = *checkpoint;
+
+	forEachCharacterInLine(
+	        pieces, pieces.characterToCursor(l.begin + offset),
+	        [&](uint32_t character) {
+		        if(character == '\r')
+			        return false;
+		        std::size_t next = string::advanceDisplayColumn(
+		                current, character, tabWidth);
+		        if(next > column)
+			        return false;
+		        current = next;
+		        ++offset;
+		        return true;
+		});
+	return pieces.characterToCursor(l.begin + offset);
+}
+
+std::size_t DisplayColumns::lineWidth(PieceTable const &pieces,
+                                      std::size_t line)
+{
+	Line &l = getLine(pieces, line);
+	scan(l, [](std::size_t, std::size_t) { return false; });
+	return l.scannedColumn;
+}
+
+DisplayColumns::Line &DisplayColumns::getLine(PieceTable const &pieces,
+                                              std::size_t line)
+{
+	if(pieces.pieces.getRoot() != table.pieces.getRoot())
+	{
+		// Lines which end before the first piece the two versions
+		// don't share haven't changed (and neither has where they
+		// begin), so only the lines after that need to be rescanned.
+		// Finding that piece is cheap if the versions are related.
+		PieceTree::size_type shared = commonPieceCount(
+		        table.pieces, pieces.pieces, false,
+		        std::min(table.pieces.size(), pieces.pieces.size()));
+		std::size_t unchanged = pieces.pieces.offsetOf(shared).newlines;
+		for(auto it = lines.begin(); it != lines.end();)
+		{
+			if(it->first >= unchanged)
+				it = lines.erase(it);
+			else
+				++it;
+		}
+		table = pieces;
+	}
+
+	auto it = lines.find(line);
+	if(it != lines.end())
+		return it->second;
+
+	if(lines.size() >= MAXIMUM_CACHED_LINES)
+		lines.clear();
+	Line &l = lines[line];
+	l.begin = table.cursorToCharacter(table.lineToCursor(line));
+	l.checkpoints.assign(1, 0);
+	l.scannedCharacters = 0;
+	l.scannedColumn = 0;
+	l.complete = false;
+	return l;
+}
+
+template <typename Predicate>
+void DisplayColumns::scan(Line &line, Predicate const &done)
+{
+	if(line.complete || done(line.scannedCharacters, line.scannedColumn))
+		return;
+
+	bool complete = true;
+	forEachCharacterInLine(
+	        table, table.characterToCursor(line.begin +
+	                                       line.scannedCharacters),
+	        [&](uint32_t character) {
+		        line.scannedColumn = string::advanceDisplayColumn(
+		                line.scannedColumn, character, tabWidth);
+		        if(++line.scannedCharacters % CHECKPOINT_INTERVAL == 0)
+			        line.checkpoints.push_back(line.scannedColumn);
+
+		        if(done(line.scannedCharacters, line.scannedColumn))
+		        {
+			        complete = false;
+			        return false;
+		        }
+		        return true;
+		});
+	line.complete = complete;
+}
+}
+}
+}
@@ -0,0 +1,156 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_document_DisplayColumns_HPP
+#define qompose_core_document_DisplayColumns_HPP
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "core/document/Cursor.hpp"
+#include "core/document/PieceTable.hpp"
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+/*!
+ * \brief DisplayColumns converts between Cursors and display columns.
+ *
+ * A character's display column depends on the width of every character
+ * before it on its line (tabs in particular), so computing it is O(n) in
+ * the length of the line. To avoid rescanning long lines on every cursor
+ * movement, this class remembers the column of every
+ * CHECKPOINT_INTERVAL'th character on the lines it has scanned, so each
+ * query only needs to scan from the nearest checkpoint.
+ *
+ * The checkpoints describe one particular version of a PieceTable. When
+ * a different version is queried, the checkpoints of every line from the
+ * first one which differs between the two versions onwards are discarded
+ * automatically, so it is always safe to query the latest version after
+ * an edit, and the lines before the edit needn't be scanned again.
+ */
+class DisplayColumns
+{
+public:
+	/*!
+	 * The number of characters between checkpoints.
+	 */
+	static constexpr std::size_t CHECKPOINT_INTERVAL = 256;
+
+	/*!
+	 * The maximum number of lines to remember checkpoints for. Once
+	 * this many lines have been scanned, the cache is cleared.
+	 */
+	static constexpr std::size_t MAXIMUM_CACHED_LINES = 4096;
+
+	/*!
+	 * \param t The width of a tab stop, in columns.
+	 */
+	explicit DisplayColumns(std::size_t t = 8);
+
+	DisplayColumns(DisplayColumns const &) = default;
+	DisplayColumns(DisplayColumns &&) = default;
+	DisplayColumns &operator=(DisplayColumns const &) = default;
+	DisplayColumns &operator=(DisplayColumns &&) = default;
+
+	~DisplayColumns() = default;
+
+	std::size_t getTabWidth() const;
+
+	/*!
+	 * Change the width of a tab stop, which discards all checkpoints.
+	 *
+	 * \param t The width of a tab stop, in columns.
+	 */
+	void setTabWidth(std::size_t t);
+
+	/*!
+	 * \param pieces The table the given Cursor refers to.
+	 * \param cursor A position in the table.
+	 * \return The zero-based display column of the given position.
+	 */
+	std::size_t columnOf(PieceTable const &pieces, Cursor const &cursor);
+
+	/*!
+	 * Return the position on the given line which is closest to the
+	 * given display column, without going past it or past the end of
+	 * the line. A '\r' is treated as the end of the line, so a
+	 * position is never returned between a '\r' and a '\n'.
+	 *
+	 * \param pieces The table to search.
+	 * \param line The zero-based line number.
+	 * \param column The zero-based display column.
+	 * \return The closest position on that line.
+	 */
+	Cursor cursorAt(PieceTable const &pieces, std::size_t line,
+	                std::size_t column);
+
+	/*!
+	 * \param pieces The table to search.
+	 * \param line The zero-based line number.
+	 * \return The number of columns needed to display the given line.
+	 */
+	std::size_t lineWidth(PieceTable const &pieces, std::size_t line);
+
+private:
+	struct Line
+	{
+		// The character offset (relative to the whole table) of the
+		// beginning of the line.
+		std::size_t begin;
+		// The column of every CHECKPOINT_INTERVAL'th character.
+		std::vector<std::size_t> checkpoints;
+		// How far into the line we've scanned so far.
+		std::size_t scannedCharacters;
+		std::size_t scannedColumn;
+		bool complete;
+	};
+
+	std::size_t tabWidth;
+
+	// The version of the table our checkpoints describe. Keeping a
+	// copy (which is O(1)) guarantees that its tree isn't reused by
+	// another version while we're holding on to it.
+	PieceTable table;
+	std::unordered_map<std::size_t, Line> lines;
+
+	/*!
+	 * Return the checkpoints for the given line, first discarding the
+	 * checkpoints of any lines which differ if the given table is a
+	 * different version than the one they describe.
+	 */
+	Line &getLine(PieceTable const &pieces, std::size_t line);
+
+	/*!
+	 * Scan more of the given line, recording checkpoints along the
+	 * way, until the given predicate (called with the number of
+	 * characters and columns scanned so far) returns true or the end
+	 * of the line is reached.
+	 */
+	template <typename Predicate>
+	void scan(Line &line, Predicate const &done);
+};
+}
+}
+}
+
+#endif
@@ -18,13 +18,292 @@
 
 #include "DocumentHistory.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <bdrck/fs/TemporaryStorage.hpp>
+
+#include <leveldb/db.h>
+
+#include "core/document/Piece.hpp"
+#include "core/document/PieceTable.hpp"
+#include "core/document/PieceTree.hpp"
+
+#include "DocumentHistory.pb.h"
+
+namespace
+{
+/*!
+ * A rough estimate of the memory used by a single PieceTree node,
+ * including its reference count block.
+ */
+constexpr std::size_t ESTIMATED_NODE_SIZE = 128;
+
+/*!
+ * The number of root-to-leaf paths a typical edit copies: one to split the
+ * piece being edited, and one or two to insert or erase the new pieces.
+ */
+constexpr std::size_t PATHS_PER_EDIT = 3;
+
+/*!
+ * LevelDB buffers this many bytes of writes in memory before flushing them
+ * to disk. We keep it small, since the whole point of the log is to get
+ * entries out of memory.
+ */
+constexpr std::size_t LOG_WRITE_BUFFER_SIZE = 1024 * 1024;
+
+std::size_t estimateCost(qompose::core::document::Document const &document)
+{
+	// An AVL tree with n nodes is at most ~1.44 log2(n) tall.
+	std::size_t depth = 1;
+	for(std::size_t n = document.pieces.pieces.size(); n > 0; n >>= 1)
+		++depth;
+	depth += depth / 2;
+
+	return sizeof(qompose::core::document::DocumentHistory::Entry) +
+	       ESTIMATED_NODE_SIZE * PATHS_PER_EDIT * depth;
+}
+
+/*!
+ * Returns true if the given edit continues the run of edits which produced
+ * the previous snapshot: that is, if it inserted text at (and moved past)
+ * the previous cursor, or removed text immediately before or after it.
+ */
+bool continuesRun(qompose::core::document::Document const &previous,
+                  qompose::core::document::Document const &next,
+                  qompose::core::document::EditKind kind)
+{
+	std::size_t before = previous.pieces.length();
+	std::size_t after = next.pieces.length();
+	std::size_t from = previous.cursor.getCharacterOffset();
+	std::size_t to = next.cursor.getCharacterOffset();
+
+	switch(kind)
+	{
+	case qompose::core::document::EditKind::Insertion:
+		return after > before && to > from &&
+		       to - from == after - before;
+
+	case qompose::core::document::EditKind::Deletion:
+		if(after >= before)
+			return false;
+		return to == from || (to < from && from - to == before - after);
+
+	default:
+		return false;
+	}
+}
+}
+
 namespace qompose
 {
 namespace core
 {
 namespace document
 {
-DocumentHistory::DocumentHistory() : past(), future()
+namespace detail
+{
+/*!
+ * \brief The on-disk log of snapshots spilled out of a DocumentHistory.
+ *
+ * Spilled snapshots form a stack, ordered from oldest to newest. Each one
+ * is stored as the pieces which differ between it and the snapshot which
+ * came after it, so only the newest spilled snapshot can be reloaded, and
+ * only given the snapshot which followed it.
+ *
+ * Only the pieces are written to disk, not the text they refer to. All of
+ * the snapshots share one ResourceTable, which keeps the text alive.
+ */
+class DocumentHistoryLog
+{
+public:
+	DocumentHistoryLog();
+
+	DocumentHistoryLog(DocumentHistoryLog const &) = delete;
+	DocumentHistoryLog(DocumentHistoryLog &&) = delete;
+	DocumentHistoryLog &operator=(DocumentHistoryLog const &) = delete;
+	DocumentHistoryLog &operator=(DocumentHistoryLog &&) = delete;
+
+	~DocumentHistoryLog() = default;
+
+	std::size_t size() const;
+
+	/*!
+	 * Spill a snapshot to the log.
+	 *
+	 * \param older The snapshot to spill.
+	 * \param newer The snapshot which came immediately after it.
+	 */
+	void push(Document const &older, Document const &newer);
+
+	/*!
+	 * Remove the newest spilled snapshot from the log, and return it.
+	 *
+	 * \param newer The snapshot which came immediately after it.
+	 * \return The reconstructed snapshot.
+	 */
+	Document pop(Document const &newer);
+
+private:
+	// The directory must outlive the database stored in it.
+	bdrck::fs::TemporaryStorage directory;
+	std::unique_ptr<leveldb::DB> database;
+	std::size_t count;
+};
+
+DocumentHistoryLog::DocumentHistoryLog()
+        : directory(bdrck::fs::TemporaryStorageType::DIRECTORY),
+          database(),
+          count(0)
+{
+	leveldb::Options options;
+	options.create_if_missing = true;
+	options.write_buffer_size = LOG_WRITE_BUFFER_SIZE;
+
+	leveldb::DB *db = nullptr;
+	leveldb::Status status =
+	        leveldb::DB::Open(options, directory.getPath(), &db);
+	if(!status.ok())
+		throw std::runtime_error(status.ToString());
+	database.reset(db);
+}
+
+std::size_t DocumentHistoryLog::size() const
+{
+	return count;
+}
+
+void DocumentHistoryLog::push(Document const &older, Document const &newer)
+{
+	// Snapshots are usually separated by a single edit, so the pieces
+	// which differ are a short run somewhere in the middle, and the trees
+	// share every subtree on either side of it.
+	PieceTree const &olderTree = older.pieces.pieces;
+	PieceTree const &newerTree = newer.pieces.pieces;
+	std::size_t limit = std::min(olderTree.size(), newerTree.size());
+	std::size_t prefix =
+	        commonPieceCount(olderTree, newerTree, false, limit);
+	std::size_t suffix = commonPieceCount(olderTree, newerTree, true,
+	                                      limit - prefix);
+
+	qompose::core::messages::SpilledHistoryEntry entry;
+	entry.set_first(prefix);
+	entry.set_erased(newerTree.size() - prefix - suffix);
+	entry.set_cursor(older.cursor.getCharacterOffset());
+	ResourceTable const &resources = older.pieces.getResources();
+	std::size_t last = olderTree.size() - suffix;
+	olderTree.forEach(prefix, last, [&](Piece const &piece) {
+		uint8_t const *resource = resources.data(piece.getResource());
+		auto spilled = entry.add_pieces();
+		spilled->set_resource(piece.getResource());
+		spilled->set_offset(
+		        static_cast<uint64_t>(piece.data() - resource));
+		spilled->set_bytes(piece.metrics.bytes);
+		spilled->set_characters(piece.metrics.characters);
+		spilled->set_newlines(piece.metrics.newlines);
+		return true;
+	});
+
+	std::string value;
+	entry.SerializeToString(&value);
+	leveldb::Status status = database->Put(
+	        leveldb::WriteOptions(), std::to_string(count), value);
+	if(!status.ok())
+		throw std::runtime_error(status.ToString());
+	++count;
+}
+
+Document DocumentHistoryLog::pop(Document const &newer)
+{
+	if(count == 0)
+	{
+		throw std::runtime_error(
+		        "No spilled history entries to reload.");
+	}
+
+	std::string key = std::to_string(count - 1);
+	std::string value;
+	leveldb::Status status =
+	        database->Get(leveldb::ReadOptions(), key, &value);
+	if(!status.ok())
+		throw std::runtime_error(status.ToString());
+
+	qompose::core::messages::SpilledHistoryEntry entry;
+	if(!entry.ParseFromString(value))
+		throw std::runtime_error("Corrupt spilled history entry.");
+
+	PieceTable table(newer.pieces);
+	for(uint64_t i = 0; i < entry.erased(); ++i)
+		table.pieces.erase(entry.first());
+
+	PieceTree::size_type index = entry.first();
+	for(auto const &spilled : entry.pieces())
+	{
+		auto id = static_cast<ResourceId>(spilled.resource());
+		uint8_t const *begin =
+		        table.getResources().data(id) + spilled.offset();
+		PieceMetrics metrics(spilled.bytes(), spilled.characters(),
+		                     spilled.newlines());
+		table.pieces.insert(index++, Piece(id, begin,
+		                                   begin + spilled.bytes(),
+		                                   metrics));
+	}
+
+	database->Delete(leveldb::WriteOptions(), key);
+	--count;
+	return Document(table, table.characterToCursor(entry.cursor()));
+}
+}
+
+namespace
+{
+void discard(DocumentHistory &history,
+             std::deque<DocumentHistory::Entry> &entries)
+{
+	for(auto const &entry : entries)
+		history.cost -= entry.cost;
+	entries.clear();
+}
+
+/*!
+ * Spill the oldest snapshots to disk until the history is within its
+ * budget. The present snapshot is always kept in memory.
+ */
+void enforceBudget(DocumentHistory &history)
+{
+	while(history.cost > history.budget && history.past.size() > 1)
+	{
+		if(!history.log)
+			history.log.reset(new detail::DocumentHistoryLog());
+		history.log->push(history.past[0].document,
+		                  history.past[1].document);
+		history.cost -= history.past.front().cost;
+		history.past.pop_front();
+	}
+}
+
+void reload(DocumentHistory &history)
+{
+	Document document = history.log->pop(history.past.front().document);
+	std::size_t cost = estimateCost(document);
+	history.past.push_front({document, cost});
+	history.cost += cost;
+}
+}
+
+DocumentHistory::DocumentHistory(std::size_t b)
+        : past(), future(), budget(b), cost(0), run(EditKind::Other), log()
+{
+}
+
+DocumentHistory::DocumentHistory(DocumentHistory &&) = default;
+DocumentHistory &DocumentHistory::operator=(DocumentHistory &&) = default;
+
+DocumentHistory::~DocumentHistory()
 {
 }
 
@@ -32,30 +311,66 @@ boost::optional<Document> present(DocumentHistory &history)
 {
 	if(history.past.empty())
 		return boost::none;
-	return history.past.top();
+	return history.past.back().document;
+}
+
+std::size_t undoDepth(DocumentHistory const &history)
+{
+	return history.past.size() + (!!history.log ? history.log->size() : 0);
 }
 
 void undo(DocumentHistory &history)
 {
 	if(history.past.empty())
 		return;
-	history.future.push(history.past.top());
-	history.past.pop();
+	if(history.past.size() == 1 && !!history.log && history.log->size() > 0)
+		reload(history);
+
+	history.future.push_back(std::move(history.past.back()));
+	history.past.pop_back();
+	history.run = EditKind::Other;
 }
 
 void redo(DocumentHistory &history)
 {
 	if(history.future.empty())
 		return;
-	history.past.push(history.future.top());
-	history.future.pop();
+	history.past.push_back(std::move(history.future.back()));
+	history.future.pop_back();
+	history.run = EditKind::Other;
+}
+
+void discardSpilled(DocumentHistory &history)
+{
+	history.log.reset();
 }
 
-void push(DocumentHistory &history, Document const &document)
+void push(DocumentHistory &history, Document const &document, EditKind kind)
 {
-	while(!history.future.empty())
-		history.future.pop();
-	history.past.push(document);
+	discard(history, history.future);
+
+	if(kind != EditKind::Other && kind == history.run &&
+	   !history.past.empty() &&
+	   continuesRun(history.past.back().document, document, kind))
+	{
+		// The newest spilled entry is stored as a diff against the
+		// present one, so it has to be reloaded (and then re-spilled
+		// against the extended entry) before the present one changes.
+		if(history.past.size() == 1 && !!history.log &&
+		   history.log->size() > 0)
+		{
+			reload(history);
+		}
+		history.past.back().document = document;
+		enforceBudget(history);
+		return;
+	}
+
+	std::size_t cost = estimateCost(document);
+	history.past.push_back({document, cost});
+	history.cost += cost;
+	history.run = kind;
+	enforceBudget(history);
 }
 }
 }
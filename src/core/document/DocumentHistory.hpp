@@ -19,7 +19,9 @@
 #ifndef qompose_core_document_DocumentHistory_HPP
 #define qompose_core_document_DocumentHistory_HPP
 
-#include <stack>
+#include <cstddef>
+#include <deque>
+#include <memory>
 
 #include <boost/optional/optional.hpp>
 
@@ -31,26 +33,107 @@ namespace core
 {
 namespace document
 {
+/*!
+ * By default, a DocumentHistory keeps roughly this many bytes of snapshots
+ * in memory before it starts spilling the oldest ones to disk.
+ */
+constexpr std::size_t DEFAULT_HISTORY_BUDGET = 64 * 1024 * 1024;
+
+/*!
+ * \brief This enumeration denotes the kind of edit which produced a
+ * Document pushed onto a DocumentHistory.
+ *
+ * Consecutive edits of the same kind which continue at the cursor (i.e.,
+ * a run of typing or of backspacing) are coalesced into a single entry,
+ * so they are undone all at once.
+ */
+enum class EditKind
+{
+	Other,
+	Insertion,
+	Deletion
+};
+
+namespace detail
+{
+class DocumentHistoryLog;
+}
+
+/*!
+ * \brief A DocumentHistory is a stack of Document snapshots.
+ *
+ * Because PieceTables are persistent, pushing a snapshot doesn't copy the
+ * document's pieces; each snapshot only costs the tree nodes which are not
+ * shared with its neighbors, which is O(log n) per edit between them.
+ *
+ * The history tries to keep the estimated cost of its snapshots within a
+ * byte budget. When pushing a snapshot exceeds it, the oldest snapshots
+ * are spilled to an on-disk log, each one stored as the difference between
+ * it and the next newer snapshot. Undoing past the oldest snapshot in
+ * memory transparently reloads them.
+ */
 struct DocumentHistory
 {
-	std::stack<Document> past;
-	std::stack<Document> future;
+	struct Entry
+	{
+		Document document;
+		// The estimated number of bytes this entry keeps alive.
+		std::size_t cost;
+	};
 
-	DocumentHistory();
+	std::deque<Entry> past;
+	std::deque<Entry> future;
+
+	std::size_t budget;
+	std::size_t cost;
+
+	// The kind of the edit run which the next push may extend, or
+	// EditKind::Other if it must start a new entry.
+	EditKind run;
+
+	std::unique_ptr<detail::DocumentHistoryLog> log;
+
+	explicit DocumentHistory(std::size_t b = DEFAULT_HISTORY_BUDGET);
 
 	DocumentHistory(DocumentHistory const &) = delete;
-	DocumentHistory(DocumentHistory &&) = default;
+	DocumentHistory(DocumentHistory &&);
 	DocumentHistory &operator=(DocumentHistory const &) = delete;
-	DocumentHistory &operator=(DocumentHistory &&) = default;
+	DocumentHistory &operator=(DocumentHistory &&);
 
-	~DocumentHistory() = default;
+	~DocumentHistory();
 };
 
 boost::optional<Document> present(DocumentHistory &history);
 
+/*!
+ * \return The number of snapshots which can be undone, including those
+ * which have been spilled to disk.
+ */
+std::size_t undoDepth(DocumentHistory const &history);
+
 void undo(DocumentHistory &history);
 void redo(DocumentHistory &history);
-void push(DocumentHistory &history, Document const &document);
+
+/*!
+ * Discard the snapshots which have been spilled to disk, so they can no
+ * longer be undone. Spilled snapshots can't be updated in place, so this
+ * is needed if the text their pieces refer to has changed.
+ *
+ * \param history The history to modify.
+ */
+void discardSpilled(DocumentHistory &history);
+
+/*!
+ * Push a new snapshot onto the history, discarding any snapshots which
+ * could have been redone. If the snapshot continues the current run of
+ * edits of the same kind, it replaces the previous snapshot instead.
+ *
+ * \param history The history to modify.
+ * \param document The new snapshot.
+ * \param kind The kind of edit which produced the new snapshot.
+ */
+void push(DocumentHistory &history, Document const &document,
+          EditKind kind = EditKind::Other);
 }
 }
 }
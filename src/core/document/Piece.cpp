@@ -0,0 +1,253 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Piece.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+
+#include "core/document/TextScanner.hpp"
+#include "core/string/Utf8Count.hpp"
+
+namespace
+{
+bool isUtf8ContinuationByte(uint8_t byte)
+{
+	return (byte & 0xC0U) == 0x80U;
+}
+
+/*!
+ * Find a good place to end a piece which starts at begin. The returned
+ * pointer is at most MAXIMUM_PIECE_SIZE bytes after begin, and it is
+ * moved backwards as needed so it doesn't split a UTF-8 character.
+ */
+uint8_t const *findPieceEnd(uint8_t const *begin, uint8_t const *end)
+{
+	if(static_cast<std::size_t>(end - begin) <=
+	   qompose::core::document::MAXIMUM_PIECE_SIZE)
+	{
+		return end;
+	}
+
+	uint8_t const *pieceEnd =
+	        begin + qompose::core::document::MAXIMUM_PIECE_SIZE;
+	while(pieceEnd > begin && isUtf8ContinuationByte(*pieceEnd))
+		--pieceEnd;
+
+	// If the data is so malformed that there is no character boundary
+	// at all, just split it anyway; decoding it will fail later.
+	if(pieceEnd == begin)
+		pieceEnd = begin + qompose::core::document::MAXIMUM_PIECE_SIZE;
+	return pieceEnd;
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+PieceMetrics::PieceMetrics() : bytes(0), characters(0), newlines(0)
+{
+}
+
+PieceMetrics::PieceMetrics(std::size_t b, std::size_t c, std::size_t n)
+        : bytes(b), characters(c), newlines(n)
+{
+}
+
+bool PieceMetrics::operator==(PieceMetrics const &o) const
+{
+	return bytes == o.bytes && characters == o.characters &&
+	       newlines == o.newlines;
+}
+
+bool PieceMetrics::operator!=(PieceMetrics const &o) const
+{
+	return !(*this == o);
+}
+
+PieceMetrics &PieceMetrics::operator+=(PieceMetrics const &o)
+{
+	bytes += o.bytes;
+	characters += o.characters;
+	newlines += o.newlines;
+	return *this;
+}
+
+PieceMetrics &PieceMetrics::operator-=(PieceMetrics const &o)
+{
+	bytes -= o.bytes;
+	characters -= o.characters;
+	newlines -= o.newlines;
+	return *this;
+}
+
+PieceMetrics operator+(PieceMetrics a, PieceMetrics const &b)
+{
+	a += b;
+	return a;
+}
+
+PieceMetrics operator-(PieceMetrics a, PieceMetrics const &b)
+{
+	a -= b;
+	return a;
+}
+
+Piece::Piece(ResourceId r, uint8_t const *b, uint8_t const *e)
+        : bytes(b), resource(r), metrics()
+{
+	// Validate and measure the bytes in a single pass.
+	TextStatistics statistics = scanText(b, e, false);
+	if(!statistics.valid)
+		throw std::runtime_error("Invalid UTF-8 piece.");
+	metrics.bytes = statistics.bytes;
+	metrics.characters = statistics.characters;
+	metrics.newlines = statistics.lineFeeds + statistics.crlfs;
+}
+
+Piece::Piece(ResourceId r, uint8_t const *b, uint8_t const *,
+             PieceMetrics const &m)
+        : bytes(b), resource(r), metrics(m)
+{
+}
+
+ResourceId Piece::getResource() const
+{
+	return resource;
+}
+
+uint8_t const *Piece::data() const
+{
+	return bytes;
+}
+
+uint8_t const *Piece::dataEnd() const
+{
+	return data() + metrics.bytes;
+}
+
+std::pair<Piece, Piece> split(Piece const &piece, uint8_t const *position)
+{
+	assert(position > piece.data());
+	assert(position < piece.dataEnd());
+
+	// The piece's bytes were already validated when it was constructed,
+	// so we can count characters without decoding them.
+	PieceMetrics prefix;
+	prefix.bytes = static_cast<std::size_t>(position - piece.data());
+	prefix.characters = qompose::core::string::countUtf8Characters(
+	        piece.data(), position);
+	prefix.newlines = static_cast<std::size_t>(
+	        std::count(piece.data(), position, '\n'));
+
+	return std::make_pair(Piece(piece.getResource(), piece.data(),
+	                            position, prefix),
+	                      Piece(piece.getResource(), position,
+	                            piece.dataEnd(), piece.metrics - prefix));
+}
+
+uint8_t const *seekCharacter(Piece const &piece, uint8_t const *from,
+                             std::size_t fromOffset, std::size_t offset)
+{
+	assert(offset <= piece.metrics.characters);
+
+	// In a piece which is entirely ASCII, characters are bytes.
+	if(piece.metrics.characters == piece.metrics.bytes)
+		return piece.data() + offset;
+
+	auto distance = [offset](std::size_t o) {
+		return o > offset ? o - offset : offset - o;
+	};
+	if(distance(0) < distance(fromOffset))
+	{
+		from = piece.data();
+		fromOffset = 0;
+	}
+	if(distance(piece.metrics.characters) < distance(fromOffset))
+	{
+		from = piece.dataEnd();
+		fromOffset = piece.metrics.characters;
+	}
+
+	// Pieces are known to contain valid UTF-8, so we only need to skip
+	// over continuation bytes to move from one character to the next.
+	for(; fromOffset < offset; ++fromOffset)
+	{
+		++from;
+		while(from < piece.dataEnd() && isUtf8ContinuationByte(*from))
+			++from;
+	}
+	for(; fromOffset > offset; --fromOffset)
+	{
+		--from;
+		while(from > piece.data() && isUtf8ContinuationByte(*from))
+			--from;
+	}
+	return from;
+}
+
+std::vector<Piece> makePieces(ResourceId resource, uint8_t const *begin,
+                              uint8_t const *end)
+{
+	std::vector<Piece> pieces;
+	while(begin < end)
+	{
+		uint8_t const *pieceEnd = findPieceEnd(begin, end);
+		pieces.emplace_back(resource, begin, pieceEnd);
+		begin = pieceEnd;
+	}
+	return pieces;
+}
+
+std::vector<Piece> makePieces(ResourceId resource, uint8_t const *begin,
+                              uint8_t const *end, TextScanner &scanner)
+{
+	std::vector<Piece> pieces;
+	while(begin < end)
+	{
+		uint8_t const *pieceEnd = findPieceEnd(begin, end);
+		TextStatistics const &statistics = scanner.getStatistics();
+		PieceMetrics before(statistics.bytes, statistics.characters,
+		                    statistics.lineFeeds + statistics.crlfs);
+		scanner.scan(begin, pieceEnd);
+
+		// If the piece ended with an incomplete character, the
+		// scanner is still waiting for the rest of it.
+		PieceMetrics metrics =
+		        PieceMetrics(statistics.bytes, statistics.characters,
+		                     statistics.lineFeeds + statistics.crlfs) -
+		        before;
+		if(!statistics.valid ||
+		   metrics.bytes != static_cast<std::size_t>(pieceEnd - begin))
+		{
+			throw std::runtime_error("Invalid UTF-8 piece.");
+		}
+
+		pieces.emplace_back(resource, begin, pieceEnd, metrics);
+		begin = pieceEnd;
+	}
+	return pieces;
+}
+}
+}
+}
@@ -19,9 +19,12 @@
 #ifndef qompose_core_document_Piece_HPP
 #define qompose_core_document_Piece_HPP
 
-#include <list>
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
+#include "core/document/ResourceTable.hpp"
 #include "core/string/Utf8Iterator.hpp"
 
 namespace qompose
@@ -30,6 +33,16 @@ namespace core
 {
 namespace document
 {
+class TextScanner;
+
+/*!
+ * Pieces are never made larger than this many bytes. Resources which are
+ * larger than this are split into several pieces, so any operation which
+ * has to look inside of a single piece (e.g. finding the Nth character in
+ * it) does a bounded amount of work.
+ */
+constexpr std::size_t MAXIMUM_PIECE_SIZE = 64 * 1024;
+
 template <typename TextResource>
 qompose::core::string::Utf8Iterator
 beginIteratorFrom(TextResource const &resource)
@@ -47,12 +60,47 @@ endIteratorFrom(TextResource const &resource)
 	        resource.data() + resource.size());
 }
 
+/*!
+ * \brief PieceMetrics are the cached measurements of some text.
+ *
+ * Each Piece knows its own metrics, and the PieceTree caches the sum of
+ * the metrics of every subtree, so offsets can be found in O(log n) time.
+ * Lines are delimited by '\n' characters, so "\r\n" line endings are
+ * counted once.
+ */
+struct PieceMetrics
+{
+	std::size_t bytes;
+	std::size_t characters;
+	std::size_t newlines;
+
+	PieceMetrics();
+	PieceMetrics(std::size_t b, std::size_t c, std::size_t n);
+
+	PieceMetrics(PieceMetrics const &) = default;
+	PieceMetrics(PieceMetrics &&) = default;
+	PieceMetrics &operator=(PieceMetrics const &) = default;
+	PieceMetrics &operator=(PieceMetrics &&) = default;
+
+	~PieceMetrics() = default;
+
+	bool operator==(PieceMetrics const &o) const;
+	bool operator!=(PieceMetrics const &o) const;
+
+	PieceMetrics &operator+=(PieceMetrics const &o);
+	PieceMetrics &operator-=(PieceMetrics const &o);
+};
+
+PieceMetrics operator+(PieceMetrics a, PieceMetrics const &b);
+PieceMetrics operator-(PieceMetrics a, PieceMetrics const &b);
+
 /*!
  * \brief A Piece is a text segment within a piece table.
  *
- * Pieces own a reference-counted instance of the underlying text data.
- * The underlying data is not copied when Pieces are copied, so copies are
- * relatively cheap.
+ * Pieces don't own the text they refer to; it is owned by the document's
+ * ResourceTable, and each piece just records which resource its bytes
+ * belong to. This keeps pieces small and trivially copyable, so piece
+ * trees are compact and copying pieces involves no reference counting.
  *
  * The Concept both Piece and PieceTable rely upon to denote the
  * underlying data is a TextResource. This concept is any type which
@@ -66,15 +114,36 @@ endIteratorFrom(TextResource const &resource)
 class Piece
 {
 private:
-	std::shared_ptr<void> resource;
+	uint8_t const *bytes;
+	ResourceId resource;
 
 public:
-	qompose::core::string::Utf8Iterator begin;
-	qompose::core::string::Utf8Iterator end;
+	PieceMetrics metrics;
+
+	/*!
+	 * Construct a new piece referring to the given range of bytes,
+	 * which must belong to the given resource. The bytes are decoded
+	 * once in order to compute the piece's metrics, so this will throw
+	 * if they are not valid UTF-8.
+	 *
+	 * \param r The resource which the given bytes belong to.
+	 * \param b The begin pointer for the piece's bytes.
+	 * \param e The end pointer for the piece's bytes.
+	 */
+	Piece(ResourceId r, uint8_t const *b, uint8_t const *e);
 
-	template <typename TextResource>
-	Piece(TextResource &&r, qompose::core::string::Utf8Iterator b,
-	      qompose::core::string::Utf8Iterator e);
+	/*!
+	 * Construct a new piece whose metrics are already known. This does
+	 * not decode or validate the piece's bytes at all, so it is up to
+	 * the caller to make sure the given metrics are correct.
+	 *
+	 * \param r The resource which the given bytes belong to.
+	 * \param b The begin pointer for the piece's bytes.
+	 * \param e The end pointer for the piece's bytes.
+	 * \param m The metrics of the given bytes.
+	 */
+	Piece(ResourceId r, uint8_t const *b, uint8_t const *e,
+	      PieceMetrics const &m);
 
 	Piece(Piece const &) = default;
 	Piece(Piece &&) = default;
@@ -82,18 +151,76 @@ public:
 	Piece &operator=(Piece &&) = default;
 
 	~Piece() = default;
+
+	/*!
+	 * \return The resource which this piece's bytes belong to.
+	 */
+	ResourceId getResource() const;
+
+	/*!
+	 * \return A pointer to the first byte in this piece.
+	 */
+	uint8_t const *data() const;
+
+	/*!
+	 * \return A pointer just past the last byte in this piece.
+	 */
+	uint8_t const *dataEnd() const;
 };
 
-template <typename TextResource>
-Piece::Piece(TextResource &&r, qompose::core::string::Utf8Iterator b,
-             qompose::core::string::Utf8Iterator e)
-        : resource(std::make_shared<TextResource>(std::move(r))),
-          begin(b),
-          end(e)
-{
-}
+/*!
+ * Split the given piece into two pieces, at the given position. The
+ * position must be the beginning of a character inside the piece, and it
+ * must not be the first character (or else one of the pieces would be
+ * empty).
+ *
+ * \param piece The piece to split.
+ * \param position The first byte of the second resulting piece.
+ * \return The two pieces which, in order, make up the original piece.
+ */
+std::pair<Piece, Piece> split(Piece const &piece, uint8_t const *position);
+
+/*!
+ * Find a character inside of the given piece, without decoding the piece.
+ * Pieces which only contain ASCII are indexed directly; otherwise, the
+ * search starts from whichever of the piece's beginning, its end, or the
+ * given known character is closest to the desired character.
+ *
+ * \param piece The piece to search.
+ * \param from The first byte of some character in the piece, or its end.
+ * \param fromOffset The offset of that character within the piece.
+ * \param offset The offset of the character to find within the piece.
+ * \return A pointer to the first byte of the desired character.
+ */
+uint8_t const *seekCharacter(Piece const &piece, uint8_t const *from,
+                             std::size_t fromOffset, std::size_t offset);
 
-typedef std::list<Piece> PieceContainer;
+/*!
+ * Split the given range of bytes into pieces, none of which are larger
+ * than MAXIMUM_PIECE_SIZE. Pieces are only split on UTF-8 character
+ * boundaries.
+ *
+ * \param resource The resource which the given bytes belong to.
+ * \param begin The begin pointer for the range.
+ * \param end The end pointer for the range.
+ * \return The pieces which, in order, make up the given range.
+ */
+std::vector<Piece> makePieces(ResourceId resource, uint8_t const *begin,
+                              uint8_t const *end);
+
+/*!
+ * Split the given range of bytes into pieces, as above, but measure them
+ * using the given scanner, so that statistics for the whole text (which
+ * may span several calls) are computed in the same pass.
+ *
+ * \param resource The resource which the given bytes belong to.
+ * \param begin The begin pointer for the range.
+ * \param end The end pointer for the range.
+ * \param scanner The scanner to measure the pieces with.
+ * \return The pieces which, in order, make up the given range.
+ */
+std::vector<Piece> makePieces(ResourceId resource, uint8_t const *begin,
+                              uint8_t const *end, TextScanner &scanner);
 }
 }
 }
@@ -18,24 +18,72 @@
 
 #include "PieceTable.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+
+#include "core/string/Utf8Count.hpp"
+
+namespace
+{
+bool isUtf8ContinuationByte(uint8_t byte)
+{
+	return (byte & 0xC0U) == 0x80U;
+}
+}
+
 namespace qompose
 {
 namespace core
 {
 namespace document
 {
+PieceTable::PieceTable()
+        : pieces(),
+          resources(std::make_shared<ResourceTable>()),
+          addBuffer(std::make_shared<AddBuffer>())
+{
+}
+
+PieceTable::size_type PieceTable::dataSize() const
+{
+	return pieces.getMetrics().bytes;
+}
+
+PieceTable::size_type PieceTable::length() const
+{
+	return pieces.getMetrics().characters;
+}
+
+bool PieceTable::empty() const
+{
+	return pieces.empty();
+}
+
+PieceTable::size_type PieceTable::lineCount() const
+{
+	return pieces.getMetrics().newlines + 1;
+}
+
+ResourceTable const &PieceTable::getResources() const
+{
+	return *resources;
+}
+
 Cursor PieceTable::begin() const
 {
-	auto beginPiece = pieces.begin();
-	auto endPiece = pieces.end();
-	return Cursor(beginPiece, beginPiece, endPiece,
-	              beginPiece == endPiece ? Cursor::PositionIterator()
-	                                     : beginPiece->begin);
+	if(pieces.empty())
+		return end();
+	Piece const &first = pieces[0];
+	return Cursor(pieces.getRoot(), 0, &first, PieceMetrics(), 0,
+	              Cursor::PositionIterator(first.data(), first.dataEnd()));
 }
 
 Cursor PieceTable::end() const
 {
-	return Cursor(pieces.begin(), pieces.end(), pieces.end(),
+	return Cursor(pieces.getRoot(), pieces.size(), nullptr,
+	              pieces.getMetrics(), length(),
 	              Cursor::PositionIterator());
 }
 
@@ -48,6 +96,248 @@ ReverseCursor PieceTable::rend() const
 {
 	return ReverseCursor(begin());
 }
+
+Cursor PieceTable::byteToCursor(size_type offset) const
+{
+	if(offset >= dataSize())
+		return end();
+
+	PieceTree::Location location =
+	        pieces.find(&PieceMetrics::bytes, offset);
+	Piece const &piece = pieces[location.index];
+
+	// If the offset is in the middle of a character, move back to the
+	// beginning of that character.
+	uint8_t const *position =
+	        piece.data() + (offset - location.offset.bytes);
+	while(position > piece.data() && isUtf8ContinuationByte(*position))
+		--position;
+
+	return cursorAt(location, position);
+}
+
+Cursor PieceTable::characterToCursor(size_type offset) const
+{
+	if(offset >= length())
+		return end();
+
+	PieceTree::Location location =
+	        pieces.find(&PieceMetrics::characters, offset);
+	Piece const &piece = pieces[location.index];
+
+	uint8_t const *position = seekCharacter(
+	        piece, piece.data(), 0, offset - location.offset.characters);
+	return Cursor(pieces.getRoot(), location.index, &piece, location.offset,
+	              offset, Cursor::PositionIterator(
+	                              piece.data(), piece.dataEnd(), position));
+}
+
+PieceTable::size_type PieceTable::cursorToByte(Cursor const &cursor) const
+{
+	return cursor.getByteOffset();
+}
+
+PieceTable::size_type
+PieceTable::cursorToCharacter(Cursor const &cursor) const
+{
+	return cursor.getCharacterOffset();
+}
+
+Cursor PieceTable::lineToCursor(size_type line) const
+{
+	if(line == 0)
+		return begin();
+	if(line >= lineCount())
+		return end();
+
+	// Find the piece containing the newline which ends the previous
+	// line, and then search for that newline inside the piece.
+	PieceTree::Location location =
+	        pieces.find(&PieceMetrics::newlines, line - 1);
+	Piece const &piece = pieces[location.index];
+
+	uint8_t const *position = piece.data();
+	uint8_t const *pieceEnd = piece.data() + piece.metrics.bytes;
+	for(size_type n = location.offset.newlines; n < line; ++n)
+	{
+		position = static_cast<uint8_t const *>(std::memchr(
+		        position, '\n',
+		        static_cast<std::size_t>(pieceEnd - position)));
+		assert(position != nullptr);
+		++position;
+	}
+
+	return cursorAt(location, position);
+}
+
+PieceTable::size_type PieceTable::cursorToLine(Cursor const &cursor) const
+{
+	if(cursor.piece == nullptr)
+		return cursor.pieceOffset.newlines;
+	return cursor.pieceOffset.newlines +
+	       static_cast<size_type>(std::count(cursor.piece->data(),
+	                                         cursor.position.getCurrent(),
+	                                         '\n'));
+}
+
+bool PieceTable::forEachSpan(Cursor const &first, Cursor const &last,
+                             SpanVisitor const &visitor) const
+{
+	assert(first.root == pieces.getRoot() || first.piece == nullptr);
+	assert(last.root == pieces.getRoot() || last.piece == nullptr);
+
+	if(first.piece == nullptr || !(first < last))
+		return true;
+
+	uint8_t const *firstByte = first.position.getCurrent();
+	uint8_t const *lastByte =
+	        last.piece != nullptr ? last.position.getCurrent() : nullptr;
+	PieceTree::size_type lastIndex =
+	        last.piece != nullptr ? last.index + 1 : pieces.size();
+
+	PieceTree::size_type index = first.index;
+	return pieces.forEach(first.index, lastIndex, [&](Piece const &piece) {
+		uint8_t const *begin =
+		        index == first.index ? firstByte : piece.data();
+		uint8_t const *end = index == last.index && lastByte != nullptr
+		                             ? lastByte
+		                             : piece.dataEnd();
+		++index;
+		return begin == end || visitor(begin, end);
+	});
+}
+
+bool PieceTable::forEachSpan(SpanVisitor const &visitor) const
+{
+	return forEachSpan(begin(), end(), visitor);
+}
+
+bool PieceTable::forEachLineSpan(size_type first, size_type last,
+                                 SpanVisitor const &visitor) const
+{
+	last = std::min(last, lineCount());
+	if(first >= last)
+		return true;
+
+	// Each line after the first starts in the piece containing the
+	// newline which ends the line before it, and ends in the piece
+	// containing its own newline (or the last piece).
+	PieceTree::size_type firstIndex = 0;
+	if(first > 0)
+	{
+		firstIndex =
+		        pieces.find(&PieceMetrics::newlines, first - 1).index;
+	}
+	PieceTree::size_type lastIndex =
+	        pieces.find(&PieceMetrics::newlines, last - 1).index + 1;
+	return pieces.forEach(firstIndex, lastIndex, [&](Piece const &piece) {
+		return visitor(piece.data(), piece.dataEnd());
+	});
+}
+
+Cursor PieceTable::insert(Cursor const &position,
+                          qompose::core::string::Utf8StringRef const &text)
+{
+	assert(position.root == pieces.getRoot() || position.piece == nullptr);
+
+	size_type offset = position.getCharacterOffset();
+	if(text.empty())
+		return characterToCursor(offset);
+
+	PieceTree::size_type index =
+	        splitAt(offset, position.position.getCurrent());
+	uint8_t const *textBegin = text.data();
+	uint8_t const *textEnd = text.data() + text.dataSize();
+
+	// If we're inserting right after the last text inserted, just
+	// extend that piece instead of adding a new one.
+	boost::optional<Piece> extended;
+	if(index > 0)
+	{
+		extended = addBuffer->extend(pieces[index - 1], textBegin,
+		                             textEnd);
+	}
+
+	if(!!extended)
+	{
+		pieces.replace(index - 1, *extended);
+	}
+	else
+	{
+		auto appended =
+		        addBuffer->append(*resources, textBegin, textEnd);
+		for(auto const &piece : appended)
+			pieces.insert(index++, piece);
+	}
+
+	return characterToCursor(offset);
+}
+
+Cursor PieceTable::erase(Cursor const &first, Cursor const &last)
+{
+	assert(first.root == pieces.getRoot() || first.piece == nullptr);
+	assert(last.root == pieces.getRoot() || last.piece == nullptr);
+
+	size_type firstOffset = first.getCharacterOffset();
+	size_type lastOffset = last.getCharacterOffset();
+	if(firstOffset < lastOffset)
+	{
+		// Split at the end of the range first, so the first
+		// Cursor's offset remains valid afterwards.
+		splitAt(lastOffset, last.position.getCurrent());
+		PieceTree::size_type firstIndex =
+		        splitAt(firstOffset, first.position.getCurrent());
+		PieceTree::size_type lastIndex =
+		        pieces.find(&PieceMetrics::characters, lastOffset)
+		                .index;
+
+		for(auto index = firstIndex; index < lastIndex; ++index)
+			pieces.erase(firstIndex);
+	}
+
+	return characterToCursor(firstOffset);
+}
+
+Cursor PieceTable::cursorAt(PieceTree::Location const &location,
+                            uint8_t const *position) const
+{
+	Piece const &piece = pieces[location.index];
+	uint8_t const *pieceEnd = piece.data() + piece.metrics.bytes;
+	if(position == pieceEnd)
+	{
+		PieceTree::Location next{location.index + 1,
+		                         location.offset + piece.metrics};
+		if(next.index == pieces.size())
+			return end();
+		return cursorAt(next, pieces[next.index].data());
+	}
+
+	// Pieces are known to contain valid UTF-8, so we can count the
+	// characters before the position without decoding them.
+	size_type characters = qompose::core::string::countUtf8Characters(
+	        piece.data(), position);
+	return Cursor(pieces.getRoot(), location.index, &piece, location.offset,
+	              location.offset.characters + characters,
+	              Cursor::PositionIterator(piece.data(), pieceEnd,
+	                                       position));
+}
+
+PieceTree::size_type PieceTable::splitAt(size_type offset,
+                                         uint8_t const *position)
+{
+	if(offset >= length())
+		return pieces.size();
+
+	PieceTree::Location location =
+	        pieces.find(&PieceMetrics::characters, offset);
+	if(location.offset.characters == offset)
+		return location.index;
+
+	auto halves = split(pieces[location.index], position);
+	pieces.replace(location.index, halves.first);
+	pieces.insert(location.index + 1, halves.second);
+	return location.index + 1;
+}
 }
 }
 }
@@ -19,10 +19,20 @@
 #ifndef qompose_core_document_PieceTable_HPP
 #define qompose_core_document_PieceTable_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "core/document/AddBuffer.hpp"
 #include "core/document/Cursor.hpp"
 #include "core/document/Piece.hpp"
+#include "core/document/PieceTree.hpp"
+#include "core/document/ResourceTable.hpp"
+#include "core/string/Utf8StringRef.hpp"
 
 namespace qompose
 {
@@ -30,36 +40,331 @@ namespace core
 {
 namespace document
 {
+/*!
+ * \brief A PieceTable is a sequence of characters, made up of pieces of
+ * one or more TextResources.
+ *
+ * The pieces are stored in a balanced tree, so converting between
+ * offsets or line numbers and Cursors is O(log n) in the number of pieces.
+ * Line numbers start at zero, and lines are delimited by '\n' characters.
+ *
+ * PieceTables are persistent, so copying one is O(1): the copy shares the
+ * original's PieceTree, and each subsequent modification to either of
+ * them copies only the O(log n) tree nodes it touches.
+ *
+ * Text inserted into a PieceTable is appended to an AddBuffer, which is
+ * shared between copies of the table. Since it is append-only, this is
+ * safe even if the copies are modified independently.
+ */
 struct PieceTable
 {
 	typedef Cursor iterator;
 	typedef Cursor const_iterator;
 	typedef ReverseCursor reverse_iterator;
 	typedef ReverseCursor const_reverse_iterator;
+	typedef std::size_t size_type;
+
+	/*!
+	 * A SpanVisitor is called with the begin and end pointers of a
+	 * contiguous range of UTF-8 bytes. It returns false to stop the
+	 * iteration early.
+	 */
+	typedef std::function<bool(uint8_t const *, uint8_t const *)>
+	        SpanVisitor;
+
+	PieceTree pieces;
 
-	PieceContainer pieces;
+	/*!
+	 * Construct an empty piece table.
+	 */
+	PieceTable();
 
-	template <typename TextResource> PieceTable(TextResource &&resource);
+	/*!
+	 * Construct a piece table whose contents are the given resource.
+	 * This is disabled for PieceTables themselves, so it doesn't hide
+	 * the copy constructor for non-const tables.
+	 *
+	 * \param resource The TextResource to take ownership of.
+	 */
+	template <typename TextResource,
+	          typename = typename std::enable_if<!std::is_same<
+	                  typename std::decay<TextResource>::type,
+	                  PieceTable>::value>::type>
+	PieceTable(TextResource &&resource);
+
+	/*!
+	 * Construct a piece table whose contents are the given resource,
+	 * measuring it with the given scanner. This way, statistics for
+	 * the whole resource are computed in the same pass over its bytes
+	 * as the table's own metrics.
+	 *
+	 * \param resource The TextResource to take ownership of.
+	 * \param scanner The scanner to measure the resource with.
+	 */
+	template <typename TextResource>
+	PieceTable(TextResource &&resource, TextScanner &scanner);
 
 	PieceTable(PieceTable const &) = default;
 	PieceTable(PieceTable &&) = default;
 	PieceTable &operator=(PieceTable const &) = default;
 	PieceTable &operator=(PieceTable &&) = default;
 
+	/*!
+	 * \return The length of this table's contents, in bytes.
+	 */
+	size_type dataSize() const;
+
+	/*!
+	 * \return The length of this table's contents, in characters.
+	 */
+	size_type length() const;
+
+	/*!
+	 * \return Whether or not this table is empty.
+	 */
+	bool empty() const;
+
+	/*!
+	 * \return The number of lines in this table. This is always at
+	 * least one, as even an empty table contains one empty line.
+	 */
+	size_type lineCount() const;
+
+	/*!
+	 * \return The table which owns the text this table's pieces refer
+	 * to. It is shared by all copies of this table.
+	 */
+	ResourceTable const &getResources() const;
+
 	Cursor begin() const;
 	Cursor end() const;
 	ReverseCursor rbegin() const;
 	ReverseCursor rend() const;
+
+	/*!
+	 * Return a Cursor pointing to the character which contains the
+	 * byte at the given offset. If the offset is past the end of the
+	 * table, then end() is returned instead.
+	 *
+	 * \param offset The byte offset to find.
+	 * \return A Cursor pointing at the given offset.
+	 */
+	Cursor byteToCursor(size_type offset) const;
+
+	/*!
+	 * Return a Cursor pointing to the character with the given offset.
+	 * If the offset is past the end of the table, then end() is
+	 * returned instead.
+	 *
+	 * \param offset The character offset to find.
+	 * \return A Cursor pointing at the given offset.
+	 */
+	Cursor characterToCursor(size_type offset) const;
+
+	/*!
+	 * \param cursor A Cursor which refers to this table.
+	 * \return The offset of the given Cursor, in bytes.
+	 */
+	size_type cursorToByte(Cursor const &cursor) const;
+
+	/*!
+	 * \param cursor A Cursor which refers to this table.
+	 * \return The offset of the given Cursor, in characters.
+	 */
+	size_type cursorToCharacter(Cursor const &cursor) const;
+
+	/*!
+	 * Return a Cursor pointing to the first character on the given
+	 * line. If the line is past the end of the table, or if it is the
+	 * (empty) last line, then end() is returned instead.
+	 *
+	 * \param line The line number to find.
+	 * \return A Cursor pointing at the beginning of the given line.
+	 */
+	Cursor lineToCursor(size_type line) const;
+
+	/*!
+	 * \param cursor A Cursor which refers to this table.
+	 * \return The number of the line the given Cursor is on.
+	 */
+	size_type cursorToLine(Cursor const &cursor) const;
+
+	/*!
+	 * Call the given function with the raw bytes of the characters in
+	 * the range [first, last), as a sequence of contiguous spans (one
+	 * per piece, at most MAXIMUM_PIECE_SIZE bytes long). This lets bulk
+	 * algorithms work on whole runs of bytes at once, instead of
+	 * decoding one character at a time with a Cursor.
+	 *
+	 * Spans always begin and end on character boundaries, and they are
+	 * never empty.
+	 *
+	 * \param first The first character to visit.
+	 * \param last The character after the last one to visit.
+	 * \param visitor The function to call with each span.
+	 * \return False if the visitor stopped iteration early.
+	 */
+	bool forEachSpan(Cursor const &first, Cursor const &last,
+	                 SpanVisitor const &visitor) const;
+
+	/*!
+	 * Call the given function with the raw bytes of this entire table.
+	 * This is equivalent to forEachSpan(begin(), end(), visitor).
+	 *
+	 * \param visitor The function to call with each span.
+	 * \return False if the visitor stopped iteration early.
+	 */
+	bool forEachSpan(SpanVisitor const &visitor) const;
+
+	/*!
+	 * Call the given function with the raw bytes of every piece which
+	 * contains part of the lines in the range [first, last). Unlike
+	 * forEachSpan(), whole pieces are visited, so the pieces' contents
+	 * don't have to be read to find where the lines begin and end.
+	 * This is useful e.g. to prefetch the lines about to be displayed.
+	 *
+	 * \param first The zero-based number of the first line to visit.
+	 * \param last The number of the line after the last one to visit.
+	 * \param visitor The function to call with each piece's bytes.
+	 * \return False if the visitor stopped iteration early.
+	 */
+	bool forEachLineSpan(size_type first, size_type last,
+	                     SpanVisitor const &visitor) const;
+
+	/*!
+	 * Insert the given text before the character the given Cursor
+	 * points to. This invalidates all existing Cursors. This will throw
+	 * if the given text is not valid UTF-8, in which case the table's
+	 * contents are left unchanged.
+	 *
+	 * \param position The position to insert the text at.
+	 * \param text The text to insert.
+	 * \return A Cursor pointing to the first inserted character.
+	 */
+	Cursor insert(Cursor const &position,
+	              qompose::core::string::Utf8StringRef const &text);
+
+	/*!
+	 * Remove the characters in the range [first, last) from the table.
+	 * This invalidates all existing Cursors.
+	 *
+	 * \param first The first character to remove.
+	 * \param last The character after the last one to remove.
+	 * \return A Cursor pointing to the character after those removed.
+	 */
+	Cursor erase(Cursor const &first, Cursor const &last);
+
+	/*!
+	 * Append the entire contents of the given resource to the end of
+	 * this table, taking ownership of it. Unlike insert(), this doesn't
+	 * copy the resource's bytes, so it's the cheapest way to build up
+	 * a table from a sequence of chunks. This will throw if the bytes
+	 * are not valid UTF-8.
+	 *
+	 * \param resource The TextResource to take ownership of.
+	 */
+	template <typename TextResource> void append(TextResource &&resource);
+
+	/*!
+	 * Append the entire contents of the given resource, as above, but
+	 * measure it using the given scanner. Successive chunks of some
+	 * text can be appended with the same scanner.
+	 *
+	 * \param resource The TextResource to take ownership of.
+	 * \param scanner The scanner to measure the resource with.
+	 */
+	template <typename TextResource>
+	void append(TextResource &&resource, TextScanner &scanner);
+
+private:
+	std::shared_ptr<ResourceTable> resources;
+	std::shared_ptr<AddBuffer> addBuffer;
+
+	/*!
+	 * Construct a Cursor pointing at the given byte in the piece at the
+	 * given location. The byte must be the first byte of a character,
+	 * or the end of the piece.
+	 */
+	Cursor cursorAt(PieceTree::Location const &location,
+	                uint8_t const *position) const;
+
+	/*!
+	 * Make sure a piece begins at the given character offset, splitting
+	 * the piece which contains it if necessary.
+	 *
+	 * \param offset The character offset to split at.
+	 * \param position A pointer to the character at the given offset.
+	 * \return The index of the piece which begins at the given offset.
+	 */
+	PieceTree::size_type splitAt(size_type offset, uint8_t const *position);
+
+	/*!
+	 * Add the given resource to this table, and append the given
+	 * pieces (which must refer to it) to the end of the table.
+	 */
+	template <typename TextResource>
+	void appendPieces(std::shared_ptr<TextResource> const &resource,
+	                  std::vector<Piece> const &appended);
 };
 
+template <typename TextResource, typename>
+PieceTable::PieceTable(TextResource &&resource)
+        : pieces(),
+          resources(std::make_shared<ResourceTable>()),
+          addBuffer(std::make_shared<AddBuffer>())
+{
+	auto r = std::make_shared<typename std::decay<TextResource>::type>(
+	        std::forward<TextResource>(resource));
+	ResourceId id = resources->add(r, r->data());
+	pieces = PieceTree(makePieces(id, r->data(), r->data() + r->size()));
+}
+
+template <typename TextResource>
+PieceTable::PieceTable(TextResource &&resource, TextScanner &scanner)
+        : pieces(),
+          resources(std::make_shared<ResourceTable>()),
+          addBuffer(std::make_shared<AddBuffer>())
+{
+	auto r = std::make_shared<typename std::decay<TextResource>::type>(
+	        std::forward<TextResource>(resource));
+	ResourceId id = resources->add(r, r->data());
+	pieces = PieceTree(
+	        makePieces(id, r->data(), r->data() + r->size(), scanner));
+}
+
+template <typename TextResource>
+void PieceTable::append(TextResource &&resource)
+{
+	auto r = std::make_shared<typename std::decay<TextResource>::type>(
+	        std::forward<TextResource>(resource));
+	// Split the resource into pieces before adding it to the table, so
+	// the table is left unchanged if its bytes aren't valid UTF-8.
+	appendPieces(r, makePieces(0, r->data(), r->data() + r->size()));
+}
+
 template <typename TextResource>
-PieceTable::PieceTable(TextResource &&resource) : pieces()
+void PieceTable::append(TextResource &&resource, TextScanner &scanner)
 {
-	auto b = resource.data();
-	auto e = resource.data() + resource.size();
-	pieces.emplace_back(std::move(resource),
-	                    qompose::core::string::Utf8Iterator(b, e),
-	                    qompose::core::string::Utf8Iterator(b, e, e));
+	auto r = std::make_shared<typename std::decay<TextResource>::type>(
+	        std::forward<TextResource>(resource));
+	appendPieces(r, makePieces(0, r->data(), r->data() + r->size(),
+	                           scanner));
+}
+
+template <typename TextResource>
+void PieceTable::appendPieces(std::shared_ptr<TextResource> const &resource,
+                              std::vector<Piece> const &appended)
+{
+	if(appended.empty())
+		return;
+
+	ResourceId id = resources->add(resource, resource->data());
+	for(auto const &piece : appended)
+	{
+		pieces.insert(pieces.size(),
+		              Piece(id, piece.data(), piece.dataEnd(),
+		                    piece.metrics));
+	}
 }
 }
 }
@@ -0,0 +1,653 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PieceTree.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/pool/pool_alloc.hpp>
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+namespace detail
+{
+/*!
+ * \brief A single node in a PieceTree.
+ *
+ * Nodes may be shared between several trees, so a node must never be
+ * modified unless the modifying tree is its only owner; see mutate().
+ * Copying a node is shallow: the copy shares its children.
+ */
+struct PieceTreeNode
+{
+	Piece piece;
+	std::shared_ptr<PieceTreeNode> left;
+	std::shared_ptr<PieceTreeNode> right;
+
+	// Cached information about the subtree rooted at this node.
+	int height;
+	std::size_t count;
+	PieceMetrics metrics;
+
+	PieceTreeNode(Piece const &p)
+	        : piece(p),
+	          left(),
+	          right(),
+	          height(1),
+	          count(1),
+	          metrics(p.metrics)
+	{
+	}
+
+	PieceTreeNode(PieceTreeNode const &) = default;
+};
+}
+
+namespace
+{
+typedef detail::PieceTreeNode Node;
+typedef std::shared_ptr<Node> NodePointer;
+
+/*!
+ * Nodes are all the same size, and are allocated and freed constantly as
+ * trees are edited, so they (and their reference counts) are allocated
+ * from a pool instead of with the general purpose allocator. This also
+ * tends to keep the nodes of a tree close together in memory.
+ */
+typedef boost::fast_pool_allocator<Node> NodeAllocator;
+
+template <typename... Arguments> NodePointer makeNode(Arguments &&... args)
+{
+	return std::allocate_shared<Node>(NodeAllocator(),
+	                                  std::forward<Arguments>(args)...);
+}
+
+int heightOf(NodePointer const &node)
+{
+	return !!node ? node->height : 0;
+}
+
+std::size_t countOf(Node const *node)
+{
+	return node != nullptr ? node->count : 0;
+}
+
+std::size_t countOf(NodePointer const &node)
+{
+	return countOf(node.get());
+}
+
+PieceMetrics metricsOf(NodePointer const &node)
+{
+	return !!node ? node->metrics : PieceMetrics();
+}
+
+/*!
+ * Return a reference to the given node which is safe to modify. If the
+ * node is shared with any other tree, it is first replaced with a copy
+ * (this is the "path copying" which makes the tree persistent). Since
+ * this is always done from the root downwards, the children of a copied
+ * node are themselves shared, and will be copied in turn if they are
+ * modified.
+ */
+Node &mutate(NodePointer &node)
+{
+	assert(!!node);
+	if(node.use_count() > 1)
+		node = makeNode(*node);
+	return *node;
+}
+
+void update(Node &node)
+{
+	node.height = 1 + std::max(heightOf(node.left), heightOf(node.right));
+	node.count = 1 + countOf(node.left) + countOf(node.right);
+	node.metrics =
+	        metricsOf(node.left) + node.piece.metrics +
+	        metricsOf(node.right);
+}
+
+void rotateLeft(NodePointer &node)
+{
+	Node &n = mutate(node);
+	NodePointer pivot = std::move(n.right);
+	Node &p = mutate(pivot);
+	n.right = std::move(p.left);
+	update(n);
+	p.left = std::move(node);
+	update(p);
+	node = std::move(pivot);
+}
+
+void rotateRight(NodePointer &node)
+{
+	Node &n = mutate(node);
+	NodePointer pivot = std::move(n.left);
+	Node &p = mutate(pivot);
+	n.left = std::move(p.right);
+	update(n);
+	p.right = std::move(node);
+	update(p);
+	node = std::move(pivot);
+}
+
+/*!
+ * Restore the AVL invariant at the given node, assuming both of its
+ * subtrees are already balanced and differ in height by at most two.
+ * The node itself must already be safe to modify.
+ */
+void rebalance(NodePointer &node)
+{
+	update(*node);
+	int balance = heightOf(node->left) - heightOf(node->right);
+	if(balance > 1)
+	{
+		if(heightOf(node->left->left) < heightOf(node->left->right))
+			rotateLeft(node->left);
+		rotateRight(node);
+	}
+	else if(balance < -1)
+	{
+		if(heightOf(node->right->right) < heightOf(node->right->left))
+			rotateRight(node->right);
+		rotateLeft(node);
+	}
+}
+
+NodePointer build(std::vector<Piece> const &pieces, std::size_t begin,
+                  std::size_t end)
+{
+	if(begin >= end)
+		return nullptr;
+	std::size_t middle = begin + (end - begin) / 2;
+	NodePointer node = makeNode(pieces[middle]);
+	node->left = build(pieces, begin, middle);
+	node->right = build(pieces, middle + 1, end);
+	update(*node);
+	return node;
+}
+
+void insertAt(NodePointer &node, std::size_t index, Piece const &piece)
+{
+	if(!node)
+	{
+		node = makeNode(piece);
+		return;
+	}
+
+	Node &n = mutate(node);
+	std::size_t leftCount = countOf(n.left);
+	if(index <= leftCount)
+		insertAt(n.left, index, piece);
+	else
+		insertAt(n.right, index - leftCount - 1, piece);
+	rebalance(node);
+}
+
+/*!
+ * Remove the leftmost node from the given subtree, returning it.
+ */
+NodePointer removeFirst(NodePointer &node)
+{
+	Node &n = mutate(node);
+	if(!n.left)
+	{
+		NodePointer first = std::move(node);
+		node = first->right;
+		first->right = nullptr;
+		return first;
+	}
+
+	NodePointer first = removeFirst(n.left);
+	rebalance(node);
+	return first;
+}
+
+void eraseAt(NodePointer &node, std::size_t index)
+{
+	assert(!!node);
+
+	Node &n = mutate(node);
+	std::size_t leftCount = countOf(n.left);
+	if(index < leftCount)
+	{
+		eraseAt(n.left, index);
+	}
+	else if(index > leftCount)
+	{
+		eraseAt(n.right, index - leftCount - 1);
+	}
+	else
+	{
+		if(!n.left || !n.right)
+		{
+			NodePointer child = !!n.left ? n.left : n.right;
+			node = std::move(child);
+			return;
+		}
+
+		NodePointer successor = removeFirst(n.right);
+		successor->left = std::move(n.left);
+		successor->right = std::move(n.right);
+		node = std::move(successor);
+	}
+	rebalance(node);
+}
+
+void replaceAt(NodePointer &node, std::size_t index, Piece const &piece)
+{
+	Node &n = mutate(node);
+	std::size_t leftCount = countOf(n.left);
+	if(index < leftCount)
+		replaceAt(n.left, index, piece);
+	else if(index > leftCount)
+		replaceAt(n.right, index - leftCount - 1, piece);
+	else
+		n.piece = piece;
+	update(n);
+}
+
+void visit(Node const *node,
+           std::function<void(Piece const &)> const &visitor)
+{
+	if(node == nullptr)
+		return;
+	visit(node->left.get(), visitor);
+	visitor(node->piece);
+	visit(node->right.get(), visitor);
+}
+
+/*!
+ * Visit the pieces in the given subtree whose indices (relative to the
+ * subtree) are in the range [first, last), skipping any subtrees which
+ * are entirely outside of the range.
+ */
+bool visit(Node const *node, std::size_t first, std::size_t last,
+           std::function<bool(Piece const &)> const &visitor)
+{
+	if(node == nullptr || first >= last)
+		return true;
+
+	std::size_t leftCount = countOf(node->left);
+	if(first < leftCount &&
+	   !visit(node->left.get(), first, std::min(last, leftCount), visitor))
+	{
+		return false;
+	}
+	if(first <= leftCount && leftCount < last && !visitor(node->piece))
+		return false;
+	if(last <= leftCount + 1)
+		return true;
+	return visit(node->right.get(),
+	             first > leftCount + 1 ? first - leftCount - 1 : 0,
+	             last - leftCount - 1, visitor);
+}
+
+/*!
+ * Return a version of the given subtree whose pieces have been measured
+ * again, reusing the given map's results for any nodes which were already
+ * measured through some other tree, so they stay shared.
+ */
+NodePointer
+remeasure(NodePointer const &node,
+          std::function<PieceMetrics(Piece const &)> const &measure,
+          std::unordered_map<Node const *, NodePointer> &measured)
+{
+	if(!node)
+		return node;
+	auto it = measured.find(node.get());
+	if(it != measured.end())
+		return it->second;
+
+	NodePointer left = remeasure(node->left, measure, measured);
+	NodePointer right = remeasure(node->right, measure, measured);
+	PieceMetrics metrics = measure(node->piece);
+	NodePointer result = node;
+	if(left != node->left || right != node->right ||
+	   !(metrics == node->piece.metrics))
+	{
+		result = makeNode(*node);
+		result->left = left;
+		result->right = right;
+		result->piece.metrics = metrics;
+		update(*result);
+	}
+	measured.emplace(node.get(), result);
+	return result;
+}
+
+bool isSamePiece(Piece const &a, Piece const &b)
+{
+	return a.data() == b.data() && a.metrics == b.metrics;
+}
+
+/*!
+ * \brief An in-order (or reverse order) walk over a tree, which can skip
+ * entire subtrees instead of visiting their pieces one at a time.
+ */
+class Frontier
+{
+public:
+	/*!
+	 * \brief One step of the walk: either a whole subtree, or just the
+	 * piece stored in a single node.
+	 */
+	struct Step
+	{
+		Node const *node;
+		bool subtree;
+
+		std::size_t count() const
+		{
+			return subtree ? node->count : 1;
+		}
+	};
+
+	Frontier(Node const *root, bool r) : reverse(r), steps()
+	{
+		pushSubtree(root);
+	}
+
+	bool empty() const
+	{
+		return steps.empty();
+	}
+
+	Step top() const
+	{
+		return steps.back();
+	}
+
+	void pop()
+	{
+		steps.pop_back();
+	}
+
+	/*!
+	 * Replace the subtree step on top of the walk with its children and
+	 * its own piece.
+	 */
+	void expand()
+	{
+		Node const *node = steps.back().node;
+		steps.pop_back();
+		pushSubtree(reverse ? node->left.get() : node->right.get());
+		steps.push_back({node, false});
+		pushSubtree(reverse ? node->right.get() : node->left.get());
+	}
+
+private:
+	bool reverse;
+	std::vector<Step> steps;
+
+	void pushSubtree(Node const *node)
+	{
+		if(node != nullptr)
+			steps.push_back({node, true});
+	}
+};
+}
+
+PieceTree::size_type commonPieceCount(PieceTree const &a,
+                                      PieceTree const &b, bool reverse,
+                                      PieceTree::size_type limit)
+{
+	Frontier fa(a.getRoot(), reverse);
+	Frontier fb(b.getRoot(), reverse);
+	PieceTree::size_type count = 0;
+	while(count < limit && !fa.empty() && !fb.empty())
+	{
+		Frontier::Step x = fa.top();
+		Frontier::Step y = fb.top();
+		if(x.subtree && y.subtree && x.node == y.node &&
+		   count + x.count() <= limit)
+		{
+			count += x.count();
+			fa.pop();
+			fb.pop();
+		}
+		else if(x.subtree && (!y.subtree || x.count() >= y.count()))
+		{
+			// Split the larger subtree first, so the two walks line
+			// up again on the next subtree they share.
+			fa.expand();
+		}
+		else if(y.subtree)
+		{
+			fb.expand();
+		}
+		else if(isSamePiece(x.node->piece, y.node->piece))
+		{
+			++count;
+			fa.pop();
+			fb.pop();
+		}
+		else
+		{
+			break;
+		}
+	}
+	return count;
+}
+
+void forEachDistinctPiece(std::vector<PieceTree const *> const &trees,
+                          std::function<void(Piece const &)> const &visitor)
+{
+	// Nodes never change once they're shared, so a node we've seen
+	// before is the root of a subtree we've already visited in full.
+	std::unordered_set<Node const *> visited;
+	std::vector<Node const *> pending;
+	for(PieceTree const *tree : trees)
+		pending.push_back(tree->getRoot());
+	while(!pending.empty())
+	{
+		Node const *node = pending.back();
+		pending.pop_back();
+		if(node == nullptr || !visited.insert(node).second)
+			continue;
+
+		visitor(node->piece);
+		pending.push_back(node->left.get());
+		pending.push_back(node->right.get());
+	}
+}
+
+void remeasurePieces(std::vector<PieceTree *> const &trees,
+                     std::function<PieceMetrics(Piece const &)> const &measure)
+{
+	// Keep the old roots alive until we're done, so the nodes we've
+	// measured can't be freed and their addresses reused.
+	std::vector<NodePointer> roots;
+	std::unordered_map<Node const *, NodePointer> measured;
+	for(PieceTree *tree : trees)
+	{
+		roots.push_back(tree->root);
+		tree->root = remeasure(tree->root, measure, measured);
+	}
+}
+
+namespace detail
+{
+std::size_t pieceCount(PieceTreeNode const *root)
+{
+	return countOf(root);
+}
+
+Piece const &pieceAt(PieceTreeNode const *root, std::size_t index)
+{
+	PieceTreeNode const *node = root;
+	while(node != nullptr)
+	{
+		std::size_t leftCount = countOf(node->left);
+		if(index < leftCount)
+		{
+			node = node->left.get();
+		}
+		else if(index > leftCount)
+		{
+			index -= leftCount + 1;
+			node = node->right.get();
+		}
+		else
+		{
+			return node->piece;
+		}
+	}
+
+	throw std::out_of_range("Piece index out of bounds.");
+}
+
+PieceTree::Location findPiece(PieceTreeNode const *root,
+                              PieceTree::Metric metric, std::size_t offset)
+{
+	PieceTree::Location location{0, PieceMetrics()};
+	Node const *node = root;
+	while(node != nullptr)
+	{
+		PieceMetrics left = metricsOf(node->left);
+		if(offset < left.*metric)
+		{
+			node = node->left.get();
+			continue;
+		}
+
+		offset -= left.*metric;
+		location.offset += left;
+		location.index += countOf(node->left);
+		if(offset < node->piece.metrics.*metric)
+			return location;
+
+		offset -= node->piece.metrics.*metric;
+		location.offset += node->piece.metrics;
+		location.index += 1;
+		node = node->right.get();
+	}
+	return location;
+}
+}
+
+PieceTree::PieceTree() : root()
+{
+}
+
+PieceTree::PieceTree(std::vector<Piece> const &pieces)
+        : root(build(pieces, 0, pieces.size()))
+{
+}
+
+PieceTree::~PieceTree()
+{
+}
+
+detail::PieceTreeNode const *PieceTree::getRoot() const
+{
+	return root.get();
+}
+
+PieceTree::size_type PieceTree::size() const
+{
+	return countOf(root);
+}
+
+bool PieceTree::empty() const
+{
+	return !root;
+}
+
+PieceMetrics PieceTree::getMetrics() const
+{
+	return metricsOf(root);
+}
+
+Piece const &PieceTree::operator[](size_type index) const
+{
+	return detail::pieceAt(root.get(), index);
+}
+
+PieceMetrics PieceTree::offsetOf(size_type index) const
+{
+	PieceMetrics offset;
+	Node const *node = root.get();
+	while(node != nullptr)
+	{
+		std::size_t leftCount = countOf(node->left);
+		if(index <= leftCount)
+		{
+			node = node->left.get();
+		}
+		else
+		{
+			index -= leftCount + 1;
+			offset += metricsOf(node->left) + node->piece.metrics;
+			node = node->right.get();
+		}
+	}
+	return offset;
+}
+
+PieceTree::Location PieceTree::find(Metric metric, size_type offset) const
+{
+	return detail::findPiece(root.get(), metric, offset);
+}
+
+void PieceTree::forEach(
+        std::function<void(Piece const &)> const &visitor) const
+{
+	visit(root.get(), visitor);
+}
+
+bool PieceTree::forEach(
+        size_type first, size_type last,
+        std::function<bool(Piece const &)> const &visitor) const
+{
+	return visit(root.get(), first, std::min(last, size()), visitor);
+}
+
+void PieceTree::insert(size_type index, Piece const &piece)
+{
+	if(index > size())
+		throw std::out_of_range("Piece index out of bounds.");
+	insertAt(root, index, piece);
+}
+
+void PieceTree::erase(size_type index)
+{
+	if(index >= size())
+		throw std::out_of_range("Piece index out of bounds.");
+	eraseAt(root, index);
+}
+
+void PieceTree::replace(size_type index, Piece const &piece)
+{
+	if(index >= size())
+		throw std::out_of_range("Piece index out of bounds.");
+	replaceAt(root, index, piece);
+}
+}
+}
+}
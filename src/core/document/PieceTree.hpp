@@ -0,0 +1,253 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_document_PieceTree_HPP
+#define qompose_core_document_PieceTree_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "core/document/Piece.hpp"
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+namespace detail
+{
+struct PieceTreeNode;
+
+std::size_t pieceCount(PieceTreeNode const *root);
+Piece const &pieceAt(PieceTreeNode const *root, std::size_t index);
+}
+
+/*!
+ * \brief A PieceTree is a balanced (AVL) tree of pieces, ordered by their
+ * position in the document.
+ *
+ * Each node caches the number of pieces and the PieceMetrics of its
+ * subtree, so looking up a piece by index or by byte / character offset,
+ * as well as inserting or erasing a single piece, are all O(log n).
+ *
+ * PieceTrees are persistent: copying a tree is O(1), and the copies share
+ * all of their nodes. Modifying a tree copies only the O(log n) nodes on
+ * the path to the modified piece, so the old and new versions of a tree
+ * still share every subtree which wasn't changed.
+ */
+class PieceTree
+{
+public:
+	typedef std::size_t size_type;
+
+	/*!
+	 * A pointer to one of the size_type members of PieceMetrics, used
+	 * to select which kind of offset a search is done by.
+	 */
+	typedef size_type PieceMetrics::*Metric;
+
+	/*!
+	 * \brief The result of looking up a piece by offset.
+	 */
+	struct Location
+	{
+		// The index of the piece which was found.
+		size_type index;
+		// The metrics of all of the pieces before the one found.
+		PieceMetrics offset;
+	};
+
+	PieceTree();
+
+	/*!
+	 * Construct a balanced tree from the given pieces, in O(n) time.
+	 *
+	 * \param pieces The pieces to store, in document order.
+	 */
+	explicit PieceTree(std::vector<Piece> const &pieces);
+
+	PieceTree(PieceTree const &) = default;
+	PieceTree(PieceTree &&) = default;
+	PieceTree &operator=(PieceTree const &) = default;
+	PieceTree &operator=(PieceTree &&) = default;
+
+	~PieceTree();
+
+	/*!
+	 * Return this tree's root node. Since nodes are immutable once they
+	 * are shared, the root identifies this version of the tree; it stays
+	 * valid for as long as some tree which shares it is alive.
+	 *
+	 * \return This tree's root node, or nullptr if it is empty.
+	 */
+	detail::PieceTreeNode const *getRoot() const;
+
+	/*!
+	 * \return The number of pieces in this tree.
+	 */
+	size_type size() const;
+
+	/*!
+	 * \return Whether or not this tree contains no pieces.
+	 */
+	bool empty() const;
+
+	/*!
+	 * \return The sum of the metrics of all pieces in the tree.
+	 */
+	PieceMetrics getMetrics() const;
+
+	/*!
+	 * Return the piece with the given index. The index must be less
+	 * than size().
+	 *
+	 * \param index The index of the desired piece.
+	 * \return The piece at the given index.
+	 */
+	Piece const &operator[](size_type index) const;
+
+	/*!
+	 * \param index The index of a piece, or size().
+	 * \return The sum of the metrics of all pieces before the index.
+	 */
+	PieceMetrics offsetOf(size_type index) const;
+
+	/*!
+	 * Find the piece which contains the given offset. If the offset is
+	 * past the end of the tree, then the returned index is size().
+	 *
+	 * \param metric The kind of offset to search by.
+	 * \param offset The offset to search for.
+	 * \return The location of the piece containing the offset.
+	 */
+	Location find(Metric metric, size_type offset) const;
+
+	/*!
+	 * Call the given function with every piece in the tree, in order.
+	 * This is O(n), whereas visiting each piece with operator[] would
+	 * be O(n log n).
+	 *
+	 * \param visitor The function to call with each piece.
+	 */
+	void forEach(std::function<void(Piece const &)> const &visitor) const;
+
+	/*!
+	 * Call the given function with each piece whose index is in the
+	 * range [first, last), in order, in O(log n + (last - first)) time.
+	 * Iteration stops early if the function returns false.
+	 *
+	 * \param first The index of the first piece to visit.
+	 * \param last The index after the last piece to visit.
+	 * \param visitor The function to call with each piece.
+	 * \return False if the visitor stopped iteration early.
+	 */
+	bool forEach(size_type first, size_type last,
+	             std::function<bool(Piece const &)> const &visitor) const;
+
+	/*!
+	 * Insert a new piece before the piece with the given index. If the
+	 * index is size(), the piece is appended.
+	 *
+	 * \param index The index the new piece will have.
+	 * \param piece The new piece to insert.
+	 */
+	void insert(size_type index, Piece const &piece);
+
+	/*!
+	 * Remove the piece with the given index from the tree.
+	 *
+	 * \param index The index of the piece to remove.
+	 */
+	void erase(size_type index);
+
+	/*!
+	 * Replace the piece with the given index with a different piece.
+	 *
+	 * \param index The index of the piece to replace.
+	 * \param piece The new piece to store at the given index.
+	 */
+	void replace(size_type index, Piece const &piece);
+
+private:
+	std::shared_ptr<detail::PieceTreeNode> root;
+
+	friend void remeasurePieces(
+	        std::vector<PieceTree *> const &trees,
+	        std::function<PieceMetrics(Piece const &)> const &measure);
+};
+
+/*!
+ * Count how many pieces at the beginning (or, in reverse, at the end) of
+ * two trees refer to the same bytes (with the same metrics), up to the
+ * given limit. Subtrees which the trees share are skipped without visiting
+ * their pieces, so for two versions of a tree separated by a few edits
+ * this is O(log n).
+ *
+ * \param a The first tree to compare.
+ * \param b The second tree to compare.
+ * \param reverse Whether to compare from the end of the trees.
+ * \param limit The maximum number of pieces to count.
+ * \return The number of leading (or trailing) pieces the trees share.
+ */
+PieceTree::size_type commonPieceCount(PieceTree const &a,
+                                      PieceTree const &b, bool reverse,
+                                      PieceTree::size_type limit);
+
+/*!
+ * Call the given function with every piece in any of the given trees,
+ * visiting pieces which several trees share only once. Since versions of
+ * a tree share every subtree which wasn't edited, this is proportional to
+ * the number of distinct nodes, rather than to the total size of all of
+ * the trees. Pieces are not visited in any particular order.
+ *
+ * \param trees The trees whose pieces should be visited.
+ * \param visitor The function to call with each piece.
+ */
+void forEachDistinctPiece(std::vector<PieceTree const *> const &trees,
+                          std::function<void(Piece const &)> const &visitor);
+
+/*!
+ * Replace the metrics of the pieces in the given trees, because the bytes
+ * they refer to have been changed in place (e.g. by another program, in a
+ * mapped file). Only the metrics change, so every piece must still be
+ * valid UTF-8, and still refer to the same bytes. Nodes which several
+ * trees share are only measured once, and remain shared afterwards.
+ *
+ * \param trees The trees whose pieces should be measured again.
+ * \param measure A function which returns a piece's new metrics.
+ */
+void remeasurePieces(std::vector<PieceTree *> const &trees,
+                     std::function<PieceMetrics(Piece const &)> const &measure);
+
+namespace detail
+{
+/*!
+ * This is the same as PieceTree::find, but it operates on any version of
+ * a tree, given its root node.
+ */
+PieceTree::Location findPiece(PieceTreeNode const *root,
+                              PieceTree::Metric metric, std::size_t offset);
+}
+}
+}
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceTable.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+ResourceTable::ResourceTable() : resources()
+{
+}
+
+ResourceId ResourceTable::add(std::shared_ptr<void> const &owner,
+                              uint8_t const *data)
+{
+	if(resources.size() >= std::numeric_limits<ResourceId>::max())
+		throw std::length_error("Too many resources in ResourceTable.");
+	resources.push_back({owner, data});
+	return static_cast<ResourceId>(resources.size() - 1);
+}
+
+std::size_t ResourceTable::size() const
+{
+	return resources.size();
+}
+
+uint8_t const *ResourceTable::data(ResourceId id) const
+{
+	return resources.at(id).data;
+}
+}
+}
+}
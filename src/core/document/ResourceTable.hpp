@@ -0,0 +1,95 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_document_ResourceTable_HPP
+#define qompose_core_document_ResourceTable_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+/*!
+ * A ResourceId identifies one of the resources in a ResourceTable.
+ */
+typedef uint32_t ResourceId;
+
+/*!
+ * \brief A ResourceTable owns all of the text a document's pieces refer to.
+ *
+ * Pieces identify the resource their bytes belong to with a small
+ * ResourceId, instead of each one holding a reference count on it. All of
+ * the versions of a document (e.g., the snapshots in its DocumentHistory)
+ * share one table, so its resources are released together, when the last
+ * version of the document is destroyed.
+ *
+ * Resources must never move their bytes, so pointers into them remain
+ * valid for as long as the table exists.
+ */
+class ResourceTable
+{
+public:
+	ResourceTable();
+
+	ResourceTable(ResourceTable const &) = delete;
+	ResourceTable(ResourceTable &&) = default;
+	ResourceTable &operator=(ResourceTable const &) = delete;
+	ResourceTable &operator=(ResourceTable &&) = default;
+
+	~ResourceTable() = default;
+
+	/*!
+	 * Add a resource to this table.
+	 *
+	 * \param owner The object which owns the resource's bytes.
+	 * \param data A pointer to the first of the resource's bytes.
+	 * \return The new resource's ID.
+	 */
+	ResourceId add(std::shared_ptr<void> const &owner, uint8_t const *data);
+
+	/*!
+	 * \return The number of resources in this table.
+	 */
+	std::size_t size() const;
+
+	/*!
+	 * \param id The ID of a resource in this table.
+	 * \return A pointer to the first of the resource's bytes.
+	 */
+	uint8_t const *data(ResourceId id) const;
+
+private:
+	struct Resource
+	{
+		std::shared_ptr<void> owner;
+		uint8_t const *data;
+	};
+
+	std::vector<Resource> resources;
+};
+}
+}
+}
+
+#endif
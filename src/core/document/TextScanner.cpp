@@ -0,0 +1,398 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TextScanner.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/string/Utf8Validation.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QOMPOSE_TEXT_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+/*!
+ * Text is validated and then scanned this many bytes at a time, so each
+ * block is still in the L1 cache while it is scanned.
+ */
+constexpr std::size_t BLOCK_SIZE = 16 * 1024;
+
+// The longest sequence our decoder accepts; see Utf8Decoder.
+constexpr std::size_t MAXIMUM_CHARACTER_LENGTH = 6;
+
+// The number of bytes described by each set of BlockMasks.
+constexpr std::size_t MASK_WIDTH = 64;
+
+/*!
+ * \brief BlockMasks classify each byte in a run of up to 64 bytes.
+ *
+ * Bit i of each mask describes the i'th byte in the run.
+ */
+struct BlockMasks
+{
+	uint64_t lineFeeds;
+	uint64_t carriageReturns;
+	// Bytes which start a character, i.e. aren't continuation bytes.
+	uint64_t starts;
+	// Bytes which are not ASCII.
+	uint64_t high;
+};
+
+typedef void (*MaskFunction)(uint8_t const *, BlockMasks &);
+
+bool isUtf8ContinuationByte(uint8_t byte)
+{
+	return (byte & 0xC0U) == 0x80U;
+}
+
+/*!
+ * \return The number of bytes in the character which starts with the
+ * given byte, or 1 if it can't start a multi-byte character.
+ */
+std::size_t expectedLength(uint8_t byte)
+{
+	if(byte >= 0xC0U && byte < 0xE0U)
+		return 2;
+	if(byte >= 0xE0U && byte < 0xF0U)
+		return 3;
+	if(byte >= 0xF0U && byte < 0xF8U)
+		return 4;
+	if(byte >= 0xF8U && byte < 0xFCU)
+		return 5;
+	if(byte >= 0xFCU && byte < 0xFEU)
+		return 6;
+	return 1;
+}
+
+/*!
+ * \return A mask with the lowest n bits set.
+ */
+uint64_t lowBits(std::size_t n)
+{
+	return n >= MASK_WIDTH ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+}
+
+std::size_t popcount(uint64_t mask)
+{
+	return static_cast<std::size_t>(__builtin_popcountll(mask));
+}
+
+void masksScalar(uint8_t const *begin, std::size_t length, BlockMasks &masks)
+{
+	masks = BlockMasks{0, 0, 0, 0};
+	for(std::size_t i = 0; i < length; ++i)
+	{
+		uint64_t bit = uint64_t(1) << i;
+		if(begin[i] == '\n')
+			masks.lineFeeds |= bit;
+		if(begin[i] == '\r')
+			masks.carriageReturns |= bit;
+		if(!isUtf8ContinuationByte(begin[i]))
+			masks.starts |= bit;
+		if(begin[i] >= 0x80U)
+			masks.high |= bit;
+	}
+}
+
+void masksScalar(uint8_t const *begin, BlockMasks &masks)
+{
+	masksScalar(begin, MASK_WIDTH, masks);
+}
+
+#ifdef QOMPOSE_TEXT_SCANNER_X86
+uint64_t maskBits(int mask)
+{
+	return static_cast<uint64_t>(static_cast<uint32_t>(mask));
+}
+
+__attribute__((target("sse2"))) void masksSse2(uint8_t const *begin,
+                                               BlockMasks &masks)
+{
+	__m128i const lf = _mm_set1_epi8('\n');
+	__m128i const cr = _mm_set1_epi8('\r');
+	// As signed bytes, continuation bytes are exactly those in the
+	// range [-128, -65].
+	__m128i const threshold = _mm_set1_epi8(-65);
+
+	masks = BlockMasks{0, 0, 0, 0};
+	for(std::size_t i = 0; i < MASK_WIDTH; i += 16)
+	{
+		__m128i block = _mm_loadu_si128(
+		        reinterpret_cast<__m128i const *>(begin + i));
+		masks.lineFeeds |=
+		        maskBits(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lf)))
+		        << i;
+		masks.carriageReturns |=
+		        maskBits(_mm_movemask_epi8(_mm_cmpeq_epi8(block, cr)))
+		        << i;
+		masks.starts |= maskBits(_mm_movemask_epi8(
+		                        _mm_cmpgt_epi8(block, threshold)))
+		                << i;
+		masks.high |= maskBits(_mm_movemask_epi8(block)) << i;
+	}
+}
+
+__attribute__((target("avx2"))) void masksAvx2(uint8_t const *begin,
+                                               BlockMasks &masks)
+{
+	__m256i const lf = _mm256_set1_epi8('\n');
+	__m256i const cr = _mm256_set1_epi8('\r');
+	__m256i const threshold = _mm256_set1_epi8(-65);
+
+	masks = BlockMasks{0, 0, 0, 0};
+	for(std::size_t i = 0; i < MASK_WIDTH; i += 32)
+	{
+		__m256i block = _mm256_loadu_si256(
+		        reinterpret_cast<__m256i const *>(begin + i));
+		masks.lineFeeds |= maskBits(_mm256_movemask_epi8(
+		                           _mm256_cmpeq_epi8(block, lf)))
+		                   << i;
+		masks.carriageReturns |= maskBits(_mm256_movemask_epi8(
+		                                 _mm256_cmpeq_epi8(block, cr)))
+		                         << i;
+		masks.starts |= maskBits(_mm256_movemask_epi8(
+		                        _mm256_cmpgt_epi8(block, threshold)))
+		                << i;
+		masks.high |= maskBits(_mm256_movemask_epi8(block)) << i;
+	}
+}
+#endif
+
+MaskFunction selectMasks()
+{
+#ifdef QOMPOSE_TEXT_SCANNER_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return masksAvx2;
+	if(__builtin_cpu_supports("sse2"))
+		return masksSse2;
+#endif
+	return masksScalar;
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+TextStatistics::TextStatistics()
+        : valid(true),
+          ascii(true),
+          bytes(0),
+          characters(0),
+          lineFeeds(0),
+          crlfs(0),
+          carriageReturns(0),
+          longestLine(0),
+          lineStarts()
+{
+}
+
+std::size_t TextStatistics::lineCount() const
+{
+	return lineFeeds + crlfs + 1;
+}
+
+LineEnding TextStatistics::lineEnding() const
+{
+	if(lineFeeds >= crlfs && lineFeeds >= carriageReturns)
+		return LineEnding::Lf;
+	if(crlfs >= carriageReturns)
+		return LineEnding::CrLf;
+	return LineEnding::Cr;
+}
+
+bool TextStatistics::hasMixedLineEndings() const
+{
+	int kinds = (lineFeeds > 0 ? 1 : 0) + (crlfs > 0 ? 1 : 0) +
+	            (carriageReturns > 0 ? 1 : 0);
+	return kinds > 1;
+}
+
+TextScanner::TextScanner(bool i)
+        : indexLines(i),
+          statistics(),
+          lineLength(0),
+          afterCarriageReturn(false),
+          pending(),
+          pendingLength(0)
+{
+	if(indexLines)
+		statistics.lineStarts.push_back(0);
+}
+
+void TextScanner::scan(uint8_t const *begin, uint8_t const *end)
+{
+	if(pendingLength > 0)
+	{
+		// Try to complete the character split across chunks.
+		std::size_t length = expectedLength(pending[0]);
+		while(pendingLength < length && begin < end &&
+		      isUtf8ContinuationByte(*begin))
+		{
+			pending[pendingLength++] = *begin++;
+		}
+		if(pendingLength < length && begin == end)
+			return;
+
+		scanCompleteCharacters(pending, pending + pendingLength);
+		pendingLength = 0;
+	}
+
+	// Hold back an incomplete character at the end of this chunk.
+	uint8_t const *last = end;
+	std::ptrdiff_t const maximum = MAXIMUM_CHARACTER_LENGTH;
+	while(last > begin && end - last < maximum &&
+	      isUtf8ContinuationByte(*(last - 1)))
+	{
+		--last;
+	}
+	if(last > begin && end - last < maximum)
+	{
+		--last;
+		std::size_t length = static_cast<std::size_t>(end - last);
+		if(length < expectedLength(*last))
+		{
+			std::copy(last, end, pending);
+			pendingLength = length;
+			end = last;
+		}
+	}
+
+	scanCompleteCharacters(begin, end);
+}
+
+TextStatistics const &TextScanner::finish()
+{
+	if(pendingLength > 0)
+	{
+		scanCompleteCharacters(pending, pending + pendingLength);
+		pendingLength = 0;
+	}
+
+	statistics.longestLine = std::max(statistics.longestLine, lineLength);
+	lineLength = 0;
+	return statistics;
+}
+
+TextStatistics const &TextScanner::getStatistics() const
+{
+	return statistics;
+}
+
+void TextScanner::scanCompleteCharacters(uint8_t const *begin,
+                                         uint8_t const *end)
+{
+	while(begin < end)
+	{
+		// Blocks are split on character boundaries, so they can be
+		// validated independently.
+		uint8_t const *blockEnd =
+		        begin + std::min(BLOCK_SIZE,
+		                         static_cast<std::size_t>(end - begin));
+		for(std::size_t i = 1; i < MAXIMUM_CHARACTER_LENGTH &&
+		                       blockEnd < end && blockEnd > begin &&
+		                       isUtf8ContinuationByte(*blockEnd);
+		    ++i)
+		{
+			--blockEnd;
+		}
+		if(blockEnd == begin)
+			blockEnd = std::min(begin + BLOCK_SIZE, end);
+
+		if(statistics.valid)
+		{
+			statistics.valid = qompose::core::string::isValidUtf8(
+			        begin, blockEnd);
+		}
+		scanBlock(begin, blockEnd);
+		begin = blockEnd;
+	}
+}
+
+void TextScanner::scanBlock(uint8_t const *begin, uint8_t const *end)
+{
+	static MaskFunction const computeMasks = selectMasks();
+
+	while(begin < end)
+	{
+		std::size_t length = std::min(
+		        MASK_WIDTH, static_cast<std::size_t>(end - begin));
+		BlockMasks masks;
+		if(length == MASK_WIDTH)
+			computeMasks(begin, masks);
+		else
+			masksScalar(begin, length, masks);
+
+		// A CRLF is a '\n' whose preceding byte (possibly the last
+		// byte of the previous run) is a '\r'.
+		uint64_t afterCr = (masks.carriageReturns << 1) |
+		                   (afterCarriageReturn ? 1U : 0U);
+		std::size_t crlfs = popcount(masks.lineFeeds & afterCr);
+		statistics.lineFeeds += popcount(masks.lineFeeds) - crlfs;
+		statistics.crlfs += crlfs;
+		statistics.carriageReturns += popcount(masks.carriageReturns);
+		statistics.carriageReturns -= crlfs;
+		statistics.characters += popcount(masks.starts);
+		statistics.ascii = statistics.ascii && masks.high == 0;
+
+		std::size_t lineBegin = 0;
+		for(uint64_t lf = masks.lineFeeds; lf != 0; lf &= lf - 1)
+		{
+			std::size_t i = static_cast<std::size_t>(
+			        __builtin_ctzll(lf));
+			lineLength += popcount(masks.starts & lowBits(i) &
+			                       ~lowBits(lineBegin));
+			// Don't count the '\r' of a CRLF as part of the line.
+			lineLength -= (afterCr >> i) & 1U;
+			statistics.longestLine =
+			        std::max(statistics.longestLine, lineLength);
+			if(indexLines)
+			{
+				statistics.lineStarts.push_back(
+				        statistics.bytes + i + 1);
+			}
+			lineLength = 0;
+			lineBegin = i + 1;
+		}
+		lineLength += popcount(masks.starts & lowBits(length) &
+		                       ~lowBits(lineBegin));
+
+		afterCarriageReturn =
+		        ((masks.carriageReturns >> (length - 1)) & 1U) != 0;
+		statistics.bytes += length;
+		begin += length;
+	}
+}
+
+TextStatistics scanText(uint8_t const *begin, uint8_t const *end,
+                        bool indexLines)
+{
+	TextScanner scanner(indexLines);
+	scanner.scan(begin, end);
+	return scanner.finish();
+}
+}
+}
+}
@@ -0,0 +1,175 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_document_TextScanner_HPP
+#define qompose_core_document_TextScanner_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace qompose
+{
+namespace core
+{
+namespace document
+{
+enum class LineEnding
+{
+	Lf,
+	CrLf,
+	Cr
+};
+
+/*!
+ * \brief TextStatistics describe some UTF-8 text, as it was loaded.
+ *
+ * Like PieceMetrics, lines are delimited by '\n' characters, so the line
+ * index agrees with PieceTable's: a "\r\n" ends a line, but a lone '\r'
+ * does not (although it is still counted as a line ending).
+ */
+struct TextStatistics
+{
+	bool valid;
+	// Whether or not every byte is less than 0x80.
+	bool ascii;
+	std::size_t bytes;
+	std::size_t characters;
+
+	// The number of each kind of line ending. A '\r' immediately
+	// followed by '\n' is only counted as a CRLF.
+	std::size_t lineFeeds;
+	std::size_t crlfs;
+	std::size_t carriageReturns;
+
+	// The length of the longest line, in characters, not including its
+	// line ending.
+	std::size_t longestLine;
+
+	// The byte offset at which each line starts, if lines were indexed.
+	std::vector<std::size_t> lineStarts;
+
+	TextStatistics();
+
+	TextStatistics(TextStatistics const &) = default;
+	TextStatistics(TextStatistics &&) = default;
+	TextStatistics &operator=(TextStatistics const &) = default;
+	TextStatistics &operator=(TextStatistics &&) = default;
+
+	~TextStatistics() = default;
+
+	/*!
+	 * \return The number of lines, which is always at least one.
+	 */
+	std::size_t lineCount() const;
+
+	/*!
+	 * \return The most common kind of line ending, preferring LF (and
+	 * then CRLF) in case of a tie. Text without any line endings is
+	 * considered to use LF.
+	 */
+	LineEnding lineEnding() const;
+
+	/*!
+	 * \return Whether more than one kind of line ending is used.
+	 */
+	bool hasMixedLineEndings() const;
+};
+
+/*!
+ * \brief A TextScanner computes TextStatistics in a single pass.
+ *
+ * The text can be given in any number of chunks, which may split UTF-8
+ * characters or CRLF line endings; this is handy when the text is being
+ * produced incrementally (e.g. by a TextDecoder).
+ *
+ * The scan is done one cache-sized block at a time: each block is
+ * validated, and then its line endings and characters are found using the
+ * widest vector instructions the CPU supports, while it is still in
+ * cache. So, the text is only read from memory once.
+ */
+class TextScanner
+{
+public:
+	/*!
+	 * \param i Whether or not to record the start of every line.
+	 */
+	explicit TextScanner(bool i = true);
+
+	TextScanner(TextScanner const &) = default;
+	TextScanner(TextScanner &&) = default;
+	TextScanner &operator=(TextScanner const &) = default;
+	TextScanner &operator=(TextScanner &&) = default;
+
+	~TextScanner() = default;
+
+	/*!
+	 * Scan the next chunk of text.
+	 *
+	 * \param begin The first byte of the chunk.
+	 * \param end The end of the chunk.
+	 */
+	void scan(uint8_t const *begin, uint8_t const *end);
+
+	/*!
+	 * Finish scanning, after the last chunk has been scanned. Any
+	 * incomplete character at the end of the text makes it invalid.
+	 *
+	 * \return The statistics for all of the scanned text.
+	 */
+	TextStatistics const &finish();
+
+	/*!
+	 * \return The statistics for the text scanned so far, not
+	 * including any incomplete character at the end of the last
+	 * chunk, or the last line (if it hasn't ended yet).
+	 */
+	TextStatistics const &getStatistics() const;
+
+private:
+	bool indexLines;
+	TextStatistics statistics;
+
+	// The number of characters in the current line so far.
+	std::size_t lineLength;
+	// Whether or not the last byte scanned was a '\r'.
+	bool afterCarriageReturn;
+
+	// An incomplete character at the end of the last chunk.
+	uint8_t pending[6];
+	std::size_t pendingLength;
+
+	void scanCompleteCharacters(uint8_t const *begin, uint8_t const *end);
+	void scanBlock(uint8_t const *begin, uint8_t const *end);
+};
+
+/*!
+ * A convenience function to scan a single contiguous range of text.
+ *
+ * \param begin The first byte of the text.
+ * \param end The end of the text.
+ * \param indexLines Whether or not to record the start of every line.
+ * \return The statistics for the given text.
+ */
+TextStatistics scanText(uint8_t const *begin, uint8_t const *end,
+                        bool indexLines = true);
+}
+}
+}
+
+#endif
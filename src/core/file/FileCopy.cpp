@@ -0,0 +1,118 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileCopy.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <bdrck/util/Error.hpp>
+
+namespace
+{
+// The size of the buffer used to copy ranges in userspace.
+constexpr std::size_t COPY_BUFFER_SIZE = 1024 * 1024;
+
+/*!
+ * \return Whether the given copy_file_range() error means it can't be
+ * used for these descriptors at all, as opposed to a real I/O error.
+ */
+bool isUnsupportedCopyError(int error)
+{
+	return error == ENOSYS || error == EXDEV || error == EINVAL ||
+	       error == EOPNOTSUPP || error == EBADF;
+}
+
+std::size_t copyInUserspace(int from, std::size_t offset, int to,
+                            std::size_t length)
+{
+	std::vector<uint8_t> buffer(std::min(length, COPY_BUFFER_SIZE));
+	std::size_t copied = 0;
+	while(copied < length)
+	{
+		std::size_t chunk = std::min(length - copied, buffer.size());
+		ssize_t r = pread(from, buffer.data(), chunk,
+		                  static_cast<off_t>(offset + copied));
+		if(r == -1 && errno == EINTR)
+			continue;
+		if(r == -1)
+			bdrck::util::error::throwErrnoError();
+		if(r == 0)
+			break;
+
+		qompose::core::file::writeFully(to, buffer.data(),
+		                                buffer.data() + r);
+		copied += static_cast<std::size_t>(r);
+	}
+	return copied;
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace file
+{
+std::size_t copyFileRange(int from, std::size_t offset, int to,
+                          std::size_t length)
+{
+	loff_t fromOffset = static_cast<loff_t>(offset);
+	std::size_t copied = 0;
+	while(copied < length)
+	{
+		ssize_t r = copy_file_range(from, &fromOffset, to, nullptr,
+		                            length - copied, 0);
+		if(r == -1 && errno == EINTR)
+			continue;
+		if(r == -1)
+		{
+			// Older kernels only support copying within the same
+			// filesystem (and some filesystems not at all).
+			if(!isUnsupportedCopyError(errno))
+				bdrck::util::error::throwErrnoError();
+			return copied + copyInUserspace(from, offset + copied,
+			                                to, length - copied);
+		}
+		if(r == 0)
+			break;
+		copied += static_cast<std::size_t>(r);
+	}
+	return copied;
+}
+
+void writeFully(int fd, uint8_t const *begin, uint8_t const *end)
+{
+	while(begin < end)
+	{
+		ssize_t r =
+		        write(fd, begin, static_cast<std::size_t>(end - begin));
+		if(r == -1 && errno == EINTR)
+			continue;
+		if(r == -1)
+			bdrck::util::error::throwErrnoError();
+		begin += r;
+	}
+}
+}
+}
+}
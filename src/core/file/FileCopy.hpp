@@ -0,0 +1,62 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_file_FileCopy_HPP
+#define qompose_core_file_FileCopy_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace qompose
+{
+namespace core
+{
+namespace file
+{
+/*!
+ * Append a range of one file to another, at the destination's current
+ * offset, without copying it through userspace if possible. This uses
+ * copy_file_range(), which lets filesystems which support it share the
+ * range's extents (i.e., reflink it) instead of copying any data. If the
+ * kernel or filesystem doesn't support that, the range is copied with
+ * pread() and write() instead.
+ *
+ * \param from The descriptor to copy from, which isn't modified.
+ * \param offset The offset of the range to copy.
+ * \param to The descriptor to copy to.
+ * \param length The length of the range to copy, in bytes.
+ * \return The number of bytes copied, which is less than length only if
+ * the source ends before the end of the range.
+ */
+std::size_t copyFileRange(int from, std::size_t offset, int to,
+                          std::size_t length);
+
+/*!
+ * Write all of the given bytes to the given descriptor, at its current
+ * offset, retrying after short writes.
+ *
+ * \param fd The descriptor to write to.
+ * \param begin The first byte to write.
+ * \param end The end of the bytes to write.
+ */
+void writeFully(int fd, uint8_t const *begin, uint8_t const *end);
+}
+}
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileWatcher.hpp"
+
+#include <cerrno>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <bdrck/util/Error.hpp>
+
+namespace
+{
+constexpr uint32_t WATCHED_EVENTS = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                    IN_MOVE_SELF | IN_DELETE_SELF;
+
+constexpr std::size_t EVENT_BUFFER_SIZE = 4096;
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace file
+{
+FileWatcher::FileWatcher(std::string const &path, Callback const &c)
+        : callback(c), inotifyFd(-1), stopFds{-1, -1}, worker()
+{
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(inotifyFd == -1)
+		bdrck::util::error::throwErrnoError();
+
+	if(inotify_add_watch(inotifyFd, path.c_str(), WATCHED_EVENTS) == -1 ||
+	   pipe2(stopFds, O_CLOEXEC) == -1)
+	{
+		int error = errno;
+		close(inotifyFd);
+		errno = error;
+		bdrck::util::error::throwErrnoError();
+	}
+
+	// Start the worker last, once everything it uses is initialized.
+	worker = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+	// Closing the write end of the pipe wakes the worker up.
+	close(stopFds[1]);
+	worker.join();
+	close(stopFds[0]);
+	close(inotifyFd);
+}
+
+void FileWatcher::run()
+{
+	alignas(struct inotify_event) char buffer[EVENT_BUFFER_SIZE];
+	struct pollfd fds[2] = {{inotifyFd, POLLIN, 0},
+	                        {stopFds[0], POLLIN, 0}};
+	while(true)
+	{
+		if(poll(fds, 2, -1) == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			return;
+		}
+		if(fds[1].revents != 0)
+			return;
+		if(fds[0].revents == 0)
+			continue;
+
+		// Drain every event which is queued, and then report them all
+		// at once. We don't care which events they were, since the
+		// callback has to check the file's current state anyway.
+		bool removed = false;
+		ssize_t length;
+		while((length = read(inotifyFd, buffer, EVENT_BUFFER_SIZE)) > 0)
+		{
+			for(char *it = buffer; it < buffer + length;)
+			{
+				auto event = reinterpret_cast<
+				        struct inotify_event const *>(it);
+				removed = removed || (event->mask & IN_IGNORED);
+				it += sizeof(struct inotify_event) + event->len;
+			}
+		}
+		callback();
+
+		// Once the file has been deleted, there is nothing else to
+		// watch for.
+		if(removed)
+			return;
+	}
+}
+}
+}
+}
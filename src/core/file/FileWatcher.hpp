@@ -0,0 +1,81 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_file_FileWatcher_HPP
+#define qompose_core_file_FileWatcher_HPP
+
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace qompose
+{
+namespace core
+{
+namespace file
+{
+/*!
+ * \brief Watches a file for changes made by any process.
+ *
+ * This object owns a worker thread which waits for the file to be
+ * modified, have its attributes changed, or be moved or deleted, and
+ * calls a callback whenever it is. Changes which happen close together
+ * are reported with a single call.
+ *
+ * The file is watched by inode, not by path, so e.g. a log file which
+ * is rotated by renaming it is still watched after it has been renamed.
+ *
+ * The callback is called on the worker thread, so it should generally
+ * just hand the notification off to some other thread.
+ */
+class FileWatcher
+{
+public:
+	typedef std::function<void()> Callback;
+
+	/*!
+	 * \param path The path to the file to watch.
+	 * \param c The callback to call whenever the file is changed.
+	 */
+	FileWatcher(std::string const &path, Callback const &c);
+
+	FileWatcher(FileWatcher const &) = delete;
+	FileWatcher(FileWatcher &&) = delete;
+	FileWatcher &operator=(FileWatcher const &) = delete;
+	FileWatcher &operator=(FileWatcher &&) = delete;
+
+	/*!
+	 * Stop watching the file. Once this returns, the callback will not
+	 * be called again.
+	 */
+	~FileWatcher();
+
+private:
+	Callback callback;
+	int inotifyFd;
+	int stopFds[2];
+
+	std::thread worker;
+
+	void run();
+};
+}
+}
+}
+
+#endif
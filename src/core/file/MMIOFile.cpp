@@ -18,7 +18,13 @@
 
 #include "MMIOFile.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
 #include <fcntl.h>
+#include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -29,6 +35,46 @@
 #include <bdrck/fs/ExclusiveFileLock.hpp>
 #include <bdrck/util/Error.hpp>
 
+#include "core/file/SigbusGuard.hpp"
+
+namespace
+{
+/*!
+ * Files no larger than this which are opened to be read sequentially (or
+ * soon) are read in full as they are mapped, instead of one page fault
+ * at a time.
+ */
+constexpr std::size_t POPULATE_THRESHOLD = 8 * 1024 * 1024;
+
+std::size_t pageSize()
+{
+	static std::size_t const size =
+	        static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	return size;
+}
+
+bool isReadOnly(qompose::core::file::MMIOFileMode mode)
+{
+	return mode != qompose::core::file::MMIOFileMode::Exclusive;
+}
+
+int toAdvice(qompose::core::file::MMIOAccessPattern pattern)
+{
+	switch(pattern)
+	{
+	case qompose::core::file::MMIOAccessPattern::Normal:
+		return MADV_NORMAL;
+	case qompose::core::file::MMIOAccessPattern::Sequential:
+		return MADV_SEQUENTIAL;
+	case qompose::core::file::MMIOAccessPattern::Random:
+		return MADV_RANDOM;
+	case qompose::core::file::MMIOAccessPattern::WillNeed:
+		return MADV_WILLNEED;
+	}
+	return MADV_NORMAL;
+}
+}
+
 namespace qompose
 {
 namespace core
@@ -41,9 +87,10 @@ struct FileDescriptorHandle
 {
 	int fd;
 
-	FileDescriptorHandle(std::string const &path) : fd(-1)
+	FileDescriptorHandle(std::string const &path, MMIOFileMode mode)
+	        : fd(-1)
 	{
-		fd = open(path.c_str(), O_RDWR);
+		fd = open(path.c_str(), isReadOnly(mode) ? O_RDONLY : O_RDWR);
 		if(fd == -1)
 			bdrck::util::error::throwErrnoError();
 	}
@@ -57,42 +104,125 @@ struct FileDescriptorHandle
 struct MmapHandle
 {
 	void *handle;
+	std::size_t length;
 
-	MmapHandle(int fd, struct stat const &stats) : handle(nullptr)
+	MmapHandle(int fd, struct stat const &stats, MMIOFileMode mode,
+	           bool populate)
+	        : handle(nullptr),
+	          length(static_cast<std::size_t>(stats.st_size))
 	{
-		handle = mmap(nullptr, static_cast<std::size_t>(stats.st_size),
-		              PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		int flags = populate ? MAP_POPULATE : 0;
+
+		// Read-only mappings are shared, so they don't need to reserve
+		// memory for copy-on-write pages which will never be written.
+		if(isReadOnly(mode))
+		{
+			handle = mmap(nullptr, length, PROT_READ,
+			              MAP_SHARED | flags, fd, 0);
+		}
+		else
+		{
+			handle = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+			              MAP_PRIVATE | flags, fd, 0);
+		}
 		if(handle == MAP_FAILED)
+			bdrck::util::error::throwErrnoError();
+		guardMapping(handle, length);
+	}
+
+	MmapHandle(MmapHandle const &) = delete;
+	MmapHandle &operator=(MmapHandle const &) = delete;
+
+	~MmapHandle()
+	{
+		unguardMapping(handle);
+		munmap(handle, length);
+	}
+
+	/*!
+	 * Replace this mapping with anonymous memory, at the same address,
+	 * containing only the given ranges of the mapping's contents. The
+	 * rest of the memory is zero-filled.
+	 */
+	void replace(std::vector<MMIOFile::Range> const &ranges)
+	{
+		void *copy = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+		                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(copy == MAP_FAILED)
+			bdrck::util::error::throwErrnoError();
+
+		// Any pages which are already gone read as zeros, thanks to
+		// our SIGBUS guard.
+		for(auto const &range : ranges)
+		{
+			if(range.first >= length)
+				continue;
+			std::size_t count =
+			        std::min(range.second, length - range.first);
+			std::memcpy(static_cast<uint8_t *>(copy) + range.first,
+			            static_cast<uint8_t const *>(handle) +
+			                    range.first,
+			            count);
+		}
+
+		// Moving the copy on top of the mapping replaces it in one
+		// step, so other threads never see the address unmapped.
+		if(mprotect(copy, length, PROT_READ) == -1 ||
+		   mremap(copy, length, length, MREMAP_MAYMOVE | MREMAP_FIXED,
+		          handle) == MAP_FAILED)
 		{
+			int error = errno;
+			munmap(copy, length);
+			errno = error;
+			bdrck::util::error::throwErrnoError();
 		}
+		unguardMapping(handle);
 	}
 };
 
 struct MMIOFileImpl
 {
-	bdrck::fs::ExclusiveFileLock lock;
-	FileDescriptorHandle fdHandle;
+	MMIOFileMode mode;
+	boost::optional<bdrck::fs::ExclusiveFileLock> lock;
+	// Once the file is detached, it is closed (and unlocked).
+	boost::optional<FileDescriptorHandle> fdHandle;
 	struct stat stats;
 	boost::optional<MmapHandle> fileHandle;
 
-	MMIOFileImpl(std::string const &path)
-	        : lock(path), fdHandle(path), stats(), fileHandle(boost::none)
+	MMIOFileImpl(std::string const &path, MMIOFileMode m,
+	             MMIOAccessPattern pattern)
+	        : mode(m),
+	          lock(boost::none),
+	          fdHandle(boost::none),
+	          stats(),
+	          fileHandle(boost::none)
 	{
-		int ret = fstat(fdHandle.fd, &stats);
+		fdHandle.emplace(path, m);
+
+		// A shared lock is held by our own descriptor, so it is
+		// released when the descriptor is closed.
+		if(mode == MMIOFileMode::Exclusive)
+		{
+			lock.emplace(path);
+		}
+		else if(mode == MMIOFileMode::Shared &&
+		        flock(fdHandle->fd, LOCK_SH) == -1)
+		{
+			bdrck::util::error::throwErrnoError();
+		}
+
+		int ret = fstat(fdHandle->fd, &stats);
 		if(ret == -1)
 			bdrck::util::error::throwErrnoError();
 
 		if(stats.st_size > 0)
 		{
-			fileHandle.emplace(fdHandle.fd, stats);
-
-			ret = madvise(fileHandle->handle,
-			              static_cast<std::size_t>(stats.st_size),
-			              MADV_RANDOM);
-			if(ret == -1)
-			{
-				bdrck::util::error::throwErrnoError();
-			}
+			bool populate =
+			        (pattern == MMIOAccessPattern::Sequential ||
+			         pattern == MMIOAccessPattern::WillNeed) &&
+			        size() <= POPULATE_THRESHOLD;
+			fileHandle.emplace(fdHandle->fd, stats, mode, populate);
+			advise(pattern, 0, size());
 		}
 	}
 
@@ -114,14 +244,128 @@ struct MMIOFileImpl
 	{
 		return static_cast<std::size_t>(stats.st_size);
 	}
+
+	/*!
+	 * Give the given madvise() advice for part of the mapping. The range
+	 * is widened to page boundaries, and clamped to the file.
+	 *
+	 * \return The result of madvise(), or 0 if the range is empty.
+	 */
+	int adviseRange(int advice, std::size_t offset, std::size_t length)
+	{
+		if(!fileHandle || offset >= size())
+			return 0;
+
+		std::size_t misalignment = offset % pageSize();
+		length = std::min(length, size() - offset) + misalignment;
+		offset -= misalignment;
+		return madvise(static_cast<uint8_t *>(fileHandle->handle) +
+		                       offset,
+		               length, advice);
+	}
+
+	void advise(MMIOAccessPattern pattern, std::size_t offset,
+	            std::size_t length)
+	{
+		if(adviseRange(toAdvice(pattern), offset, length) == -1)
+			bdrck::util::error::throwErrnoError();
+	}
+
+	void populate(std::size_t offset, std::size_t length)
+	{
+#ifdef MADV_POPULATE_READ
+		if(adviseRange(MADV_POPULATE_READ, offset, length) == 0)
+			return;
+		// Kernels older than 5.14 don't support this, in which case
+		// we fault the pages in ourselves instead.
+		if(errno != EINVAL)
+			bdrck::util::error::throwErrnoError();
+#endif
+
+		if(!fileHandle || offset >= size())
+			return;
+		length = std::min(length, size() - offset);
+		if(length == 0)
+			return;
+		uint8_t const volatile *bytes = data() + offset;
+		for(std::size_t i = 0; i < length; i += pageSize())
+			bytes[i];
+		bytes[length - 1];
+	}
+
+	bool adviseHugePages(bool enabled)
+	{
+		int advice = enabled ? MADV_HUGEPAGE : MADV_NOHUGEPAGE;
+		return adviseRange(advice, 0, size()) == 0;
+	}
+
+	MMIOFileChange getChange() const
+	{
+		if(!fdHandle)
+			return MMIOFileChange::None;
+		if(!!fileHandle && hasGuardedFault(fileHandle->handle))
+			return MMIOFileChange::Truncated;
+
+		struct stat current;
+		if(fstat(fdHandle->fd, &current) == -1)
+			bdrck::util::error::throwErrnoError();
+		if(current.st_size < stats.st_size)
+			return MMIOFileChange::Truncated;
+		if(current.st_size > stats.st_size)
+			return MMIOFileChange::Extended;
+		if(current.st_mtim.tv_sec != stats.st_mtim.tv_sec ||
+		   current.st_mtim.tv_nsec != stats.st_mtim.tv_nsec)
+		{
+			return MMIOFileChange::Modified;
+		}
+		return MMIOFileChange::None;
+	}
+
+	void detach(std::vector<MMIOFile::Range> const &ranges)
+	{
+		if(!fdHandle)
+			return;
+		if(!!fileHandle)
+			fileHandle->replace(ranges);
+		fdHandle = boost::none;
+		lock = boost::none;
+	}
+
+	void zero(MMIOFile::Range const &range)
+	{
+		if(!!fdHandle)
+		{
+			throw std::runtime_error(
+			        "Only detached files can be modified.");
+		}
+		if(!fileHandle || range.first >= size())
+			return;
+
+		// Our copy is read-only, so make just the pages in the range
+		// writable while we change them.
+		std::size_t length =
+		        std::min(range.second, size() - range.first);
+		std::size_t first = range.first - range.first % pageSize();
+		std::size_t pages = range.first + length - first;
+		uint8_t *bytes = static_cast<uint8_t *>(fileHandle->handle);
+		if(mprotect(bytes + first, pages, PROT_READ | PROT_WRITE) == -1)
+			bdrck::util::error::throwErrnoError();
+		std::memset(bytes + range.first, 0, length);
+		if(mprotect(bytes + first, pages, PROT_READ) == -1)
+			bdrck::util::error::throwErrnoError();
+	}
 };
 }
 
-MMIOFile::MMIOFile(std::string const &path)
-        : impl(std::make_unique<detail::MMIOFileImpl>(path))
+MMIOFile::MMIOFile(std::string const &path, MMIOFileMode mode,
+                   MMIOAccessPattern pattern)
+        : impl(std::make_unique<detail::MMIOFileImpl>(path, mode, pattern))
 {
 }
 
+MMIOFile::MMIOFile(MMIOFile &&) = default;
+MMIOFile &MMIOFile::operator=(MMIOFile &&) = default;
+
 MMIOFile::~MMIOFile()
 {
 }
@@ -135,6 +379,63 @@ std::size_t MMIOFile::size() const
 {
 	return impl->size();
 }
+
+MMIOFileMode MMIOFile::getMode() const
+{
+	return impl->mode;
+}
+
+void MMIOFile::advise(MMIOAccessPattern pattern, std::size_t offset,
+                      std::size_t length)
+{
+	impl->advise(pattern, offset, length);
+}
+
+void MMIOFile::populate(std::size_t offset, std::size_t length)
+{
+	impl->populate(offset, length);
+}
+
+bool MMIOFile::adviseHugePages(bool enabled)
+{
+	return impl->adviseHugePages(enabled);
+}
+
+MMIOFileChange MMIOFile::getChange() const
+{
+	return impl->getChange();
+}
+
+void MMIOFile::detach(std::vector<Range> const &ranges)
+{
+	impl->detach(ranges);
+}
+
+void MMIOFile::detach()
+{
+	detach({Range(0, size())});
+}
+
+bool MMIOFile::isDetached() const
+{
+	return !impl->fdHandle;
+}
+
+void MMIOFile::zero(Range const &range)
+{
+	impl->zero(range);
+}
+
+int MMIOFile::duplicateDescriptor() const
+{
+	if(!impl->fdHandle)
+		return -1;
+
+	int fd = fcntl(impl->fdHandle->fd, F_DUPFD_CLOEXEC, 0);
+	if(fd == -1)
+		bdrck::util::error::throwErrnoError();
+	return fd;
+}
 }
 }
 }
@@ -23,6 +23,8 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace qompose
 {
@@ -35,21 +37,189 @@ namespace detail
 struct MMIOFileImpl;
 }
 
+/*!
+ * \brief How an MMIOFile opens and locks its file.
+ */
+enum class MMIOFileMode
+{
+	/*!
+	 * The file is opened for reading and writing, and is locked
+	 * exclusively for as long as it is mapped.
+	 */
+	Exclusive,
+
+	/*!
+	 * The file is opened and mapped read-only, and holds a shared lock,
+	 * so any number of readers can map it at once (but not while it is
+	 * locked exclusively).
+	 */
+	Shared,
+
+	/*!
+	 * The file is opened and mapped read-only, without any locking.
+	 */
+	Unlocked
+};
+
+/*!
+ * \brief How the contents of a mapped file are expected to be accessed.
+ *
+ * This is passed along to the kernel (see madvise(2)), which uses it to
+ * decide how much to read ahead of page faults, and which pages to evict
+ * first.
+ */
+enum class MMIOAccessPattern
+{
+	Normal,
+	// Read from beginning to end, e.g. while loading or scanning.
+	Sequential,
+	// Read in no particular order, e.g. while editing.
+	Random,
+	// Read soon; starts reading the pages in the background.
+	WillNeed
+};
+
+/*!
+ * \brief How a mapped file has been changed since it was mapped.
+ */
+enum class MMIOFileChange
+{
+	None,
+	// The file grew, e.g. because something was appended to it.
+	Extended,
+	// The file's contents were modified, but it is the same size.
+	Modified,
+	// The file shrank, so some of the mapping has been lost.
+	Truncated
+};
+
+/*!
+ * \brief A disk file which has been mapped into memory.
+ *
+ * Small files opened with the Sequential or WillNeed access pattern are
+ * read in full when they are mapped, since they'll be read in full soon
+ * anyway.
+ *
+ * The mapping reflects changes other processes make to the file. If the
+ * file is truncated, reading the part of the mapping past its new end
+ * yields zeros instead of raising SIGBUS (see guardMapping()). To stop
+ * seeing changes, the file can be detached, which replaces the mapping
+ * with a private copy of (some of) its contents.
+ *
+ * Implements the TextResource Concept defined in
+ * core/document/PieceTable.hpp.
+ */
 class MMIOFile
 {
 public:
-	MMIOFile(std::string const &path);
+	// A range of bytes in the file, as an offset and a length.
+	typedef std::pair<std::size_t, std::size_t> Range;
+
+	MMIOFile(std::string const &path,
+	         MMIOFileMode mode = MMIOFileMode::Exclusive,
+	         MMIOAccessPattern pattern = MMIOAccessPattern::Random);
 
 	MMIOFile(MMIOFile const &) = delete;
-	MMIOFile(MMIOFile &&) = default;
+	MMIOFile(MMIOFile &&);
 	MMIOFile &operator=(MMIOFile const &) = delete;
-	MMIOFile &operator=(MMIOFile &&) = default;
+	MMIOFile &operator=(MMIOFile &&);
 
 	~MMIOFile();
 
 	uint8_t const *data() const;
 	std::size_t size() const;
 
+	MMIOFileMode getMode() const;
+
+	/*!
+	 * Change how (part of) the mapped file is expected to be accessed.
+	 * The range is widened to page boundaries as necessary, and is
+	 * clamped to the size of the file.
+	 *
+	 * \param pattern The new access pattern.
+	 * \param offset The offset of the first byte the pattern applies to.
+	 * \param length The number of bytes the pattern applies to.
+	 */
+	void advise(MMIOAccessPattern pattern, std::size_t offset = 0,
+	            std::size_t length = SIZE_MAX);
+
+	/*!
+	 * Read (part of) the mapped file into memory now, so accessing it
+	 * later doesn't stall on page faults. Unlike WillNeed advice, this
+	 * blocks until the pages are resident, so it is meant to be called
+	 * from a worker thread (see MMIOPrefetcher).
+	 *
+	 * \param offset The offset of the first byte to read.
+	 * \param length The number of bytes to read.
+	 */
+	void populate(std::size_t offset = 0, std::size_t length = SIZE_MAX);
+
+	/*!
+	 * Hint whether the mapping should be backed by transparent huge
+	 * pages, which reduces TLB misses when scanning very large files.
+	 * Not every kernel supports this for file mappings, in which case
+	 * the hint is ignored.
+	 *
+	 * \param enabled Whether huge pages should be used.
+	 * \return Whether or not the hint was accepted.
+	 */
+	bool adviseHugePages(bool enabled);
+
+	/*!
+	 * Check whether the file has been changed (by any process) since it
+	 * was mapped, by comparing its current size and modification time
+	 * to those it had when it was mapped. Renaming or replacing the file
+	 * doesn't change the file we have mapped, so it isn't detected.
+	 *
+	 * \return How the file has changed, or None if it is detached.
+	 */
+	MMIOFileChange getChange() const;
+
+	/*!
+	 * Replace the mapping with private memory which contains only the
+	 * given ranges of the file's contents, and close the file. The rest
+	 * of the memory reads as zeros. The memory remains at the same
+	 * address, so pointers into it remain valid, but it no longer
+	 * reflects changes to the file.
+	 *
+	 * Only the given ranges are copied, so detaching a huge file of
+	 * which only a small part is still referenced is cheap. Any part of
+	 * the file which has already been truncated is lost, and reads as
+	 * zeros.
+	 *
+	 * \param ranges The ranges of the file's contents to keep.
+	 */
+	void detach(std::vector<Range> const &ranges);
+
+	/*!
+	 * Detach from the file, keeping all of its contents.
+	 */
+	void detach();
+
+	bool isDetached() const;
+
+	/*!
+	 * Overwrite part of a detached file's private copy of its contents
+	 * with zeros, e.g. because the bytes which were copied turned out
+	 * to be unusable. The range is clamped to the size of the file.
+	 * This throws if the file isn't detached, since its contents are
+	 * shared with the file until then.
+	 *
+	 * \param range The range of bytes to overwrite.
+	 */
+	void zero(Range const &range);
+
+	/*!
+	 * Return a new descriptor for the mapped file, e.g. so parts of it
+	 * can be copied by the kernel without reading them through the
+	 * mapping. The descriptor remains valid (and keeps referring to the
+	 * same file) even if this file is detached later on; the caller is
+	 * responsible for closing it.
+	 *
+	 * \return A new descriptor, or -1 if the file is detached.
+	 */
+	int duplicateDescriptor() const;
+
 private:
 	std::unique_ptr<detail::MMIOFileImpl> impl;
 };
@@ -0,0 +1,119 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MMIOPrefetcher.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace qompose
+{
+namespace core
+{
+namespace file
+{
+constexpr std::size_t MMIOPrefetcher::MAXIMUM_PENDING_REQUESTS;
+
+MMIOPrefetcher::MMIOPrefetcher(std::shared_ptr<MMIOFile> const &f)
+        : file(f),
+          mutex(),
+          changed(),
+          pending(),
+          busy(false),
+          stopping(false),
+          worker()
+{
+	// Start the worker last, once everything it uses is initialized.
+	worker = std::thread(&MMIOPrefetcher::run, this);
+}
+
+MMIOPrefetcher::~MMIOPrefetcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		pending.clear();
+	}
+	changed.notify_all();
+	worker.join();
+}
+
+std::shared_ptr<MMIOFile> const &MMIOPrefetcher::getFile() const
+{
+	return file;
+}
+
+void MMIOPrefetcher::prefetch(uint8_t const *begin, uint8_t const *end)
+{
+	uint8_t const *fileBegin = file->data();
+	uint8_t const *fileEnd = fileBegin + file->size();
+	begin = std::max(begin, fileBegin);
+	end = std::min(end, fileEnd);
+	if(begin >= end)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.emplace_back(
+		        static_cast<std::size_t>(begin - fileBegin),
+		        static_cast<std::size_t>(end - begin));
+		if(pending.size() > MAXIMUM_PENDING_REQUESTS)
+			pending.pop_front();
+	}
+	changed.notify_all();
+}
+
+void MMIOPrefetcher::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this]() { return pending.empty() && !busy; });
+}
+
+void MMIOPrefetcher::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true)
+	{
+		changed.wait(lock,
+		             [this]() { return stopping || !pending.empty(); });
+		if(stopping)
+			return;
+
+		Range range = pending.back();
+		pending.pop_back();
+		busy = true;
+		lock.unlock();
+
+		// Prefetching is only an optimization, so if it fails, the
+		// range will just be read more slowly later on.
+		try
+		{
+			file->populate(range.first, range.second);
+		}
+		catch(std::exception const &)
+		{
+		}
+
+		lock.lock();
+		busy = false;
+		changed.notify_all();
+	}
+}
+}
+}
+}
@@ -0,0 +1,117 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_file_MMIOPrefetcher_HPP
+#define qompose_core_file_MMIOPrefetcher_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "core/file/MMIOFile.hpp"
+
+namespace qompose
+{
+namespace core
+{
+namespace file
+{
+/*!
+ * \brief Reads parts of a mapped file into memory in the background.
+ *
+ * Reading a part of a large mapped file for the first time stalls on
+ * page faults, which is noticeable if it happens on e.g. the GUI thread
+ * while painting. This object owns a worker thread which populates the
+ * ranges it is asked to, so they are (hopefully) resident by the time
+ * they are actually read.
+ *
+ * Requests are meant to be made speculatively, e.g. for the next few
+ * screens in the direction the user is scrolling. So, the most recent
+ * requests are handled first, and only the last few requests which
+ * haven't been started yet are kept; older ones are dropped.
+ */
+class MMIOPrefetcher
+{
+public:
+	/*!
+	 * The maximum number of requests which are waiting to be handled.
+	 */
+	static constexpr std::size_t MAXIMUM_PENDING_REQUESTS = 8;
+
+	/*!
+	 * \param f The mapped file to prefetch parts of.
+	 */
+	explicit MMIOPrefetcher(std::shared_ptr<MMIOFile> const &f);
+
+	MMIOPrefetcher(MMIOPrefetcher const &) = delete;
+	MMIOPrefetcher(MMIOPrefetcher &&) = delete;
+	MMIOPrefetcher &operator=(MMIOPrefetcher const &) = delete;
+	MMIOPrefetcher &operator=(MMIOPrefetcher &&) = delete;
+
+	/*!
+	 * Stop the worker thread. A range which is currently being read is
+	 * finished first, but any other pending requests are dropped.
+	 */
+	~MMIOPrefetcher();
+
+	/*!
+	 * \return The mapped file this object prefetches parts of.
+	 */
+	std::shared_ptr<MMIOFile> const &getFile() const;
+
+	/*!
+	 * Request that the given range of bytes be read in the background.
+	 * Since the range is given as pointers, this can be used directly
+	 * with e.g. the spans of a PieceTable; any part of the range which
+	 * is outside of the mapped file is ignored.
+	 *
+	 * \param begin The first byte to read.
+	 * \param end The end of the range of bytes to read.
+	 */
+	void prefetch(uint8_t const *begin, uint8_t const *end);
+
+	/*!
+	 * Block until every request made so far has been handled.
+	 */
+	void wait();
+
+private:
+	typedef std::pair<std::size_t, std::size_t> Range;
+
+	std::shared_ptr<MMIOFile> file;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<Range> pending;
+	bool busy;
+	bool stopping;
+
+	std::thread worker;
+
+	void run();
+};
+}
+}
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SigbusGuard.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <bdrck/util/Error.hpp>
+
+namespace
+{
+/*!
+ * \brief A guarded mapping, as seen by the signal handler.
+ *
+ * The handler can't take locks, so every field is atomic. A slot is in
+ * use while begin is nonzero; it is claimed (under guardMutex) by
+ * setting end before begin, and released by clearing begin first.
+ */
+struct GuardedMapping
+{
+	std::atomic<uintptr_t> begin;
+	std::atomic<uintptr_t> end;
+	std::atomic<bool> faulted;
+};
+
+GuardedMapping guardedMappings[qompose::core::file::MAXIMUM_GUARDED_MAPPINGS];
+std::mutex guardMutex;
+
+struct sigaction previousAction;
+std::size_t guardPageSize = 0;
+
+GuardedMapping *findMapping(uintptr_t begin)
+{
+	for(auto &mapping : guardedMappings)
+	{
+		if(mapping.begin.load() == begin)
+			return &mapping;
+	}
+	return nullptr;
+}
+
+void handleSigbus(int signal, siginfo_t *info, void *context)
+{
+	auto address = reinterpret_cast<uintptr_t>(info->si_addr);
+	for(auto &mapping : guardedMappings)
+	{
+		uintptr_t begin = mapping.begin.load();
+		uintptr_t end = mapping.end.load();
+		if(begin == 0 || address < begin || address >= end)
+			continue;
+
+		// Replace the page with zeros. The faulting access is retried
+		// once we return, and this time it succeeds.
+		uintptr_t page = address - address % guardPageSize;
+		void *replaced = mmap(reinterpret_cast<void *>(page),
+		                      guardPageSize, PROT_READ,
+		                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+		                      -1, 0);
+		if(replaced != MAP_FAILED)
+		{
+			mapping.faulted.store(true);
+			return;
+		}
+	}
+
+	// This isn't one of our faults, so pass it along.
+	if((previousAction.sa_flags & SA_SIGINFO) != 0)
+	{
+		previousAction.sa_sigaction(signal, info, context);
+	}
+	else if(previousAction.sa_handler != SIG_DFL &&
+	        previousAction.sa_handler != SIG_IGN)
+	{
+		previousAction.sa_handler(signal);
+	}
+	else
+	{
+		// Restore the default action; the faulting access is retried
+		// once we return, and this time it isn't caught.
+		sigaction(SIGBUS, &previousAction, nullptr);
+	}
+}
+
+void installHandler()
+{
+	guardPageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+	struct sigaction action;
+	action.sa_sigaction = handleSigbus;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_SIGINFO;
+	if(sigaction(SIGBUS, &action, &previousAction) == -1)
+		bdrck::util::error::throwErrnoError();
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace file
+{
+bool guardMapping(void const *begin, std::size_t length)
+{
+	static std::once_flag installed;
+	std::call_once(installed, installHandler);
+
+	std::lock_guard<std::mutex> lock(guardMutex);
+	GuardedMapping *mapping = findMapping(0);
+	if(mapping == nullptr)
+		return false;
+
+	auto address = reinterpret_cast<uintptr_t>(begin);
+	mapping->faulted.store(false);
+	mapping->end.store(address + length);
+	mapping->begin.store(address);
+	return true;
+}
+
+void unguardMapping(void const *begin)
+{
+	std::lock_guard<std::mutex> lock(guardMutex);
+	GuardedMapping *mapping =
+	        findMapping(reinterpret_cast<uintptr_t>(begin));
+	if(mapping == nullptr)
+		return;
+
+	mapping->begin.store(0);
+	mapping->end.store(0);
+}
+
+bool hasGuardedFault(void const *begin)
+{
+	std::lock_guard<std::mutex> lock(guardMutex);
+	GuardedMapping const *mapping =
+	        findMapping(reinterpret_cast<uintptr_t>(begin));
+	return mapping != nullptr && mapping->faulted.load();
+}
+}
+}
+}
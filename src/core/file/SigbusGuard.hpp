@@ -0,0 +1,70 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_file_SigbusGuard_HPP
+#define qompose_core_file_SigbusGuard_HPP
+
+#include <cstddef>
+
+namespace qompose
+{
+namespace core
+{
+namespace file
+{
+/*!
+ * The maximum number of mappings which can be guarded at once. Mappings
+ * registered beyond this limit simply aren't guarded.
+ */
+constexpr std::size_t MAXIMUM_GUARDED_MAPPINGS = 64;
+
+/*!
+ * Protect the given file mapping against SIGBUS. Accessing a page of a
+ * mapping beyond the end of its file raises SIGBUS, which usually means
+ * the file was truncated by another process after it was mapped. Rather
+ * than crashing, the page is replaced with a page of zeros, and the
+ * access is retried.
+ *
+ * The signal handler which does this is installed the first time a
+ * mapping is guarded. Any SIGBUS for an address outside of the guarded
+ * mappings is passed on to the handler which was installed before it.
+ *
+ * \param begin The beginning of the mapping, which must be page-aligned.
+ * \param length The length of the mapping, in bytes.
+ * \return Whether the mapping is guarded (see MAXIMUM_GUARDED_MAPPINGS).
+ */
+bool guardMapping(void const *begin, std::size_t length);
+
+/*!
+ * Stop guarding the given mapping, e.g. before it is unmapped. This has
+ * no effect if the mapping isn't guarded.
+ *
+ * \param begin The beginning of the mapping, as given to guardMapping().
+ */
+void unguardMapping(void const *begin);
+
+/*!
+ * \param begin The beginning of a guarded mapping.
+ * \return Whether any of the given mapping's pages have been replaced.
+ */
+bool hasGuardedFault(void const *begin);
+}
+}
+}
+
+#endif
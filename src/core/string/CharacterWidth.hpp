@@ -0,0 +1,59 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_string_CharacterWidth_HPP
+#define qompose_core_string_CharacterWidth_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+/*!
+ * Return the number of columns the given character occupies when
+ * displayed in a monospaced font. This is zero for combining marks and
+ * other zero-width characters, two for East Asian wide and fullwidth
+ * characters, and one for everything else (including tabs and other
+ * control characters; see advanceDisplayColumn()).
+ *
+ * \param character The character to measure.
+ * \return The character's display width, in columns.
+ */
+std::size_t characterWidth(uint32_t character);
+
+/*!
+ * Return the display column just after the given character, assuming it
+ * is displayed starting at the given column. Tabs advance to the next
+ * multiple of the tab width.
+ *
+ * \param column The zero-based column the character is displayed at.
+ * \param character The character being displayed.
+ * \param tabWidth The width of a tab stop, in columns.
+ * \return The column after the character.
+ */
+std::size_t advanceDisplayColumn(std::size_t column, uint32_t character,
+                                 std::size_t tabWidth);
+}
+}
+}
+
+#endif
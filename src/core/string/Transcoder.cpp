@@ -0,0 +1,600 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Transcoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "core/string/Utf8Decoder.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QOMPOSE_TRANSCODER_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+using qompose::core::string::TextEncoding;
+
+constexpr uint32_t REPLACEMENT_CHARACTER = 0xFFFDU;
+constexpr uint32_t BYTE_ORDER_MARK = 0xFEFFU;
+
+// The longest possible character in any supported encoding, in bytes.
+// This is a 6-byte UTF-8 sequence.
+constexpr std::size_t MAXIMUM_CHARACTER_SIZE = 6;
+
+/*!
+ * The ASCII kernels convert the run of ASCII characters at the beginning
+ * of the given range, and return a pointer just past the last one they
+ * converted. They may stop early (e.g. if the rest of the range is too
+ * short to be worth vectorizing); the caller deals with any remaining
+ * characters one at a time.
+ */
+struct AsciiKernels
+{
+	// Copy ASCII bytes as-is.
+	uint8_t const *(*copy)(uint8_t const *, uint8_t const *, uint8_t *&);
+	// Convert ASCII UTF-16 code units to single bytes.
+	uint8_t const *(*narrow)(uint8_t const *, uint8_t const *, bool,
+	                         uint8_t *&);
+	// Convert ASCII bytes to UTF-16 code units.
+	uint8_t const *(*widen)(uint8_t const *, uint8_t const *, bool,
+	                        uint8_t *&);
+};
+
+uint8_t const *copyScalar(uint8_t const *begin, uint8_t const *end,
+                          uint8_t *&out)
+{
+	constexpr uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+	while(end - begin >= 8)
+	{
+		uint64_t block;
+		std::memcpy(&block, begin, sizeof(block));
+		if((block & HIGH_BITS) != 0)
+			break;
+		std::memcpy(out, begin, sizeof(block));
+		begin += 8;
+		out += 8;
+	}
+	while(begin < end && *begin < 0x80U)
+		*out++ = *begin++;
+	return begin;
+}
+
+uint8_t const *narrowScalar(uint8_t const *begin, uint8_t const *end,
+                            bool bigEndian, uint8_t *&out)
+{
+	for(; end - begin >= 2; begin += 2)
+	{
+		uint8_t low = bigEndian ? begin[1] : begin[0];
+		uint8_t high = bigEndian ? begin[0] : begin[1];
+		if(high != 0 || low >= 0x80U)
+			break;
+		*out++ = low;
+	}
+	return begin;
+}
+
+uint8_t const *widenScalar(uint8_t const *begin, uint8_t const *end,
+                           bool bigEndian, uint8_t *&out)
+{
+	for(; begin < end && *begin < 0x80U; ++begin)
+	{
+		*out++ = bigEndian ? 0 : *begin;
+		*out++ = bigEndian ? *begin : 0;
+	}
+	return begin;
+}
+
+#ifdef QOMPOSE_TRANSCODER_X86
+__attribute__((target("sse2"))) uint8_t const *
+copySse2(uint8_t const *begin, uint8_t const *end, uint8_t *&out)
+{
+	while(end - begin >= 16)
+	{
+		__m128i block = _mm_loadu_si128(
+		        reinterpret_cast<__m128i const *>(begin));
+		if(_mm_movemask_epi8(block) != 0)
+			break;
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out), block);
+		begin += 16;
+		out += 16;
+	}
+	return copyScalar(begin, end, out);
+}
+
+__attribute__((target("sse2"))) __m128i swapBytes(__m128i units)
+{
+	return _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+}
+
+__attribute__((target("sse2"))) uint8_t const *
+narrowSse2(uint8_t const *begin, uint8_t const *end, bool bigEndian,
+           uint8_t *&out)
+{
+	__m128i const nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+	__m128i const zero = _mm_setzero_si128();
+
+	// Convert 16 code units at a time.
+	while(end - begin >= 32)
+	{
+		__m128i first = _mm_loadu_si128(
+		        reinterpret_cast<__m128i const *>(begin));
+		__m128i second = _mm_loadu_si128(
+		        reinterpret_cast<__m128i const *>(begin + 16));
+		if(bigEndian)
+		{
+			first = swapBytes(first);
+			second = swapBytes(second);
+		}
+
+		__m128i high =
+		        _mm_and_si128(_mm_or_si128(first, second), nonAscii);
+		if(_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF)
+			break;
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+		                 _mm_packus_epi16(first, second));
+		begin += 32;
+		out += 16;
+	}
+	return narrowScalar(begin, end, bigEndian, out);
+}
+
+__attribute__((target("sse2"))) uint8_t const *
+widenSse2(uint8_t const *begin, uint8_t const *end, bool bigEndian,
+          uint8_t *&out)
+{
+	__m128i const zero = _mm_setzero_si128();
+
+	while(end - begin >= 16)
+	{
+		__m128i block = _mm_loadu_si128(
+		        reinterpret_cast<__m128i const *>(begin));
+		if(_mm_movemask_epi8(block) != 0)
+			break;
+
+		__m128i first = bigEndian ? _mm_unpacklo_epi8(zero, block)
+		                          : _mm_unpacklo_epi8(block, zero);
+		__m128i second = bigEndian ? _mm_unpackhi_epi8(zero, block)
+		                           : _mm_unpackhi_epi8(block, zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out), first);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16), second);
+		begin += 16;
+		out += 32;
+	}
+	return widenScalar(begin, end, bigEndian, out);
+}
+#endif
+
+AsciiKernels selectKernels()
+{
+#ifdef QOMPOSE_TRANSCODER_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		return {copySse2, narrowSse2, widenSse2};
+#endif
+	return {copyScalar, narrowScalar, widenScalar};
+}
+
+AsciiKernels const &kernels()
+{
+	static AsciiKernels const selected = selectKernels();
+	return selected;
+}
+
+std::size_t unitSize(TextEncoding encoding)
+{
+	switch(encoding)
+	{
+	case TextEncoding::Latin1:
+		return 1;
+	case TextEncoding::Utf16LE:
+	case TextEncoding::Utf16BE:
+		return 2;
+	case TextEncoding::Utf32LE:
+	case TextEncoding::Utf32BE:
+		return 4;
+	}
+	return 1;
+}
+
+bool isBigEndian(TextEncoding encoding)
+{
+	return encoding == TextEncoding::Utf16BE ||
+	       encoding == TextEncoding::Utf32BE;
+}
+
+uint32_t readUnit(uint8_t const *position, std::size_t size, bool bigEndian)
+{
+	uint32_t unit = 0;
+	for(std::size_t i = 0; i < size; ++i)
+	{
+		std::size_t shift = 8 * (bigEndian ? size - 1 - i : i);
+		unit |= static_cast<uint32_t>(position[i]) << shift;
+	}
+	return unit;
+}
+
+void writeUnit(uint32_t unit, std::size_t size, bool bigEndian,
+               uint8_t *&out)
+{
+	for(std::size_t i = 0; i < size; ++i)
+	{
+		std::size_t shift = 8 * (bigEndian ? size - 1 - i : i);
+		*out++ = static_cast<uint8_t>(unit >> shift);
+	}
+}
+
+bool isNoncharacter(uint32_t character)
+{
+	return (character >= 0xFDD0U && character <= 0xFDEFU) ||
+	       (character & 0xFFFEU) == 0xFFFEU;
+}
+
+/*!
+ * Append the given character to the output as UTF-8. Anything which
+ * isn't valid UTF-8 is replaced with U+FFFD.
+ */
+void writeUtf8(uint32_t character, uint8_t *&out)
+{
+	if((character >= 0xD800U && character <= 0xDFFFU) ||
+	   character > 0x10FFFFU || isNoncharacter(character))
+	{
+		character = REPLACEMENT_CHARACTER;
+	}
+
+	if(character < 0x80U)
+	{
+		*out++ = static_cast<uint8_t>(character);
+	}
+	else if(character < 0x800U)
+	{
+		*out++ = static_cast<uint8_t>(0xC0U | (character >> 6));
+		*out++ = static_cast<uint8_t>(0x80U | (character & 0x3FU));
+	}
+	else if(character < 0x10000U)
+	{
+		*out++ = static_cast<uint8_t>(0xE0U | (character >> 12));
+		*out++ = static_cast<uint8_t>(0x80U |
+		                              ((character >> 6) & 0x3FU));
+		*out++ = static_cast<uint8_t>(0x80U | (character & 0x3FU));
+	}
+	else
+	{
+		*out++ = static_cast<uint8_t>(0xF0U | (character >> 18));
+		*out++ = static_cast<uint8_t>(0x80U |
+		                              ((character >> 12) & 0x3FU));
+		*out++ = static_cast<uint8_t>(0x80U |
+		                              ((character >> 6) & 0x3FU));
+		*out++ = static_cast<uint8_t>(0x80U | (character & 0x3FU));
+	}
+}
+
+/*!
+ * Append the given character to the output in the given encoding,
+ * replacing it if the encoding can't represent it.
+ */
+void writeCharacter(TextEncoding encoding, uint32_t character,
+                    uint8_t *&out)
+{
+	if(encoding == TextEncoding::Latin1)
+	{
+		*out++ = static_cast<uint8_t>(character <= 0xFFU ? character
+		                                                 : '?');
+		return;
+	}
+
+	if(character > 0x10FFFFU)
+		character = REPLACEMENT_CHARACTER;
+
+	bool bigEndian = isBigEndian(encoding);
+	std::size_t size = unitSize(encoding);
+	if(size == 2 && character >= 0x10000U)
+	{
+		character -= 0x10000U;
+		writeUnit(0xD800U | (character >> 10), 2, bigEndian, out);
+		writeUnit(0xDC00U | (character & 0x3FFU), 2, bigEndian, out);
+		return;
+	}
+	writeUnit(character, size, bigEndian, out);
+}
+
+/*!
+ * Convert as much of the given range from the given encoding to UTF-8 as
+ * possible. Unless this is the final chunk, this stops at an incomplete
+ * character at the end of the range.
+ *
+ * \return A pointer just past the last byte which was converted.
+ */
+uint8_t const *decodeChunk(TextEncoding encoding, bool &atStart,
+                           uint8_t const *begin, uint8_t const *end,
+                           bool final, uint8_t *&out)
+{
+	AsciiKernels const &ascii = kernels();
+	std::size_t size = unitSize(encoding);
+	bool bigEndian = isBigEndian(encoding);
+
+	if(atStart && encoding != TextEncoding::Latin1)
+	{
+		if(static_cast<std::size_t>(end - begin) < size && !final)
+			return begin;
+		if(static_cast<std::size_t>(end - begin) >= size &&
+		   readUnit(begin, size, bigEndian) == BYTE_ORDER_MARK)
+		{
+			begin += size;
+		}
+	}
+	atStart = false;
+
+	while(static_cast<std::size_t>(end - begin) >= size)
+	{
+		if(size == 1)
+			begin = ascii.copy(begin, end, out);
+		else if(size == 2)
+			begin = ascii.narrow(begin, end, bigEndian, out);
+		if(static_cast<std::size_t>(end - begin) < size)
+			break;
+
+		uint32_t unit = readUnit(begin, size, bigEndian);
+		if(size == 2 && unit >= 0xD800U && unit <= 0xDBFFU)
+		{
+			// A high surrogate is only meaningful together with
+			// the low surrogate after it.
+			bool complete = end - begin >= 4;
+			if(!complete && !final)
+				return begin;
+			uint32_t low = 0;
+			if(complete)
+				low = readUnit(begin + 2, 2, bigEndian);
+			if(low >= 0xDC00U && low <= 0xDFFFU)
+			{
+				writeUtf8(0x10000U + ((unit - 0xD800U) << 10) +
+				                  (low - 0xDC00U),
+				          out);
+				begin += 4;
+				continue;
+			}
+		}
+
+		writeUtf8(unit, out);
+		begin += size;
+	}
+
+	if(begin < end)
+	{
+		if(!final)
+			return begin;
+		writeUtf8(REPLACEMENT_CHARACTER, out);
+	}
+	return end;
+}
+
+/*!
+ * Convert as much of the given range from UTF-8 to the given encoding as
+ * possible. Unless this is the final chunk, this stops at an incomplete
+ * character at the end of the range.
+ *
+ * \return A pointer just past the last byte which was converted.
+ */
+uint8_t const *encodeChunk(TextEncoding encoding, bool byteOrderMark,
+                           bool &atStart, uint8_t const *begin,
+                           uint8_t const *end, bool final, uint8_t *&out)
+{
+	AsciiKernels const &ascii = kernels();
+	std::size_t size = unitSize(encoding);
+	bool bigEndian = isBigEndian(encoding);
+
+	if(atStart && byteOrderMark && encoding != TextEncoding::Latin1)
+		writeCharacter(encoding, BYTE_ORDER_MARK, out);
+	atStart = false;
+
+	while(begin < end)
+	{
+		if(size == 1)
+			begin = ascii.copy(begin, end, out);
+		else if(size == 2)
+			begin = ascii.widen(begin, end, bigEndian, out);
+		if(begin == end)
+			break;
+
+		using qompose::core::string::Utf8DecodeResult;
+		using qompose::core::string::Utf8DecodeStatus;
+		Utf8DecodeResult result;
+		Utf8DecodeStatus status = qompose::core::string::
+		        decodeUtf8Character(begin, end, result);
+		if(status == Utf8DecodeStatus::Ok)
+		{
+			writeCharacter(encoding, result.value, out);
+			begin = result.currentEnd;
+			continue;
+		}
+		if(status == Utf8DecodeStatus::Truncated && !final)
+			return begin;
+
+		// Replace the invalid byte, along with any continuation bytes
+		// after it (which can't begin a character anyway).
+		writeCharacter(encoding, REPLACEMENT_CHARACTER, out);
+		do
+			++begin;
+		while(begin < end && (*begin & 0xC0U) == 0x80U);
+	}
+	return end;
+}
+
+/*!
+ * Run the given chunk converter over the given range, first finishing
+ * the incomplete character left pending by the previous chunk (if any),
+ * and then leaving any incomplete character at the end of this chunk
+ * pending in turn.
+ *
+ * \param maximumExpansion The most output bytes the converter can
+ * produce for each input byte.
+ */
+template <typename Converter>
+void transcode(uint8_t *pending, std::size_t &pendingLength,
+               uint8_t const *begin, uint8_t const *end, bool final,
+               std::size_t maximumExpansion, std::vector<uint8_t> &output,
+               Converter const &convert)
+{
+	std::size_t length = static_cast<std::size_t>(end - begin);
+	std::size_t offset = output.size();
+	output.resize(offset + (pendingLength + length) * maximumExpansion +
+	              2 * MAXIMUM_CHARACTER_SIZE);
+	uint8_t *out = output.data() + offset;
+
+	if(pendingLength > 0)
+	{
+		// Borrow enough bytes from this chunk to complete the pending
+		// character, and convert the two together.
+		uint8_t joined[2 * MAXIMUM_CHARACTER_SIZE];
+		std::size_t borrowed = std::min(length, MAXIMUM_CHARACTER_SIZE);
+		std::copy(pending, pending + pendingLength, joined);
+		std::copy(begin, begin + borrowed, joined + pendingLength);
+
+		std::size_t joinedLength = pendingLength + borrowed;
+		std::size_t consumed = static_cast<std::size_t>(
+		        convert(joined, joined + joinedLength,
+		                final && borrowed == length, out) -
+		        joined);
+		if(consumed < pendingLength)
+		{
+			// This chunk was too short to complete the character.
+			std::copy(joined + consumed, joined + joinedLength,
+			          pending);
+			pendingLength = joinedLength - consumed;
+			begin = end;
+		}
+		else
+		{
+			begin += consumed - pendingLength;
+			pendingLength = 0;
+		}
+	}
+
+	if(pendingLength == 0)
+	{
+		uint8_t const *stop = convert(begin, end, final, out);
+		std::copy(stop, end, pending);
+		pendingLength = static_cast<std::size_t>(end - stop);
+	}
+
+	output.resize(static_cast<std::size_t>(out - output.data()));
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+std::experimental::optional<TextEncoding>
+textEncodingFromName(std::string const &name)
+{
+	std::string normalized(name);
+	std::transform(normalized.begin(), normalized.end(),
+	               normalized.begin(), [](unsigned char c) {
+		               return static_cast<char>(std::toupper(c));
+		       });
+
+	if(normalized == "ISO-8859-1" || normalized == "LATIN1" ||
+	   normalized == "LATIN-1")
+	{
+		return TextEncoding::Latin1;
+	}
+	if(normalized == "UTF-16LE")
+		return TextEncoding::Utf16LE;
+	if(normalized == "UTF-16BE")
+		return TextEncoding::Utf16BE;
+	if(normalized == "UTF-32LE")
+		return TextEncoding::Utf32LE;
+	if(normalized == "UTF-32BE")
+		return TextEncoding::Utf32BE;
+	return std::experimental::nullopt;
+}
+
+TextDecoder::TextDecoder(TextEncoding e)
+        : encoding(e), atStart(true), pending(), pendingLength(0)
+{
+}
+
+void TextDecoder::decode(uint8_t const *begin, uint8_t const *end,
+                         std::vector<uint8_t> &output)
+{
+	decode(begin, end, false, output);
+}
+
+void TextDecoder::finish(std::vector<uint8_t> &output)
+{
+	decode(nullptr, nullptr, true, output);
+	atStart = true;
+}
+
+void TextDecoder::decode(uint8_t const *begin, uint8_t const *end,
+                         bool final, std::vector<uint8_t> &output)
+{
+	// Every input byte becomes at most two UTF-8 bytes (Latin-1 is the
+	// worst case).
+	transcode(pending, pendingLength, begin, end, final, 2, output,
+	          [this](uint8_t const *b, uint8_t const *e, bool f,
+	                 uint8_t *&out) {
+		          return decodeChunk(encoding, atStart, b, e, f, out);
+		  });
+}
+
+TextEncoder::TextEncoder(TextEncoding e, bool bom)
+        : encoding(e),
+          byteOrderMark(bom),
+          atStart(true),
+          pending(),
+          pendingLength(0)
+{
+}
+
+void TextEncoder::encode(uint8_t const *begin, uint8_t const *end,
+                         std::vector<uint8_t> &output)
+{
+	encode(begin, end, false, output);
+}
+
+void TextEncoder::finish(std::vector<uint8_t> &output)
+{
+	encode(nullptr, nullptr, true, output);
+	atStart = true;
+}
+
+void TextEncoder::encode(uint8_t const *begin, uint8_t const *end,
+                         bool final, std::vector<uint8_t> &output)
+{
+	// Every input byte becomes at most one code unit (ASCII is the
+	// worst case).
+	transcode(pending, pendingLength, begin, end, final,
+	          unitSize(encoding), output,
+	          [this](uint8_t const *b, uint8_t const *e, bool f,
+	                 uint8_t *&out) {
+		          return encodeChunk(encoding, byteOrderMark, atStart,
+		                             b, e, f, out);
+		  });
+}
+}
+}
+}
@@ -0,0 +1,177 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_string_Transcoder_HPP
+#define qompose_core_string_Transcoder_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <experimental/optional>
+#include <string>
+#include <vector>
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+/*!
+ * The non-UTF-8 encodings which can be converted to and from UTF-8 by
+ * TextDecoder and TextEncoder.
+ */
+enum class TextEncoding
+{
+	Latin1,
+	Utf16LE,
+	Utf16BE,
+	Utf32LE,
+	Utf32BE
+};
+
+/*!
+ * Find the TextEncoding for the given encoding name (e.g. "UTF-16LE" or
+ * "ISO-8859-1"), ignoring case. Names which don't specify a byte order,
+ * like "UTF-16", aren't recognized.
+ *
+ * \param name The name of the encoding.
+ * \return The encoding, or nothing if it isn't supported.
+ */
+std::experimental::optional<TextEncoding>
+textEncodingFromName(std::string const &name);
+
+/*!
+ * \brief A TextDecoder converts text in some other encoding to UTF-8.
+ *
+ * Text can be decoded in arbitrarily sized chunks, which needn't be split
+ * on character boundaries; incomplete characters at the end of a chunk
+ * are kept until the next one arrives. This means text can be converted
+ * as it's read, with memory use bounded by the chunk size.
+ *
+ * A byte order mark at the start of the text is removed. Anything which
+ * can't be represented as valid UTF-8 (e.g. unpaired surrogates or
+ * noncharacters) is replaced with U+FFFD, so the output can always be
+ * used as a PieceTable resource.
+ *
+ * Runs of ASCII characters are converted with vector instructions where
+ * they are available.
+ */
+class TextDecoder
+{
+public:
+	/*!
+	 * \param e The encoding of the text to decode.
+	 */
+	explicit TextDecoder(TextEncoding e);
+
+	TextDecoder(TextDecoder const &) = default;
+	TextDecoder(TextDecoder &&) = default;
+	TextDecoder &operator=(TextDecoder const &) = default;
+	TextDecoder &operator=(TextDecoder &&) = default;
+
+	~TextDecoder() = default;
+
+	/*!
+	 * Decode the next chunk of text, appending the result to the given
+	 * output. The output always ends on a character boundary.
+	 *
+	 * \param begin The first byte of the chunk.
+	 * \param end The end of the chunk.
+	 * \param output The buffer to append UTF-8 text to.
+	 */
+	void decode(uint8_t const *begin, uint8_t const *end,
+	            std::vector<uint8_t> &output);
+
+	/*!
+	 * Finish decoding, appending a replacement character to the given
+	 * output if the text ended with an incomplete character. The
+	 * decoder can then be reused to decode another text.
+	 *
+	 * \param output The buffer to append UTF-8 text to.
+	 */
+	void finish(std::vector<uint8_t> &output);
+
+private:
+	TextEncoding encoding;
+	bool atStart;
+	uint8_t pending[6];
+	std::size_t pendingLength;
+
+	void decode(uint8_t const *begin, uint8_t const *end, bool final,
+	            std::vector<uint8_t> &output);
+};
+
+/*!
+ * \brief A TextEncoder converts UTF-8 text to some other encoding.
+ *
+ * This is the reverse of TextDecoder, with the same chunking behavior.
+ * Characters which can't be represented in the target encoding are
+ * replaced with U+FFFD, or with '?' for Latin-1.
+ */
+class TextEncoder
+{
+public:
+	/*!
+	 * \param e The encoding to convert text to.
+	 * \param bom Whether or not to begin the output with a byte order
+	 * mark. This is ignored for Latin-1.
+	 */
+	explicit TextEncoder(TextEncoding e, bool bom = false);
+
+	TextEncoder(TextEncoder const &) = default;
+	TextEncoder(TextEncoder &&) = default;
+	TextEncoder &operator=(TextEncoder const &) = default;
+	TextEncoder &operator=(TextEncoder &&) = default;
+
+	~TextEncoder() = default;
+
+	/*!
+	 * Encode the next chunk of UTF-8 text, appending the result to the
+	 * given output.
+	 *
+	 * \param begin The first byte of the chunk.
+	 * \param end The end of the chunk.
+	 * \param output The buffer to append encoded text to.
+	 */
+	void encode(uint8_t const *begin, uint8_t const *end,
+	            std::vector<uint8_t> &output);
+
+	/*!
+	 * Finish encoding, appending a replacement character to the given
+	 * output if the text ended with an incomplete character. The
+	 * encoder can then be reused to encode another text.
+	 *
+	 * \param output The buffer to append encoded text to.
+	 */
+	void finish(std::vector<uint8_t> &output);
+
+private:
+	TextEncoding encoding;
+	bool byteOrderMark;
+	bool atStart;
+	uint8_t pending[6];
+	std::size_t pendingLength;
+
+	void encode(uint8_t const *begin, uint8_t const *end, bool final,
+	            std::vector<uint8_t> &output);
+};
+}
+}
+}
+
+#endif
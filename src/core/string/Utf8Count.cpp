@@ -0,0 +1,127 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Utf8Count.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QOMPOSE_UTF8_COUNT_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+typedef std::size_t (*CountFunction)(uint8_t const *, uint8_t const *);
+
+/*!
+ * The portable version of the counting kernel, which handles eight bytes
+ * at a time. A continuation byte is one whose top two bits are 10.
+ */
+std::size_t countScalar(uint8_t const *begin, uint8_t const *end)
+{
+	constexpr uint64_t LOW_BITS = 0x0101010101010101ULL;
+
+	std::size_t characters = 0;
+	while(end - begin >= 8)
+	{
+		uint64_t block;
+		std::memcpy(&block, begin, sizeof(block));
+		uint64_t continuations =
+		        (block >> 7) & ~(block >> 6) & LOW_BITS;
+		characters += 8 - static_cast<std::size_t>(
+		                          __builtin_popcountll(continuations));
+		begin += 8;
+	}
+
+	for(; begin < end; ++begin)
+	{
+		if((*begin & 0xC0U) != 0x80U)
+			++characters;
+	}
+	return characters;
+}
+
+#ifdef QOMPOSE_UTF8_COUNT_X86
+__attribute__((target("sse2,popcnt"))) std::size_t
+countSse2(uint8_t const *begin, uint8_t const *end)
+{
+	// As signed bytes, continuation bytes are exactly those in the
+	// range [-128, -65].
+	__m128i const threshold = _mm_set1_epi8(-65);
+
+	std::size_t characters = 0;
+	while(end - begin >= 16)
+	{
+		__m128i block = _mm_loadu_si128(
+		        reinterpret_cast<__m128i const *>(begin));
+		int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(block, threshold));
+		characters += static_cast<std::size_t>(
+		        __builtin_popcount(static_cast<unsigned>(mask)));
+		begin += 16;
+	}
+	return characters + countScalar(begin, end);
+}
+
+__attribute__((target("avx2,popcnt"))) std::size_t
+countAvx2(uint8_t const *begin, uint8_t const *end)
+{
+	__m256i const threshold = _mm256_set1_epi8(-65);
+
+	std::size_t characters = 0;
+	while(end - begin >= 32)
+	{
+		__m256i block = _mm256_loadu_si256(
+		        reinterpret_cast<__m256i const *>(begin));
+		int mask = _mm256_movemask_epi8(
+		        _mm256_cmpgt_epi8(block, threshold));
+		characters += static_cast<std::size_t>(
+		        __builtin_popcount(static_cast<unsigned>(mask)));
+		begin += 32;
+	}
+	return characters + countScalar(begin, end);
+}
+#endif
+
+CountFunction selectCount()
+{
+#ifdef QOMPOSE_UTF8_COUNT_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+		return countAvx2;
+	if(__builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt"))
+		return countSse2;
+#endif
+	return countScalar;
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+std::size_t countUtf8Characters(uint8_t const *begin, uint8_t const *end)
+{
+	static CountFunction const count = selectCount();
+	return count(begin, end);
+}
+}
+}
+}
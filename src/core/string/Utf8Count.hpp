@@ -0,0 +1,49 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_string_Utf8Count_HPP
+#define qompose_core_string_Utf8Count_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+/*!
+ * Count the characters in the given UTF-8 bytes, by counting the bytes
+ * which aren't continuation bytes. Nothing is decoded or validated, so
+ * the result is only meaningful if the bytes are already known to be
+ * valid (see isValidUtf8).
+ *
+ * This uses the widest vector instructions the CPU supports, selected
+ * at runtime.
+ *
+ * \param begin The first byte to count.
+ * \param end The end of the range of bytes to count.
+ * \return The number of characters in the range.
+ */
+std::size_t countUtf8Characters(uint8_t const *begin, uint8_t const *end);
+}
+}
+}
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Utf8Decoder.hpp"
+
+#include <cstddef>
+
+namespace
+{
+/*
+ * Each byte is mapped to a class, which is all the state machine needs to
+ * know about it. Continuation bytes are split into ranges because of the
+ * restrictions on the second byte of some sequences, which is how
+ * overlong sequences and surrogates are rejected without decoding them.
+ */
+enum ByteClass : uint8_t
+{
+	CLASS_ASCII,
+	CLASS_CONTINUATION_80_83,
+	CLASS_CONTINUATION_84_87,
+	CLASS_CONTINUATION_88_8F,
+	CLASS_CONTINUATION_90_9F,
+	CLASS_CONTINUATION_A0_BF,
+	CLASS_INVALID,   // C0-C1 (always overlong), FE-FF
+	CLASS_LEAD_2,    // C2-DF
+	CLASS_LEAD_E0,   // Second byte must be A0-BF.
+	CLASS_LEAD_3,    // E1-EC, EE-EF
+	CLASS_LEAD_ED,   // Second byte must be 80-9F (no surrogates).
+	CLASS_LEAD_F0,   // Second byte must be 90-BF.
+	CLASS_LEAD_4,    // F1-F7
+	CLASS_LEAD_F8,   // Second byte must be 88-BF.
+	CLASS_LEAD_5,    // F9-FB
+	CLASS_LEAD_FC,   // Second byte must be 84-BF.
+	CLASS_LEAD_6,    // FD
+	CLASS_COUNT
+};
+
+/*
+ * The states of the decoder. A state other than STATE_ACCEPT or
+ * STATE_REJECT means more continuation bytes are needed.
+ */
+enum State : uint8_t
+{
+	STATE_ACCEPT,
+	STATE_REJECT,
+	STATE_NEED_1,
+	STATE_NEED_2,
+	STATE_NEED_3,
+	STATE_NEED_4,
+	STATE_NEED_5,
+	STATE_E0_SECOND,
+	STATE_ED_SECOND,
+	STATE_F0_SECOND,
+	STATE_F8_SECOND,
+	STATE_FC_SECOND,
+	STATE_COUNT
+};
+
+struct Utf8Dfa
+{
+	uint8_t byteClass[256];
+	uint8_t leadMask[CLASS_COUNT];
+	uint8_t transition[STATE_COUNT][CLASS_COUNT];
+};
+
+constexpr uint8_t classify(unsigned int byte)
+{
+	if(byte < 0x80U)
+		return CLASS_ASCII;
+	if(byte < 0x84U)
+		return CLASS_CONTINUATION_80_83;
+	if(byte < 0x88U)
+		return CLASS_CONTINUATION_84_87;
+	if(byte < 0x90U)
+		return CLASS_CONTINUATION_88_8F;
+	if(byte < 0xA0U)
+		return CLASS_CONTINUATION_90_9F;
+	if(byte < 0xC0U)
+		return CLASS_CONTINUATION_A0_BF;
+	if(byte < 0xC2U)
+		return CLASS_INVALID;
+	if(byte < 0xE0U)
+		return CLASS_LEAD_2;
+	if(byte == 0xE0U)
+		return CLASS_LEAD_E0;
+	if(byte == 0xEDU)
+		return CLASS_LEAD_ED;
+	if(byte < 0xF0U)
+		return CLASS_LEAD_3;
+	if(byte == 0xF0U)
+		return CLASS_LEAD_F0;
+	if(byte < 0xF8U)
+		return CLASS_LEAD_4;
+	if(byte == 0xF8U)
+		return CLASS_LEAD_F8;
+	if(byte < 0xFCU)
+		return CLASS_LEAD_5;
+	if(byte == 0xFCU)
+		return CLASS_LEAD_FC;
+	if(byte == 0xFDU)
+		return CLASS_LEAD_6;
+	return CLASS_INVALID;
+}
+
+constexpr bool isContinuation(unsigned int c)
+{
+	return c >= CLASS_CONTINUATION_80_83 && c <= CLASS_CONTINUATION_A0_BF;
+}
+
+constexpr Utf8Dfa makeDfa()
+{
+	Utf8Dfa dfa{};
+
+	for(unsigned int byte = 0; byte < 256; ++byte)
+		dfa.byteClass[byte] = classify(byte);
+
+	dfa.leadMask[CLASS_ASCII] = 0x7FU;
+	dfa.leadMask[CLASS_LEAD_2] = 0x1FU;
+	dfa.leadMask[CLASS_LEAD_E0] = 0x0FU;
+	dfa.leadMask[CLASS_LEAD_3] = 0x0FU;
+	dfa.leadMask[CLASS_LEAD_ED] = 0x0FU;
+	dfa.leadMask[CLASS_LEAD_F0] = 0x07U;
+	dfa.leadMask[CLASS_LEAD_4] = 0x07U;
+	dfa.leadMask[CLASS_LEAD_F8] = 0x03U;
+	dfa.leadMask[CLASS_LEAD_5] = 0x03U;
+	dfa.leadMask[CLASS_LEAD_FC] = 0x01U;
+	dfa.leadMask[CLASS_LEAD_6] = 0x01U;
+
+	for(unsigned int s = 0; s < STATE_COUNT; ++s)
+	{
+		for(unsigned int c = 0; c < CLASS_COUNT; ++c)
+			dfa.transition[s][c] = STATE_REJECT;
+	}
+
+	auto &start = dfa.transition[STATE_ACCEPT];
+	start[CLASS_ASCII] = STATE_ACCEPT;
+	start[CLASS_LEAD_2] = STATE_NEED_1;
+	start[CLASS_LEAD_E0] = STATE_E0_SECOND;
+	start[CLASS_LEAD_3] = STATE_NEED_2;
+	start[CLASS_LEAD_ED] = STATE_ED_SECOND;
+	start[CLASS_LEAD_F0] = STATE_F0_SECOND;
+	start[CLASS_LEAD_4] = STATE_NEED_3;
+	start[CLASS_LEAD_F8] = STATE_F8_SECOND;
+	start[CLASS_LEAD_5] = STATE_NEED_4;
+	start[CLASS_LEAD_FC] = STATE_FC_SECOND;
+	start[CLASS_LEAD_6] = STATE_NEED_5;
+
+	for(unsigned int c = 0; c < CLASS_COUNT; ++c)
+	{
+		if(!isContinuation(c))
+			continue;
+
+		dfa.transition[STATE_NEED_1][c] = STATE_ACCEPT;
+		dfa.transition[STATE_NEED_2][c] = STATE_NEED_1;
+		dfa.transition[STATE_NEED_3][c] = STATE_NEED_2;
+		dfa.transition[STATE_NEED_4][c] = STATE_NEED_3;
+		dfa.transition[STATE_NEED_5][c] = STATE_NEED_4;
+
+		if(c >= CLASS_CONTINUATION_A0_BF)
+			dfa.transition[STATE_E0_SECOND][c] = STATE_NEED_1;
+		if(c <= CLASS_CONTINUATION_90_9F)
+			dfa.transition[STATE_ED_SECOND][c] = STATE_NEED_1;
+		if(c >= CLASS_CONTINUATION_90_9F)
+			dfa.transition[STATE_F0_SECOND][c] = STATE_NEED_2;
+		if(c >= CLASS_CONTINUATION_88_8F)
+			dfa.transition[STATE_F8_SECOND][c] = STATE_NEED_3;
+		if(c >= CLASS_CONTINUATION_84_87)
+			dfa.transition[STATE_FC_SECOND][c] = STATE_NEED_4;
+	}
+
+	return dfa;
+}
+
+constexpr Utf8Dfa DFA = makeDfa();
+
+bool isNoncharacter(uint32_t character)
+{
+	return (character >= 0xFDD0U && character <= 0xFDEFU) ||
+	       (character <= 0x10FFFFU && (character & 0xFFFEU) == 0xFFFEU);
+}
+
+/*!
+ * Work out why the decoder rejected the given byte, which is the offset'th
+ * byte of the character starting at current.
+ */
+qompose::core::string::Utf8DecodeStatus
+describeRejection(uint8_t const *current, std::size_t offset)
+{
+	typedef qompose::core::string::Utf8DecodeStatus Status;
+
+	uint8_t byteClass = DFA.byteClass[current[offset]];
+	if(offset == 0)
+	{
+		return current[0] == 0xC0U || current[0] == 0xC1U
+		               ? Status::Overlong
+		               : Status::InvalidStartByte;
+	}
+	if(!isContinuation(byteClass))
+		return Status::InvalidContinuationByte;
+
+	// A continuation byte is only rejected if it is the second byte of
+	// a sequence with a restricted second byte.
+	return current[0] == 0xEDU ? Status::Surrogate : Status::Overlong;
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+Utf8DecodeStatus decodeUtf8Character(uint8_t const *current,
+                                     uint8_t const *end,
+                                     Utf8DecodeResult &result)
+{
+	if(*current < 0x80U)
+	{
+		result = {*current, current, current + 1};
+		return Utf8DecodeStatus::Ok;
+	}
+
+	uint8_t byteClass = DFA.byteClass[*current];
+	uint32_t value = *current & DFA.leadMask[byteClass];
+	uint8_t state = DFA.transition[STATE_ACCEPT][byteClass];
+
+	uint8_t const *next = current + 1;
+	while(state > STATE_REJECT)
+	{
+		if(next == end)
+			return Utf8DecodeStatus::Truncated;
+		state = DFA.transition[state][DFA.byteClass[*next]];
+		value = (value << 6) | (*next & 0x3FU);
+		++next;
+	}
+
+	if(state == STATE_REJECT)
+	{
+		return describeRejection(
+		        current, static_cast<std::size_t>(next - current) - 1);
+	}
+	if(isNoncharacter(value))
+		return Utf8DecodeStatus::Noncharacter;
+
+	result = {value, current, next};
+	return Utf8DecodeStatus::Ok;
+}
+
+char const *describeUtf8DecodeStatus(Utf8DecodeStatus status)
+{
+	switch(status)
+	{
+	case Utf8DecodeStatus::Ok:
+		return "No error.";
+	case Utf8DecodeStatus::InvalidStartByte:
+		return "Encountered invalid UTF-8 start byte.";
+	case Utf8DecodeStatus::InvalidContinuationByte:
+		return "Encountered invalid UTF-8 continuation byte.";
+	case Utf8DecodeStatus::Truncated:
+		return "UTF-8 bytes ended prematurely.";
+	case Utf8DecodeStatus::Overlong:
+		return "Encountered overlong UTF-8 character.";
+	case Utf8DecodeStatus::Surrogate:
+		return "Encountered invalid UTF-16 surrogate.";
+	case Utf8DecodeStatus::Noncharacter:
+		return "Encountered UTF-8 character that is permanently "
+		       "reserved for internal use.";
+	}
+	return "Unknown UTF-8 decoding error.";
+}
+}
+}
+}
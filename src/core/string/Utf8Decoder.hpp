@@ -0,0 +1,76 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_string_Utf8Decoder_HPP
+#define qompose_core_string_Utf8Decoder_HPP
+
+#include <cstdint>
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+struct Utf8DecodeResult
+{
+	uint32_t value;            // Current character's processed value.
+	uint8_t const *current;    // Current character's begin pointer.
+	uint8_t const *currentEnd; // Current character's end pointer.
+};
+
+enum class Utf8DecodeStatus
+{
+	Ok,
+	InvalidStartByte,
+	InvalidContinuationByte,
+	Truncated,
+	Overlong,
+	Surrogate,
+	Noncharacter
+};
+
+/*!
+ * Decode the single UTF-8 character starting at current, without
+ * throwing. Besides the usual 1- to 4-byte sequences, the 5- and 6-byte
+ * forms from the original UTF-8 definition are accepted. Overlong
+ * sequences, UTF-16 surrogates and noncharacters are rejected.
+ *
+ * Decoding is done by a small table-driven state machine (in the style
+ * of Bjoern Hoehrmann's decoder), with a separate fast path for ASCII.
+ *
+ * \param current A pointer to the first byte of the character. This must
+ * be less than end.
+ * \param end The end of the range of bytes being decoded.
+ * \param result Filled in with the decoded character on success.
+ * \return Ok if the character was decoded, or the reason it is invalid.
+ */
+Utf8DecodeStatus decodeUtf8Character(uint8_t const *current,
+                                     uint8_t const *end,
+                                     Utf8DecodeResult &result);
+
+/*!
+ * \param status A decoding error.
+ * \return A human readable description of the given error.
+ */
+char const *describeUtf8DecodeStatus(Utf8DecodeStatus status);
+}
+}
+}
+
+#endif
@@ -23,19 +23,14 @@
 #include <cstdint>
 #include <iterator>
 
+#include "core/string/Utf8Decoder.hpp"
+
 namespace qompose
 {
 namespace core
 {
 namespace string
 {
-struct Utf8DecodeResult
-{
-	uint32_t value;            // Current character's processed value.
-	uint8_t const *current;    // Current character's begin pointer.
-	uint8_t const *currentEnd; // Current character's end pointer.
-};
-
 class Utf8Iterator : public std::iterator<std::bidirectional_iterator_tag,
                                           uint32_t, std::ptrdiff_t,
                                           uint32_t const *, uint32_t const &>
@@ -79,6 +74,11 @@ public:
 	reference operator*() const;
 	pointer operator->() const;
 
+	/*!
+	 * \return A pointer to the first byte of the current character.
+	 */
+	uint8_t const *getCurrent() const;
+
 private:
 	uint8_t const *begin;
 	uint8_t const *end;
@@ -18,8 +18,14 @@
 
 #include "Utf8String.hpp"
 
-#include <iterator>
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
+
+#include <boost/flyweight.hpp>
+
+#include "core/string/Utf8Count.hpp"
+#include "core/string/Utf8Validation.hpp"
 
 namespace
 {
@@ -43,6 +49,13 @@ uint8_t const *getRealUtf8BeginPointer(uint8_t const *begin, uint8_t const *end)
 
 	return begin;
 }
+
+bool isUtf8ContinuationByte(uint8_t byte)
+{
+	return (byte & 0xC0U) == 0x80U;
+}
+
+typedef boost::flyweights::flyweight<std::vector<uint8_t>> InternedBytes;
 }
 
 namespace qompose
@@ -51,20 +64,28 @@ namespace core
 {
 namespace string
 {
+constexpr Utf8String::size_type Utf8String::INLINE_CAPACITY;
+constexpr Utf8String::size_type Utf8String::CHARACTER_INDEX_STRIDE;
+
 Utf8String::Utf8String() noexcept
-        : bytes(),
-          bytesBegin(bytes.get().data()),
-          bytesEnd(bytes.get().data() + bytes.get().size()),
-          characterLength(0)
+        : owner(),
+          external(nullptr),
+          byteLength(0),
+          inlineBytes(),
+          characterLength(0),
+          characterIndex()
 {
 }
 
 Utf8String::Utf8String(uint8_t const *begin, uint8_t const *end)
-        : bytes(getRealUtf8BeginPointer(begin, end), end),
-          bytesBegin(bytes.get().data()),
-          bytesEnd(bytes.get().data() + bytes.get().size()),
-          characterLength(std::experimental::nullopt)
+        : owner(),
+          external(nullptr),
+          byteLength(0),
+          inlineBytes(),
+          characterLength(std::experimental::nullopt),
+          characterIndex()
 {
+	assign(getRealUtf8BeginPointer(begin, end), end);
 }
 
 Utf8String::Utf8String(bdrck::string::StringRef const &str)
@@ -79,11 +100,29 @@ Utf8String::Utf8String(Utf8StringRef const &str)
 {
 }
 
+Utf8String Utf8String::intern(Utf8StringRef const &str)
+{
+	uint8_t const *begin = str.data();
+	uint8_t const *end = str.data() + str.dataSize();
+	begin = getRealUtf8BeginPointer(begin, end);
+
+	auto interned = std::make_shared<InternedBytes const>(begin, end);
+	Utf8String ret;
+	ret.external = interned->get().data();
+	ret.byteLength = interned->get().size();
+	ret.owner = std::move(interned);
+	ret.characterLength = std::experimental::nullopt;
+	return ret;
+}
+
 bool Utf8String::operator==(Utf8String const &o) const
 {
-	if((bytesEnd - bytesBegin) != (o.bytesEnd - o.bytesBegin))
+	if(byteLength != o.byteLength)
 		return false;
-	return std::equal(bytesBegin, bytesEnd, o.bytesBegin);
+	// Copies of a long string, and interned strings, share their bytes.
+	if(data() == o.data())
+		return true;
+	return std::equal(data(), data() + byteLength, o.data());
 }
 
 bool Utf8String::operator!=(Utf8String const &o) const
@@ -93,12 +132,12 @@ bool Utf8String::operator!=(Utf8String const &o) const
 
 uint8_t const *Utf8String::data() const
 {
-	return bytesBegin;
+	return !!owner ? external : inlineBytes;
 }
 
 Utf8String::size_type Utf8String::dataLength() const
 {
-	return static_cast<size_type>(bytesEnd - bytesBegin);
+	return byteLength;
 }
 
 Utf8String::size_type Utf8String::dataSize() const
@@ -108,15 +147,20 @@ Utf8String::size_type Utf8String::dataSize() const
 
 bool Utf8String::empty() const
 {
-	return bytes.get().empty();
+	return byteLength == 0;
 }
 
 Utf8String::size_type Utf8String::length() const
 {
 	if(!characterLength)
 	{
-		characterLength.emplace(
-		        static_cast<size_type>(std::distance(begin(), end())));
+		// Once the bytes are known to be valid, characters can be
+		// counted without decoding them.
+		uint8_t const *begin = data();
+		uint8_t const *end = begin + byteLength;
+		if(!isValidUtf8(begin, end))
+			throw std::runtime_error("Invalid UTF-8 string.");
+		characterLength.emplace(countUtf8Characters(begin, end));
 	}
 
 	return *characterLength;
@@ -129,15 +173,13 @@ Utf8String::size_type Utf8String::size() const
 
 Utf8String::const_iterator Utf8String::begin() const
 {
-	return const_iterator(bytes.get().data(),
-	                      bytes.get().data() + bytes.get().size());
+	return const_iterator(data(), data() + byteLength);
 }
 
 Utf8String::const_iterator Utf8String::end() const
 {
-	return const_iterator(bytes.get().data(),
-	                      bytes.get().data() + bytes.get().size(),
-	                      bytes.get().data() + bytes.get().size());
+	return const_iterator(data(), data() + byteLength,
+	                      data() + byteLength);
 }
 
 Utf8String::const_reverse_iterator Utf8String::rbegin() const
@@ -150,7 +192,7 @@ Utf8String::const_reverse_iterator Utf8String::rend() const
 	return const_reverse_iterator(begin());
 }
 
-Utf8String::iterator::reference Utf8String::at(size_type pos) const
+Utf8String::iterator::value_type Utf8String::at(size_type pos) const
 {
 	if(pos >= length())
 	{
@@ -160,22 +202,72 @@ Utf8String::iterator::reference Utf8String::at(size_type pos) const
 	return (*this)[pos];
 }
 
-Utf8String::iterator::reference Utf8String::operator[](size_type pos) const
+Utf8String::iterator::value_type Utf8String::
+operator[](size_type pos) const
 {
-	auto it = begin();
-	std::advance(it, pos);
-	return *it;
+	uint8_t const *begin = data();
+	uint8_t const *end = begin + byteLength;
+
+	// If every character is a single byte, the string is pure ASCII.
+	if(length() == byteLength)
+		return begin[pos];
+
+	if(!characterIndex)
+	{
+		// length() has already validated the string, so characters
+		// can be found just by skipping continuation bytes.
+		auto index = std::make_shared<std::vector<size_type>>();
+		index->reserve(*characterLength / CHARACTER_INDEX_STRIDE + 1);
+		size_type character = 0;
+		for(uint8_t const *it = begin; it < end; ++it)
+		{
+			if(isUtf8ContinuationByte(*it))
+				continue;
+			if(character++ % CHARACTER_INDEX_STRIDE == 0)
+				index->push_back(
+				        static_cast<size_type>(it - begin));
+		}
+		characterIndex = std::move(index);
+	}
+
+	uint8_t const *position =
+	        begin + (*characterIndex)[pos / CHARACTER_INDEX_STRIDE];
+	for(size_type n = pos % CHARACTER_INDEX_STRIDE; n > 0; --n)
+	{
+		++position;
+		while(position < end && isUtf8ContinuationByte(*position))
+			++position;
+	}
+	return *const_iterator(begin, end, position);
 }
 
-Utf8String::iterator::reference Utf8String::front() const
+Utf8String::iterator::value_type Utf8String::front() const
 {
 	return *begin();
 }
 
-Utf8String::iterator::reference Utf8String::back() const
+Utf8String::iterator::value_type Utf8String::back() const
 {
 	return *rbegin();
 }
+
+void Utf8String::assign(uint8_t const *begin, uint8_t const *end)
+{
+	byteLength = static_cast<size_type>(end - begin);
+	if(byteLength <= INLINE_CAPACITY)
+	{
+		owner.reset();
+		external = nullptr;
+		std::copy(begin, end, inlineBytes);
+		return;
+	}
+
+	std::shared_ptr<uint8_t> buffer(new uint8_t[byteLength],
+	                                std::default_delete<uint8_t[]>());
+	std::copy(begin, end, buffer.get());
+	external = buffer.get();
+	owner = std::move(buffer);
+}
 }
 }
 }
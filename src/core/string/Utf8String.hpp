@@ -22,10 +22,9 @@
 #include <cstddef>
 #include <cstdint>
 #include <experimental/optional>
+#include <memory>
 #include <vector>
 
-#include <boost/flyweight.hpp>
-
 #include <bdrck/string/StringRef.hpp>
 
 #include "core/string/Utf8Iterator.hpp"
@@ -37,11 +36,31 @@ namespace core
 {
 namespace string
 {
+/*!
+ * \brief An immutable UTF-8 string.
+ *
+ * Short strings are stored inline, without any allocation. Longer
+ * strings are stored in a reference counted buffer, so copying a string
+ * never copies its bytes. Strings can also be interned explicitly (see
+ * intern()), in which case all interned strings with the same contents
+ * share a single buffer.
+ */
 class Utf8String
 {
 public:
 	typedef std::size_t size_type;
 
+	/*!
+	 * Strings with at most this many bytes are stored inline.
+	 */
+	static constexpr size_type INLINE_CAPACITY = 23;
+
+	/*!
+	 * The number of characters between the entries in the index used
+	 * for random character access (see at()).
+	 */
+	static constexpr size_type CHARACTER_INDEX_STRIDE = 64;
+
 	typedef Utf8Iterator iterator;
 	typedef Utf8Iterator const_iterator;
 	typedef Utf8ReverseIterator reverse_iterator;
@@ -70,6 +89,17 @@ public:
 
 	~Utf8String() = default;
 
+	/*!
+	 * Construct a string whose bytes are shared with every other
+	 * interned string with the same contents. This requires hashing
+	 * the string and locking a global table, so it is only worthwhile
+	 * for strings which are likely to be duplicated many times.
+	 *
+	 * \param str The contents of the new string.
+	 * \return An interned copy of the given string.
+	 */
+	static Utf8String intern(Utf8StringRef const &str);
+
 	bool operator==(Utf8String const &o) const;
 	bool operator!=(Utf8String const &o) const;
 
@@ -116,14 +146,16 @@ public:
 	const_reverse_iterator rend() const;
 
 	/*!
-	 * Random character access function, with bounds checking. Beware
-	 * that each call to this function is O(n), so using iterators
-	 * instead is much more efficient.
+	 * Random character access function, with bounds checking. If the
+	 * string is pure ASCII, this is O(1). Otherwise, the first call
+	 * builds an index of the byte offset of every
+	 * CHARACTER_INDEX_STRIDE'th character in O(n), after which each
+	 * call only scans at most CHARACTER_INDEX_STRIDE characters.
 	 *
 	 * \param pos The position of the desired character.
 	 * \return The character at the given position in the string.
 	 */
-	iterator::reference at(size_type pos) const;
+	iterator::value_type at(size_type pos) const;
 
 	/*!
 	 * A version of at() without bounds checking.
@@ -131,16 +163,24 @@ public:
 	 * \param pos The position of the desired character.
 	 * \return The character at the given position in the string.
 	 */
-	iterator::reference operator[](size_type pos) const;
+	iterator::value_type operator[](size_type pos) const;
 
-	iterator::reference front() const;
-	iterator::reference back() const;
+	iterator::value_type front() const;
+	iterator::value_type back() const;
 
 private:
-	const boost::flyweights::flyweight<std::vector<uint8_t>> bytes;
-	uint8_t const *const bytesBegin;
-	uint8_t const *const bytesEnd;
-	mutable std::experimental::optional<const size_type> characterLength;
+	// Keeps a heap allocated (or interned) buffer alive. This is null
+	// for strings stored inline.
+	std::shared_ptr<void const> owner;
+	uint8_t const *external;
+	size_type byteLength;
+	uint8_t inlineBytes[INLINE_CAPACITY];
+	mutable std::experimental::optional<size_type> characterLength;
+	// The byte offsets of every CHARACTER_INDEX_STRIDE'th character,
+	// built the first time a non-ASCII string is randomly accessed.
+	mutable std::shared_ptr<std::vector<size_type> const> characterIndex;
+
+	void assign(uint8_t const *begin, uint8_t const *end);
 };
 }
 }
@@ -22,6 +22,9 @@
 #include <iterator>
 #include <stdexcept>
 
+#include "core/string/Utf8Count.hpp"
+#include "core/string/Utf8Validation.hpp"
+
 namespace qompose
 {
 namespace core
@@ -67,7 +70,9 @@ Utf8StringRef::size_type Utf8StringRef::dataLength() const
 
 Utf8StringRef::size_type Utf8StringRef::size() const
 {
-	return static_cast<size_type>(std::distance(begin(), end()));
+	if(!isValidUtf8(beginPtr, endPtr))
+		throw std::runtime_error("Invalid UTF-8 string.");
+	return countUtf8Characters(beginPtr, endPtr);
 }
 
 Utf8StringRef::size_type Utf8StringRef::length() const
@@ -0,0 +1,252 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Utf8Validation.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "core/string/Utf8Decoder.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QOMPOSE_UTF8_VALIDATION_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+/*!
+ * Ranges are split into chunks of about this many bytes to be validated
+ * in parallel. Each chunk is validated in blocks of VALIDATION_BLOCK_SIZE
+ * bytes, checking between blocks whether another chunk has already been
+ * found to be invalid.
+ */
+constexpr std::size_t PARALLEL_CHUNK_SIZE = 4 * 1024 * 1024;
+constexpr std::size_t VALIDATION_BLOCK_SIZE = 256 * 1024;
+
+// The longest sequence our decoder accepts; see Utf8Decoder.
+constexpr std::size_t MAXIMUM_CHARACTER_LENGTH = 6;
+
+typedef uint8_t const *(*AsciiSkipFunction)(uint8_t const *,
+                                             uint8_t const *);
+
+/*!
+ * Return a pointer to the first non-ASCII byte in the given range, or
+ * end if there is none. This portable version checks eight bytes at a
+ * time.
+ */
+uint8_t const *skipAsciiScalar(uint8_t const *begin, uint8_t const *end)
+{
+	constexpr uint64_t HIGH_BITS = 0x8080808080808080ULL;
+	while(end - begin >= 8)
+	{
+		uint64_t block;
+		std::memcpy(&block, begin, sizeof(block));
+		if((block & HIGH_BITS) != 0)
+			break;
+		begin += 8;
+	}
+
+	while(begin < end && *begin < 0x80U)
+		++begin;
+	return begin;
+}
+
+#ifdef QOMPOSE_UTF8_VALIDATION_X86
+std::ptrdiff_t firstSetBit(int mask)
+{
+	return __builtin_ctz(static_cast<unsigned>(mask));
+}
+
+__attribute__((target("sse2"))) uint8_t const *
+skipAsciiSse2(uint8_t const *begin, uint8_t const *end)
+{
+	while(end - begin >= 16)
+	{
+		__m128i block = _mm_loadu_si128(
+		        reinterpret_cast<__m128i const *>(begin));
+		int mask = _mm_movemask_epi8(block);
+		if(mask != 0)
+			return begin + firstSetBit(mask);
+		begin += 16;
+	}
+	return skipAsciiScalar(begin, end);
+}
+
+__attribute__((target("avx2"))) uint8_t const *
+skipAsciiAvx2(uint8_t const *begin, uint8_t const *end)
+{
+	// Check two vectors per iteration, so the loop is limited by
+	// loads rather than by the branch.
+	while(end - begin >= 64)
+	{
+		__m256i first = _mm256_loadu_si256(
+		        reinterpret_cast<__m256i const *>(begin));
+		__m256i second = _mm256_loadu_si256(
+		        reinterpret_cast<__m256i const *>(begin + 32));
+		if(_mm256_movemask_epi8(_mm256_or_si256(first, second)) != 0)
+			break;
+		begin += 64;
+	}
+
+	while(end - begin >= 32)
+	{
+		__m256i block = _mm256_loadu_si256(
+		        reinterpret_cast<__m256i const *>(begin));
+		int mask = _mm256_movemask_epi8(block);
+		if(mask != 0)
+			return begin + firstSetBit(mask);
+		begin += 32;
+	}
+	return skipAsciiSse2(begin, end);
+}
+#endif
+
+bool isUtf8ContinuationByte(uint8_t byte)
+{
+	return (byte & 0xC0U) == 0x80U;
+}
+
+/*!
+ * Move the given position forward to the start of the next character,
+ * if it is in the middle of one. Valid UTF-8 never contains more than
+ * MAXIMUM_CHARACTER_LENGTH - 1 continuation bytes in a row, so if the
+ * position can't be aligned within that distance the text is invalid
+ * anyway, and the position is returned as-is.
+ */
+uint8_t const *alignToCharacter(uint8_t const *position, uint8_t const *end)
+{
+	uint8_t const *aligned = position;
+	for(std::size_t i = 1; i < MAXIMUM_CHARACTER_LENGTH; ++i)
+	{
+		if(aligned == end || !isUtf8ContinuationByte(*aligned))
+			return aligned;
+		++aligned;
+	}
+	return aligned == end || !isUtf8ContinuationByte(*aligned)
+	               ? aligned
+	               : position;
+}
+
+AsciiSkipFunction selectSkipAscii()
+{
+#ifdef QOMPOSE_UTF8_VALIDATION_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return skipAsciiAvx2;
+	if(__builtin_cpu_supports("sse2"))
+		return skipAsciiSse2;
+#endif
+	return skipAsciiScalar;
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+bool isValidUtf8(uint8_t const *begin, uint8_t const *end)
+{
+	static AsciiSkipFunction const skipAscii = selectSkipAscii();
+
+	while(begin < end)
+	{
+		begin = skipAscii(begin, end);
+
+		// Validate characters one at a time until we're back to ASCII,
+		// which can then be skipped in bulk again.
+		while(begin < end && *begin >= 0x80U)
+		{
+			Utf8DecodeResult result;
+			if(decodeUtf8Character(begin, end, result) !=
+			   Utf8DecodeStatus::Ok)
+			{
+				return false;
+			}
+			begin = result.currentEnd;
+		}
+	}
+	return true;
+}
+
+bool isValidUtf8Parallel(uint8_t const *begin, uint8_t const *end,
+                         std::size_t threads)
+{
+	std::size_t size = static_cast<std::size_t>(end - begin);
+	std::size_t chunks =
+	        (size + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+	if(threads == 0)
+		threads = std::max(1U, std::thread::hardware_concurrency());
+	threads = std::min(threads, chunks);
+	if(threads <= 1)
+		return isValidUtf8(begin, end);
+
+	// Every chunk's boundaries are computed the same way, so the chunks
+	// exactly cover the range. Chunks may be empty, if a boundary's
+	// alignment moves it past the next one.
+	auto boundary = [=](std::size_t chunk) {
+		if(chunk >= chunks)
+			return end;
+		return alignToCharacter(begin + chunk * PARALLEL_CHUNK_SIZE,
+		                        end);
+	};
+
+	std::atomic<std::size_t> nextChunk(0);
+	std::atomic<bool> invalid(false);
+	auto work = [&]() {
+		for(std::size_t chunk = nextChunk++; chunk < chunks;
+		    chunk = nextChunk++)
+		{
+			uint8_t const *first = boundary(chunk);
+			uint8_t const *last =
+			        std::max(first, boundary(chunk + 1));
+			while(first < last && !invalid.load())
+			{
+				std::size_t remaining =
+				        static_cast<std::size_t>(last - first);
+				uint8_t const *blockEnd = alignToCharacter(
+				        first + std::min(VALIDATION_BLOCK_SIZE,
+				                         remaining),
+				        last);
+				if(!isValidUtf8(first, blockEnd))
+					invalid.store(true);
+				first = blockEnd;
+			}
+			if(invalid.load())
+				return;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(std::size_t i = 1; i < threads; ++i)
+		workers.emplace_back(work);
+	work();
+	for(auto &worker : workers)
+		worker.join();
+
+	return !invalid.load();
+}
+}
+}
+}
@@ -0,0 +1,66 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_string_Utf8Validation_HPP
+#define qompose_core_string_Utf8Validation_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+/*!
+ * Check whether the given bytes are valid UTF-8, according to exactly
+ * the same rules Utf8Iterator uses when decoding: 5- and 6-byte sequences
+ * are accepted, but overlong sequences, UTF-16 surrogates and
+ * noncharacters are not.
+ *
+ * Runs of ASCII are skipped using the widest vector instructions the CPU
+ * supports (selected at runtime), so validating mostly-ASCII text is
+ * limited by memory bandwidth rather than by branching on every byte.
+ *
+ * \param begin The first byte to validate.
+ * \param end The end of the range of bytes to validate.
+ * \return Whether or not the range contains only valid UTF-8.
+ */
+bool isValidUtf8(uint8_t const *begin, uint8_t const *end);
+
+/*!
+ * Check whether the given bytes are valid UTF-8, exactly as
+ * isValidUtf8() does, but using several threads for large ranges. The
+ * range is split into chunks which begin on character boundaries, and
+ * which are validated independently; as soon as any chunk is found to be
+ * invalid, the remaining chunks are skipped.
+ *
+ * \param begin The first byte to validate.
+ * \param end The end of the range of bytes to validate.
+ * \param threads The maximum number of threads to use, or 0 to use one
+ * per hardware thread.
+ * \return Whether or not the range contains only valid UTF-8.
+ */
+bool isValidUtf8Parallel(uint8_t const *begin, uint8_t const *end,
+                         std::size_t threads = 0);
+}
+}
+}
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WhitespaceTrimmer.hpp"
+
+#include <algorithm>
+
+namespace
+{
+bool isTrimmable(uint8_t byte)
+{
+	return byte == ' ' || byte == '\t' || byte == '\v' || byte == '\f';
+}
+
+bool isLineEnding(uint8_t byte)
+{
+	return byte == '\n' || byte == '\r';
+}
+
+/*!
+ * Return a pointer just past the first line ending in the given range, or
+ * nullptr if there is none.
+ */
+uint8_t const *afterFirstLineEnding(uint8_t const *begin, uint8_t const *end)
+{
+	uint8_t const *it = std::find_if(begin, end, isLineEnding);
+	return it == end ? nullptr : it + 1;
+}
+
+/*!
+ * Return a pointer just past the last line ending in the given range, or
+ * nullptr if there is none.
+ */
+uint8_t const *afterLastLineEnding(uint8_t const *begin, uint8_t const *end)
+{
+	for(uint8_t const *it = end; it > begin; --it)
+	{
+		if(isLineEnding(*(it - 1)))
+			return it;
+	}
+	return nullptr;
+}
+}
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+WhitespaceTrimmer::WhitespaceTrimmer() : pending()
+{
+}
+
+void WhitespaceTrimmer::trim(uint8_t const *begin, uint8_t const *end,
+                             std::vector<uint8_t> &output)
+{
+	// Bytes are copied in runs: everything before emitted has already
+	// been copied (or dropped), and whitespace from run onwards may
+	// still turn out to be trailing.
+	uint8_t const *emitted = begin;
+	uint8_t const *run = nullptr;
+	for(uint8_t const *it = begin; it < end; ++it)
+	{
+		if(isTrimmable(*it))
+		{
+			if(run == nullptr)
+				run = it;
+			continue;
+		}
+
+		if(isLineEnding(*it))
+		{
+			output.insert(output.end(), emitted,
+			              run != nullptr ? run : it);
+			emitted = it;
+			pending.clear();
+		}
+		else if(!pending.empty())
+		{
+			// Whitespace held back from previous chunks always
+			// comes before anything in this one.
+			output.insert(output.end(), pending.begin(),
+			              pending.end());
+			pending.clear();
+		}
+		run = nullptr;
+	}
+
+	output.insert(output.end(), emitted, run != nullptr ? run : end);
+	if(run != nullptr)
+		pending.insert(pending.end(), run, end);
+}
+
+void WhitespaceTrimmer::finish()
+{
+	pending.clear();
+}
+
+EditedLineTrimmer::EditedLineTrimmer(uint8_t const *sb, uint8_t const *se,
+                                     SpanVisitor const &v)
+        : sourceBegin(sb),
+          sourceEnd(se),
+          visitor(v),
+          trimmer(),
+          trimmed(),
+          rangeBegin(nullptr),
+          rangeEnd(nullptr),
+          lineBegin(nullptr),
+          lineEnd(nullptr),
+          editing(false)
+{
+}
+
+bool EditedLineTrimmer::trim(uint8_t const *begin, uint8_t const *end)
+{
+	if(begin == end)
+		return true;
+
+	if(begin >= sourceBegin && end <= sourceEnd)
+	{
+		if(begin == rangeEnd)
+		{
+			rangeEnd = end;
+			return true;
+		}
+		bool r = finishRange();
+		rangeBegin = begin;
+		rangeEnd = end;
+		return r;
+	}
+
+	// Text which isn't from the source was added by an edit, and so
+	// was the line any held back text belongs to.
+	if(!finishRange() || !trimEdited(lineBegin, lineEnd))
+		return false;
+	lineBegin = lineEnd = nullptr;
+	editing = !isLineEnding(*(end - 1));
+	return trimEdited(begin, end);
+}
+
+bool EditedLineTrimmer::finish()
+{
+	bool r = finishRange();
+
+	// A line held back at the very end of the text is only unedited if
+	// it is also the end of the source.
+	if(r && lineBegin != lineEnd)
+	{
+		r = lineEnd == sourceEnd ? visitor(lineBegin, lineEnd)
+		                         : trimEdited(lineBegin, lineEnd);
+	}
+	lineBegin = lineEnd = nullptr;
+	editing = false;
+	trimmer.finish();
+	return r;
+}
+
+bool EditedLineTrimmer::trimEdited(uint8_t const *begin, uint8_t const *end)
+{
+	if(begin == end)
+		return true;
+	trimmed.clear();
+	trimmer.trim(begin, end, trimmed);
+	return trimmed.empty() ||
+	       visitor(trimmed.data(), trimmed.data() + trimmed.size());
+}
+
+bool EditedLineTrimmer::finishRange()
+{
+	uint8_t const *begin = rangeBegin;
+	uint8_t const *end = rangeEnd;
+	rangeBegin = rangeEnd = nullptr;
+	if(begin == end)
+		return true;
+
+	// If a line was already in progress, this range continues it after
+	// a break, and if the range starts partway through a line of the
+	// source, the start of that line was removed. Either way, the
+	// range's first line was edited.
+	bool continues = editing || lineBegin != lineEnd;
+	if(continues || (begin != sourceBegin && !isLineEnding(*(begin - 1))))
+	{
+		if(!trimEdited(lineBegin, lineEnd))
+			return false;
+		lineBegin = lineEnd = nullptr;
+
+		uint8_t const *next = afterFirstLineEnding(begin, end);
+		editing = next == nullptr;
+		if(!trimEdited(begin, editing ? end : next))
+			return false;
+		if(editing)
+			return true;
+		begin = next;
+	}
+
+	// Lines which end within the range are unedited. Whatever follows
+	// the last of them is held back until we know whether its line
+	// continues elsewhere.
+	uint8_t const *last = afterLastLineEnding(begin, end);
+	if(last != nullptr)
+	{
+		if(!visitor(begin, last))
+			return false;
+		begin = last;
+	}
+	lineBegin = begin;
+	lineEnd = end;
+	return true;
+}
+}
+}
+}
@@ -0,0 +1,156 @@
+/*
+ * Qompose - A simple programmer's text editor.
+ * Copyright (C) 2013 Axel Rasmussen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef qompose_core_string_WhitespaceTrimmer_HPP
+#define qompose_core_string_WhitespaceTrimmer_HPP
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace qompose
+{
+namespace core
+{
+namespace string
+{
+/*!
+ * \brief A WhitespaceTrimmer removes trailing whitespace from UTF-8 text.
+ *
+ * Text can be trimmed one chunk at a time, with chunks split anywhere:
+ * whitespace at the end of a chunk is held back until the rest of its
+ * line shows whether it is trailing. Whitespace at the very end of the
+ * text is trimmed as well.
+ *
+ * Only ASCII whitespace (spaces, tabs, vertical tabs and form feeds) is
+ * trimmed, so the trimmer never needs to decode the text. Both '\n' and
+ * '\r' end a line, so any line ending style is handled.
+ */
+class WhitespaceTrimmer
+{
+public:
+	WhitespaceTrimmer();
+
+	WhitespaceTrimmer(WhitespaceTrimmer const &) = default;
+	WhitespaceTrimmer(WhitespaceTrimmer &&) = default;
+	WhitespaceTrimmer &operator=(WhitespaceTrimmer const &) = default;
+	WhitespaceTrimmer &operator=(WhitespaceTrimmer &&) = default;
+
+	~WhitespaceTrimmer() = default;
+
+	/*!
+	 * Trim the next chunk of text, appending the result to the given
+	 * output.
+	 *
+	 * \param begin The first byte of the chunk.
+	 * \param end The end of the chunk.
+	 * \param output The buffer to append trimmed text to.
+	 */
+	void trim(uint8_t const *begin, uint8_t const *end,
+	          std::vector<uint8_t> &output);
+
+	/*!
+	 * Finish trimming, discarding any whitespace held back at the end
+	 * of the text. The trimmer can then be reused to trim another text.
+	 */
+	void finish();
+
+private:
+	std::vector<uint8_t> pending;
+};
+
+/*!
+ * \brief An EditedLineTrimmer removes trailing whitespace only from lines
+ * which were edited.
+ *
+ * Text is given as a sequence of spans, e.g. those of a PieceTable which
+ * was loaded from a source file. A line which is a whole line of the
+ * source, unbroken, is unedited, and is passed on as-is, pointing into
+ * the source. Only the ends of each such range are read,
+ * to find where its first and last lines end. Every other line is trimmed
+ * with a WhitespaceTrimmer.
+ */
+class EditedLineTrimmer
+{
+public:
+	/*!
+	 * A SpanVisitor is called with each span of the result. Spans
+	 * which don't point into the source are only valid until it
+	 * returns. It returns false to stop early.
+	 */
+	typedef std::function<bool(uint8_t const *, uint8_t const *)>
+	        SpanVisitor;
+
+	/*!
+	 * \param sb The beginning of the source the text was loaded from.
+	 * \param se The end of the source the text was loaded from.
+	 * \param v The function to call with each span of the result.
+	 */
+	EditedLineTrimmer(uint8_t const *sb, uint8_t const *se,
+	                  SpanVisitor const &v);
+
+	EditedLineTrimmer(EditedLineTrimmer const &) = default;
+	EditedLineTrimmer(EditedLineTrimmer &&) = default;
+	EditedLineTrimmer &operator=(EditedLineTrimmer const &) = default;
+	EditedLineTrimmer &operator=(EditedLineTrimmer &&) = default;
+
+	~EditedLineTrimmer() = default;
+
+	/*!
+	 * Trim the next span of text. Spans of the source which follow one
+	 * another directly are treated as one unbroken range.
+	 *
+	 * \param begin The first byte of the span.
+	 * \param end The end of the span.
+	 * \return False if the visitor asked to stop, or true otherwise.
+	 */
+	bool trim(uint8_t const *begin, uint8_t const *end);
+
+	/*!
+	 * Finish trimming, passing on whatever is left of the text.
+	 *
+	 * \return False if the visitor asked to stop, or true otherwise.
+	 */
+	bool finish();
+
+private:
+	uint8_t const *sourceBegin;
+	uint8_t const *sourceEnd;
+	SpanVisitor visitor;
+
+	WhitespaceTrimmer trimmer;
+	std::vector<uint8_t> trimmed;
+
+	// The unbroken range of the source we're collecting spans into.
+	uint8_t const *rangeBegin;
+	uint8_t const *rangeEnd;
+	// The end of a range which was held back because it might be the
+	// start of an unedited line.
+	uint8_t const *lineBegin;
+	uint8_t const *lineEnd;
+	// Whether we're in the middle of a line which was edited.
+	bool editing;
+
+	bool trimEdited(uint8_t const *begin, uint8_t const *end);
+	bool finishRange();
+};
+}
+}
+}
+
+#endif